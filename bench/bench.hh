@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <thread>
+
+#include <clean-core/macros.hh>
+#include <clean-core/vector.hh>
+
+/**
+ * minimal benchmark harness for rich-log-bench
+ *
+ * Usage:
+ *
+ *   RLOG_BENCHMARK("LOG disabled at runtime")
+ *   {
+ *       for (int64_t i = 0; i < iterations; ++i)
+ *           LOGD(Bench, Debug, "value %d", i);
+ *   }
+ *
+ * each benchmark runs its loop for 'iterations' operations
+ * the harness increases the iteration count until the run is long enough to be measured reliably
+ */
+
+#define RLOG_BENCHMARK(Name) DETAIL_RLOG_BENCHMARK(Name, CC_MACRO_JOIN(_rlog_bench_, __COUNTER__))
+#define DETAIL_RLOG_BENCHMARK(Name, Fun)                                           \
+    static void Fun(int64_t iterations);                                           \
+    static ::rlog::bench::benchmark_registerer CC_MACRO_JOIN(Fun, _reg)(Name, Fun); \
+    static void Fun(int64_t iterations)
+
+namespace rlog::bench
+{
+using benchmark_fun = void (*)(int64_t iterations);
+
+struct benchmark_registerer
+{
+    benchmark_registerer(char const* name, benchmark_fun fun);
+};
+
+/// prevents the compiler from optimizing away a computed value
+template <class T>
+CC_FORCE_INLINE void do_not_optimize(T const& value)
+{
+#if defined(CC_COMPILER_MSVC)
+    static_cast<void>(reinterpret_cast<char const volatile&>(value));
+#else
+    asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+/// runs f(iterations / thread_count) on thread_count threads at the same time
+/// the reported time is wall time, i.e. ns/op is the throughput of all threads combined
+template <class F>
+void run_parallel(int thread_count, int64_t iterations, F&& f)
+{
+    cc::vector<std::thread> threads;
+    for (auto t = 0; t < thread_count; ++t)
+        threads.emplace_back([&] { f(iterations / thread_count); });
+    for (auto& t : threads)
+        t.join();
+}
+}
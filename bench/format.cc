@@ -0,0 +1,26 @@
+#include <rich-log/detail/deferred.hh>
+#include <rich-log/log.hh>
+
+#include "bench.hh"
+
+// parsing the format string at runtime vs walking the segments compiled from the literal
+
+RLOG_BENCHMARK("format, parsed at runtime")
+{
+    for (int64_t i = 0; i < iterations; ++i)
+    {
+        auto s = rlog::detail::format("frame %d took {} ms (budget: {})", i, 16.5, "60 fps");
+        rlog::bench::do_not_optimize(s);
+    }
+}
+
+RLOG_BENCHMARK("format, compiled at compile time")
+{
+    auto const budget = "60 fps";
+    auto const ms = 16.5;
+    for (int64_t i = 0; i < iterations; ++i)
+    {
+        auto s = DETAIL_RICH_LOG_CAPTURE("frame %d took {} ms (budget: {})", i, ms, budget).format();
+        rlog::bench::do_not_optimize(s);
+    }
+}
@@ -0,0 +1,122 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include <clean-core/span.hh>
+#include <clean-core/vector.hh>
+
+#include "bench.hh"
+
+namespace
+{
+struct benchmark
+{
+    char const* name;
+    rlog::bench::benchmark_fun fun;
+};
+
+cc::vector<benchmark>& all_benchmarks()
+{
+    static cc::vector<benchmark> v;
+    return v;
+}
+
+struct result
+{
+    char const* name;
+    double ns_per_op;
+    int64_t iterations;
+};
+
+double run_seconds(rlog::bench::benchmark_fun fun, int64_t iterations)
+{
+    auto const start = std::chrono::steady_clock::now();
+    fun(iterations);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void write_json_string(std::FILE* f, char const* s)
+{
+    std::fputc('"', f);
+    for (; *s; ++s)
+    {
+        if (*s == '"' || *s == '\\')
+            std::fputc('\\', f);
+        std::fputc(*s, f);
+    }
+    std::fputc('"', f);
+}
+
+// {"hardware_threads": 16, "benchmarks": [{"name": "...", "ns_per_op": 1.23, "iterations": 1000}, ...]}
+void write_json(std::FILE* f, cc::span<result const> results)
+{
+    std::fprintf(f, "{\n  \"hardware_threads\": %u,\n  \"benchmarks\": [", std::thread::hardware_concurrency());
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        std::fprintf(f, "%s\n    {\"name\": ", i == 0 ? "" : ",");
+        write_json_string(f, results[i].name);
+        std::fprintf(f, ", \"ns_per_op\": %.3f, \"iterations\": %lld}", results[i].ns_per_op, (long long)results[i].iterations);
+    }
+    std::fprintf(f, "\n  ]\n}\n");
+}
+}
+
+rlog::bench::benchmark_registerer::benchmark_registerer(char const* name, benchmark_fun fun) { all_benchmarks().push_back({name, fun}); }
+
+// Usage: rich-log-bench [--json <file>] [name filter]
+//   --json writes the results as JSON to the given file (or to stdout if the file is "-", the table is omitted then)
+int main(int argc, char** argv)
+{
+    char const* filter = nullptr;
+    char const* json_path = nullptr;
+    for (auto i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            json_path = argv[++i];
+        else
+            filter = argv[i];
+    }
+
+    auto const json_to_stdout = json_path && std::strcmp(json_path, "-") == 0;
+    cc::vector<result> results;
+
+    for (auto const& b : all_benchmarks())
+    {
+        if (filter && !std::strstr(b.name, filter))
+            continue;
+
+        // grow the iteration count until a run takes at least 0.2s
+        int64_t iterations = 1;
+        auto seconds = run_seconds(b.fun, iterations);
+        while (seconds < 0.2 && iterations < (int64_t(1) << 40))
+        {
+            iterations *= seconds < 0.02 ? 10 : 2;
+            seconds = run_seconds(b.fun, iterations);
+        }
+
+        auto const ns_per_op = seconds * 1e9 / double(iterations);
+        results.push_back({b.name, ns_per_op, iterations});
+
+        if (!json_to_stdout)
+            std::printf("%-60s %12.2f ns/op  (%lld iterations)\n", b.name, ns_per_op, (long long)iterations);
+    }
+
+    if (json_to_stdout)
+    {
+        write_json(stdout, results);
+    }
+    else if (json_path)
+    {
+        auto const f = std::fopen(json_path, "w");
+        if (!f)
+        {
+            std::fprintf(stderr, "cannot open '%s'\n", json_path);
+            return 1;
+        }
+        write_json(f, results);
+        std::fclose(f);
+    }
+
+    return 0;
+}
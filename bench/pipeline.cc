@@ -0,0 +1,466 @@
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+#include <clean-core/macros.hh>
+#include <clean-core/span.hh>
+#include <clean-core/string.hh>
+#include <clean-core/string_view.hh>
+
+#ifdef CC_OS_WINDOWS
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <rich-log/console.hh>
+#include <rich-log/flight_recorder.hh>
+#include <rich-log/gzip.hh>
+#include <rich-log/log.hh>
+#include <rich-log/logger.hh>
+#include <rich-log/sink.hh>
+#include <rich-log/site_stats.hh>
+#include <rich-log/structured_sink.hh>
+#include <rich-log/text_file_logger.hh>
+
+#include "bench.hh"
+
+// costs of the individual stages of a LOG call:
+//   - LOGs that are disabled at compile time, at run time, or by a rate limiter (also with per-site stats or the flight recorder)
+//   - formatting a single argument through rlog::detail::formatter
+//   - the built-in default logger (writing to the null device), also with contention on its mutex
+//   - local logger stacks (scoped_logger_override)
+//   - structured messages (LOGS) serialized by the JSON lines and logfmt sinks
+//   - rotating text files with background compression
+
+RICH_LOG_DECLARE_DOMAIN_DETAIL(BenchWarningsOnly, Warning, extern);
+RICH_LOG_DEFINE_DOMAIN(BenchWarningsOnly, "BenchWarningsOnly");
+
+namespace
+{
+// redirects stdout (where the default logger writes Info messages) to the null device while alive
+struct scoped_stdout_to_null
+{
+#ifdef CC_OS_WINDOWS
+    int saved_fd = -1;
+
+    scoped_stdout_to_null()
+    {
+        std::fflush(stdout);
+        saved_fd = _dup(_fileno(stdout));
+        auto const null_fd = _open("NUL", _O_WRONLY);
+        _dup2(null_fd, _fileno(stdout));
+        _close(null_fd);
+    }
+
+    ~scoped_stdout_to_null()
+    {
+        std::fflush(stdout);
+        _dup2(saved_fd, _fileno(stdout));
+        _close(saved_fd);
+    }
+#else
+    int saved_fd = -1;
+
+    scoped_stdout_to_null()
+    {
+        std::fflush(stdout);
+        saved_fd = ::dup(fileno(stdout));
+        auto const null_fd = ::open("/dev/null", O_WRONLY);
+        ::dup2(null_fd, fileno(stdout));
+        ::close(null_fd);
+    }
+
+    ~scoped_stdout_to_null()
+    {
+        std::fflush(stdout);
+        ::dup2(saved_fd, fileno(stdout));
+        ::close(saved_fd);
+    }
+#endif
+
+    scoped_stdout_to_null(scoped_stdout_to_null const&) = delete;
+    scoped_stdout_to_null& operator=(scoped_stdout_to_null const&) = delete;
+};
+
+rlog::location g_bench_location = {"bench", "pipeline.cc", 1};
+
+rlog::message_ref make_message(rlog::domain_info const& domain, cc::string_view text)
+{
+    rlog::message_ref msg;
+    msg.timestamp = rlog::get_current_timestamp();
+    msg.location = &g_bench_location;
+    msg.domain = &domain;
+    msg.verbosity = rlog::verbosity::Info;
+    msg.thread_name = "bench";
+    msg.message = text;
+    return msg;
+}
+}
+
+//
+// disabled LOGs
+//
+
+RLOG_BENCHMARK("LOG disabled at compile time")
+{
+    for (int64_t i = 0; i < iterations; ++i)
+        LOGD(BenchWarningsOnly, Info, "value %d in {}", i, "some text");
+}
+
+RLOG_BENCHMARK("LOG disabled at runtime")
+{
+    // Debug is below the runtime minimum of the Default domain
+    for (int64_t i = 0; i < iterations; ++i)
+        LOGD(Default, Debug, "value %d in {}", i, "some text");
+}
+
+RLOG_BENCHMARK("LOG disabled at runtime, site stats enabled")
+{
+    rlog::enable_log_site_stats();
+    for (int64_t i = 0; i < iterations; ++i)
+        LOGD(Default, Debug, "value %d in {}", i, "some text");
+    rlog::enable_log_site_stats(false);
+}
+
+RLOG_BENCHMARK("LOG disabled at runtime, recorded by the flight recorder")
+{
+    rlog::flight::enable();
+    for (int64_t i = 0; i < iterations; ++i)
+        LOGD(Default, Debug, "value %d in {}", i, "some text");
+    rlog::flight::disable();
+}
+
+RLOG_BENCHMARK("LOG rate-limited (every_nth, 1 in 1000 passes)")
+{
+    auto const discard = rlog::scoped_logger_override([](rlog::message_ref, bool&) { return true; });
+
+    static rlog::rate::every_nth limiter{1000};
+    for (int64_t i = 0; i < iterations; ++i)
+        LOGD_ONCE(limiter, Default, Info, "value %d in {}", i, "some text");
+}
+
+RLOG_BENCHMARK("LOG to discarding logger, site stats enabled")
+{
+    auto const discard = rlog::scoped_logger_override([](rlog::message_ref, bool&) { return true; });
+
+    rlog::enable_log_site_stats();
+    for (int64_t i = 0; i < iterations; ++i)
+        LOG("value %d in {}", i, "some text");
+    rlog::enable_log_site_stats(false);
+}
+
+//
+// formatting per argument type
+//
+
+namespace
+{
+struct custom_type
+{
+    float x, y, z;
+};
+
+cc::string to_string(custom_type const& v)
+{
+    // a typical user-defined to_string that allocates
+    char buffer[64];
+    auto const len = std::snprintf(buffer, sizeof(buffer), "(%g, %g, %g)", v.x, v.y, v.z);
+    return cc::string(cc::string_view(buffer, size_t(len)));
+}
+
+template <class T>
+void bench_format_arg(T const& value, int64_t iterations)
+{
+    size_t size = 0;
+    auto const count = [&](cc::span<char const> chars) { size += chars.size(); };
+    for (int64_t i = 0; i < iterations; ++i)
+    {
+        rlog::detail::formatter::do_format(count, value, {});
+        rlog::bench::do_not_optimize(size);
+    }
+}
+}
+
+#define RLOG_BENCH_FORMAT_ARG(TypeName, ...)     \
+    RLOG_BENCHMARK("format argument: " TypeName) \
+    {                                            \
+        static auto const value = __VA_ARGS__;   \
+        bench_format_arg(value, iterations);     \
+    }                                            \
+    CC_FORCE_SEMICOLON
+
+RLOG_BENCH_FORMAT_ARG("bool", true);
+RLOG_BENCH_FORMAT_ARG("char", 'x');
+RLOG_BENCH_FORMAT_ARG("int", 123456);
+RLOG_BENCH_FORMAT_ARG("int64_t", int64_t(-1234567890123));
+RLOG_BENCH_FORMAT_ARG("float", 3.14159f);
+RLOG_BENCH_FORMAT_ARG("double", 2.718281828459045);
+RLOG_BENCH_FORMAT_ARG("char const*", static_cast<char const*>("a short c string"));
+RLOG_BENCH_FORMAT_ARG("cc::string_view", cc::string_view("a short string view"));
+RLOG_BENCH_FORMAT_ARG("cc::string", cc::string("a short cc::string"));
+RLOG_BENCH_FORMAT_ARG("custom to_string", custom_type{1.f, 2.5f, -3.f});
+
+//
+// built-in default logger
+//
+
+RLOG_BENCHMARK("default_logger_fun to null device")
+{
+    auto const _ = scoped_stdout_to_null();
+    auto const msg = make_message(Log::Default::domain, "frame 1234 took 16.5 ms (budget: 60 fps)");
+
+    for (int64_t i = 0; i < iterations; ++i)
+    {
+        auto break_on_log = false;
+        rlog::default_logger_fun(msg, break_on_log);
+    }
+}
+
+RLOG_BENCHMARK("default_logger_fun to null device, multiline")
+{
+    auto const _ = scoped_stdout_to_null();
+    auto const msg = make_message(Log::BenchWarningsOnly::domain, "first line\nsecond line\nthird line");
+
+    for (int64_t i = 0; i < iterations; ++i)
+    {
+        auto break_on_log = false;
+        rlog::default_logger_fun(msg, break_on_log);
+    }
+}
+
+RLOG_BENCHMARK("default_logger_fun to null device, buffered console")
+{
+    auto const _ = scoped_stdout_to_null();
+
+    rlog::console::config cfg;
+    cfg.buffered = true;
+    rlog::console::configure(cfg);
+
+    auto const msg = make_message(Log::Default::domain, "frame 1234 took 16.5 ms (budget: 60 fps)");
+    for (int64_t i = 0; i < iterations; ++i)
+    {
+        auto break_on_log = false;
+        rlog::default_logger_fun(msg, break_on_log);
+    }
+
+    rlog::console::configure({});
+}
+
+RLOG_BENCHMARK("LOG to null device (full pipeline)")
+{
+    auto const _ = scoped_stdout_to_null();
+    for (int64_t i = 0; i < iterations; ++i)
+        LOG("frame %d took {} ms (budget: {})", i, 16.5, "60 fps");
+}
+
+// contention: all threads write through the default logger, which serializes on its mutex
+
+namespace
+{
+void bench_default_logger_contention(int thread_count, int64_t iterations)
+{
+    auto const _ = scoped_stdout_to_null();
+    rlog::bench::run_parallel(thread_count, iterations,
+                              [](int64_t n)
+                              {
+                                  auto const msg = make_message(Log::Default::domain, "frame 1234 took 16.5 ms (budget: 60 fps)");
+                                  for (int64_t i = 0; i < n; ++i)
+                                  {
+                                      auto break_on_log = false;
+                                      rlog::default_logger_fun(msg, break_on_log);
+                                  }
+                              });
+}
+}
+
+#define RLOG_BENCH_CONTENTION(Threads)                                      \
+    RLOG_BENCHMARK("default_logger_fun contention, " #Threads " thread(s)") \
+    {                                                                       \
+        bench_default_logger_contention(Threads, iterations);               \
+    }                                                                       \
+    CC_FORCE_SEMICOLON
+
+RLOG_BENCH_CONTENTION(1);
+RLOG_BENCH_CONTENTION(2);
+RLOG_BENCH_CONTENTION(4);
+RLOG_BENCH_CONTENTION(8);
+RLOG_BENCH_CONTENTION(16);
+RLOG_BENCH_CONTENTION(32);
+
+// all threads LOG from the same site to their own discarding logger, so only the shared location can contend
+
+namespace
+{
+void bench_same_site(int thread_count, int64_t iterations)
+{
+    rlog::bench::run_parallel(thread_count, iterations,
+                              [](int64_t n)
+                              {
+                                  auto const discard = rlog::scoped_logger_override([](rlog::message_ref, bool&) { return true; });
+                                  for (int64_t i = 0; i < n; ++i)
+                                      LOG("value %d", i);
+                              });
+}
+}
+
+#define RLOG_BENCH_SAME_SITE(Threads)                           \
+    RLOG_BENCHMARK("LOG from one site, " #Threads " thread(s)") \
+    {                                                           \
+        bench_same_site(Threads, iterations);                   \
+    }                                                           \
+    CC_FORCE_SEMICOLON
+
+RLOG_BENCH_SAME_SITE(1);
+RLOG_BENCH_SAME_SITE(4);
+RLOG_BENCH_SAME_SITE(16);
+
+//
+// local logger stacks
+//
+
+namespace
+{
+// the innermost logger consumes the message, all others pass it on
+void bench_nested_overrides(int depth, int64_t iterations)
+{
+    rlog::push_local_logger(
+        [](rlog::message_ref msg, bool&)
+        {
+            rlog::bench::do_not_optimize(msg.message.size());
+            return true;
+        });
+    for (auto d = 1; d < depth; ++d)
+        rlog::push_local_logger([](rlog::message_ref, bool&) { return false; });
+
+    for (int64_t i = 0; i < iterations; ++i)
+        LOG("frame %d took {} ms", i, 16.5);
+
+    for (auto d = 0; d < depth; ++d)
+        rlog::pop_local_logger();
+}
+}
+
+#define RLOG_BENCH_NESTED_OVERRIDES(Depth)                                 \
+    RLOG_BENCHMARK("LOG through " #Depth " nested scoped_logger_override") \
+    {                                                                      \
+        bench_nested_overrides(Depth, iterations);                         \
+    }                                                                      \
+    CC_FORCE_SEMICOLON
+
+RLOG_BENCH_NESTED_OVERRIDES(1);
+RLOG_BENCH_NESTED_OVERRIDES(2);
+RLOG_BENCH_NESTED_OVERRIDES(4);
+RLOG_BENCH_NESTED_OVERRIDES(16);
+
+RLOG_BENCHMARK("LOG in scoped_logger_silence")
+{
+    auto _ = rlog::scoped_logger_silence{};
+    for (int64_t i = 0; i < iterations; ++i)
+        LOG("frame %d took {} ms", i, 16.5);
+}
+
+RLOG_BENCHMARK("LOG while another thread is silenced")
+{
+    auto is_silenced = std::atomic<bool>(false);
+    auto is_done = std::atomic<bool>(false);
+    auto t = std::thread(
+        [&]
+        {
+            auto _ = rlog::scoped_logger_silence{};
+            is_silenced = true;
+            while (!is_done.load())
+                std::this_thread::yield();
+        });
+    while (!is_silenced.load())
+        std::this_thread::yield();
+
+    auto _ = rlog::scoped_logger_override(
+        [](rlog::message_ref msg, bool&)
+        {
+            rlog::bench::do_not_optimize(msg.message.size());
+            return true;
+        });
+    for (int64_t i = 0; i < iterations; ++i)
+        LOG("frame %d took {} ms", i, 16.5);
+
+    is_done = true;
+    t.join();
+}
+
+//
+// structured messages
+//
+
+namespace
+{
+template <class Sink>
+void bench_structured_sink(int64_t iterations)
+{
+    auto const discard = [](rlog::message_ref const&, cc::string_view line) { rlog::bench::do_not_optimize(line.size()); };
+    auto const id = rlog::add_sink(cc::make_unique<Sink>(discard));
+
+    cc::string_view const path = "/api/v1/items";
+    for (int64_t i = 0; i < iterations; ++i)
+        LOGS(Default, Info, "request done", rlog::kv("latency_us", i), rlog::kv("path", path), rlog::kv("status", 200), rlog::kv("cached", true));
+
+    rlog::remove_sink(id);
+}
+}
+
+RLOG_BENCHMARK("LOGS to json_lines_sink (4 fields)")
+{
+    bench_structured_sink<rlog::json_lines_sink>(iterations);
+}
+
+RLOG_BENCHMARK("LOGS to logfmt_sink (4 fields)")
+{
+    bench_structured_sink<rlog::logfmt_sink>(iterations);
+}
+
+//
+// text files
+//
+
+RLOG_BENCHMARK("LOG to text_file_sink (rotating, compressed)")
+{
+    rlog::text_file_config cfg;
+    cfg.path_prefix = "rlog-bench-text";
+    cfg.max_file_size = 4u << 20;
+    cfg.max_files = 2;
+    auto const id = rlog::add_sink(cc::make_unique<rlog::text_file_sink>(cfg));
+
+    for (int64_t i = 0; i < iterations; ++i)
+        LOG("frame %d took {} ms", i, 16.5);
+
+    // waits for the compression of the last file
+    rlog::remove_sink(id);
+
+    for (auto f = 0; f < 64; ++f)
+    {
+        char path[64];
+        std::snprintf(path, sizeof(path), "rlog-bench-text.%06d.log.gz", f);
+        std::remove(path);
+    }
+}
+
+RLOG_BENCHMARK("gzip_encoder, per 64 byte log line")
+{
+    cc::string line;
+    cc::string out;
+    auto enc = rlog::gzip_encoder();
+    for (int64_t i = 0; i < iterations; ++i)
+    {
+        char buffer[80];
+        auto const n = std::snprintf(buffer, sizeof(buffer), "06.05.24 07:14:10 t000 INFO Net request %08lld done\n", (long long)i);
+        enc.append(cc::span<char const>(buffer, size_t(n)), out);
+        if (out.size() > 64 * 1024)
+        {
+            rlog::bench::do_not_optimize(out.size());
+            out.clear();
+        }
+    }
+    enc.finish(out);
+}
@@ -0,0 +1,93 @@
+#include <rich-log/auto_limit.hh>
+#include <rich-log/log.hh>
+#include <rich-log/logger.hh>
+
+#include "bench.hh"
+
+RLOG_BENCHMARK("rate-limited LOG_ONCE (suppressed)")
+{
+    rlog::rate::once once;
+    once.try_log(); // every LOG below is suppressed
+
+    for (int64_t i = 0; i < iterations; ++i)
+        LOG_ONCE(once, "suppressed value %d in {}", i, "some text");
+}
+
+RLOG_BENCHMARK("formatting a suppressed message (cost before rate check moved)")
+{
+    for (int64_t i = 0; i < iterations; ++i)
+    {
+        auto s = rlog::detail::format("suppressed value %d in {}", i, "some text");
+        rlog::bench::do_not_optimize(s);
+    }
+}
+
+// contention benchmarks: all threads hammer the same (static) limiter
+// each limiter is set up so that nearly all calls are suppressed, which is the hot case in practice
+
+namespace
+{
+template <class Limiter>
+void bench_limiter(Limiter& limiter, int thread_count, int64_t iterations)
+{
+    rlog::bench::run_parallel(thread_count, iterations,
+                              [&](int64_t n)
+                              {
+                                  auto passed = 0;
+                                  for (int64_t i = 0; i < n; ++i)
+                                      passed += rlog::detail::pass_rate_limit(&limiter);
+                                  rlog::bench::do_not_optimize(passed);
+                              });
+}
+}
+
+#define RLOG_BENCH_LIMITER(Name, Threads, ...)                 \
+    RLOG_BENCHMARK("limiter " Name ", " #Threads " thread(s)") \
+    {                                                          \
+        static __VA_ARGS__;                                    \
+        bench_limiter(limiter, Threads, iterations);           \
+    }                                                          \
+    CC_FORCE_SEMICOLON
+
+RLOG_BENCH_LIMITER("once", 1, rlog::rate::once limiter);
+RLOG_BENCH_LIMITER("once", 4, rlog::rate::once limiter);
+RLOG_BENCH_LIMITER("once", 16, rlog::rate::once limiter);
+
+RLOG_BENCH_LIMITER("time_limited", 1, rlog::rate::time_limited limiter{1.0});
+RLOG_BENCH_LIMITER("time_limited", 4, rlog::rate::time_limited limiter{1.0});
+RLOG_BENCH_LIMITER("time_limited", 16, rlog::rate::time_limited limiter{1.0});
+
+RLOG_BENCH_LIMITER("token_bucket", 1, rlog::rate::token_bucket limiter{10, 1.0});
+RLOG_BENCH_LIMITER("token_bucket", 4, rlog::rate::token_bucket limiter{10, 1.0});
+RLOG_BENCH_LIMITER("token_bucket", 16, rlog::rate::token_bucket limiter{10, 1.0});
+
+RLOG_BENCH_LIMITER("every_nth", 1, rlog::rate::every_nth limiter{1000});
+RLOG_BENCH_LIMITER("every_nth", 4, rlog::rate::every_nth limiter{1000});
+RLOG_BENCH_LIMITER("every_nth", 16, rlog::rate::every_nth limiter{1000});
+
+RLOG_BENCH_LIMITER("exponential_backoff", 1, rlog::rate::exponential_backoff limiter);
+RLOG_BENCH_LIMITER("exponential_backoff", 4, rlog::rate::exponential_backoff limiter);
+RLOG_BENCH_LIMITER("exponential_backoff", 16, rlog::rate::exponential_backoff limiter);
+
+// automatic rate limit: a loop that keeps logging the same site, as in a misbehaving server
+// the messages never reach the (discarding) logger, except for the first burst and the summaries
+
+RLOG_BENCHMARK("LOG with auto limit (identical messages, collapsed)")
+{
+    auto const discard = rlog::scoped_logger_override([](rlog::message_ref, bool&) { return true; });
+
+    rlog::rate::set_auto_limit({});
+    for (int64_t i = 0; i < iterations; ++i)
+        LOG("value %d in {}", 17, "some text");
+    rlog::rate::disable_auto_limit();
+}
+
+RLOG_BENCHMARK("LOG with auto limit (distinct messages, over budget)")
+{
+    auto const discard = rlog::scoped_logger_override([](rlog::message_ref, bool&) { return true; });
+
+    rlog::rate::set_auto_limit({});
+    for (int64_t i = 0; i < iterations; ++i)
+        LOG("value %d in {}", i, "some text");
+    rlog::rate::disable_auto_limit();
+}
@@ -0,0 +1,880 @@
+#include "async.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include <clean-core/macros.hh>
+#include <clean-core/string.hh>
+#include <clean-core/utility.hh>
+#include <clean-core/vector.hh>
+
+#include <rich-log/crash_handler.hh>
+#include <rich-log/detail/deferred.hh>
+#include <rich-log/domain.hh>
+#include <rich-log/location.hh>
+#include <rich-log/log.hh>
+#include <rich-log/log_line.hh>
+#include <rich-log/timestamp.hh>
+
+namespace
+{
+enum record_kind : uint32_t
+{
+    record_padding = 0, // skip to the start of the buffer
+    record_message = 1,
+    record_deferred = 2, // payload is a deferred_payload header followed by serialized arguments
+};
+
+// every record starts with this prefix
+// padding records consist only of the prefix (they can be as small as 8 byte)
+struct record_prefix
+{
+    uint32_t size; // total size in bytes, including header, payload, and alignment
+    uint32_t kind;
+};
+
+// full header of a message or deferred record
+// followed by thread_name_size + message_size + fields_size bytes of payload
+struct record_header
+{
+    record_prefix prefix;
+    rlog::timestamp timestamp; // monotonic part is used to merge buffers
+    rlog::location const* location;
+    rlog::domain_info const* domain;
+    int32_t verbosity;
+    uint16_t thread_id;
+    uint16_t thread_name_size; // bytes of the name in the payload, 0 if thread_name is set
+    char const* thread_name;   // interned name (see rlog::detail::has_interned_thread_name), only copied otherwise
+    uint32_t message_size;
+    uint32_t fields_size; // encoded message_ref::fields (see encode_fields)
+};
+
+// start of the payload of deferred records
+struct deferred_payload
+{
+    decltype(rlog::detail::deferred_vtable::format_serialized) format_serialized;
+    rlog::detail::format_string fmt_str;
+};
+
+constexpr size_t record_alignment = 8;
+constexpr size_t max_thread_name_size = 31;
+
+constexpr size_t align_record_size(size_t s) { return (s + record_alignment - 1) & ~(record_alignment - 1); }
+
+cc::string_view thread_name_of(record_header const& h, char const* payload)
+{
+    return h.thread_name ? cc::string_view(h.thread_name) : cc::string_view(payload, h.thread_name_size);
+}
+
+void append_bytes(cc::vector<std::byte>& out, void const* data, size_t size)
+{
+    auto const offset = out.size();
+    out.resize(offset + size);
+    std::memcpy(out.data() + offset, data, size);
+}
+
+void append_string(cc::vector<std::byte>& out, cc::string_view s)
+{
+    auto const size = uint32_t(s.size());
+    append_bytes(out, &size, 4);
+    append_bytes(out, s.data(), s.size());
+}
+
+// encoded fields:
+//   [uint32 count]
+//   per field: [uint8 field_type][uint32 key size][key] followed by either 8 byte (scalars) or [uint32 size][chars] (string, other)
+// values of type 'other' are formatted here, because the referenced arguments are gone once the LOG call returns
+void encode_fields(cc::vector<std::byte>& out, cc::span<rlog::field const> fields)
+{
+    out.clear();
+
+    auto const count = uint32_t(fields.size());
+    append_bytes(out, &count, 4);
+
+    for (auto const& f : fields)
+    {
+        auto const type = uint8_t(f.type);
+        append_bytes(out, &type, 1);
+        append_string(out, f.key);
+
+        switch (f.type)
+        {
+        case rlog::field_type::signed_int:
+        case rlog::field_type::unsigned_int:
+        case rlog::field_type::floating_point:
+            append_bytes(out, &f.u, 8); // all share the same 8 byte
+            break;
+        case rlog::field_type::boolean:
+        {
+            uint64_t const b = f.b ? 1 : 0;
+            append_bytes(out, &b, 8);
+            break;
+        }
+        case rlog::field_type::string:
+            append_string(out, f.str);
+            break;
+        case rlog::field_type::other:
+        {
+            auto const size_offset = out.size();
+            append_string(out, {});
+            f.format_value([&](cc::span<char const> chars) { append_bytes(out, chars.data(), chars.size()); });
+
+            auto const size = uint32_t(out.size() - size_offset - 4);
+            std::memcpy(out.data() + size_offset, &size, 4);
+            break;
+        }
+        }
+    }
+}
+
+// the decoded fields view 'data'
+void decode_fields(cc::vector<rlog::field>& out, std::byte const* data)
+{
+    out.clear();
+
+    auto const read_string = [&]
+    {
+        uint32_t size;
+        std::memcpy(&size, data, 4);
+        auto const s = cc::string_view(reinterpret_cast<char const*>(data + 4), size);
+        data += 4 + size;
+        return s;
+    };
+
+    uint32_t count;
+    std::memcpy(&count, data, 4);
+    data += 4;
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        rlog::field f;
+        f.type = rlog::field_type(uint8_t(*data++));
+        f.key = read_string();
+
+        switch (f.type)
+        {
+        case rlog::field_type::signed_int:
+        case rlog::field_type::unsigned_int:
+        case rlog::field_type::floating_point:
+            std::memcpy(&f.u, data, 8);
+            data += 8;
+            break;
+        case rlog::field_type::boolean:
+        {
+            uint64_t b;
+            std::memcpy(&b, data, 8);
+            f.b = b != 0;
+            data += 8;
+            break;
+        }
+        case rlog::field_type::string:
+        case rlog::field_type::other:
+            f.str = read_string();
+            break;
+        }
+
+        out.push_back(f);
+    }
+}
+
+enum class write_result
+{
+    written,
+    dropped,
+    disabled, // async logging was shut down while waiting for space
+};
+
+std::atomic<bool> g_async_enabled = {false};
+std::atomic<rlog::async::overflow_policy> g_overflow_policy = {rlog::async::overflow_policy::block};
+std::atomic<uint64_t> g_total_dropped = {0};
+
+// the background thread must never log into its own buffer (it would wait for itself)
+thread_local bool tls_is_consumer = false;
+
+void wake_consumer();
+
+// single producer (owning thread), single consumer (background thread) byte ring buffer
+// positions increase monotonically and are only masked on access
+// with drop_oldest, the producer may also advance read_pos (both sides use CAS for that)
+struct thread_buffer
+{
+    explicit thread_buffer(size_t capacity) : capacity(capacity), mask(capacity - 1) { data.resize(capacity); }
+
+    size_t const capacity;
+    size_t const mask;
+    cc::vector<std::byte> data;
+
+    alignas(64) std::atomic<uint64_t> write_pos = {0};
+    alignas(64) std::atomic<uint64_t> read_pos = {0};
+    std::atomic<uint64_t> dispatch_end = {0}; // records before it are being dispatched by the background thread
+    std::atomic<uint64_t> dropped = {0};
+    std::atomic<bool> orphaned = {false}; // set when the owning thread exits
+
+    // large messages are truncated so that a single record can never clog the buffer
+    size_t max_payload_size() const { return capacity / 4 - sizeof(record_header) - max_thread_name_size; }
+
+    // called by the owning thread
+    // if 'deferred' is set, the payload is the serialized arguments (deferred_size must fit into max_payload_size)
+    // 'fields' are the encoded message fields (see encode_fields), they must fit into max_payload_size as well
+    write_result write(rlog::message_ref const& msg, //
+                       rlog::detail::deferred_message const* deferred,
+                       size_t deferred_size,
+                       cc::span<std::byte const> fields)
+    {
+        auto const is_interned = rlog::detail::has_interned_thread_name(msg);
+        auto const thread_name_size = is_interned ? 0 : cc::min(msg.thread_name.size(), max_thread_name_size);
+        auto message_size = deferred ? deferred_size : msg.message.size();
+
+        if (message_size > max_payload_size() - fields.size())
+            message_size = max_payload_size() - fields.size();
+
+        auto const size = align_record_size(sizeof(record_header) + thread_name_size + message_size + fields.size());
+
+        auto const head = write_pos.load(std::memory_order_relaxed);
+        auto const contiguous = capacity - (head & mask);
+        auto const needed = contiguous < size ? contiguous + size : size;
+
+        while (head + needed - read_pos.load(std::memory_order_acquire) > capacity)
+        {
+            if (!g_async_enabled.load(std::memory_order_relaxed))
+                return write_result::disabled;
+
+            switch (g_overflow_policy.load(std::memory_order_relaxed))
+            {
+            case rlog::async::overflow_policy::block:
+                wake_consumer();
+                std::this_thread::yield();
+                break;
+
+            case rlog::async::overflow_policy::drop_newest:
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return write_result::dropped;
+
+            case rlog::async::overflow_policy::drop_oldest:
+                drop_oldest_record();
+                break;
+            }
+        }
+
+        auto pos = head;
+        if (contiguous < size)
+        {
+            record_prefix const padding = {uint32_t(contiguous), record_padding};
+            std::memcpy(&data[pos & mask], &padding, sizeof(padding));
+            pos += contiguous;
+        }
+
+        record_header header;
+        header.prefix = {uint32_t(size), deferred ? record_deferred : record_message};
+        header.timestamp = msg.timestamp;
+        header.location = msg.location;
+        header.domain = msg.domain;
+        header.verbosity = msg.verbosity;
+        header.thread_id = msg.thread_id;
+        header.thread_name_size = uint16_t(thread_name_size);
+        header.thread_name = is_interned ? msg.thread_name.data() : nullptr;
+        header.message_size = uint32_t(message_size);
+        header.fields_size = uint32_t(fields.size());
+
+        auto const dst = &data[pos & mask];
+        std::memcpy(dst, &header, sizeof(header));
+        std::memcpy(dst + sizeof(header), msg.thread_name.data(), thread_name_size);
+        auto const payload = dst + sizeof(header) + thread_name_size;
+        if (deferred)
+        {
+            deferred_payload const dp = {deferred->vtable->format_serialized, deferred->fmt_str};
+            std::memcpy(payload, &dp, sizeof(dp));
+            deferred->vtable->serialize(payload + sizeof(dp), deferred->args);
+        }
+        else
+            std::memcpy(payload, msg.message.data(), message_size);
+        if (!fields.empty())
+            std::memcpy(payload + message_size, fields.data(), fields.size());
+
+        write_pos.store(head + needed, std::memory_order_release);
+        return write_result::written;
+    }
+
+    // called by the owning thread if the buffer is full (drop_oldest policy)
+    // the record at read_pos cannot change under us because only this thread writes records
+    void drop_oldest_record()
+    {
+        auto tail = read_pos.load(std::memory_order_acquire);
+        if (tail == write_pos.load(std::memory_order_relaxed))
+            return;
+
+        // records that are already being dispatched are only freed, they are not lost
+        record_prefix prefix;
+        std::memcpy(&prefix, &data[tail & mask], sizeof(prefix));
+        if (read_pos.compare_exchange_strong(tail, tail + prefix.size, std::memory_order_acq_rel) && prefix.kind != record_padding
+            && tail >= dispatch_end.load(std::memory_order_acquire))
+            dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // called by the background thread
+    // appends the available message records up to 'max_time' (monotonic) to 'out' without consuming them
+    // they stay visible to the crash handler until consume is called after they were dispatched
+    // records of a buffer are in timestamp order, so the first newer one ends the drain
+    // returns the position after the last appended record
+    uint64_t drain(cc::vector<std::byte>& out, int64_t max_time)
+    {
+        auto tail = read_pos.load(std::memory_order_acquire);
+        auto const head = write_pos.load(std::memory_order_acquire);
+
+        while (tail < head)
+        {
+            record_prefix prefix;
+            std::memcpy(&prefix, &data[tail & mask], sizeof(prefix));
+
+            // a concurrent drop_oldest might have overwritten the record while we read it
+            // in that case read_pos moved past it (see below), but the size must be sane before we copy
+            auto const contiguous = capacity - (tail & mask);
+            auto const min_size = prefix.kind != record_padding ? sizeof(record_header) : sizeof(record_prefix);
+            if (prefix.size < min_size || prefix.size > contiguous || prefix.size % record_alignment != 0)
+            {
+                tail = cc::max(tail, read_pos.load(std::memory_order_acquire));
+                continue;
+            }
+
+            auto const prev_size = out.size();
+            if (prefix.kind != record_padding)
+            {
+                record_header header;
+                std::memcpy(&header, &data[tail & mask], sizeof(header));
+                if (header.timestamp.monotonic_ns > max_time)
+                    break;
+
+                out.resize(prev_size + prefix.size);
+                std::memcpy(out.data() + prev_size, &data[tail & mask], prefix.size);
+            }
+
+            // the producer only overwrites records that read_pos has passed, so the copy is intact if it has not passed it yet
+            std::atomic_thread_fence(std::memory_order_acquire);
+            auto const current_tail = read_pos.load(std::memory_order_relaxed);
+            if (current_tail > tail)
+            {
+                // dropped by the producer
+                out.resize(prev_size);
+                tail = current_tail;
+                continue;
+            }
+
+            tail += prefix.size;
+        }
+
+        dispatch_end.store(tail, std::memory_order_release);
+        return tail;
+    }
+
+    // called by the background thread once the records up to 'end' (see drain) are dispatched
+    void consume(uint64_t end)
+    {
+        auto tail = read_pos.load(std::memory_order_acquire);
+        while (tail < end && !read_pos.compare_exchange_weak(tail, end, std::memory_order_acq_rel))
+        {
+        }
+    }
+
+    bool is_empty() const { return read_pos.load(std::memory_order_acquire) == write_pos.load(std::memory_order_acquire); }
+
+    // called by the crash handler (see rlog::detail::drain_async_for_crash), possibly concurrently to the background thread
+    // reads the prefix of the oldest record, returns false if there is none (or if it is not sane)
+    bool read_oldest_prefix(uint64_t& tail, record_prefix& prefix) const
+    {
+        tail = read_pos.load(std::memory_order_acquire);
+        if (tail >= write_pos.load(std::memory_order_acquire))
+            return false;
+
+        std::memcpy(&prefix, &data[tail & mask], sizeof(prefix));
+
+        auto const min_size = prefix.kind != record_padding ? sizeof(record_header) : sizeof(record_prefix);
+        return prefix.size >= min_size && prefix.size <= capacity - (tail & mask) && prefix.size % record_alignment == 0;
+    }
+
+    // copies the header of the oldest message record (skipping padding), returns false if there is none
+    bool peek_oldest(record_header& header)
+    {
+        uint64_t tail;
+        record_prefix prefix;
+        while (read_oldest_prefix(tail, prefix))
+        {
+            if (prefix.kind != record_padding)
+            {
+                std::memcpy(&header, &data[tail & mask], sizeof(header));
+                return true;
+            }
+
+            read_pos.compare_exchange_strong(tail, tail + prefix.size, std::memory_order_acq_rel);
+        }
+        return false;
+    }
+
+    // copies the oldest message record to 'out' and consumes it
+    // returns false if it was consumed by someone else in the meantime (or did not fit into 'out' and was skipped)
+    bool take_oldest(std::byte* out, size_t out_size)
+    {
+        uint64_t tail;
+        record_prefix prefix;
+        if (!read_oldest_prefix(tail, prefix) || prefix.kind == record_padding)
+            return false;
+
+        if (prefix.size > out_size)
+        {
+            read_pos.compare_exchange_strong(tail, tail + prefix.size, std::memory_order_acq_rel);
+            return false;
+        }
+
+        std::memcpy(out, &data[tail & mask], prefix.size);
+        return read_pos.compare_exchange_strong(tail, tail + prefix.size, std::memory_order_acq_rel);
+    }
+};
+
+struct thread_buffer_holder
+{
+    thread_buffer* buffer = nullptr;
+
+    // the background thread deletes the buffer once it is drained
+    ~thread_buffer_holder()
+    {
+        if (buffer)
+            buffer->orphaned.store(true, std::memory_order_release);
+    }
+};
+
+thread_local thread_buffer_holder tls_buffer;
+
+// reports dropped messages in the log itself
+rlog::location g_dropped_location = {"rlog::async", __FILE__, __LINE__};
+
+struct async_state
+{
+    std::mutex mutex; // protects everything below
+    std::condition_variable wake_cv;
+    std::condition_variable flushed_cv;
+
+    cc::vector<thread_buffer*> buffers;
+    std::thread thread;
+    rlog::async::config cfg;
+
+    // a single record of the largest buffer so far, the crash handler cannot allocate
+    cc::vector<std::byte> crash_record;
+
+    // also taken when buffers or crash_record change, the crash handler reads them without the mutex
+    rlog::detail::crash_guard crash_guard;
+
+    uint64_t flush_requested = 0;
+    uint64_t flush_completed = 0;
+    bool wake_requested = false;
+    bool stop_requested = false;
+    bool running = false;
+
+    ~async_state() { stop(); }
+
+    void start(rlog::async::config const& c)
+    {
+        auto lock = std::unique_lock<std::mutex>(mutex);
+        if (running)
+            return;
+
+        cfg = c;
+        size_t size = 4096;
+        while (size < c.buffer_size)
+            size *= 2;
+        cfg.buffer_size = size;
+
+        // records are at most a quarter of their buffer (see thread_buffer::max_payload_size)
+        if (crash_record.size() < size / 4)
+        {
+            auto _ = std::lock_guard<rlog::detail::crash_guard>(crash_guard);
+            crash_record.resize(size / 4);
+        }
+
+        g_overflow_policy.store(cfg.on_overflow, std::memory_order_relaxed);
+
+        stop_requested = false;
+        running = true;
+        thread = std::thread([this] { run(); });
+
+        g_async_enabled.store(true, std::memory_order_release);
+    }
+
+    void stop()
+    {
+        auto lock = std::unique_lock<std::mutex>(mutex);
+        if (!running)
+            return;
+
+        // new messages are logged synchronously from now on
+        g_async_enabled.store(false, std::memory_order_release);
+
+        stop_requested = true;
+        wake_cv.notify_one();
+
+        lock.unlock();
+        thread.join(); // the thread drains everything one last time
+        lock.lock();
+
+        running = false;
+        flushed_cv.notify_all();
+        remove_orphaned_buffers();
+    }
+
+    void flush()
+    {
+        auto lock = std::unique_lock<std::mutex>(mutex);
+        if (!running)
+            return;
+
+        auto const target = ++flush_requested;
+        wake_cv.notify_one();
+        flushed_cv.wait(lock, [&] { return flush_completed >= target || !running; });
+    }
+
+    void wake()
+    {
+        {
+            auto _ = std::lock_guard<std::mutex>(mutex);
+            wake_requested = true;
+        }
+        wake_cv.notify_one();
+    }
+
+    thread_buffer* register_thread()
+    {
+        auto _ = std::lock_guard<std::mutex>(mutex);
+        auto const buffer = new thread_buffer(cfg.buffer_size);
+
+        auto _guard = std::lock_guard<rlog::detail::crash_guard>(crash_guard);
+        buffers.push_back(buffer);
+        return buffer;
+    }
+
+    // NOTE: mutex must be held
+    void remove_orphaned_buffers()
+    {
+        auto _ = std::lock_guard<rlog::detail::crash_guard>(crash_guard);
+        for (size_t i = 0; i < buffers.size();)
+        {
+            auto const b = buffers[i];
+            if (b->orphaned.load(std::memory_order_acquire) && b->is_empty())
+            {
+                delete b;
+                buffers[i] = buffers.back();
+                buffers.pop_back();
+            }
+            else
+                ++i;
+        }
+    }
+
+    void run()
+    {
+        tls_is_consumer = true;
+
+        cc::vector<thread_buffer*> snapshot;
+        cc::vector<uint64_t> drain_ends;
+        cc::vector<std::byte> batch;
+        cc::vector<size_t> record_offsets;
+        cc::string formatted;
+        cc::vector<rlog::field> fields;
+
+        auto lock = std::unique_lock<std::mutex>(mutex);
+        while (true)
+        {
+            auto const flush_target = flush_requested;
+            auto const stopping = stop_requested;
+
+            // a producer can be preempted between taking its timestamp and committing the record
+            // records younger than the poll interval are therefore held back until the next pass, so that such a late record
+            // is still merged before them (flushing, stopping, and producers waiting for space take everything)
+            int64_t max_time = INT64_MAX;
+            if (!stopping && flush_target == flush_completed && !wake_requested)
+                max_time = rlog::get_current_timestamp().monotonic_ns - int64_t(cfg.poll_interval_ms) * 1'000'000;
+            wake_requested = false;
+
+            snapshot.clear();
+            for (auto b : buffers)
+                snapshot.push_back(b);
+
+            lock.unlock();
+            auto const had_work = drain_and_dispatch(snapshot, max_time, drain_ends, batch, record_offsets, formatted, fields);
+            lock.lock();
+
+            remove_orphaned_buffers();
+            flush_completed = flush_target;
+            flushed_cv.notify_all();
+
+            if (stopping)
+                break;
+
+            if (!had_work && !stop_requested && !wake_requested && flush_requested == flush_target)
+                wake_cv.wait_for(lock, std::chrono::milliseconds(cfg.poll_interval_ms));
+        }
+    }
+
+    // NOTE: called without holding the mutex
+    static bool drain_and_dispatch(cc::span<thread_buffer*> snapshot, //
+                                   int64_t max_time,
+                                   cc::vector<uint64_t>& drain_ends,
+                                   cc::vector<std::byte>& batch,
+                                   cc::vector<size_t>& record_offsets,
+                                   cc::string& formatted,
+                                   cc::vector<rlog::field>& fields)
+    {
+        batch.clear();
+        record_offsets.clear();
+        drain_ends.clear();
+
+        uint64_t dropped = 0;
+        for (auto b : snapshot)
+        {
+            drain_ends.push_back(b->drain(batch, max_time));
+            dropped += b->dropped.exchange(0, std::memory_order_relaxed);
+        }
+
+        for (size_t offset = 0; offset < batch.size();)
+        {
+            record_offsets.push_back(offset);
+
+            record_prefix prefix;
+            std::memcpy(&prefix, batch.data() + offset, sizeof(prefix));
+            offset += prefix.size;
+        }
+
+        auto header_at = [&](size_t offset)
+        {
+            record_header h;
+            std::memcpy(&h, batch.data() + offset, sizeof(h));
+            return h;
+        };
+
+        // each buffer is already sorted, so this is effectively a merge
+        std::stable_sort(record_offsets.begin(), record_offsets.end(), //
+                         [&](size_t a, size_t b) { return header_at(a).timestamp.monotonic_ns < header_at(b).timestamp.monotonic_ns; });
+
+        for (auto offset : record_offsets)
+        {
+            auto const h = header_at(offset);
+            auto const payload = reinterpret_cast<char const*>(batch.data() + offset + sizeof(record_header));
+
+            rlog::message_ref msg;
+            msg.timestamp = h.timestamp;
+            msg.location = h.location;
+            msg.domain = h.domain;
+            msg.verbosity = rlog::verbosity::type(h.verbosity);
+            msg.thread_id = h.thread_id;
+            msg.thread_name = thread_name_of(h, payload);
+            msg.message = cc::string_view(payload + h.thread_name_size, h.message_size);
+
+            if (h.fields_size > 0)
+            {
+                decode_fields(fields, reinterpret_cast<std::byte const*>(payload + h.thread_name_size + h.message_size));
+                msg.fields = fields;
+            }
+
+            if (h.prefix.kind == record_deferred)
+            {
+                deferred_payload dp;
+                std::memcpy(&dp, payload + h.thread_name_size, sizeof(dp));
+
+                formatted.clear();
+                dp.format_serialized([&](cc::span<char const> chars) { formatted += cc::string_view(chars.data(), chars.size()); }, dp.fmt_str,
+                                     reinterpret_cast<std::byte const*>(payload + h.thread_name_size + sizeof(dp)));
+                msg.message = formatted;
+            }
+
+            auto break_on_log = false; // cannot be honored anymore
+            rlog::detail::dispatch_to_global_logger(msg, break_on_log);
+        }
+
+        // only now, so the crash handler also writes the records of this batch
+        // (a crash during the batch may write some of them twice, but none is lost)
+        for (size_t i = 0; i < snapshot.size(); ++i)
+            snapshot[i]->consume(drain_ends[i]);
+
+        if (dropped > 0)
+        {
+            g_total_dropped.fetch_add(dropped, std::memory_order_relaxed);
+
+            char text[96];
+            auto const len = std::snprintf(text, sizeof(text), "async log buffer overflow, dropped %llu message(s)", (unsigned long long)dropped);
+
+            rlog::message_ref msg;
+            msg.timestamp = rlog::get_current_timestamp();
+            msg.location = &g_dropped_location;
+            msg.domain = &Log::Default::domain;
+            msg.verbosity = rlog::verbosity::Warning;
+            msg.thread_name = "rlog-async";
+            msg.message = cc::string_view(text, size_t(len));
+
+            auto break_on_log = false;
+            rlog::detail::dispatch_to_global_logger(msg, break_on_log);
+        }
+
+        return !record_offsets.empty() || dropped > 0;
+    }
+};
+
+// constructed on first use (i.e. after all logger statics) so it is destroyed (and flushed) before them
+async_state& state()
+{
+    static async_state s;
+    return s;
+}
+
+void wake_consumer() { state().wake(); }
+
+// "hh:mm:ss.mmmZ [thread] SEVERITY Domain message", only with async-signal-safe operations
+void write_crash_line(rlog::detail::signal_safe_writer& out, std::byte const* record)
+{
+    record_header h;
+    std::memcpy(&h, record, sizeof(h));
+    auto const payload = reinterpret_cast<char const*>(record + sizeof(record_header));
+
+    auto const ns = h.timestamp.subsecond_ns();
+    auto const time_of_day = uint64_t((h.timestamp.wall_ns - ns) / 1'000'000'000 % 86400);
+    out.append_uint(time_of_day / 3600, 2);
+    out.append(':');
+    out.append_uint(time_of_day / 60 % 60, 2);
+    out.append(':');
+    out.append_uint(time_of_day % 60, 2);
+    out.append('.');
+    out.append_uint(uint64_t(ns / 1'000'000), 3);
+    out.append("Z ");
+
+    auto const thread_name = thread_name_of(h, payload);
+    if (!thread_name.empty())
+    {
+        out.append('[');
+        out.append(thread_name);
+        out.append("] ");
+    }
+
+    out.append(rlog::get_verbosity_name(rlog::verbosity::type(h.verbosity)));
+    out.append(' ');
+
+    if (h.domain != &Log::Default::domain)
+    {
+        out.append(h.domain->name);
+        out.append(' ');
+    }
+
+    if (h.prefix.kind == record_deferred)
+    {
+        deferred_payload dp;
+        std::memcpy(&dp, payload + h.thread_name_size, sizeof(dp));
+        dp.format_serialized([&](cc::span<char const> chars) { out.append(cc::string_view(chars.data(), chars.size())); }, dp.fmt_str,
+                             reinterpret_cast<std::byte const*>(payload + h.thread_name_size + sizeof(dp)));
+    }
+    else
+        out.append(cc::string_view(payload + h.thread_name_size, h.message_size));
+
+    out.append('\n');
+}
+}
+
+void rlog::async::enable(config const& cfg) { state().start(cfg); }
+
+bool rlog::async::is_enabled() { return g_async_enabled.load(std::memory_order_acquire); }
+
+void rlog::async::flush()
+{
+    if (!is_enabled() || tls_is_consumer)
+        return;
+
+    state().flush();
+}
+
+void rlog::async::shutdown()
+{
+    if (tls_is_consumer)
+        return;
+
+    state().stop();
+}
+
+uint64_t rlog::async::dropped_message_count() { return g_total_dropped.load(std::memory_order_relaxed); }
+
+bool rlog::detail::try_enqueue_async(message_ref const& msg, deferred_message const* deferred)
+{
+    if (!g_async_enabled.load(std::memory_order_acquire) || tls_is_consumer)
+        return false;
+
+    auto buffer = tls_buffer.buffer;
+    if (!buffer)
+        buffer = tls_buffer.buffer = state().register_thread();
+
+    if (deferred)
+    {
+        // the caller formats these on its thread and enqueues the text instead
+        if (!deferred->is_serializable())
+            return false;
+
+        auto const deferred_size = sizeof(deferred_payload) + deferred->vtable->serialized_size(deferred->args);
+
+        // very large arguments are formatted eagerly as well (and then truncated like any other message)
+        if (deferred_size > buffer->max_payload_size())
+            return false;
+
+        return buffer->write(msg, deferred, deferred_size, {}) != write_result::disabled;
+    }
+
+    if (!msg.fields.empty())
+    {
+        // reused per thread, so steady-state structured logging does not allocate
+        thread_local cc::vector<std::byte> encoded;
+        encode_fields(encoded, msg.fields);
+
+        // the caller dispatches messages with very large fields synchronously
+        if (encoded.size() > buffer->max_payload_size() / 2)
+            return false;
+
+        return buffer->write(msg, nullptr, 0, encoded) != write_result::disabled;
+    }
+
+    return buffer->write(msg, nullptr, 0, {}) != write_result::disabled;
+}
+
+bool rlog::detail::drain_async_for_crash(signal_safe_writer& out)
+{
+    if (!g_async_enabled.load(std::memory_order_acquire))
+        return true;
+
+    auto& s = state();
+    if (!s.crash_guard.try_lock_for_crash())
+        return false;
+
+    // other threads might keep logging, only messages up to now are written
+    auto const end_time = get_current_timestamp().monotonic_ns;
+
+    // the buffers are merged like in drain_and_dispatch, but one record at a time (the handler cannot allocate)
+    while (true)
+    {
+        thread_buffer* oldest = nullptr;
+        int64_t oldest_time = end_time;
+        for (auto b : s.buffers)
+        {
+            record_header h;
+            if (b->peek_oldest(h) && h.timestamp.monotonic_ns <= oldest_time)
+            {
+                oldest = b;
+                oldest_time = h.timestamp.monotonic_ns;
+            }
+        }
+
+        if (!oldest)
+            break;
+
+        if (oldest->take_oldest(s.crash_record.data(), s.crash_record.size()))
+            write_crash_line(out, s.crash_record.data());
+    }
+
+    s.crash_guard.unlock();
+    return true;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <rich-log/detail/api.hh>
+#include <rich-log/message.hh>
+
+/**
+ * opt-in asynchronous logging
+ *
+ * when enabled, messages that reach the global logger stage (i.e. were not consumed by a local logger)
+ * are copied into a per-thread lock-free ring buffer instead of being printed on the calling thread
+ * a background thread drains all buffers, merges them in timestamp order, and passes them to the global logger
+ *
+ * Usage:
+ *
+ *    int main()
+ *    {
+ *        rlog::async::config cfg;
+ *        cfg.on_overflow = rlog::async::overflow_policy::drop_oldest;
+ *        rlog::async::enable(cfg);
+ *
+ *        LOG("this is printed by the background thread");
+ *
+ *        rlog::async::flush(); // waits until everything logged so far is printed
+ *
+ *        rlog::async::shutdown(); // optional, also happens at static destruction
+ *    }
+ *
+ * NOTE: local loggers (push_local_logger, scoped_logger_override) are still called synchronously
+ * NOTE: the global logger is called from the background thread and cannot change break_on_log anymore
+ * CAUTION: set_global_default_logger must not be called while async logging is enabled
+ */
+
+namespace rlog::async
+{
+/// what happens when a thread logs into a full buffer
+enum class overflow_policy
+{
+    /// the logging thread waits until the background thread made room (no message is lost)
+    block,
+
+    /// the new message is discarded
+    drop_newest,
+
+    /// the oldest buffered messages of that thread are discarded to make room
+    drop_oldest,
+};
+
+struct config
+{
+    /// size of each per-thread buffer in bytes (rounded up to a power of two)
+    /// messages that do not fit into a quarter of the buffer are truncated
+    size_t buffer_size = 256 * 1024;
+
+    overflow_policy on_overflow = overflow_policy::block;
+
+    /// maximum time the background thread sleeps when there is nothing to do
+    /// messages are also held back for this long, so that a message whose thread was preempted before it was buffered
+    /// is still printed in timestamp order (flush and shutdown print everything right away)
+    int poll_interval_ms = 5;
+};
+
+/// starts the background thread and routes all subsequent messages through it
+/// does nothing if async logging is already enabled
+RLOG_API void enable(config const& cfg = {});
+
+/// returns true if async logging is currently enabled
+RLOG_API bool is_enabled();
+
+/// blocks until every message logged before this call was passed to the global logger
+/// does nothing if async logging is not enabled
+RLOG_API void flush();
+
+/// flushes all pending messages, stops the background thread, and returns to synchronous logging
+RLOG_API void shutdown();
+
+/// number of messages discarded by drop_newest or drop_oldest so far
+/// NOTE: each drop is also reported by a Warning in the log itself
+RLOG_API uint64_t dropped_message_count();
+}
+
+namespace rlog::detail
+{
+struct deferred_message;
+struct signal_safe_writer;
+
+/// copies the message into the buffer of the calling thread
+/// if 'deferred' is set, msg.message is ignored and the serialized arguments are formatted on the background thread
+/// msg.fields are copied as well (values of type 'other' are formatted on the calling thread)
+/// returns false if async logging is disabled (the message must then be dispatched synchronously)
+/// or if 'deferred' cannot be serialized (the message must then be formatted and enqueued as text)
+/// or if the fields are too large for the buffer (the message must then be dispatched synchronously)
+RLOG_API bool try_enqueue_async(message_ref const& msg, deferred_message const* deferred = nullptr);
+
+/// writes all messages that are still waiting for the background thread as text lines, oldest first
+/// only used by the crash handler (see crash_handler.hh), the written messages are consumed
+/// returns false if the buffer registry stayed locked
+RLOG_API bool drain_async_for_crash(signal_safe_writer& out);
+}
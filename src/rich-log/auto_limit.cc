@@ -0,0 +1,304 @@
+#include "auto_limit.hh"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+#include <clean-core/macros.hh>
+#include <clean-core/utility.hh>
+
+#include <rich-log/console.hh>
+#include <rich-log/log.hh>
+#include <rich-log/logger.hh>
+#include <rich-log/rate_limit.hh>
+
+std::atomic<bool> rlog::detail::g_auto_limit_enabled = {false};
+
+namespace
+{
+// the policy, each value is read independently (a concurrent set_auto_limit may mix old and new values for a single message)
+std::atomic<int64_t> g_emission_interval_ns = {0};
+std::atomic<int64_t> g_burst_tolerance_ns = {0};
+std::atomic<int64_t> g_repeat_interval_ns = {0};
+std::atomic<bool> g_collapse_repeats = {false};
+
+// summaries are logged through do_log and must not be limited themselves
+thread_local bool tls_is_reporting = false;
+
+// all sites that were ever limited, newest first
+// sites are added lock-free, but only removed (when their domain is unregistered) and visited under sites_mutex
+std::atomic<rlog::location*> g_first_site = {nullptr};
+
+// never destroyed, domains are also unregistered during static destruction
+std::mutex& sites_mutex()
+{
+    static auto const m = new std::mutex();
+    return *m;
+}
+
+// allocates the limit state of a site and registers it the first time it is limited
+rlog::location_limit_state& get_state(rlog::domain_info const& domain, rlog::verbosity::type verbosity, rlog::location& loc)
+{
+    auto state = loc.limit.load(std::memory_order_acquire);
+    if (state != nullptr)
+        return *state;
+
+    auto const fresh = new rlog::location_limit_state();
+    fresh->domain.store(&domain, std::memory_order_relaxed);
+    fresh->verbosity.store(int(verbosity), std::memory_order_relaxed);
+    if (!loc.limit.compare_exchange_strong(state, fresh, std::memory_order_acq_rel, std::memory_order_acquire))
+    {
+        delete fresh; // another thread registers it
+        return *state;
+    }
+
+    auto head = g_first_site.load(std::memory_order_relaxed);
+    do
+    {
+        fresh->next.store(head, std::memory_order_relaxed);
+    } while (!g_first_site.compare_exchange_weak(head, &loc, std::memory_order_release, std::memory_order_relaxed));
+    return *fresh;
+}
+
+void report(rlog::domain_info const& domain, rlog::verbosity::type verbosity, rlog::location& loc, char const* fmt, uint64_t count)
+{
+    char text[96];
+    auto const len = std::snprintf(text, sizeof(text), fmt, (unsigned long long)count, count == 1 ? "" : "s");
+
+    tls_is_reporting = true;
+    rlog::detail::do_log(domain, verbosity, &loc, cc::string_view(text, size_t(len)));
+    tls_is_reporting = false;
+}
+
+void report_repeats(rlog::domain_info const& domain, rlog::verbosity::type verbosity, rlog::location& loc, rlog::location_limit_state& s)
+{
+    // fast path: a single load if nothing was collapsed
+    if (s.repeats.load(std::memory_order_relaxed) == 0)
+        return;
+
+    if (auto const n = s.repeats.exchange(0, std::memory_order_relaxed); n > 0)
+        report(domain, verbosity, loc, "last message repeated %llu time%s", n);
+}
+
+void report_dropped(rlog::domain_info const& domain, rlog::verbosity::type verbosity, rlog::location& loc, rlog::location_limit_state& s)
+{
+    if (s.dropped.load(std::memory_order_relaxed) == 0)
+        return;
+
+    if (auto const n = s.dropped.exchange(0, std::memory_order_relaxed); n > 0)
+        report(domain, verbosity, loc, "%llu message%s dropped by the rate limit", n);
+}
+
+// logs the pending summaries every repeat_report_interval, so they also show up when a site goes quiet
+// (otherwise they would wait for the next message of the site)
+struct summary_flusher
+{
+    static constexpr int64_t min_interval_ns = 10'000'000;
+
+    std::mutex control_mutex; // serializes start and stop
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread thread;
+    bool stop_requested = false;
+
+    // the console is constructed first, so it is still there for the final flush
+    summary_flusher() { rlog::console::flush(); }
+
+    // at exit, the final flush happens on the thread (thread_locals of the main thread are already gone)
+    ~summary_flusher() { stop(); }
+
+    void start()
+    {
+        auto _ = std::lock_guard<std::mutex>(control_mutex);
+        if (thread.joinable())
+            return;
+
+        stop_requested = false;
+        thread = std::thread([this] { run(); });
+    }
+
+    void stop()
+    {
+        auto _ = std::lock_guard<std::mutex>(control_mutex);
+        if (!thread.joinable())
+            return;
+
+        {
+            auto const lock = std::lock_guard<std::mutex>(mutex);
+            stop_requested = true;
+        }
+        cv.notify_one();
+        thread.join();
+    }
+
+    void run()
+    {
+        rlog::set_current_thread_name("rlog-auto-limit");
+
+        auto lock = std::unique_lock<std::mutex>(mutex);
+        while (!stop_requested)
+        {
+            auto const interval = std::chrono::nanoseconds(cc::max(g_repeat_interval_ns.load(std::memory_order_relaxed), min_interval_ns));
+            if (cv.wait_for(lock, interval, [&] { return stop_requested; }))
+                break;
+
+            lock.unlock();
+            rlog::rate::flush_auto_limit();
+            lock.lock();
+        }
+
+        lock.unlock();
+        rlog::rate::flush_auto_limit();
+    }
+};
+
+// constructed on first use (i.e. after all logger statics) so it is destroyed (and flushed) before them
+summary_flusher& flusher()
+{
+    static summary_flusher f;
+    return f;
+}
+
+// same algorithm as rlog::rate::token_bucket, but with the policy read at the time of the call
+bool take_token(std::atomic<int64_t>& arrival_ns, int64_t now)
+{
+    auto const interval = g_emission_interval_ns.load(std::memory_order_relaxed);
+    auto const tolerance = g_burst_tolerance_ns.load(std::memory_order_relaxed);
+
+    auto tat = arrival_ns.load(std::memory_order_relaxed);
+    while (true)
+    {
+        auto const start = tat < now ? now : tat;
+        if (start - now > tolerance)
+            return false;
+
+        if (arrival_ns.compare_exchange_weak(tat, start + interval, std::memory_order_relaxed))
+            return true;
+    }
+}
+}
+
+void rlog::rate::set_auto_limit(auto_limit_policy const& policy)
+{
+    CC_ASSERT(policy.burst >= 1 && "burst must be at least 1");
+    CC_ASSERT(policy.per_second > 0 && "rate must be positive");
+
+    auto const interval = detail::seconds_to_ticks(1.0 / policy.per_second);
+    g_emission_interval_ns.store(interval, std::memory_order_relaxed);
+    g_burst_tolerance_ns.store(int64_t(policy.burst - 1) * interval, std::memory_order_relaxed);
+    g_repeat_interval_ns.store(detail::seconds_to_ticks(policy.repeat_report_interval), std::memory_order_relaxed);
+    g_collapse_repeats.store(policy.collapse_repeats, std::memory_order_relaxed);
+
+    rlog::detail::g_auto_limit_enabled.store(true, std::memory_order_release);
+    flusher().start();
+}
+
+void rlog::rate::disable_auto_limit()
+{
+    rlog::detail::g_auto_limit_enabled.store(false, std::memory_order_relaxed);
+
+    // on the calling thread first, so its local loggers get the summaries
+    flush_auto_limit();
+    flusher().stop();
+}
+
+bool rlog::rate::is_auto_limit_enabled() { return rlog::detail::is_auto_limiting(); }
+
+void rlog::rate::flush_auto_limit()
+{
+    // only registered sites are visited, so their state exists
+    // the lock is held while reporting, the site (and its domain) must not go away in between
+    auto _ = std::lock_guard<std::mutex>(sites_mutex());
+    for (auto loc = g_first_site.load(std::memory_order_acquire); loc != nullptr;)
+    {
+        auto& s = *loc->limit.load(std::memory_order_acquire);
+        auto const domain = s.domain.load(std::memory_order_relaxed);
+        auto const verbosity = rlog::verbosity::type(s.verbosity.load(std::memory_order_relaxed));
+        report_repeats(*domain, verbosity, *loc, s);
+        report_dropped(*domain, verbosity, *loc, s);
+        loc = s.next.load(std::memory_order_relaxed);
+    }
+}
+
+void rlog::detail::remove_auto_limit_sites(domain_info const& domain)
+{
+    auto _ = std::lock_guard<std::mutex>(sites_mutex());
+
+    // only the head can change concurrently (new sites are added without the lock)
+    for (auto link = &g_first_site;;)
+    {
+        auto loc = link->load(std::memory_order_acquire);
+        if (loc == nullptr)
+            break;
+
+        auto const state = loc->limit.load(std::memory_order_acquire);
+        if (state->domain.load(std::memory_order_relaxed) != &domain)
+        {
+            link = &state->next;
+            continue;
+        }
+
+        auto const next = state->next.load(std::memory_order_relaxed);
+        if (link == &g_first_site)
+        {
+            if (!g_first_site.compare_exchange_strong(loc, next, std::memory_order_acq_rel))
+                continue; // a new site was added in front, it is checked next
+        }
+        else
+            link->store(next, std::memory_order_release);
+
+        // the last summaries of the site
+        auto const verbosity = rlog::verbosity::type(state->verbosity.load(std::memory_order_relaxed));
+        report_repeats(domain, verbosity, *loc, *state);
+        report_dropped(domain, verbosity, *loc, *state);
+
+        // the location is still there (its module's statics are being destroyed right now)
+        loc->limit.store(nullptr, std::memory_order_relaxed);
+        delete state;
+    }
+}
+
+bool rlog::detail::is_collapsing_repeats() { return g_collapse_repeats.load(std::memory_order_relaxed); }
+
+bool rlog::detail::pass_auto_limit(domain_info const& domain, verbosity::type verbosity, location& loc, int64_t now_ns, uint64_t hash)
+{
+    if (tls_is_reporting)
+        return true;
+
+    auto& s = get_state(domain, verbosity, loc);
+
+    // identical to the previous message: only count it
+    // (the hash is 0 if repeats are not collapsed)
+    if (hash != 0)
+    {
+        if (s.last_hash.load(std::memory_order_relaxed) == hash)
+        {
+            if (s.repeats.fetch_add(1, std::memory_order_relaxed) == 0)
+                s.repeat_report_ns.store(now_ns + g_repeat_interval_ns.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            else if (now_ns >= s.repeat_report_ns.load(std::memory_order_relaxed))
+                report_repeats(domain, verbosity, loc, s); // the next repeat starts a new interval
+
+            return false;
+        }
+
+        // a different message ends the repeats of the previous one
+        report_repeats(domain, verbosity, loc, s);
+    }
+
+    if (!take_token(s.arrival_ns, now_ns))
+    {
+        s.dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    report_dropped(domain, verbosity, loc, s);
+
+    // only messages that are actually logged are compared against
+    // (otherwise a dropped message would be reported as repeated later)
+    if (hash != 0)
+        s.last_hash.store(hash, std::memory_order_relaxed);
+
+    return true;
+}
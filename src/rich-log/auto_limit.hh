@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include <rich-log/detail/api.hh>
+#include <rich-log/domain.hh>
+#include <rich-log/location.hh>
+
+/**
+ * automatic rate limiting: a global policy that is applied to every LOG site, without declaring limiters
+ *
+ * each site gets its own token bucket (see rlog::rate::token_bucket) with the same burst and rate
+ * identical consecutive messages of a site are collapsed into a single "last message repeated N times" record
+ *
+ * Usage:
+ *
+ *    rlog::rate::auto_limit_policy policy;
+ *    policy.burst = 100;      // up to 100 messages per site at once
+ *    policy.per_second = 10;  // .. then 10 per second
+ *    rlog::rate::set_auto_limit(policy);
+ *
+ *    for (...)
+ *        LOG_WARN("socket %d closed", fd); // logged once, then "last message repeated 1234 times"
+ *
+ * the summary records are logged like regular messages of their site (same domain, verbosity, and location):
+ *   - "last message repeated N times" when a different message arrives at the site,
+ *     and every repeat_report_interval while the same message keeps arriving
+ *   - "N messages dropped by the rate limit" before the next message that fits into the budget again
+ *   - all pending summaries are logged every repeat_report_interval by a background thread (while enabled),
+ *     by flush_auto_limit, and at exit
+ *     (summaries logged by the background thread only reach the global logger and the sinks, local loggers are per thread)
+ *
+ * "identical" means same format string and same argument values (or same text and fields for LOG with runtime strings and LOGS)
+ * collapsed and dropped messages count as 'suppressed' in the site stats (see site_stats.hh)
+ *
+ * NOTE: the policy is applied in do_log, after the verbosity and sink filters, so filtered LOGs cost nothing extra
+ *       while disabled (the default), the only cost is a relaxed load per emitted LOG
+ * NOTE: explicit limiters (LOG_ONCE etc.) are checked first, a message must pass both
+ * NOTE: the limit is per site, a few misbehaving loops cannot starve the budget of others
+ * NOTE: the state of a site is removed when the domain it logs to is unregistered (e.g. when a shared library is unloaded),
+ *       its pending summaries are logged right before
+ */
+
+namespace rlog::rate
+{
+struct auto_limit_policy
+{
+    /// messages per site that are logged at once, before the rate limit kicks in
+    int burst = 100;
+
+    /// sustained messages per second and site
+    double per_second = 10;
+
+    /// if true, identical consecutive messages of a site are counted instead of logged
+    bool collapse_repeats = true;
+
+    /// how often ongoing repeats are reported (in seconds)
+    /// also how often the background thread logs the pending summaries of all sites
+    double repeat_report_interval = 10;
+};
+
+/// enables automatic rate limiting for all LOG sites
+/// starts the background thread that logs pending summaries (see repeat_report_interval)
+/// NOTE: thread-safe, can be changed at any time (budgets already spent are kept)
+RLOG_API void set_auto_limit(auto_limit_policy const& policy);
+
+/// disables automatic rate limiting (pending summaries are logged) and stops the background thread
+RLOG_API void disable_auto_limit();
+
+/// returns true if automatic rate limiting is enabled
+RLOG_API bool is_auto_limit_enabled();
+
+/// logs the pending summaries of all sites (repeats and dropped messages)
+RLOG_API void flush_auto_limit();
+}
+
+namespace rlog::detail
+{
+/// NOTE: read in do_log, use set_auto_limit to change it
+RLOG_API extern std::atomic<bool> g_auto_limit_enabled;
+
+inline bool is_auto_limiting() { return g_auto_limit_enabled.load(std::memory_order_relaxed); }
+
+/// returns true if identical messages are collapsed, i.e. pass_auto_limit needs a message hash
+RLOG_API bool is_collapsing_repeats();
+
+/// applies the policy to a message of the site, given its monotonic time and hash (of format string and arguments)
+/// returns false if the message is collapsed or dropped
+/// pending summaries of the site are logged before this returns true
+RLOG_API bool pass_auto_limit(domain_info const& domain, verbosity::type verbosity, location& loc, int64_t now_ns, uint64_t hash);
+
+/// logs the pending summaries of the sites that log to the domain and removes them
+/// (called when it is unregistered, its sites might go away with it)
+RLOG_API void remove_auto_limit_sites(domain_info const& domain);
+}
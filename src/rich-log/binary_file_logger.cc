@@ -0,0 +1,585 @@
+#include "binary_file_logger.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#include <clean-core/macros.hh>
+#include <clean-core/utility.hh>
+#include <clean-core/vector.hh>
+
+#include <rich-log/detail/binary_format.hh>
+#include <rich-log/detail/id_table.hh>
+#include <rich-log/domain.hh>
+#include <rich-log/location.hh>
+#include <rich-log/timestamp.hh>
+
+#ifdef CC_OS_WINDOWS
+#include <clean-core/native/win32_sanitized.hh>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace bf = rlog::detail::binary_format;
+using rlog::detail::id_table;
+using rlog::detail::thread_name_table;
+
+namespace
+{
+constexpr size_t min_file_size = 64 * 1024;
+
+// a file mapped into memory
+struct mapped_file
+{
+    std::byte* data = nullptr;
+    size_t size = 0;
+#ifdef CC_OS_WINDOWS
+    ::HANDLE file = INVALID_HANDLE_VALUE;
+    ::HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+// creates (or overwrites) the file, allocates 'size' zero-filled bytes, and maps it
+bool open_mapped_file(mapped_file& f, char const* path, size_t size)
+{
+#ifdef CC_OS_WINDOWS
+    f.file = ::CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (f.file == INVALID_HANDLE_VALUE)
+        return false;
+
+    // creating the mapping extends the file to the full size
+    f.mapping = ::CreateFileMappingA(f.file, nullptr, PAGE_READWRITE, ::DWORD(uint64_t(size) >> 32), ::DWORD(size & 0xFFFFFFFF), nullptr);
+    if (f.mapping == nullptr)
+    {
+        ::CloseHandle(f.file);
+        return false;
+    }
+
+    f.data = static_cast<std::byte*>(::MapViewOfFile(f.mapping, FILE_MAP_WRITE, 0, 0, size));
+    if (f.data == nullptr)
+    {
+        ::CloseHandle(f.mapping);
+        ::CloseHandle(f.file);
+        return false;
+    }
+#else
+    f.fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (f.fd < 0)
+        return false;
+
+    // allocate the blocks up front
+    // otherwise a full disk would only show up as SIGBUS while writing into the mapping
+#ifdef __linux__
+    auto const allocated = ::posix_fallocate(f.fd, 0, off_t(size)) == 0;
+#else
+    auto const allocated = ::ftruncate(f.fd, off_t(size)) == 0;
+#endif
+    auto const data = allocated ? ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, f.fd, 0) : MAP_FAILED;
+    if (data == MAP_FAILED)
+    {
+        ::close(f.fd);
+        ::unlink(path);
+        return false;
+    }
+
+    f.data = static_cast<std::byte*>(data);
+#endif
+
+    f.size = size;
+    return true;
+}
+
+void flush_mapped_file(mapped_file const& f, size_t used_size)
+{
+#ifdef CC_OS_WINDOWS
+    ::FlushViewOfFile(f.data, used_size);
+    ::FlushFileBuffers(f.file);
+#else
+    ::msync(f.data, used_size, MS_SYNC);
+#endif
+}
+
+// unmaps the file and shrinks it to the used size
+void close_mapped_file(mapped_file& f, size_t used_size)
+{
+#ifdef CC_OS_WINDOWS
+    ::UnmapViewOfFile(f.data);
+    ::CloseHandle(f.mapping);
+
+    ::LARGE_INTEGER end;
+    end.QuadPart = ::LONGLONG(used_size);
+    if (::SetFilePointerEx(f.file, end, nullptr, FILE_BEGIN))
+        ::SetEndOfFile(f.file);
+    ::CloseHandle(f.file);
+#else
+    ::munmap(f.data, f.size);
+    (void)::ftruncate(f.fd, off_t(used_size));
+    ::close(f.fd);
+#endif
+
+    f.data = nullptr;
+}
+
+// one file of the rotating set
+// writers reserve space with a single fetch_add on write_pos
+struct segment
+{
+    mapped_file file;
+    uint64_t generation = 0; // file index + 1, so 0 means "never defined" in id_table
+    std::atomic<size_t> write_pos = {0};
+    std::atomic<int> writers = {0};
+    bool is_closed = false;
+
+    size_t used_size() const { return cc::min(write_pos.load(), file.size); }
+};
+
+uint32_t id_of(id_table::entry const* e) { return e ? e->id.load(std::memory_order_relaxed) : bf::unknown_id; }
+
+uint16_t domain_id_of(id_table::entry const* e)
+{
+    auto const id = id_of(e);
+    return id < bf::unknown_domain_id ? uint16_t(id) : bf::unknown_domain_id;
+}
+
+bool needs_definition(id_table::entry const* e, uint64_t generation)
+{
+    return e != nullptr && e->id.load(std::memory_order_relaxed) != bf::unknown_id
+           && e->defined_generation.load(std::memory_order_relaxed) != generation;
+}
+
+size_t definition_size(char const* s0, char const* s1 = nullptr)
+{
+    return sizeof(bf::definition_record) + std::strlen(s0) + 1 + (s1 ? std::strlen(s1) + 1 : 0);
+}
+
+// writes the record prefix last, so a record never has a valid size without its data
+// (the file is zero-filled and decoders stop at size 0)
+std::byte* commit_record(std::byte* dst, bf::record_prefix const& prefix)
+{
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(dst, &prefix, sizeof(prefix));
+    return dst + bf::align_record_size(prefix.size);
+}
+
+std::byte* write_definition(std::byte* dst, bf::record_kind kind, uint32_t id, int32_t line, char const* s0, char const* s1 = nullptr)
+{
+    auto const size = definition_size(s0, s1);
+
+    auto p = dst + sizeof(bf::definition_record);
+    for (auto s : {s0, s1})
+        if (s != nullptr)
+        {
+            auto const len = std::strlen(s) + 1;
+            std::memcpy(p, s, len);
+            p += len;
+        }
+
+    std::memcpy(dst + offsetof(bf::definition_record, id), &id, sizeof(id));
+    std::memcpy(dst + offsetof(bf::definition_record, line), &line, sizeof(line));
+
+    bf::record_prefix prefix = {};
+    prefix.size = uint32_t(size);
+    prefix.kind = kind;
+    return commit_record(dst, prefix);
+}
+}
+
+struct rlog::binary_file_logger::state
+{
+    binary_file_config config;
+
+    std::atomic<segment*> current = {nullptr};
+
+    // all segments ever created, closed once they are replaced and no writer uses them anymore
+    // the segment structs themselves live until the logger is destroyed, so writers never see a dangling pointer
+    std::mutex rotate_mutex;
+    cc::vector<cc::unique_ptr<segment>> segments;
+
+    id_table domains{1 << 10}; // ids must fit into record_prefix::domain_id
+    id_table locations{1 << 14};
+    thread_name_table threads;
+    std::atomic<uint32_t> next_domain_id = {1};
+    std::atomic<uint32_t> next_location_id = {0};
+
+    cc::string file_path(uint64_t index) const
+    {
+        char suffix[32];
+        std::snprintf(suffix, sizeof(suffix), ".%06llu.rlog", (unsigned long long)index);
+
+        auto path = config.path_prefix;
+        path += suffix;
+        return path;
+    }
+
+    // must hold rotate_mutex
+    bool open_next_segment()
+    {
+        auto const index = uint64_t(segments.size());
+        auto seg = cc::make_unique<segment>();
+        seg->generation = index + 1;
+
+        if (!open_mapped_file(seg->file, file_path(index).c_str(), config.file_size))
+            return false;
+
+        bf::file_header header = {};
+        std::memcpy(header.magic, bf::magic, sizeof(header.magic));
+        header.version = bf::version;
+        header.header_size = uint32_t(bf::align_record_size(sizeof(header)));
+        header.file_index = index;
+        header.created_wall_ns = rlog::get_current_timestamp().wall_ns;
+        std::memcpy(seg->file.data, &header, sizeof(header));
+        seg->write_pos = header.header_size;
+
+        current.store(seg.get());
+        segments.push_back(cc::move(seg));
+
+        // delete the oldest file
+        if (config.max_files > 0 && index >= uint64_t(config.max_files))
+            std::remove(file_path(index - config.max_files).c_str());
+
+        return true;
+    }
+
+    // must hold rotate_mutex
+    void close_unused_segments()
+    {
+        auto const curr = current.load();
+        for (auto& seg : segments)
+            if (seg.get() != curr && !seg->is_closed && seg->writers.load() == 0)
+            {
+                close_mapped_file(seg->file, seg->used_size());
+                seg->is_closed = true;
+            }
+    }
+
+    // switches to the next file if 'full' is still the current one
+    // returns false if no file is available
+    bool rotate(segment* full)
+    {
+        auto _ = std::lock_guard<std::mutex>(rotate_mutex);
+
+        if (current.load() != full)
+            return current.load() != nullptr; // already rotated by another thread
+
+        auto const ok = open_next_segment();
+        close_unused_segments();
+        return ok;
+    }
+
+    // returns the current segment and registers as its writer (nullptr if there is none)
+    segment* acquire_segment()
+    {
+        while (true)
+        {
+            auto const seg = current.load();
+            if (seg == nullptr)
+                return nullptr;
+
+            // re-check after registering: once a segment is replaced, its file is only closed if no writer is registered
+            seg->writers.fetch_add(1);
+            if (current.load() == seg)
+                return seg;
+
+            seg->writers.fetch_sub(1);
+        }
+    }
+
+    static void release_segment(segment* seg) { seg->writers.fetch_sub(1, std::memory_order_release); }
+};
+
+rlog::binary_file_logger::binary_file_logger(binary_file_config config) : _state(cc::make_unique<state>())
+{
+    _state->config = cc::move(config);
+    _state->config.file_size = bf::align_record_size(cc::max(_state->config.file_size, min_file_size));
+
+    auto _ = std::lock_guard<std::mutex>(_state->rotate_mutex);
+    if (!_state->open_next_segment())
+        std::fprintf(stderr, "[rich-log] unable to create binary log file '%s'\n", _state->file_path(0).c_str());
+}
+
+rlog::binary_file_logger::~binary_file_logger()
+{
+    auto _ = std::lock_guard<std::mutex>(_state->rotate_mutex);
+    _state->current.store(nullptr);
+
+    for (auto& seg : _state->segments)
+        if (!seg->is_closed)
+        {
+            CC_ASSERT(seg->writers.load() == 0 && "binary_file_logger destroyed while writing");
+            close_mapped_file(seg->file, seg->used_size());
+            seg->is_closed = true;
+        }
+}
+
+bool rlog::binary_file_logger::is_valid() const { return _state->current.load() != nullptr; }
+
+void rlog::binary_file_logger::write(message_ref const& msg)
+{
+    auto& s = *_state;
+
+    // resolve ids, first use assigns them
+    auto const new_location_id = [&] { return s.next_location_id.fetch_add(1); };
+    auto const new_domain_id = [&] { return s.next_domain_id.fetch_add(1); };
+    // domains are keyed by registration id, the address of an unloaded domain might be reused
+    // (unregistered domains have registration id 0 and are written as unknown)
+    // the same holds for locations, so their address is stamped with the registration id of their domain
+    // (a site always logs to the same domain, which gets a new registration id when its module is loaded again)
+    auto const registration_id = msg.domain ? msg.domain->registration_id : 0u;
+    auto const domain = registration_id != 0 ? s.domains.find_or_insert(registration_id, new_domain_id) : nullptr;
+    auto const location = msg.location ? s.locations.find_or_insert(uint64_t(uintptr_t(msg.location)), new_location_id, registration_id) : nullptr;
+    // the definition of a new name version is written below, like the one of any version that is new to the file
+    auto const thread_id = thread_name_table::thread_id_of(msg);
+    auto const thread_version = s.threads.get_version(msg, [](uint16_t) {});
+
+    // thread names are not null-terminated
+    char thread_name[64];
+    auto const thread_name_size = cc::min(msg.thread_name.size(), sizeof(thread_name) - 1);
+    std::memcpy(thread_name, msg.thread_name.data(), thread_name_size);
+    thread_name[thread_name_size] = '\0';
+
+    // a single message must never fill a whole file
+    auto const message_size = cc::min(msg.message.size(), s.config.file_size / 4);
+
+    while (true)
+    {
+        auto const seg = s.acquire_segment();
+        if (seg == nullptr)
+            return; // no file
+
+        // definitions are written before the first use in each file
+        // (racing threads might both write one, duplicates are harmless)
+        auto const gen = seg->generation;
+        auto const define_domain = needs_definition(domain, gen);
+        auto const define_location = needs_definition(location, gen);
+        auto const define_thread = s.threads.needs_definition(msg, thread_version, gen);
+
+        size_t size = bf::align_record_size(sizeof(bf::message_record) + message_size);
+        if (define_domain)
+            size += bf::align_record_size(definition_size(msg.domain->name, msg.domain->ansi_color_code));
+        if (define_location)
+            size += bf::align_record_size(definition_size(msg.location->function, msg.location->file));
+        if (define_thread)
+            size += bf::align_record_size(definition_size(thread_name));
+
+        auto const pos = seg->write_pos.fetch_add(size, std::memory_order_relaxed);
+        if (pos + size > seg->file.size)
+        {
+            s.release_segment(seg);
+            if (!s.rotate(seg))
+                return; // message is lost
+            continue;
+        }
+
+        auto dst = seg->file.data + pos;
+
+        if (define_domain)
+        {
+            dst = write_definition(dst, bf::kind_domain, id_of(domain), 0, msg.domain->name, msg.domain->ansi_color_code);
+            domain->defined_generation.store(gen, std::memory_order_relaxed);
+        }
+        if (define_location)
+        {
+            dst = write_definition(dst, bf::kind_location, id_of(location), msg.location->line, msg.location->function, msg.location->file);
+            location->defined_generation.store(gen, std::memory_order_relaxed);
+        }
+        if (define_thread)
+        {
+            dst = write_definition(dst, bf::kind_thread, thread_id, thread_version, thread_name);
+            s.threads.set_defined(msg, thread_version, gen);
+        }
+
+        // message
+        auto const location_id = id_of(location);
+        std::memcpy(dst + offsetof(bf::message_record, wall_ns), &msg.timestamp.wall_ns, sizeof(int64_t));
+        std::memcpy(dst + offsetof(bf::message_record, location_id), &location_id, sizeof(uint32_t));
+        std::memcpy(dst + offsetof(bf::message_record, thread_id), &thread_id, sizeof(uint16_t));
+        std::memcpy(dst + offsetof(bf::message_record, thread_name_version), &thread_version, sizeof(uint16_t));
+        std::memcpy(dst + sizeof(bf::message_record), msg.message.data(), message_size);
+
+        bf::record_prefix prefix = {};
+        prefix.size = uint32_t(sizeof(bf::message_record) + message_size);
+        prefix.kind = bf::kind_message;
+        prefix.verbosity = uint8_t(msg.verbosity);
+        prefix.domain_id = domain_id_of(domain);
+        commit_record(dst, prefix);
+
+        s.release_segment(seg);
+        return;
+    }
+}
+
+void rlog::binary_file_logger::flush()
+{
+    auto const seg = _state->acquire_segment();
+    if (seg == nullptr)
+        return;
+
+    flush_mapped_file(seg->file, seg->used_size());
+    _state->release_segment(seg);
+}
+
+rlog::logger_fun rlog::make_binary_file_logger(binary_file_config config)
+{
+    return [logger = cc::make_unique<binary_file_logger>(cc::move(config))](message_ref msg, bool&)
+    {
+        logger->write(msg);
+        return true;
+    };
+}
+
+bool rlog::read_binary_log_file(char const* path, cc::function_ref<void(message_ref const&)> on_message)
+{
+    auto const file = std::fopen(path, "rb");
+    if (file == nullptr)
+        return false;
+
+    cc::vector<std::byte> data;
+    std::fseek(file, 0, SEEK_END);
+    auto const file_size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    data.resize(file_size > 0 ? size_t(file_size) : 0);
+    data.resize(std::fread(data.data(), 1, data.size(), file));
+    std::fclose(file);
+
+    bf::file_header header;
+    if (data.size() < sizeof(header))
+        return false;
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, bf::magic, sizeof(header.magic)) != 0 || header.version != bf::version || header.header_size > data.size())
+        return false;
+
+    struct location_def
+    {
+        char const* function = "";
+        char const* file = "";
+        int line = 0;
+    };
+
+    struct domain_def
+    {
+        char const* name = "";
+        char const* ansi_color_code = "";
+    };
+
+    cc::vector<domain_def> domains;
+    cc::vector<location_def> locations;
+    cc::vector<cc::vector<char const*>> thread_names; // by thread id and name version
+
+    constexpr uint32_t max_id = 1 << 24; // protection against corrupt files
+
+    // calls f(prefix, record_start) for every complete record
+    auto const for_each_record = [&](auto&& f)
+    {
+        size_t pos = header.header_size;
+        while (pos + sizeof(bf::record_prefix) <= data.size())
+        {
+            bf::record_prefix prefix;
+            std::memcpy(&prefix, data.data() + pos, sizeof(prefix));
+            if (prefix.size < sizeof(prefix) || pos + prefix.size > data.size())
+                break; // end of data
+
+            f(prefix, data.data() + pos);
+            pos += bf::align_record_size(prefix.size);
+        }
+    };
+
+    // the strings of a definition, null-terminated within the record
+    auto const definition_string = [](std::byte const* record, uint32_t size, size_t index) -> char const*
+    {
+        auto s = reinterpret_cast<char const*>(record + sizeof(bf::definition_record));
+        auto const end = reinterpret_cast<char const*>(record + size);
+        for (; s < end; --index)
+        {
+            auto const terminator = static_cast<char const*>(std::memchr(s, '\0', size_t(end - s)));
+            if (terminator == nullptr)
+                break;
+            if (index == 0)
+                return s;
+            s = terminator + 1;
+        }
+        return "";
+    };
+
+    // definitions first (they might appear after their first use)
+    for_each_record(
+        [&](bf::record_prefix const& prefix, std::byte const* record)
+        {
+            if (prefix.kind == bf::kind_message || prefix.size < sizeof(bf::definition_record))
+                return;
+
+            bf::definition_record def;
+            std::memcpy(&def, record, sizeof(def));
+            if (def.id >= max_id)
+                return;
+
+            switch (prefix.kind)
+            {
+            case bf::kind_domain:
+                if (domains.size() <= def.id)
+                    domains.resize(def.id + 1);
+                domains[def.id] = {definition_string(record, prefix.size, 0), definition_string(record, prefix.size, 1)};
+                break;
+            case bf::kind_location:
+                if (locations.size() <= def.id)
+                    locations.resize(def.id + 1);
+                locations[def.id] = {definition_string(record, prefix.size, 0), definition_string(record, prefix.size, 1), def.line};
+                break;
+            case bf::kind_thread:
+            {
+                if (def.id >= rlog::max_thread_ids || def.line <= 0 || def.line > 0xFFFF)
+                    break;
+
+                if (thread_names.size() <= def.id)
+                    thread_names.resize(def.id + 1);
+                auto& versions = thread_names[def.id];
+                if (versions.size() <= size_t(def.line))
+                    versions.resize(def.line + 1);
+                versions[def.line] = definition_string(record, prefix.size, 0);
+                break;
+            }
+            default: // unknown records are skipped
+                break;
+            }
+        });
+
+    for_each_record(
+        [&](bf::record_prefix const& prefix, std::byte const* record)
+        {
+            if (prefix.kind != bf::kind_message || prefix.size < sizeof(bf::message_record))
+                return;
+
+            bf::message_record m;
+            std::memcpy(&m, record, sizeof(m));
+
+            auto const loc_def = m.location_id < locations.size() ? locations[m.location_id] : location_def{};
+            rlog::location loc = {loc_def.function, loc_def.file, loc_def.line};
+
+            auto const dom_def = prefix.domain_id < domains.size() ? domains[prefix.domain_id] : domain_def{"?", ""};
+            domain_info domain;
+            domain.name = dom_def.name;
+            domain.ansi_color_code = dom_def.ansi_color_code;
+
+            message_ref msg;
+            msg.timestamp.wall_ns = m.wall_ns;
+            msg.location = &loc;
+            msg.domain = &domain;
+            msg.verbosity = prefix.verbosity < verbosity::_count ? verbosity::type(prefix.verbosity) : verbosity::Fatal;
+            msg.thread_id = m.thread_id;
+            if (m.thread_id < thread_names.size() && m.thread_name_version < thread_names[m.thread_id].size()
+                && thread_names[m.thread_id][m.thread_name_version] != nullptr)
+                msg.thread_name = thread_names[m.thread_id][m.thread_name_version];
+            msg.message = cc::string_view(reinterpret_cast<char const*>(record + sizeof(m)), prefix.size - sizeof(m));
+
+            if (cc::string_view(msg.domain->name) == Log::Default::domain.name)
+                msg.domain = &Log::Default::domain;
+
+            on_message(msg);
+        });
+
+    return true;
+}
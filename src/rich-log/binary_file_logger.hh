@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <clean-core/function_ref.hh>
+#include <clean-core/string.hh>
+#include <clean-core/unique_ptr.hh>
+
+#include <rich-log/detail/api.hh>
+#include <rich-log/logger.hh>
+#include <rich-log/message.hh>
+#include <rich-log/sink.hh>
+
+namespace rlog
+{
+struct binary_file_config
+{
+    /// files are named "<path_prefix>.<index>.rlog" with a 6 digit index starting at 0
+    /// NOTE: existing files with the same name are overwritten, use a unique prefix per run (e.g. including the date)
+    cc::string path_prefix = "log";
+
+    /// size of each file, allocated up front
+    /// files are truncated to the used size when they are closed
+    size_t file_size = 64u << 20;
+
+    /// if more files exist, the oldest ones are deleted (0 keeps all files)
+    int max_files = 8;
+};
+
+/// writes compact binary log records into a set of pre-allocated, memory-mapped, rotating files
+/// use the rlog-decode tool to turn them back into text (see detail/binary_format.hh for the format)
+///
+/// each record contains the timestamp, verbosity, domain (registration id), location, thread, and message text
+/// writing is lock-free and needs no syscalls, only switching to the next file takes a lock
+///
+/// Usage:
+///
+///   rlog::set_global_default_logger(rlog::make_binary_file_logger({"logs/server"}));
+///
+/// NOTE: threads are identified by their id (rlog::get_current_thread_id), their name is defined again when it changes
+///       the data survives crashes of the process (it is in the page cache), flush() is only needed for OS crashes
+class RLOG_API binary_file_logger
+{
+public:
+    explicit binary_file_logger(binary_file_config config);
+    ~binary_file_logger();
+
+    /// false if the first file could not be created
+    bool is_valid() const;
+
+    /// writes a single message, thread-safe
+    void write(message_ref const& msg);
+
+    /// asks the OS to write the mapped data of the current file to disk
+    void flush();
+
+    binary_file_logger(binary_file_logger&&) = delete;
+    binary_file_logger& operator=(binary_file_logger&&) = delete;
+    binary_file_logger(binary_file_logger const&) = delete;
+    binary_file_logger& operator=(binary_file_logger const&) = delete;
+
+private:
+    struct state;
+    cc::unique_ptr<state> _state;
+};
+
+/// binary_file_logger as a sink (see sink.hh)
+class RLOG_API binary_file_sink final : public sink
+{
+public:
+    explicit binary_file_sink(binary_file_config config) : _logger(cc::move(config)) {}
+
+    void write(message_ref const& msg) override { _logger.write(msg); }
+    void flush() override { _logger.flush(); }
+
+private:
+    binary_file_logger _logger;
+};
+
+/// creates a logger that writes all messages into binary files and consumes them
+/// (the files are closed when the logger is destroyed, e.g. by set_global_default_logger({}))
+RLOG_API logger_fun make_binary_file_logger(binary_file_config config);
+
+/// reads a file written by binary_file_logger and calls on_message for every message in file order
+/// the message_refs are reconstructed from the definitions in the file, the Default domain maps to Log::Default::domain
+/// returns false if the file cannot be read or is not a binary log file
+RLOG_API bool read_binary_log_file(char const* path, cc::function_ref<void(message_ref const&)> on_message);
+}
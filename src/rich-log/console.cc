@@ -0,0 +1,271 @@
+#include "console.hh"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include <clean-core/macros.hh>
+#include <clean-core/string.hh>
+#include <clean-core/vector.hh>
+
+#include <rich-log/crash_handler.hh>
+
+#ifdef CC_OS_WINDOWS
+#include <io.h>
+#else
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+namespace
+{
+// writes everything, retrying on partial writes
+void write_all(rlog::detail::console_stream stream, char const* data, size_t size)
+{
+    auto const file = stream == rlog::detail::console_stream::out ? stdout : stderr;
+
+#ifdef CC_OS_WINDOWS
+    auto const fd = _fileno(file);
+    while (size > 0)
+    {
+        auto const chunk = size < (size_t(1) << 30) ? unsigned(size) : unsigned(1) << 30;
+        auto const written = _write(fd, data, chunk);
+        if (written <= 0)
+            return;
+        data += written;
+        size -= size_t(written);
+    }
+#else
+    auto const fd = fileno(file);
+    while (size > 0)
+    {
+        auto const written = ::write(fd, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return; // nothing sensible to do, e.g. closed pipe
+        }
+        data += written;
+        size -= size_t(written);
+    }
+#endif
+}
+
+// output of the program itself that is still in the stdio buffers must come first
+// (without such output this is only a lock and a check per stream, no syscall)
+void flush_stdio()
+{
+    std::fflush(stdout);
+    std::fflush(stderr);
+}
+
+// a sequence of pending bytes for the same stream
+struct pending_run
+{
+    rlog::detail::console_stream stream;
+    size_t size;
+};
+
+struct console_state
+{
+    // guards everything below and all writes, which keeps the order across stdout and stderr
+    std::mutex mutex;
+    rlog::console::config cfg;
+
+    // buffered mode: pending output in logging order
+    // also guarded by crash_guard, so the crash handler can write it without the mutex
+    cc::string pending;
+    cc::vector<pending_run> runs;
+    rlog::detail::crash_guard crash_guard;
+
+    // output taken from pending by flush_pending, written run by run outside of crash_guard
+    // written_runs (guarded by crash_guard) counts the runs that are completely written, the crash handler writes the others
+    cc::string writing;
+    cc::vector<pending_run> writing_runs;
+    size_t written_runs = 0;
+    std::chrono::steady_clock::time_point pending_since;
+
+    // writes pending output after max_delay_ms
+    std::thread flusher;
+    std::condition_variable flusher_cv;
+    bool stop_requested = false;
+
+    ~console_state() { configure({}); }
+
+    // must hold mutex
+    void flush_pending()
+    {
+        {
+            auto _ = std::lock_guard<rlog::detail::crash_guard>(crash_guard);
+            if (runs.empty())
+                return;
+
+            std::swap(pending, writing);
+            std::swap(runs, writing_runs);
+            written_runs = 0;
+        }
+
+        flush_stdio();
+
+        // a run is only marked as written after the write, so a crash in between writes it twice rather than never
+        size_t offset = 0;
+        while (true)
+        {
+            pending_run run;
+            {
+                auto _ = std::lock_guard<rlog::detail::crash_guard>(crash_guard);
+                if (written_runs >= writing_runs.size()) // done, or taken by the crash handler
+                {
+                    writing.clear();
+                    writing_runs.clear();
+                    written_runs = 0;
+                    return;
+                }
+                run = writing_runs[written_runs];
+            }
+
+            write_all(run.stream, writing.data() + offset, run.size);
+            offset += run.size;
+
+            auto _ = std::lock_guard<rlog::detail::crash_guard>(crash_guard);
+            ++written_runs;
+        }
+    }
+
+    // must hold mutex
+    bool has_pending()
+    {
+        auto _ = std::lock_guard<rlog::detail::crash_guard>(crash_guard);
+        return !runs.empty();
+    }
+
+    // writes the runs starting at first_run
+    // only uses async-signal-safe operations (for the crash handler)
+    static void write_runs(cc::string const& text, cc::vector<pending_run> const& text_runs, size_t first_run)
+    {
+        size_t offset = 0;
+        for (size_t i = 0; i < text_runs.size(); ++i)
+        {
+            if (i >= first_run)
+                write_all(text_runs[i].stream, text.data() + offset, text_runs[i].size);
+            offset += text_runs[i].size;
+        }
+    }
+
+    void write(rlog::detail::console_stream stream, cc::string_view text, bool urgent)
+    {
+        auto _ = std::lock_guard<std::mutex>(mutex);
+
+        if (!cfg.buffered)
+        {
+            flush_stdio();
+            write_all(stream, text.data(), text.size());
+            return;
+        }
+
+        auto was_empty = false;
+        auto is_full = false;
+        {
+            auto _ = std::lock_guard<rlog::detail::crash_guard>(crash_guard);
+            was_empty = runs.empty();
+
+            if (!runs.empty() && runs.back().stream == stream)
+                runs.back().size += text.size();
+            else
+                runs.push_back({stream, text.size()});
+            pending += text;
+
+            is_full = pending.size() >= cfg.max_buffered_bytes;
+        }
+
+        if (was_empty)
+        {
+            pending_since = std::chrono::steady_clock::now();
+            flusher_cv.notify_one();
+        }
+
+        if (urgent || is_full)
+            flush_pending();
+    }
+
+    void configure(rlog::console::config const& new_cfg)
+    {
+        auto lock = std::unique_lock<std::mutex>(mutex);
+        flush_pending();
+        cfg = new_cfg;
+
+        if (cfg.buffered && !flusher.joinable())
+        {
+            stop_requested = false;
+            flusher = std::thread([this] { run_flusher(); });
+        }
+        else if (!cfg.buffered && flusher.joinable())
+        {
+            stop_requested = true;
+            flusher_cv.notify_one();
+
+            lock.unlock();
+            flusher.join();
+        }
+    }
+
+    void run_flusher()
+    {
+        auto lock = std::unique_lock<std::mutex>(mutex);
+        while (!stop_requested)
+        {
+            if (!has_pending())
+            {
+                flusher_cv.wait(lock);
+                continue;
+            }
+
+            auto const deadline = pending_since + std::chrono::milliseconds(cfg.max_delay_ms);
+            flusher_cv.wait_until(lock, deadline, [&] { return stop_requested || !has_pending(); });
+
+            if (has_pending() && std::chrono::steady_clock::now() >= deadline)
+                flush_pending();
+        }
+    }
+};
+
+// constructed on first use (i.e. after all logger statics) so it is destroyed (and flushed) before them
+console_state& state()
+{
+    static console_state s;
+    return s;
+}
+}
+
+void rlog::console::configure(config const& cfg) { state().configure(cfg); }
+
+void rlog::console::flush()
+{
+    auto& s = state();
+    auto _ = std::lock_guard<std::mutex>(s.mutex);
+    s.flush_pending();
+}
+
+void rlog::detail::write_to_console(console_stream stream, cc::string_view text, bool urgent) { state().write(stream, text, urgent); }
+
+bool rlog::detail::drain_console_for_crash()
+{
+    auto& s = state();
+    if (!s.crash_guard.try_lock_for_crash())
+        return false;
+
+    // output that flush_pending is writing right now comes first
+    // it stays allocated (flush_pending might still read it), it is only marked as written
+    console_state::write_runs(s.writing, s.writing_runs, s.written_runs);
+    s.written_runs = s.writing_runs.size();
+
+    console_state::write_runs(s.pending, s.runs, 0);
+    s.pending.clear();
+    s.runs.clear();
+    s.crash_guard.unlock();
+    return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+
+#include <clean-core/string_view.hh>
+
+#include <rich-log/detail/api.hh>
+
+/**
+ * console output of the built-in default logger and rlog::console_sink
+ *
+ * each message is assembled into a single buffer and written with a single write call, bypassing stdio
+ * stdout and stderr share one lock, so lines always appear in the order they were logged, regardless of the stream
+ *
+ * optionally, lines of many messages can be coalesced and written together, which saves syscalls when logging to pipes
+ *
+ * Usage:
+ *
+ *    rlog::console::config cfg;
+ *    cfg.buffered = true;
+ *    rlog::console::configure(cfg);
+ *
+ *    LOG("this is written within the next 100ms (or when 64 KiB are pending)");
+ *    LOG_ERROR("errors are always written immediately (together with everything pending before them)");
+ *
+ *    rlog::console::flush(); // writes everything pending now
+ *
+ * NOTE: pending output is also written at static destruction
+ * NOTE: output of the program itself through stdio (printf, std::cout with sync_with_stdio) is flushed before each write,
+ *       so it stays ordered relative to log lines
+ */
+
+namespace rlog::console
+{
+struct config
+{
+    /// if true, lines are collected and written together
+    bool buffered = false;
+
+    /// buffered only: pending output is written once it reaches this size
+    size_t max_buffered_bytes = 64 * 1024;
+
+    /// buffered only: pending output is written at most this late (by a background thread)
+    int max_delay_ms = 100;
+};
+
+/// changes the console output mode, writes everything pending first
+RLOG_API void configure(config const& cfg);
+
+/// writes all pending output (buffered mode)
+RLOG_API void flush();
+}
+
+namespace rlog::detail
+{
+enum class console_stream
+{
+    out, // stdout
+    err, // stderr
+};
+
+/// writes complete lines to the console (or buffers them, see rlog::console::config)
+/// 'urgent' output (e.g. Error and Fatal messages) is never delayed
+RLOG_API void write_to_console(console_stream stream, cc::string_view text, bool urgent);
+
+/// writes pending output (buffered mode) without flushing stdio, only used by the crash handler (see crash_handler.hh)
+/// returns false if the console stayed locked
+RLOG_API bool drain_console_for_crash();
+}
@@ -0,0 +1,372 @@
+#include "control.hh"
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include <clean-core/macros.hh>
+#include <clean-core/utility.hh>
+#include <clean-core/vector.hh>
+
+#include <rich-log/domain.hh>
+#include <rich-log/log_line.hh>
+#include <rich-log/logger.hh>
+#include <rich-log/site_stats.hh>
+
+#ifndef CC_OS_WINDOWS
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// macOS has no MSG_NOSIGNAL (a client that disconnects early only causes SIGPIPE there)
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+namespace
+{
+constexpr size_t max_command_size = 4096;
+
+char const* const help_text = //
+    "help                          lists the commands\n"
+    "domains                       lists all registered domains and their levels\n"
+    "level <pattern> <verbosity>   sets the level of all matching domains\n"
+    "break-level <verbosity>       breaks on every LOG at or above the verbosity\n"
+    "break <file>[:<line>] [off]   breaks on the LOGs of matching sites, or stops breaking\n"
+    "stats [on|off|reset]          shows the most expensive LOG sites, or enables, disables, or resets site statistics\n"
+    "verbosities: trace, debug, info, warning, error, fatal\n";
+
+cc::vector<cc::string_view> split_words(cc::string_view s)
+{
+    cc::vector<cc::string_view> words;
+    size_t i = 0;
+    while (i < s.size())
+    {
+        while (i < s.size() && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r' || s[i] == '\n'))
+            ++i;
+
+        auto const start = i;
+        while (i < s.size() && s[i] != ' ' && s[i] != '\t' && s[i] != '\r' && s[i] != '\n')
+            ++i;
+
+        if (i > start)
+            words.push_back(s.subview(start, i - start));
+    }
+    return words;
+}
+
+// case-insensitive, against the names of get_verbosity_name
+bool parse_verbosity(cc::string_view s, rlog::verbosity::type& v)
+{
+    for (auto i = 0; i < rlog::verbosity::_count; ++i)
+    {
+        auto const name = cc::string_view(rlog::get_verbosity_name(rlog::verbosity::type(i)));
+        if (name.size() != s.size())
+            continue;
+
+        auto is_equal = true;
+        for (size_t c = 0; c < s.size(); ++c)
+            is_equal &= (s[c] >= 'a' && s[c] <= 'z' ? char(s[c] - 'a' + 'A') : s[c]) == name[c];
+
+        if (is_equal)
+        {
+            v = rlog::verbosity::type(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void append_line(cc::string& out, char const* fmt, ...) CC_PRINTF_FUNC(2);
+void append_line(cc::string& out, char const* fmt, ...)
+{
+    char line[512];
+    std::va_list args;
+    va_start(args, fmt);
+    auto const len = std::vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+
+    if (len > 0)
+        out += cc::string_view(line, cc::min(size_t(len), sizeof(line) - 1));
+    out += '\n';
+}
+
+void list_domains(cc::string& out)
+{
+    for (auto d : rlog::get_domains())
+        append_line(out, "%-40s %-8s%s", d->name, rlog::get_verbosity_name(d->min_verbosity.load(std::memory_order_relaxed)),
+                    d->has_verbosity_override ? "" : " (inherited)");
+}
+
+void set_site_break(cc::string& out, cc::vector<cc::string_view> const& args)
+{
+    if (args.size() < 2 || args.size() > 3 || (args.size() == 3 && args[2] != "off" && args[2] != "on"))
+    {
+        out += "error: usage: break <file>[:<line>] [off]\n";
+        return;
+    }
+
+    // "file.cc:123" or "file.cc"
+    auto file = args[1];
+    auto line = 0;
+    for (auto i = int(file.size()) - 1; i > 0; --i)
+    {
+        if (file[i] >= '0' && file[i] <= '9')
+            continue;
+
+        if (file[i] == ':' && i + 1 < int(file.size()))
+        {
+            std::sscanf(cc::string(file.subview(i + 1)).c_str(), "%d", &line);
+            file = file.subview(0, i);
+        }
+        break;
+    }
+
+    auto const enabled = args.size() < 3 || args[2] == "on";
+    auto const count = rlog::set_site_break_on_log(cc::string(file).c_str(), line, enabled);
+    append_line(out, "%s breaking on %d site(s)", enabled ? "started" : "stopped", count);
+    if (count == 0 && !rlog::is_log_site_stats_enabled())
+        out += "note: only sites counted by site statistics are known, see 'stats on'\n";
+}
+
+void site_stats(cc::string& out, cc::vector<cc::string_view> const& args)
+{
+    if (args.size() == 1)
+        rlog::append_log_hotspots(out);
+    else if (args.size() == 2 && args[1] == "on")
+    {
+        rlog::enable_log_site_stats(true);
+        out += "site statistics enabled\n";
+    }
+    else if (args.size() == 2 && args[1] == "off")
+    {
+        rlog::enable_log_site_stats(false);
+        out += "site statistics disabled\n";
+    }
+    else if (args.size() == 2 && args[1] == "reset")
+    {
+        rlog::reset_log_site_stats();
+        out += "site statistics reset\n";
+    }
+    else
+        out += "error: usage: stats [on|off|reset]\n";
+}
+
+#ifndef CC_OS_WINDOWS
+
+// answers the command of a single connection
+void serve_connection(int fd)
+{
+    // a client that does not send its command in time is dropped, the server must not hang
+    timeval timeout = {1, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    char buffer[max_command_size];
+    size_t size = 0;
+    while (size < sizeof(buffer))
+    {
+        auto const n = ::recv(fd, buffer + size, sizeof(buffer) - size, 0);
+        if (n <= 0)
+            break;
+
+        size += size_t(n);
+        if (std::memchr(buffer, '\n', size) != nullptr)
+            break;
+    }
+
+    auto command = cc::string_view(buffer, size);
+    for (size_t i = 0; i < command.size(); ++i)
+        if (command[i] == '\n')
+        {
+            command = command.subview(0, i);
+            break;
+        }
+
+    auto const answer = rlog::control::execute(command);
+    for (size_t sent = 0; sent < answer.size();)
+    {
+        auto const n = ::send(fd, answer.data() + sent, answer.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            break;
+        sent += size_t(n);
+    }
+}
+
+#endif
+
+struct control_server
+{
+    std::mutex mutex; // protects start and stop
+    std::thread thread;
+    std::atomic<bool> is_stopping = {false};
+    int listen_fd = -1;
+    cc::string path;
+
+    ~control_server() { stop(); }
+
+    bool start(rlog::control::config const& cfg)
+    {
+        auto _ = std::lock_guard<std::mutex>(mutex);
+        stop_locked();
+
+#ifdef CC_OS_WINDOWS
+        (void)cfg;
+        std::fprintf(stderr, "[rich-log] the control socket is not supported on this platform\n");
+        return false;
+#else
+        auto socket_path = cfg.socket_path;
+        if (socket_path.empty())
+        {
+            char default_path[64];
+            std::snprintf(default_path, sizeof(default_path), "/tmp/rlog-%d.sock", int(::getpid()));
+            socket_path = default_path;
+        }
+
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(addr.sun_path))
+        {
+            std::fprintf(stderr, "[rich-log] control socket path too long: %s\n", socket_path.c_str());
+            return false;
+        }
+        std::memcpy(addr.sun_path, socket_path.data(), socket_path.size());
+
+        auto const fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+            std::fprintf(stderr, "[rich-log] unable to create control socket\n");
+            return false;
+        }
+
+        // the socket file is created by bind, with the permissions restricted by the umask
+        // so it is 0600 from the start (a chmod afterwards leaves a window in which other users can connect)
+        // NOTE: the umask is per process, files created by other threads in the meantime are restricted as well
+        ::unlink(socket_path.c_str());
+        auto const old_mask = ::umask(0177);
+        auto const is_bound = ::bind(fd, reinterpret_cast<sockaddr const*>(&addr), sizeof(addr)) == 0;
+        ::umask(old_mask);
+
+        if (!is_bound || ::listen(fd, 4) != 0)
+        {
+            std::fprintf(stderr, "[rich-log] unable to listen on control socket %s\n", socket_path.c_str());
+            ::close(fd);
+            ::unlink(socket_path.c_str());
+            return false;
+        }
+
+        listen_fd = fd;
+        path = socket_path;
+        is_stopping.store(false);
+        thread = std::thread([this] { serve(); });
+        return true;
+#endif
+    }
+
+    void stop()
+    {
+        auto _ = std::lock_guard<std::mutex>(mutex);
+        stop_locked();
+    }
+
+    void stop_locked()
+    {
+        if (!thread.joinable())
+            return;
+
+        is_stopping.store(true);
+        thread.join();
+
+#ifndef CC_OS_WINDOWS
+        ::close(listen_fd);
+        ::unlink(path.c_str());
+#endif
+        listen_fd = -1;
+        path.clear();
+    }
+
+    void serve()
+    {
+#ifndef CC_OS_WINDOWS
+        // polls so that stop does not need to wake the thread
+        while (!is_stopping.load())
+        {
+            pollfd p = {listen_fd, POLLIN, 0};
+            if (::poll(&p, 1, 100) <= 0)
+                continue;
+
+            auto const fd = ::accept(listen_fd, nullptr, nullptr);
+            if (fd < 0)
+                continue;
+
+            serve_connection(fd);
+            ::close(fd);
+        }
+#endif
+    }
+};
+
+// constructed on first use, so it is stopped before the statics it uses are destroyed
+control_server& server()
+{
+    static control_server s;
+    return s;
+}
+}
+
+bool rlog::control::start(config const& cfg) { return server().start(cfg); }
+
+void rlog::control::stop() { server().stop(); }
+
+cc::string rlog::control::get_socket_path()
+{
+    auto& s = server();
+    auto _ = std::lock_guard<std::mutex>(s.mutex);
+    return s.path;
+}
+
+cc::string rlog::control::execute(cc::string_view command)
+{
+    auto const args = split_words(command);
+
+    cc::string out;
+    if (args.empty())
+        out += "error: empty command, see 'help'\n";
+    else if (args[0] == "help")
+        out += help_text;
+    else if (args[0] == "domains")
+        list_domains(out);
+    else if (args[0] == "level")
+    {
+        auto v = verbosity::Info;
+        if (args.size() != 3 || !parse_verbosity(args[2], v))
+            out += "error: usage: level <pattern> <verbosity>\n";
+        else
+            append_line(out, "%d domain(s) set to %s", rlog::set_min_verbosity(cc::string(args[1]).c_str(), v), get_verbosity_name(v));
+    }
+    else if (args[0] == "break-level")
+    {
+        auto v = verbosity::Fatal;
+        if (args.size() != 2 || !parse_verbosity(args[1], v))
+            out += "error: usage: break-level <verbosity>\n";
+        else
+        {
+            rlog::set_break_on_log_minimum_verbosity(v);
+            append_line(out, "breaking on LOGs at or above %s", get_verbosity_name(v));
+        }
+    }
+    else if (args[0] == "break")
+        set_site_break(out, args);
+    else if (args[0] == "stats")
+        site_stats(out, args);
+    else
+        append_line(out, "error: unknown command '%s', see 'help'", cc::string(args[0]).c_str());
+
+    return out;
+}
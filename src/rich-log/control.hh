@@ -0,0 +1,64 @@
+#pragma once
+
+#include <clean-core/string.hh>
+#include <clean-core/string_view.hh>
+
+#include <rich-log/detail/api.hh>
+
+/**
+ * runtime control of a running process: change domain levels, set breakpoints, and read site statistics without a debugger
+ *
+ * commands are single lines of text, the answer is text as well
+ * they can be executed in-process (execute) or sent through a Unix domain socket (start), e.g. with the rlog-ctl tool
+ *
+ * Usage:
+ *
+ *    // in the process
+ *    rlog::control::start(); // listens on /tmp/rlog-<pid>.sock
+ *
+ *    // in a terminal
+ *    rlog-ctl <pid> domains
+ *    rlog-ctl <pid> level "MyEngine::Net::*" debug
+ *    rlog-ctl <pid> level "MyEngine::Net::*" info
+ *
+ * commands:
+ *
+ *    help                          lists the commands
+ *    domains                       lists all registered domains and their levels
+ *    level <pattern> <verbosity>   sets the level of all matching domains (see rlog::set_min_verbosity)
+ *    break-level <verbosity>       breaks on every LOG at or above the verbosity (see rlog::set_break_on_log_minimum_verbosity)
+ *    break <file>[:<line>] [off]   breaks on the LOGs of matching sites, or stops breaking (see rlog::set_site_break_on_log)
+ *    stats [on|off|reset]          shows the most expensive LOG sites, or enables, disables, or resets site statistics
+ *
+ * verbosities are trace, debug, info, warning, error, and fatal
+ *
+ * every change is a single atomic store per domain or site, logging threads are never paused
+ *
+ * NOTE: the socket is only available on POSIX systems, it is created with mode 0600 (restricted to the user running the process)
+ * NOTE: the socket is served by a background thread that handles one short-lived connection at a time
+ * CAUTION: breaking without an attached debugger terminates the process (SIGTRAP)
+ */
+
+namespace rlog::control
+{
+struct config
+{
+    /// path of the Unix domain socket, /tmp/rlog-<pid>.sock if empty
+    /// NOTE: an existing file at this path is replaced
+    cc::string socket_path;
+};
+
+/// starts serving commands on the socket (replacing a previous one)
+/// returns false if the socket could not be created
+RLOG_API bool start(config const& cfg = {});
+
+/// stops serving commands and removes the socket
+RLOG_API void stop();
+
+/// path of the socket while it is served, empty otherwise
+RLOG_API cc::string get_socket_path();
+
+/// executes a single command (see above) and returns the answer (one line per entry, lines starting with "error:" on failure)
+/// thread-safe, can also be used to build other control channels
+RLOG_API cc::string execute(cc::string_view command);
+}
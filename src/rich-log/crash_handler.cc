@@ -0,0 +1,277 @@
+#include "crash_handler.hh"
+
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <exception>
+
+#include <clean-core/macros.hh>
+
+#include <rich-log/async.hh>
+#include <rich-log/console.hh>
+
+#ifdef CC_OS_WINDOWS
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+int const g_signals[] = {
+    SIGSEGV, SIGABRT, SIGILL, SIGFPE,
+#ifdef SIGBUS
+    SIGBUS,
+#endif
+};
+constexpr int signal_count = int(sizeof(g_signals) / sizeof(g_signals[0]));
+
+// configuration of the installed handler, only changed by install_handler and uninstall_handler
+int g_fd = 2;
+int g_owned_fd = -1; // opened from config::path
+bool g_handles_signals = false;
+bool g_handles_terminate = false;
+std::terminate_handler g_previous_terminate = nullptr;
+
+#ifdef CC_OS_WINDOWS
+using signal_fun = void (*)(int);
+signal_fun g_previous_signals[signal_count] = {};
+#else
+struct sigaction g_previous_signals[signal_count] = {};
+
+// stack overflows need their own stack to run the handler on
+alignas(16) char g_alternate_stack[64 * 1024];
+#endif
+
+// messages are only drained once, e.g. std::terminate usually ends in SIGABRT
+std::atomic<bool> g_is_draining = {false};
+
+void write_all(int fd, char const* data, size_t size)
+{
+    while (size > 0)
+    {
+#ifdef CC_OS_WINDOWS
+        auto const written = _write(fd, data, unsigned(size));
+        if (written <= 0)
+            return;
+#else
+        auto const written = ::write(fd, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+#endif
+        data += written;
+        size -= size_t(written);
+    }
+}
+
+char const* get_signal_name(int sig)
+{
+    switch (sig)
+    {
+    case SIGSEGV:
+        return "SIGSEGV";
+    case SIGABRT:
+        return "SIGABRT";
+    case SIGILL:
+        return "SIGILL";
+    case SIGFPE:
+        return "SIGFPE";
+#ifdef SIGBUS
+    case SIGBUS:
+        return "SIGBUS";
+#endif
+    }
+    return "unknown signal";
+}
+
+void drain(char const* reason)
+{
+    if (g_is_draining.exchange(true))
+        return;
+
+    auto out = rlog::detail::signal_safe_writer(g_fd);
+    out.append("rlog: ");
+    out.append(reason);
+    out.append(", writing buffered log messages\n");
+    out.flush();
+
+    if (!rlog::detail::drain_console_for_crash())
+        out.append("rlog: console output is locked, pending lines are lost\n");
+
+    if (!rlog::detail::drain_async_for_crash(out))
+        out.append("rlog: async log buffers are locked, pending messages are lost\n");
+}
+
+int find_signal_index(int sig)
+{
+    for (auto i = 0; i < signal_count; ++i)
+        if (g_signals[i] == sig)
+            return i;
+    return -1;
+}
+
+void restore_signal(int index)
+{
+#ifdef CC_OS_WINDOWS
+    std::signal(g_signals[index], g_previous_signals[index] ? g_previous_signals[index] : SIG_DFL);
+#else
+    ::sigaction(g_signals[index], &g_previous_signals[index], nullptr);
+#endif
+}
+
+void on_signal(int sig)
+{
+    drain(get_signal_name(sig));
+
+    // hand over to the previous handler (or the default action)
+    // the signal is blocked while this handler runs, so the re-raised one is delivered right after it returns
+    // (faults like SIGSEGV are raised again anyway when the instruction is retried)
+    auto const index = find_signal_index(sig);
+    if (index >= 0)
+        restore_signal(index);
+    std::raise(sig);
+}
+
+void on_terminate()
+{
+    drain("std::terminate called");
+
+    if (g_previous_terminate)
+        g_previous_terminate();
+    std::abort();
+}
+}
+
+bool rlog::crash::install_handler(config const& cfg)
+{
+    uninstall_handler();
+
+    g_fd = cfg.fd;
+    if (cfg.path != nullptr)
+    {
+#ifdef CC_OS_WINDOWS
+        g_owned_fd = _open(cfg.path, _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, 0644);
+#else
+        g_owned_fd = ::open(cfg.path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+#endif
+        if (g_owned_fd < 0)
+            return false;
+        g_fd = g_owned_fd;
+    }
+
+    g_is_draining.store(false);
+
+    if (cfg.handle_signals)
+    {
+#ifdef CC_OS_WINDOWS
+        for (auto i = 0; i < signal_count; ++i)
+            g_previous_signals[i] = std::signal(g_signals[i], on_signal);
+#else
+        // keep an alternate stack the program already set up
+        stack_t stack = {};
+        if (::sigaltstack(nullptr, &stack) == 0 && (stack.ss_flags & SS_DISABLE) != 0)
+        {
+            stack.ss_sp = g_alternate_stack;
+            stack.ss_size = sizeof(g_alternate_stack);
+            stack.ss_flags = 0;
+            ::sigaltstack(&stack, nullptr);
+        }
+
+        struct sigaction action = {};
+        action.sa_handler = on_signal;
+        action.sa_flags = SA_ONSTACK;
+        sigemptyset(&action.sa_mask);
+        for (auto i = 0; i < signal_count; ++i)
+            ::sigaction(g_signals[i], &action, &g_previous_signals[i]);
+#endif
+        g_handles_signals = true;
+    }
+
+    if (cfg.handle_terminate)
+    {
+        g_previous_terminate = std::set_terminate(on_terminate);
+        g_handles_terminate = true;
+    }
+
+    return true;
+}
+
+void rlog::crash::uninstall_handler()
+{
+    if (g_handles_signals)
+    {
+        for (auto i = 0; i < signal_count; ++i)
+            restore_signal(i);
+        g_handles_signals = false;
+    }
+
+    if (g_handles_terminate)
+    {
+        std::set_terminate(g_previous_terminate);
+        g_previous_terminate = nullptr;
+        g_handles_terminate = false;
+    }
+
+    if (g_owned_fd >= 0)
+    {
+#ifdef CC_OS_WINDOWS
+        _close(g_owned_fd);
+#else
+        ::close(g_owned_fd);
+#endif
+        g_owned_fd = -1;
+    }
+    g_fd = 2;
+}
+
+void rlog::crash::drain_buffered_messages()
+{
+    auto out = detail::signal_safe_writer(g_fd);
+    detail::drain_console_for_crash();
+    detail::drain_async_for_crash(out);
+}
+
+void rlog::detail::signal_safe_writer::append(cc::string_view s)
+{
+    while (!s.empty())
+    {
+        if (size == sizeof(buffer))
+            flush();
+
+        auto const n = s.size() < sizeof(buffer) - size ? s.size() : sizeof(buffer) - size;
+        for (size_t i = 0; i < n; ++i)
+            buffer[size + i] = s[i];
+        size += n;
+        s = s.subview(n);
+    }
+}
+
+void rlog::detail::signal_safe_writer::append_uint(uint64_t v, int min_digits)
+{
+    char digits[20];
+    auto count = 0;
+    do
+    {
+        digits[count++] = char('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+
+    for (; count < min_digits && count < int(sizeof(digits)); ++count)
+        digits[count] = '0';
+
+    while (count > 0)
+        append(digits[--count]);
+}
+
+void rlog::detail::signal_safe_writer::flush()
+{
+    write_all(fd, buffer, size);
+    size = 0;
+}
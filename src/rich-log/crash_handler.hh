@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include <clean-core/string_view.hh>
+
+#include <rich-log/detail/api.hh>
+
+/**
+ * opt-in crash handler that writes log messages which are still buffered inside rich-log before the process dies
+ *
+ * with async logging (see async.hh) or buffered console output (see console.hh), the last messages before a crash
+ * are usually still in memory, and those are the most valuable ones
+ *
+ * Usage:
+ *
+ *    int main()
+ *    {
+ *        rlog::crash::install_handler(); // messages go to stderr
+ *
+ *        // or to a separate file, opened now (not during the crash)
+ *        rlog::crash::config cfg;
+ *        cfg.path = "logs/crash.log";
+ *        rlog::crash::install_handler(cfg);
+ *
+ *        rlog::async::enable();
+ *        ...
+ *    }
+ *
+ * on SIGSEGV, SIGABRT, SIGBUS, SIGILL, SIGFPE, or std::terminate, the handler
+ *   - writes pending console output (buffered mode) to stdout and stderr
+ *   - writes all messages still waiting for the async background thread to the configured fd, oldest first, as
+ *     "hh:mm:ss.mmmZ [thread] SEVERITY Domain message" (time in UTC, fields are not included)
+ *     (including the ones it is dispatching right now, output that was in flight may therefore appear twice)
+ *   - then calls the previously installed handler (or the default action, e.g. a core dump)
+ *
+ * the handler only uses async-signal-safe operations (write, atomics) and memory that was allocated up front
+ *   - the console and async buffers are taken with a spinning atomic flag (see crash_guard), not their mutex,
+ *     and skipped if the flag stays taken (e.g. by the crashed thread)
+ *   - except: serialized LOG arguments are formatted with the regular formatter, which neither allocates nor locks for them,
+ *             but is not guaranteed to be async-signal-safe (e.g. floating point formatting)
+ *
+ * NOTE: Fatal messages are always written synchronously, together with everything logged before them (see do_log)
+ * NOTE: the binary file logger writes into mapped files, its data survives a crash without any handler
+ * NOTE: stack overflows can only be handled on the thread that installed the handler (it gets an alternate signal stack)
+ */
+
+namespace rlog::crash
+{
+struct config
+{
+    /// where buffered messages are written, must stay open (default: stderr)
+    int fd = 2;
+
+    /// if set, this file is opened for appending when the handler is installed and used instead of fd
+    char const* path = nullptr;
+
+    /// SIGSEGV, SIGABRT, SIGBUS, SIGILL, SIGFPE
+    bool handle_signals = true;
+
+    /// std::set_terminate (e.g. uncaught exceptions)
+    bool handle_terminate = true;
+};
+
+/// installs the crash handler (replacing a previous configuration)
+/// returns false if cfg.path could not be opened
+RLOG_API bool install_handler(config const& cfg = {});
+
+/// restores the handlers that were installed before install_handler
+RLOG_API void uninstall_handler();
+
+/// writes everything that is still buffered, exactly like the crash handler does
+/// can be called from custom signal handlers, with the same caveat about formatting as the handler itself (see above)
+/// NOTE: the written messages are consumed, i.e. they are not passed to the loggers anymore
+RLOG_API void drain_buffered_messages();
+}
+
+namespace rlog::detail
+{
+/// buffered output to a file descriptor that only uses async-signal-safe operations (no allocation, no locks)
+struct RLOG_API signal_safe_writer
+{
+    explicit signal_safe_writer(int fd) : fd(fd) {}
+    ~signal_safe_writer() { flush(); }
+
+    signal_safe_writer(signal_safe_writer const&) = delete;
+    signal_safe_writer& operator=(signal_safe_writer const&) = delete;
+
+    void append(cc::string_view s);
+    void append(char c) { append(cc::string_view(&c, 1)); }
+
+    /// decimal, padded with zeros to at least min_digits
+    void append_uint(uint64_t v, int min_digits = 1);
+
+    void flush();
+
+    int const fd;
+    size_t size = 0;
+    char buffer[2048];
+};
+
+/// excludes the crash handler from data that is otherwise protected by a std::mutex (which is not async-signal-safe)
+/// regular code holds it (in addition to the mutex) only while it changes that data, never during I/O or waits
+/// can be used with std::lock_guard
+struct crash_guard
+{
+    void lock()
+    {
+        while (is_locked.test_and_set(std::memory_order_acquire))
+            std::this_thread::yield();
+    }
+
+    void unlock() { is_locked.clear(std::memory_order_release); }
+
+    /// the crash handler must not wait for a guard that might never be released (e.g. held by the crashed thread)
+    /// only spins on the atomic flag (no syscalls), returns true if it could be taken within a bounded number of attempts
+    bool try_lock_for_crash()
+    {
+        for (auto i = 0; i < 1'000'000; ++i)
+            if (!is_locked.test_and_set(std::memory_order_acquire))
+                return true;
+        return false;
+    }
+
+private:
+    std::atomic_flag is_locked = ATOMIC_FLAG_INIT;
+};
+}
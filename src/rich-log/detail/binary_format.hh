@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * on-disk format of rlog::binary_file_logger (decoded by the rlog-decode tool)
+ *
+ * a file starts with a file_header, followed by 8 byte aligned records until the first record with size 0
+ * (files are pre-allocated and zero-filled, so size 0 marks the end of the written data)
+ *
+ * every file is self-contained: before a domain, location, or thread id is first used in a file,
+ * a definition record with its strings is written (definitions can appear more than once)
+ * threads are identified by their rlog thread id (see rlog::get_current_thread_id) and the version of their name,
+ * a thread that renames itself (or a reused thread id) gets a new version with its own definition
+ * records of different threads can interleave, so a definition might appear after its first use
+ * and decoders should read all definitions before the messages
+ *
+ * all values are in native byte order
+ */
+
+namespace rlog::detail::binary_format
+{
+constexpr char magic[8] = {'R', 'L', 'O', 'G', 'B', 'I', 'N', '1'};
+constexpr uint32_t version = 2;
+constexpr size_t record_alignment = 8;
+
+/// name version of threads without a name (no definition is written for it)
+constexpr uint16_t unnamed_thread_version = 0;
+/// id used if the id table is full (no definition is written for it)
+constexpr uint32_t unknown_id = 0xFFFFFFFF;
+/// domain id of messages without a domain definition (unregistered domain or full id table)
+constexpr uint16_t unknown_domain_id = 0xFFFF;
+
+struct file_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t file_index;
+    int64_t created_wall_ns;
+};
+
+enum record_kind : uint8_t
+{
+    kind_domain = 1,   // definition, strings: name, ansi color code
+    kind_location = 2, // definition, strings: function, file
+    kind_thread = 3,   // definition (id: thread id, line: name version), strings: name
+    kind_message = 4,
+};
+
+struct record_prefix
+{
+    uint32_t size; // exact size in bytes (including the prefix), the next record starts at the next aligned offset
+    uint8_t kind;
+    uint8_t verbosity; // messages only
+    uint16_t domain_id; // messages only, dense per-logger id starting at 1 (see kind_domain)
+};
+
+/// followed by null-terminated strings (see record_kind) up to the record size
+struct definition_record
+{
+    record_prefix prefix;
+    uint32_t id;
+    int32_t line; // locations: line, threads: name version
+};
+
+/// followed by the message text (prefix.size - sizeof(message_record) chars, not null-terminated)
+struct message_record
+{
+    record_prefix prefix;
+    int64_t wall_ns;
+    uint32_t location_id;
+    uint16_t thread_id;           // see rlog::get_current_thread_id
+    uint16_t thread_name_version; // see kind_thread
+};
+
+static_assert(sizeof(file_header) == 32, "unexpected padding");
+static_assert(sizeof(definition_record) == 16, "unexpected padding");
+static_assert(sizeof(message_record) == 24, "unexpected padding");
+
+constexpr size_t align_record_size(size_t s) { return (s + record_alignment - 1) & ~(record_alignment - 1); }
+}
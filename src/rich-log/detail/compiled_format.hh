@@ -0,0 +1,358 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include <clean-core/span.hh>
+#include <clean-core/string_view.hh>
+
+#include <rich-log/detail/format.hh>
+
+/**
+ * compile-time parsed format strings
+ *
+ * the LOG macros pass the format string literal through a lambda (see DETAIL_RICH_LOG_CAPTURE in log.hh),
+ * so it can be parsed in a constant expression into a static list of segments:
+ *   - literal text (written as is)
+ *   - placeholders (printf "%5.2f" or pythonic "{}", "{1:x}", "{name}") with the argument they refer to
+ *
+ * parsing also validates the format string against the arguments:
+ *   - malformed placeholders
+ *   - too few or too many arguments
+ *   - printf conversions that do not fit the argument type (e.g. %d for a string)
+ * errors show up as "call to non-constexpr function rlog::detail::format_string_error" pointing at the reason
+ *
+ * a '%' that does not start a printf placeholder for the next argument (e.g. "50%" or "100% done") is not an error,
+ * such strings are left to the runtime formatter as a whole (same output as without compile-time parsing)
+ *
+ * at runtime, literal text is copied directly and each placeholder is formatted on its own
+ * only placeholders with options are parsed again (by clean-core, to keep its exact semantics)
+ */
+
+namespace rlog::detail
+{
+struct format_segment
+{
+    enum kind_t : uint8_t
+    {
+        literal,
+        auto_arg,     // "{}", "{:opts}", "%d", ...: argument index is known
+        explicit_arg, // "{1}", "{name}": resolved against all arguments at runtime
+    };
+
+    kind_t kind = literal;
+    bool has_options = false; // "{}" can be formatted without parsing
+    uint16_t arg = 0;         // argument index (auto_arg only)
+    uint32_t offset = 0;      // literal text or whole placeholder in the format string
+    uint32_t size = 0;
+};
+
+/// the parsed segments of a format string literal (static storage)
+struct compiled_format
+{
+    format_segment const* segments;
+    size_t segment_count;
+};
+
+/// a format string literal, optionally with its compiled segments
+struct format_string
+{
+    char const* str;
+    compiled_format const* compiled = nullptr; // nullptr: parsed at runtime
+};
+
+enum class arg_category : uint8_t
+{
+    integral, // including bool, char, and enums
+    floating_point,
+    pointer,
+    other,
+};
+
+template <class T>
+struct arg_category_of
+{
+    static constexpr arg_category value = std::is_integral_v<T> || std::is_enum_v<T> ? arg_category::integral
+                                          : std::is_floating_point_v<T>             ? arg_category::floating_point
+                                          : std::is_pointer_v<T> || std::is_null_pointer_v<T> ? arg_category::pointer
+                                                                                               : arg_category::other;
+};
+template <class T>
+struct arg_category_of<cc::format_arg<T>> : arg_category_of<T>
+{
+};
+template <size_t N>
+struct arg_category_of<char[N]>
+{
+    static constexpr arg_category value = arg_category::other; // strings are not pointers for printf
+};
+template <>
+struct arg_category_of<char const*>
+{
+    static constexpr arg_category value = arg_category::other;
+};
+template <>
+struct arg_category_of<char*>
+{
+    static constexpr arg_category value = arg_category::other;
+};
+
+/// NOTE: intentionally not constexpr (and not defined)
+///       calling it during constant evaluation turns invalid format strings into compile errors
+void format_string_error(char const* reason);
+
+/// returned by parse_format_string for strings with a stray '%', they are formatted at runtime
+constexpr size_t parsed_at_runtime = ~size_t(0);
+
+/// parses the format string and calls on_segment for every segment
+/// returns the number of segments (or parsed_at_runtime)
+template <class OnSegment>
+constexpr size_t parse_format_string(char const* s, arg_category const* args, size_t arg_count, OnSegment&& on_segment)
+{
+    size_t segment_count = 0;
+    size_t next_auto_arg = 0;
+    uint64_t used_args = 0;
+    auto has_named_args = false;
+
+    auto const emit = [&](format_segment::kind_t kind, size_t offset, size_t size, size_t arg, bool has_options)
+    {
+        format_segment seg;
+        seg.kind = kind;
+        seg.has_options = has_options;
+        seg.arg = uint16_t(arg);
+        seg.offset = uint32_t(offset);
+        seg.size = uint32_t(size);
+        on_segment(seg);
+        ++segment_count;
+    };
+
+    auto const use_auto_arg = [&]() -> size_t
+    {
+        if (next_auto_arg >= arg_count)
+            format_string_error("format string has more placeholders than arguments");
+        used_args |= uint64_t(1) << (next_auto_arg % 64);
+        return next_auto_arg++;
+    };
+
+    auto const is_digit = [](char c) { return '0' <= c && c <= '9'; };
+
+    size_t i = 0;
+    size_t literal_start = 0;
+    auto const flush_literal = [&]
+    {
+        if (i > literal_start)
+            emit(format_segment::literal, literal_start, i - literal_start, 0, false);
+    };
+
+    while (s[i] != '\0')
+    {
+        auto const c = s[i];
+
+        // escapes: "%%", "{{", "}}" become a single char
+        if ((c == '%' || c == '{' || c == '}') && s[i + 1] == c)
+        {
+            flush_literal();
+            emit(format_segment::literal, i, 1, 0, false);
+            i += 2;
+            literal_start = i;
+            continue;
+        }
+
+        if (c == '%')
+        {
+            flush_literal();
+            auto const start = i++;
+
+            // %[flags][width][.precision][length]conversion
+            while (s[i] == '-' || s[i] == '+' || s[i] == ' ' || s[i] == '#' || s[i] == '0')
+                ++i;
+            while (is_digit(s[i]))
+                ++i;
+            if (s[i] == '.')
+            {
+                ++i;
+                while (is_digit(s[i]))
+                    ++i;
+            }
+            while (s[i] == 'h' || s[i] == 'l' || s[i] == 'L' || s[i] == 'z' || s[i] == 'j' || s[i] == 't')
+                ++i;
+
+            auto const conversion = s[i];
+            auto required = arg_category::other; // 'other' means anything goes
+            switch (conversion)
+            {
+            case 'd':
+            case 'i':
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+            case 'c':
+                required = arg_category::integral;
+                break;
+            case 'e':
+            case 'E':
+            case 'f':
+            case 'F':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                required = arg_category::floating_point;
+                break;
+            case 'p':
+                required = arg_category::pointer;
+                break;
+            case 's':
+                break;
+            default:
+                return parsed_at_runtime; // stray '%'
+            }
+            ++i;
+
+            // e.g. "100% done" without arguments
+            if (next_auto_arg >= arg_count)
+                return parsed_at_runtime;
+
+            auto const arg = use_auto_arg();
+            auto const actual = args[arg];
+            if (required == arg_category::integral && actual != arg_category::integral)
+                format_string_error("printf conversion requires an integral argument (use %s or {} instead)");
+            if (required == arg_category::floating_point && actual != arg_category::floating_point && actual != arg_category::integral)
+                format_string_error("printf conversion requires an arithmetic argument (use %s or {} instead)");
+            if (required == arg_category::pointer && actual != arg_category::pointer)
+                format_string_error("%p requires a pointer argument");
+
+            emit(format_segment::auto_arg, start, i - start, arg, true);
+            literal_start = i;
+            continue;
+        }
+
+        if (c == '{')
+        {
+            flush_literal();
+            auto const start = i++;
+
+            // {[index|name][:options]}
+            auto const id_start = i;
+            while (s[i] != '\0' && s[i] != '}' && s[i] != ':')
+                ++i;
+            auto const id_size = i - id_start;
+            auto const has_options = s[i] == ':';
+            while (s[i] != '\0' && s[i] != '}')
+                ++i;
+            if (s[i] != '}')
+                format_string_error("unterminated '{' placeholder (use {{ for a literal {)");
+            ++i;
+
+            if (id_size == 0)
+            {
+                emit(format_segment::auto_arg, start, i - start, use_auto_arg(), has_options);
+            }
+            else if (is_digit(s[id_start]))
+            {
+                size_t index = 0;
+                for (auto k = id_start; k < id_start + id_size; ++k)
+                {
+                    if (!is_digit(s[k]))
+                        format_string_error("invalid argument index in '{' placeholder");
+                    index = index * 10 + size_t(s[k] - '0');
+                }
+                if (index >= arg_count)
+                    format_string_error("argument index out of range");
+                used_args |= uint64_t(1) << (index % 64);
+                emit(format_segment::explicit_arg, start, i - start, index, true);
+            }
+            else
+            {
+                has_named_args = true;
+                emit(format_segment::explicit_arg, start, i - start, 0, true);
+            }
+
+            literal_start = i;
+            continue;
+        }
+
+        if (c == '}')
+            format_string_error("unmatched '}' (use }} for a literal })");
+
+        ++i;
+    }
+    flush_literal();
+
+    // named arguments can be referenced in any order, so only count positional ones
+    if (!has_named_args && arg_count <= 64 && used_args != (arg_count == 64 ? ~uint64_t(0) : (uint64_t(1) << arg_count) - 1))
+        format_string_error("format string has fewer placeholders than arguments");
+
+    return segment_count;
+}
+
+template <size_t N>
+struct compiled_segments
+{
+    format_segment segments[N > 0 ? N : 1];
+};
+
+template <size_t N>
+constexpr compiled_segments<N> compile_format_string(char const* s, arg_category const* args, size_t arg_count)
+{
+    compiled_segments<N> result = {};
+    size_t i = 0;
+    parse_format_string(s, args, arg_count, [&](format_segment const& seg) { result.segments[i++] = seg; });
+    return result;
+}
+
+/// static storage of the compiled format of a single LOG site
+/// FmtSource is the (unique) type of the lambda returning the format string literal
+/// returns nullptr if the format string is left to the runtime formatter (see parsed_at_runtime)
+template <class FmtSource, class... Args>
+compiled_format const* get_compiled_format(FmtSource src)
+{
+    static constexpr arg_category args[] = {arg_category_of<Args>::value..., arg_category::other};
+    static constexpr size_t count = parse_format_string(src(), args, sizeof...(Args), [](format_segment const&) {});
+    if constexpr (count == parsed_at_runtime)
+        return nullptr;
+    else
+    {
+        static constexpr compiled_segments<count> segments = compile_format_string<count>(src(), args, sizeof...(Args));
+        static constexpr compiled_format compiled = {segments.segments, count};
+        return &compiled;
+    }
+}
+
+/// formats using the compiled segments if available
+inline void vformat_compiled(cc::stream_ref<char> s, format_string fmt, cc::span<formatter::arg_info> args)
+{
+    if (fmt.compiled == nullptr)
+    {
+        formatter::vformat_to(s, fmt.str, args);
+        return;
+    }
+
+    for (size_t i = 0; i < fmt.compiled->segment_count; ++i)
+    {
+        auto const& seg = fmt.compiled->segments[i];
+        auto const text = cc::string_view(fmt.str + seg.offset, seg.size);
+
+        switch (seg.kind)
+        {
+        case format_segment::literal:
+            s << text;
+            break;
+        case format_segment::auto_arg:
+        {
+            auto& arg = args[seg.arg];
+            if (seg.has_options)
+                formatter::vformat_to(s, text, cc::span<formatter::arg_info>(&arg, 1));
+            else
+                arg.do_format(s, arg.data, {});
+            break;
+        }
+        case format_segment::explicit_arg:
+            formatter::vformat_to(s, text, args);
+            break;
+        }
+    }
+}
+}
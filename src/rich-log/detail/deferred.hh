@@ -0,0 +1,355 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+
+#include <clean-core/string.hh>
+#include <clean-core/string_view.hh>
+
+#include <rich-log/detail/compiled_format.hh>
+#include <rich-log/detail/format.hh>
+
+/**
+ * deferred formatting
+ *
+ * LOG arguments are captured by reference (rlog::detail::capture) and only formatted if some logger needs the text
+ * if the message goes to the async backend, trivially copyable arguments are serialized into a compact binary record
+ * and formatted later on the background thread
+ *
+ * deferrable argument types:
+ *   - bool, char, integers, floating point numbers, enums
+ *   - strings (char const*, char arrays, cc::string_view, cc::string), their characters are copied inline
+ *
+ * everything else (and format strings that are not string literals) is formatted on the calling thread,
+ * but still only if needed and into a reusable per-thread buffer (see do_log_impl in logger.cc)
+ *
+ * format string literals of the LOG macros are parsed at compile time (see detail/compiled_format.hh)
+ *
+ * serialized layout:
+ *   [uint8 arg count]
+ *   per argument: [uint8 arg_tag] followed by either 8 byte (scalars) or [uint32 size][chars] (strings)
+ *
+ * the tags make the record self-describing, so binary sinks and offline tools can decode it without the C++ types
+ */
+
+namespace rlog::detail
+{
+enum class arg_tag : uint8_t
+{
+    signed_int,
+    unsigned_int,
+    floating_point,
+    boolean,
+    character,
+    string,
+};
+
+/// describes how a single argument type is captured
+/// storage_t is the type that is reconstructed and passed to the formatter on the consumer side
+template <class T, class = void>
+struct deferred_arg_traits
+{
+    static constexpr bool is_deferrable = false;
+};
+
+template <class T>
+struct deferred_arg_traits<T, std::enable_if_t<std::is_arithmetic_v<T> || std::is_enum_v<T>>>
+{
+    static constexpr bool is_deferrable = true;
+    using storage_t = T;
+
+    static constexpr arg_tag tag()
+    {
+        if constexpr (std::is_same_v<T, bool>)
+            return arg_tag::boolean;
+        else if constexpr (std::is_same_v<T, char>)
+            return arg_tag::character;
+        else if constexpr (std::is_floating_point_v<T>)
+            return arg_tag::floating_point;
+        else if constexpr (std::is_enum_v<T>)
+            return std::is_signed_v<std::underlying_type_t<T>> ? arg_tag::signed_int : arg_tag::unsigned_int;
+        else
+            return std::is_signed_v<T> ? arg_tag::signed_int : arg_tag::unsigned_int;
+    }
+
+    static constexpr size_t serialized_size(T const&) { return 1 + 8; }
+
+    static std::byte* serialize(std::byte* dst, T const& v)
+    {
+        *dst++ = std::byte(tag());
+
+        // all scalars are widened to 8 byte so the layout does not depend on the C++ type
+        if constexpr (std::is_floating_point_v<T>)
+        {
+            auto const d = double(v);
+            std::memcpy(dst, &d, 8);
+        }
+        else if constexpr (tag() == arg_tag::signed_int)
+        {
+            auto const i = int64_t(v);
+            std::memcpy(dst, &i, 8);
+        }
+        else
+        {
+            auto const u = uint64_t(v);
+            std::memcpy(dst, &u, 8);
+        }
+        return dst + 8;
+    }
+
+    static std::byte const* deserialize(std::byte const* src, storage_t& v)
+    {
+        ++src; // tag
+
+        if constexpr (std::is_floating_point_v<T>)
+        {
+            double d;
+            std::memcpy(&d, src, 8);
+            v = T(d);
+        }
+        else if constexpr (tag() == arg_tag::signed_int)
+        {
+            int64_t i;
+            std::memcpy(&i, src, 8);
+            v = T(i);
+        }
+        else
+        {
+            uint64_t u;
+            std::memcpy(&u, src, 8);
+            v = T(u);
+        }
+        return src + 8;
+    }
+};
+
+struct deferred_string_traits
+{
+    static constexpr bool is_deferrable = true;
+    using storage_t = cc::string_view;
+
+    static constexpr arg_tag tag() { return arg_tag::string; }
+
+    static cc::string_view as_view(char const* s) { return s ? cc::string_view(s) : cc::string_view("(null)"); }
+    static cc::string_view as_view(cc::string_view s) { return s; }
+
+    template <class T>
+    static size_t serialized_size(T const& v)
+    {
+        return 1 + 4 + as_view(v).size();
+    }
+
+    template <class T>
+    static std::byte* serialize(std::byte* dst, T const& v)
+    {
+        auto const s = as_view(v);
+        auto const size = uint32_t(s.size());
+        *dst++ = std::byte(arg_tag::string);
+        std::memcpy(dst, &size, 4);
+        std::memcpy(dst + 4, s.data(), size);
+        return dst + 4 + size;
+    }
+
+    static std::byte const* deserialize(std::byte const* src, cc::string_view& v)
+    {
+        ++src; // tag
+
+        uint32_t size;
+        std::memcpy(&size, src, 4);
+        v = cc::string_view(reinterpret_cast<char const*>(src + 4), size);
+        return src + 4 + size;
+    }
+};
+
+template <>
+struct deferred_arg_traits<char const*> : deferred_string_traits
+{
+};
+template <>
+struct deferred_arg_traits<char*> : deferred_string_traits
+{
+};
+template <size_t N>
+struct deferred_arg_traits<char[N]> : deferred_string_traits
+{
+};
+template <>
+struct deferred_arg_traits<cc::string_view> : deferred_string_traits
+{
+};
+template <>
+struct deferred_arg_traits<cc::string> : deferred_string_traits
+{
+};
+
+/// type-erased operations on captured arguments, one static instance per argument type list
+struct deferred_vtable
+{
+    /// formats the captured (referenced) arguments directly
+    void (*format_captured)(cc::stream_ref<char> s, format_string fmt_str, void const* args);
+
+    /// number of bytes written by serialize
+    /// NOTE: serialized_size, serialize, and format_serialized are nullptr if the message cannot be serialized
+    size_t (*serialized_size)(void const* args);
+
+    /// writes the binary representation of the arguments to dst
+    void (*serialize)(std::byte* dst, void const* args);
+
+    /// formats arguments that were previously serialized (possibly on a different thread)
+    void (*format_serialized)(cc::stream_ref<char> s, format_string fmt_str, std::byte const* data);
+};
+
+/// type-erased reference to captured LOG arguments
+/// NOTE: only valid during the LOG call
+struct deferred_message
+{
+    format_string fmt_str; // a string literal (static lifetime) if the message is serializable
+    void const* args;
+    deferred_vtable const* vtable;
+
+    bool is_serializable() const { return vtable->serialize != nullptr; }
+
+    void format_to(cc::stream_ref<char> s) const { vtable->format_captured(s, fmt_str, args); }
+
+    cc::string format() const
+    {
+        cc::string s;
+        format_to([&](cc::span<char const> chars) { s += cc::string_view(chars.data(), chars.size()); });
+        return s;
+    }
+};
+
+template <class... Ts>
+void format_values(cc::stream_ref<char> s, format_string fmt_str, Ts const&... values)
+{
+    if constexpr (sizeof...(Ts) == 0)
+    {
+        vformat_compiled(s, fmt_str, {});
+    }
+    else
+    {
+        formatter::arg_info infos[] = {formatter::make_arg_info(values)...};
+        vformat_compiled(s, fmt_str, infos);
+    }
+}
+
+template <class... Args>
+struct deferred_ops
+{
+    using tuple_t = std::tuple<Args const&...>;
+
+    static void format_captured(cc::stream_ref<char> s, format_string fmt_str, void const* args)
+    {
+        std::apply([&](Args const&... a) { format_values(s, fmt_str, a...); }, *static_cast<tuple_t const*>(args));
+    }
+
+    static size_t serialized_size(void const* args)
+    {
+        return std::apply([](Args const&... a) { return size_t(1) + (size_t(0) + ... + deferred_arg_traits<Args>::serialized_size(a)); },
+                          *static_cast<tuple_t const*>(args));
+    }
+
+    static void serialize(std::byte* dst, void const* args)
+    {
+        *dst++ = std::byte(sizeof...(Args));
+        std::apply([&](Args const&... a) { ((dst = deferred_arg_traits<Args>::serialize(dst, a)), ...); }, *static_cast<tuple_t const*>(args));
+    }
+
+    static void format_serialized(cc::stream_ref<char> s, format_string fmt_str, std::byte const* data)
+    {
+        std::tuple<typename deferred_arg_traits<Args>::storage_t...> values;
+
+        ++data; // arg count
+        std::apply([&](auto&... v) { ((data = deferred_arg_traits<Args>::deserialize(data, v)), ...); }, values);
+
+        std::apply([&](auto const&... v) { format_values(s, fmt_str, v...); }, values);
+    }
+
+    static constexpr deferred_vtable make_vtable()
+    {
+        if constexpr ((deferred_arg_traits<Args>::is_deferrable && ...))
+            return {&format_captured, &serialized_size, &serialize, &format_serialized};
+        else
+            return {&format_captured, nullptr, nullptr, nullptr};
+    }
+
+    static constexpr deferred_vtable vtable = make_vtable();
+
+    /// for format strings without static lifetime
+    static constexpr deferred_vtable text_only_vtable = {&format_captured, nullptr, nullptr, nullptr};
+};
+
+/// LOG arguments captured by reference, produced by rlog::detail::capture
+/// formatting is deferred until do_log knows where the message goes
+/// CAUTION: references temporaries of the LOG expression, do not store
+template <class... Args>
+struct captured_message
+{
+    static constexpr bool is_deferrable = (deferred_arg_traits<Args>::is_deferrable && ...);
+
+    format_string fmt_str;
+    std::tuple<Args const&...> args;
+    bool is_literal_fmt = true; // otherwise only valid during the LOG call, i.e. never serialized
+
+    cc::string format() const { return as_deferred().format(); }
+
+    deferred_message as_deferred() const
+    {
+        return {fmt_str, &args, is_literal_fmt ? &deferred_ops<Args...>::vtable : &deferred_ops<Args...>::text_only_vtable};
+    }
+};
+
+/// captures a format string that is not a literal (used by capture_static)
+/// null-terminated strings are referenced like literals (but never serialized), anything else is formatted eagerly
+template <class Fmt, class... Args>
+auto capture_runtime(Fmt const& fmt_str, Args const&... args)
+{
+    if constexpr (std::is_convertible_v<Fmt const&, char const*>)
+        return captured_message<Args...>{{fmt_str}, {args...}, false};
+    else if constexpr (std::is_same_v<Fmt, cc::string>)
+        return captured_message<Args...>{{fmt_str.c_str()}, {args...}, false};
+    else
+        return rlog::detail::format(fmt_str, args...);
+}
+
+/// true for char const(&)[N], i.e. the type of a string literal
+/// (char buffers filled at runtime are not const)
+template <class T>
+constexpr bool is_const_char_array_ref = std::is_lvalue_reference_v<T> && std::is_array_v<std::remove_reference_t<T>>
+                                         && std::is_same_v<std::remove_extent_t<std::remove_reference_t<T>>, char const>;
+
+/// captures the arguments by reference if the format string is a string literal, otherwise formats eagerly
+/// CAUTION: every const char array is taken for a literal, i.e. it is referenced (and serialized) by address and must outlive the message
+///          the LOG macros tell literals apart more reliably (see capture_static)
+template <class Fmt, class... Args>
+auto capture(Fmt&& fmt_str, Args const&... args)
+{
+    if constexpr (is_const_char_array_ref<Fmt&&>)
+        return captured_message<Args...>{{fmt_str}, {args...}};
+    else
+        return rlog::detail::format(fmt_str, args...);
+}
+
+/// true if FmtSource (the lambda of DETAIL_RICH_LOG_CAPTURE) returns a string literal
+/// literals are const char arrays that the lambda does not need to capture
+/// (char buffers are either not const or captured by reference, which makes the lambda non-empty)
+/// constexpr char arrays with static storage count as literals as well
+template <class FmtSource>
+constexpr bool is_literal_source = std::is_empty_v<FmtSource> && is_const_char_array_ref<decltype(std::declval<FmtSource&>()())>;
+
+/// formatter for the LOG macros (via DETAIL_RICH_LOG_CAPTURE)
+/// same as capture, but string literals are parsed and validated at compile time
+/// and runtime format strings (including char buffers) are only formatted if needed (see capture_runtime)
+/// fmt_source is a lambda returning the format string (evaluated in constant expressions only)
+template <class FmtSource, class Fmt, class... Args>
+auto capture_static(FmtSource fmt_source, Fmt const& fmt_str, Args const&... args)
+{
+    if constexpr (is_literal_source<FmtSource>)
+        return captured_message<Args...>{{fmt_str, get_compiled_format<FmtSource, Args...>(fmt_source)}, {args...}};
+    else
+        return capture_runtime(fmt_str, args...);
+}
+}
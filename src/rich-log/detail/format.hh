@@ -86,6 +86,17 @@ struct formatter
 template <class... Args>
 cc::string format(char const* fmt_str, Args const&... args)
 {
-    return cc::format<formatter>(fmt_str, args...);
+    cc::string s;
+    auto const append = [&](cc::span<char const> chars) { s += cc::string_view(chars.data(), chars.size()); };
+    if constexpr (sizeof...(Args) == 0)
+    {
+        formatter::vformat_to(append, fmt_str, {});
+    }
+    else
+    {
+        formatter::arg_info infos[] = {formatter::make_arg_info(args)...};
+        formatter::vformat_to(append, fmt_str, infos);
+    }
+    return s;
 }
 }
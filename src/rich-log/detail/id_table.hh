@@ -0,0 +1,170 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include <clean-core/macros.hh>
+#include <clean-core/string_view.hh>
+
+#include <rich-log/logger.hh>
+#include <rich-log/message.hh>
+
+namespace rlog::detail
+{
+/// lock-free, insert-only map from keys (pointers or name hashes) to ids
+/// used by the binary log writers to send the strings of domains, locations, and threads only once
+/// also tracks in which file generation the definition record of an id was last written
+class id_table
+{
+public:
+    static constexpr uint32_t pending_id = 0xFFFFFFFE;
+
+    struct entry
+    {
+        std::atomic<uint64_t> key = {0}; // 0 is empty
+        std::atomic<uint32_t> stamp = {0};
+        std::atomic<uint32_t> id = {pending_id};
+        std::atomic<uint64_t> defined_generation = {0};
+    };
+
+    explicit id_table(size_t capacity) : _entries(new entry[capacity]), _mask(capacity - 1)
+    {
+        CC_ASSERT((capacity & _mask) == 0 && "capacity must be a power of two");
+    }
+
+    /// returns the entry for the key, new keys get the id returned by make_id
+    /// other threads looking up the same key wait until make_id returned
+    /// the same key with a different stamp is a different entry (e.g. an address that was reused, stamped with a generation)
+    /// returns nullptr if the table is full
+    template <class MakeId>
+    entry* find_or_insert(uint64_t key, MakeId&& make_id, uint32_t stamp = 0)
+    {
+        CC_ASSERT(key != 0);
+
+        auto h = key * 0x9E3779B97F4A7C15ull;
+        h ^= h >> 32;
+        for (size_t i = 0; i <= _mask; ++i)
+        {
+            auto& e = _entries[(h + i) & _mask];
+            auto k = e.key.load(std::memory_order_acquire);
+
+            if (k == 0)
+            {
+                if (e.key.compare_exchange_strong(k, key, std::memory_order_acq_rel))
+                {
+                    e.stamp.store(stamp, std::memory_order_relaxed);
+                    e.id.store(make_id(), std::memory_order_release);
+                    return &e;
+                }
+                // k now contains the key of the thread that won the slot
+            }
+
+            if (k == key)
+            {
+                // the inserting thread might not have published the id (and stamp) yet
+                while (e.id.load(std::memory_order_acquire) == pending_id)
+                    std::this_thread::yield();
+                if (e.stamp.load(std::memory_order_relaxed) == stamp)
+                    return &e;
+            }
+        }
+
+        return nullptr;
+    }
+
+private:
+    std::unique_ptr<entry[]> _entries;
+    size_t _mask;
+};
+
+/// FNV-1a, never 0 (keys of id_table)
+inline uint64_t hash_name(cc::string_view name)
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (auto c : name)
+    {
+        h ^= uint8_t(c);
+        h *= 0x100000001b3ull;
+    }
+    return h == 0 ? 1 : h;
+}
+
+/// key of the name of the thread of a message
+/// interned names are keyed by address, which skips hashing the name for every message
+inline uint64_t thread_key(message_ref const& msg)
+{
+    if (has_interned_thread_name(msg))
+        return uint64_t(uintptr_t(msg.thread_name.data()));
+    return hash_name(msg.thread_name);
+}
+
+/// lock-free map from thread ids (see rlog::get_current_thread_id) to the version of their current name
+/// used by the binary log writers, whose records store the thread id and a name version that has its own definition
+/// a new version is assigned whenever the name of an id changes (rename, or a new thread reusing the id)
+class thread_name_table
+{
+public:
+    thread_name_table() : _slots(new slot[max_thread_ids]) {}
+
+    /// the id that is written for msg's thread (invalid ids are written as no_thread_id)
+    static uint16_t thread_id_of(message_ref const& msg) { return msg.thread_id < max_thread_ids ? msg.thread_id : no_thread_id; }
+
+    /// returns the version of the name of msg's thread (binary_format::unnamed_thread_version if it has none)
+    /// a new version is passed to define(version) before any other writer can use it
+    template <class Define>
+    uint16_t get_version(message_ref const& msg, Define&& define)
+    {
+        if (msg.thread_name.empty())
+            return 0;
+
+        auto const key = key_of(msg);
+        auto& s = _slots[thread_id_of(msg)];
+        auto current = s.state.load(std::memory_order_acquire);
+        while ((current & key_mask) != key)
+        {
+            auto version = uint16_t((current >> 48) + 1);
+            if (version == 0)
+                version = 1;
+
+            define(version);
+
+            // racing writers with a different name retry with the next version, their definition is never used
+            if (s.state.compare_exchange_weak(current, key | uint64_t(version) << 48, std::memory_order_acq_rel))
+                return version;
+        }
+        return uint16_t(current >> 48);
+    }
+
+    /// true if the definition of the version was not written into the file generation yet
+    bool needs_definition(message_ref const& msg, uint16_t version, uint64_t generation) const
+    {
+        return version != 0 && _slots[thread_id_of(msg)].defined.load(std::memory_order_relaxed) != (generation << 16 | version);
+    }
+
+    void set_defined(message_ref const& msg, uint16_t version, uint64_t generation)
+    {
+        _slots[thread_id_of(msg)].defined.store(generation << 16 | version, std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr uint64_t key_mask = (uint64_t(1) << 48) - 1;
+
+    // addresses fit into 48 bit, hashes are truncated (never 0, which is "no name yet")
+    static uint64_t key_of(message_ref const& msg)
+    {
+        auto const key = thread_key(msg) & key_mask;
+        return key == 0 ? 1 : key;
+    }
+
+    struct slot
+    {
+        std::atomic<uint64_t> state = {0};   // key of the name (low 48 bit) and its version (high 16 bit)
+        std::atomic<uint64_t> defined = {0}; // generation and version of the last written definition
+    };
+
+    std::unique_ptr<slot[]> _slots;
+};
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <rich-log/detail/binary_format.hh>
+
+/**
+ * layout of the shared-memory segment of rlog::shm_logger (read by rlog::shm_reader and the rlog-tail tool)
+ *
+ * [segment_header][definitions area][ring]
+ *
+ * the definitions area is append-only and holds binary_format::definition_records (domains, locations, threads)
+ * each definition is written once (threads: once per name version), before the first message that uses its id
+ * so a reader that starts late still finds all of them
+ *
+ * the ring holds binary_format::message_records (and padding records) at 8 byte aligned positions
+ *   - write_pos and read_pos count bytes since the start, the offset in the ring is pos % ring_size
+ *   - producers reserve space with a CAS on write_pos (messages are dropped if the ring is full)
+ *     then store a prefix with kind_reserved, write the record, and publish it by storing the final prefix (release)
+ *   - the single consumer reads records in order, zeroes them (a zero prefix means "not written yet"), and advances read_pos
+ *   - a record that does not fit before the end of the ring is preceded by a padding record up to the end
+ *
+ * record prefixes are stored and loaded as a single 64 bit atomic
+ * all values are in native byte order, producer and consumer must run on the same machine
+ */
+
+namespace rlog::detail::shm_format
+{
+constexpr char magic[8] = {'R', 'L', 'O', 'G', 'S', 'H', 'M', '1'};
+constexpr uint32_t version = 2;
+
+/// ring records that are not part of binary_format::record_kind
+enum record_kind : uint8_t
+{
+    kind_reserved = 0x10, // a producer is still writing this record (prefix.size is valid)
+    kind_padding = 0x11,  // skip to the start of the ring
+};
+
+struct segment_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size; // offset of the definitions area
+    uint64_t definitions_size;
+    uint64_t ring_size; // power of two, the ring follows the definitions area
+    int64_t producer_pid;
+    int64_t created_wall_ns;
+
+    /// set by the producer when it is destroyed, nothing is written afterwards
+    std::atomic<uint32_t> is_closed;
+
+    /// bytes used in the definitions area
+    alignas(64) std::atomic<uint64_t> definitions_pos;
+
+    /// written by producers
+    alignas(64) std::atomic<uint64_t> write_pos;
+    std::atomic<uint64_t> dropped_messages;
+
+    /// written by the consumer
+    alignas(64) std::atomic<uint64_t> read_pos;
+};
+
+static_assert(sizeof(binary_format::record_prefix) == sizeof(uint64_t), "prefix is accessed as a single atomic");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared-memory atomics must be lock-free");
+
+inline std::atomic<uint64_t>& prefix_word(std::byte* record) { return *reinterpret_cast<std::atomic<uint64_t>*>(record); }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+
+#include <clean-core/string_view.hh>
+
+#include <rich-log/detail/deferred.hh>
+#include <rich-log/detail/format.hh>
+#include <rich-log/fields.hh>
+
+/**
+ * capturing of structured messages (LOGS macros)
+ *
+ * each rlog::kv argument becomes an rlog::field in a fixed-size array on the stack of the LOG call
+ * scalars and strings are stored typed, everything else is referenced and formatted on demand
+ * message_ref::fields views this array, so no allocation is needed
+ */
+
+namespace rlog::detail
+{
+template <class T>
+field make_field(cc::format_arg<T> const& a)
+{
+    auto const info = formatter::make_arg_info(a);
+
+    field f;
+    f.key = a.name;
+    f.format_fn = info.do_format;
+    f.data = info.data;
+
+    // typed value, classified like deferred arguments (see deferred.hh)
+    if constexpr (deferred_arg_traits<T>::is_deferrable)
+    {
+        using traits = deferred_arg_traits<T>;
+        constexpr auto tag = traits::tag();
+
+        if constexpr (tag == arg_tag::signed_int)
+        {
+            f.type = field_type::signed_int;
+            f.i = int64_t(a.value);
+        }
+        else if constexpr (tag == arg_tag::unsigned_int)
+        {
+            f.type = field_type::unsigned_int;
+            f.u = uint64_t(a.value);
+        }
+        else if constexpr (tag == arg_tag::floating_point)
+        {
+            f.type = field_type::floating_point;
+            f.f = double(a.value);
+        }
+        else if constexpr (tag == arg_tag::boolean)
+        {
+            f.type = field_type::boolean;
+            f.b = a.value;
+        }
+        else if constexpr (tag == arg_tag::character)
+        {
+            f.type = field_type::string;
+            f.str = cc::string_view(&a.value, 1);
+        }
+        else
+        {
+            f.type = field_type::string;
+            f.str = traits::as_view(a.value);
+        }
+    }
+
+    return f;
+}
+
+/// a structured message captured by the LOGS macros
+/// CAUTION: references the LOG arguments, do not store
+template <size_t N>
+struct structured_message
+{
+    cc::string_view message;
+    field fields[N > 0 ? N : 1];
+};
+
+/// formatter of the LOGS macros
+/// the message is used as is (it is not a format string), all values must be passed as rlog::kv
+template <class... Args>
+structured_message<sizeof...(Args)> capture_fields(cc::string_view message, cc::format_arg<Args> const&... fields)
+{
+    return {message, {make_field(fields)...}};
+}
+}
@@ -1,4 +1,506 @@
 #include "domain.hh"
 
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include <clean-core/macros.hh>
+#include <clean-core/span.hh>
+#include <clean-core/string_view.hh>
+#include <clean-core/vector.hh>
+
+#include <rich-log/async.hh>
+#include <rich-log/auto_limit.hh>
+#include <rich-log/flight_recorder.hh>
+#include <rich-log/logger.hh>
+#include <rich-log/sink.hh>
+#include <rich-log/site_stats.hh>
+
 // default domain
 RICH_LOG_DEFINE_DOMAIN(Default, "default");
+
+namespace
+{
+// runtime verbosity of root domains without override
+constexpr auto default_min_verbosity = rlog::verbosity::Info;
+
+// open addressing hash index from domain name to domain (linear probing)
+struct domain_index
+{
+    cc::vector<rlog::domain_info*> slots; // power of two size, nullptr is empty
+    size_t count = 0;
+
+    static size_t hash(cc::string_view name)
+    {
+        // FNV-1a
+        uint64_t h = 14695981039346656037ull;
+        for (auto c : name)
+        {
+            h ^= uint8_t(c);
+            h *= 1099511628211ull;
+        }
+        return size_t(h);
+    }
+
+    rlog::domain_info* find(cc::string_view name) const
+    {
+        if (slots.empty())
+            return nullptr;
+
+        auto const mask = slots.size() - 1;
+        for (auto i = hash(name) & mask;; i = (i + 1) & mask)
+        {
+            auto const d = slots[i];
+            if (d == nullptr || cc::string_view(d->name) == name)
+                return d;
+        }
+    }
+
+    // NOTE: if a name is registered twice, find returns the first domain
+    void insert(rlog::domain_info* domain)
+    {
+        if ((count + 1) * 2 > slots.size())
+            rehash(slots.empty() ? 64 : slots.size() * 2);
+
+        place(domain);
+        ++count;
+    }
+
+private:
+    void place(rlog::domain_info* domain)
+    {
+        auto const mask = slots.size() - 1;
+        auto i = hash(domain->name) & mask;
+        while (slots[i] != nullptr)
+            i = (i + 1) & mask;
+        slots[i] = domain;
+    }
+
+    void rehash(size_t new_size)
+    {
+        auto old_slots = cc::move(slots);
+
+        slots = {};
+        slots.resize(new_size);
+        for (auto& s : slots)
+            s = nullptr;
+
+        for (auto d : old_slots)
+            if (d != nullptr)
+                place(d);
+    }
+};
+
+// immutable list of the registered domains, replaced as a whole on every (un)registration
+struct domain_list
+{
+    uint64_t version = 0;
+    cc::vector<rlog::domain_info*> domains; // in registration order
+    domain_index index;
+};
+
+// lock-free readers of the current list (domain_snapshot) use epoch-based reclamation:
+//   - readers announce themselves in the counter of the current epoch (by parity), then load the list
+//   - writers publish a new list, then advance the epoch, so readers of later epochs never see the previous list
+//   - the previous list can be freed once no reader of an earlier epoch is left
+// NOTE: constant-initialized, i.e. usable during static initialization
+std::atomic<domain_list const*> g_current_list = {nullptr};
+std::atomic<uint64_t> g_epoch = {0};
+std::atomic<int> g_readers[2] = {};
+
+struct domain_registry
+{
+    // serializes writers, guards everything below and the hierarchy links in domain_info
+    std::mutex mutex;
+
+    rlog::domain_info* first_root = nullptr; // linked via next_sibling
+    uint32_t next_registration_id = 1;
+    cc::vector<domain_list const*> retired; // replaced lists that might still be read
+
+    ~domain_registry()
+    {
+        // only statics that are destroyed later could still be reading
+        delete g_current_list.exchange(nullptr);
+        for (auto list : retired)
+            delete list;
+    }
+
+    // must hold mutex
+    domain_list const& current() const
+    {
+        static domain_list const empty_list;
+        auto const list = g_current_list.load();
+        return list ? *list : empty_list;
+    }
+
+    // must hold mutex
+    domain_list* make_list(cc::span<rlog::domain_info* const> domains) const
+    {
+        auto const list = new domain_list();
+        list->version = current().version + 1;
+        for (auto d : domains)
+        {
+            list->domains.push_back(d);
+            list->index.insert(d);
+        }
+        return list;
+    }
+
+    // replaces the current list
+    // if 'wait_for_readers' is set, returns only after no reader can see any previous list anymore
+    // otherwise, previous lists are freed by a later call
+    // must hold mutex
+    void publish(domain_list const* list, bool wait_for_readers)
+    {
+        retired.push_back(g_current_list.exchange(list));
+        auto const epoch = g_epoch.fetch_add(1);
+
+        if (wait_for_readers)
+        {
+            // new readers announce themselves in the other counter, so waiting for zero terminates even under constant reading
+            auto const wait_for = [](uint64_t e)
+            {
+                while (g_readers[e & 1].load() != 0)
+                    std::this_thread::yield();
+            };
+
+            // readers of this epoch (and earlier ones of the same parity)
+            wait_for(epoch);
+
+            // readers of the previous epoch share their counter with the current one, so flip once more
+            g_epoch.fetch_add(1);
+            wait_for(epoch + 1);
+        }
+        else if (g_readers[0].load() != 0 || g_readers[1].load() != 0)
+        {
+            return; // cheap check only, registration must not block
+        }
+
+        // a reader that announced itself afterwards sees a later epoch and thus the new list
+        for (auto r : retired)
+            delete r;
+        retired.clear();
+    }
+
+    // must hold mutex
+    rlog::domain_info*& first_child_of(rlog::domain_info* parent) { return parent ? parent->first_child : first_root; }
+
+    // closest registered domain whose name is a "::"-prefix of the given one
+    // must hold mutex
+    rlog::domain_info* find_parent(cc::string_view name) const
+    {
+        auto const& index = current().index;
+        for (auto i = name.size(); i >= 2; --i)
+        {
+            if (name[i - 2] != ':' || name[i - 1] != ':')
+                continue;
+
+            if (auto const d = index.find(name.subview(0, i - 2)))
+                return d;
+            --i; // skip the second ':'
+        }
+        return nullptr;
+    }
+
+    // must hold mutex
+    rlog::verbosity::type inherited_verbosity(rlog::domain_info const* domain) const
+    {
+        return domain->parent ? domain->parent->min_verbosity.load(std::memory_order_relaxed) : default_min_verbosity;
+    }
+
+    // must hold mutex
+    void add(rlog::domain_info* domain)
+    {
+        CC_ASSERT(domain->registration_id == 0 && "domain registered twice");
+        domain->registration_id = next_registration_id++;
+
+        auto const name = cc::string_view(domain->name);
+        auto const parent = find_parent(name);
+        domain->parent = parent;
+
+        // previously registered descendants were attached to our parent so far
+        auto const is_descendant = [&](rlog::domain_info const* d)
+        {
+            auto const n = cc::string_view(d->name);
+            return n.size() > name.size() + 2 && n.subview(0, name.size()) == name && n[name.size()] == ':' && n[name.size() + 1] == ':';
+        };
+        for (auto* link = &first_child_of(parent); *link != nullptr;)
+        {
+            auto const d = *link;
+            if (!is_descendant(d))
+            {
+                link = &d->next_sibling;
+                continue;
+            }
+
+            *link = d->next_sibling;
+            d->parent = domain;
+            d->next_sibling = domain->first_child;
+            domain->first_child = d;
+        }
+
+        domain->next_sibling = first_child_of(parent);
+        first_child_of(parent) = domain;
+
+        if (!domain->has_verbosity_override)
+            propagate(domain, inherited_verbosity(domain));
+
+        // nobody can see the new domain before, so readers of the old list do not matter
+        auto const list = make_list(current().domains);
+        list->domains.push_back(domain);
+        list->index.insert(domain);
+        publish(list, false);
+    }
+
+    // must hold mutex
+    void remove(rlog::domain_info* domain)
+    {
+        // the domain must not be visible to readers anymore before it goes away
+        cc::vector<rlog::domain_info*> remaining;
+        for (auto d : current().domains)
+            if (d != domain)
+                remaining.push_back(d);
+        publish(make_list(remaining), true);
+
+        // unlink from the parent
+        for (auto* link = &first_child_of(domain->parent); *link != nullptr; link = &(*link)->next_sibling)
+        {
+            if (*link == domain)
+            {
+                *link = domain->next_sibling;
+                break;
+            }
+        }
+
+        // children move up to our parent
+        while (auto const c = domain->first_child)
+        {
+            domain->first_child = c->next_sibling;
+            c->parent = domain->parent;
+            c->next_sibling = first_child_of(domain->parent);
+            first_child_of(domain->parent) = c;
+
+            if (!c->has_verbosity_override)
+                propagate(c, inherited_verbosity(c));
+        }
+
+        domain->parent = nullptr;
+        domain->next_sibling = nullptr;
+        domain->registration_id = 0;
+    }
+
+    // sets the verbosity of the domain and of all descendants that do not have their own override
+    // must hold mutex
+    static void propagate(rlog::domain_info* domain, rlog::verbosity::type v)
+    {
+        domain->min_verbosity.store(v, std::memory_order_relaxed);
+        for (auto c = domain->first_child; c != nullptr; c = c->next_sibling)
+            if (!c->has_verbosity_override)
+                propagate(c, v);
+    }
+
+    // must hold mutex
+    static void set_override(rlog::domain_info* domain, rlog::verbosity::type v)
+    {
+        domain->has_verbosity_override = true;
+        propagate(domain, v);
+    }
+
+    // calls f for all descendants (not the domain itself)
+    // must hold mutex
+    template <class F>
+    static void for_each_descendant(rlog::domain_info* domain, F&& f)
+    {
+        for (auto c = domain->first_child; c != nullptr; c = c->next_sibling)
+        {
+            f(c);
+            for_each_descendant(c, f);
+        }
+    }
+};
+
+domain_registry& registry()
+{
+    static domain_registry r;
+    return r;
+}
+
+bool has_wildcards(cc::string_view s)
+{
+    for (auto c : s)
+        if (c == '*' || c == '?')
+            return true;
+    return false;
+}
+}
+
+rlog::detail::domain_registerer::domain_registerer(domain_info* domain) : _domain(domain)
+{
+    {
+        auto& r = registry();
+        auto _ = std::lock_guard<std::mutex>(r.mutex);
+        r.add(domain);
+    }
+
+    rlog::detail::update_sink_mask(*domain);
+}
+
+rlog::detail::domain_registerer::~domain_registerer()
+{
+    {
+        auto& r = registry();
+        auto _ = std::lock_guard<std::mutex>(r.mutex);
+        r.remove(_domain);
+    }
+
+    // pending auto-limit summaries are logged first, they are buffered like any other message
+    rlog::detail::remove_auto_limit_sites(*_domain);
+
+    // buffered messages point to the domain, their locations, and their formatters, which all go away with a shared library
+    // (outside of the lock, the global logger and sinks might use the registry)
+    rlog::async::flush();
+    rlog::detail::discard_flight_records(*_domain);
+    rlog::detail::remove_site_stats(*_domain);
+}
+
+rlog::domain_snapshot::domain_snapshot()
+{
+    // announce as reader of the current epoch
+    // if the epoch changed in between, a writer might already have checked the counter
+    while (true)
+    {
+        auto const epoch = g_epoch.load();
+        g_readers[epoch & 1].fetch_add(1);
+        if (g_epoch.load() == epoch)
+        {
+            _epoch = epoch;
+            break;
+        }
+        g_readers[epoch & 1].fetch_sub(1);
+    }
+
+    _list = g_current_list.load();
+}
+
+rlog::domain_snapshot::~domain_snapshot() { g_readers[_epoch & 1].fetch_sub(1); }
+
+uint64_t rlog::domain_snapshot::version() const { return _list ? static_cast<domain_list const*>(_list)->version : 0; }
+
+cc::span<rlog::domain_info* const> rlog::domain_snapshot::domains() const
+{
+    if (!_list)
+        return {};
+
+    auto const& domains = static_cast<domain_list const*>(_list)->domains;
+    return {domains.data(), domains.size()};
+}
+
+rlog::domain_info* rlog::domain_snapshot::find(cc::string_view name) const
+{
+    return _list ? static_cast<domain_list const*>(_list)->index.find(name) : nullptr;
+}
+
+rlog::domain_snapshot rlog::get_domains() { return {}; }
+
+rlog::domain_info* rlog::find_domain(cc::string_view name) { return get_domains().find(name); }
+
+void rlog::set_min_verbosity(domain_info& domain, verbosity::type v)
+{
+    CC_ASSERT(0 <= v && v < verbosity::_count);
+
+    auto& r = registry();
+    auto _ = std::lock_guard<std::mutex>(r.mutex);
+    r.set_override(&domain, v);
+}
+
+void rlog::reset_min_verbosity(domain_info& domain)
+{
+    auto& r = registry();
+    auto _ = std::lock_guard<std::mutex>(r.mutex);
+
+    domain.has_verbosity_override = false;
+    r.propagate(&domain, r.inherited_verbosity(&domain));
+}
+
+int rlog::set_min_verbosity(char const* domain_pattern, verbosity::type v)
+{
+    CC_ASSERT(domain_pattern != nullptr);
+    CC_ASSERT(0 <= v && v < verbosity::_count);
+
+    auto& r = registry();
+    auto _ = std::lock_guard<std::mutex>(r.mutex);
+
+    auto const pattern = cc::string_view(domain_pattern);
+    auto const& list = r.current();
+
+    // exact name: hash lookup
+    if (!has_wildcards(pattern))
+    {
+        auto const d = list.index.find(pattern);
+        if (d != nullptr)
+            r.set_override(d, v);
+        return d != nullptr ? 1 : 0;
+    }
+
+    // "Name::*" of a registered domain: all of its descendants
+    if (pattern.size() > 3 && pattern.subview(pattern.size() - 3) == "::*" && !has_wildcards(pattern.subview(0, pattern.size() - 3)))
+    {
+        if (auto const d = list.index.find(pattern.subview(0, pattern.size() - 3)))
+        {
+            auto count = 0;
+            r.for_each_descendant(d,
+                                  [&](domain_info* c)
+                                  {
+                                      c->has_verbosity_override = true;
+                                      c->min_verbosity.store(v, std::memory_order_relaxed);
+                                      ++count;
+                                  });
+            return count;
+        }
+    }
+
+    // general pattern: scan all domains
+    auto count = 0;
+    for (auto d : list.domains)
+    {
+        if (!matches_domain_pattern(d->name, domain_pattern))
+            continue;
+
+        r.set_override(d, v);
+        ++count;
+    }
+    return count;
+}
+
+bool rlog::matches_domain_pattern(char const* domain_name, char const* pattern)
+{
+    // greedy glob matching, backtracks to the last '*' on mismatch
+    char const* last_star = nullptr;
+    char const* star_match_end = nullptr;
+    while (*domain_name != '\0')
+    {
+        if (*pattern == '*')
+        {
+            last_star = pattern++;
+            star_match_end = domain_name;
+        }
+        else if (*pattern == '?' || *pattern == *domain_name)
+        {
+            ++pattern;
+            ++domain_name;
+        }
+        else if (last_star)
+        {
+            pattern = last_star + 1;
+            domain_name = ++star_match_end;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    while (*pattern == '*')
+        ++pattern;
+    return *pattern == '\0';
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+
 #include <clean-core/macros.hh>
 
 #include <rich-log/detail/api.hh>
@@ -49,16 +52,35 @@ enum type : int
 
 struct domain_info
 {
-    rlog::verbosity::type min_verbosity = rlog::verbosity::Info; // always first
+    /// runtime minimum verbosity, read with a single relaxed load per LOG
+    /// can be changed at any time from any thread
+    /// NOTE: rlog::set_min_verbosity also applies the level to all descendants (that have no level of their own)
+    std::atomic<rlog::verbosity::type> min_verbosity = rlog::verbosity::Info; // always first
     char const* name = "";
     char const* ansi_color_code = "\u001b[38;5;244m";
 
-    static constexpr domain_info make_named(char const* name)
-    {
-        domain_info di;
-        di.name = name;
-        return di;
-    }
+    /// domain hierarchy, built at registration from the "::"-separated names
+    /// the parent is the closest registered domain whose name is a prefix, e.g. "A::B" for "A::B::C" (or "A" if there is no "A::B")
+    /// children form a singly linked list (first_child, then next_sibling)
+    /// NOTE: maintained by the domain registry, do not modify
+    ///       only stable while no domains are registered or unregistered
+    domain_info* parent = nullptr;
+    domain_info* first_child = nullptr;
+    domain_info* next_sibling = nullptr;
+
+    /// true if min_verbosity was set via rlog::set_min_verbosity (otherwise it is inherited from the parent)
+    bool has_verbosity_override = false;
+
+    /// unique per registration (starting at 1, never reused), 0 if the domain is not registered
+    uint32_t registration_id = 0;
+
+    /// per verbosity: bit i is set if sink slot i is interested in this domain (bit 0 is the global logger)
+    /// maintained by the sink registry (see sink.hh), messages without any interested sink are skipped before formatting
+    std::atomic<uint64_t> sink_mask[verbosity::_count] = {1, 1, 1, 1, 1, 1};
+    static_assert(verbosity::_count == 6, "sink_mask initializer out of date");
+
+    // NOTE: returned as prvalue (domain_info is not copyable)
+    static constexpr domain_info make_named(char const* name) { return {rlog::verbosity::Info, name}; }
 };
 }
 
@@ -86,12 +108,16 @@ struct domain_info
 ///
 ///   TODO: how can the struct be custom initialized?
 ///
-///   Domain settings can be changed anytime, e.g.:
+///   Domain settings can be changed anytime (also from a different thread while logging), e.g.:
 ///
-///     MyEngine::Log::Default::domain.min_verbosity = rlog::verbosity::Debug;
-///     MyEngine::Log::Default::domain.break_on_log[rlog::verbosity::Warning] = true;
+///     // sets the level of MyEngine and all domains below it ("MyEngine::...") that have no level of their own
+///     rlog::set_min_verbosity(MyEngine::Log::Default::domain, rlog::verbosity::Debug);
+///
+///     // or by name
+///     rlog::set_min_verbosity("MyEngine::MeshImporter::*", rlog::verbosity::Debug);
 ///
-///     (this should be externally synchronized, otherwise it might create a race condition)
+///     // only this domain, without inheritance
+///     MyEngine::Log::Default::domain.min_verbosity = rlog::verbosity::Debug;
 ///
 #define RICH_LOG_DECLARE_DEFAULT_DOMAIN() RICH_LOG_DECLARE_DOMAIN_DETAIL(Default, Trace, extern)
 #define RICH_LOG_DECLARE_DOMAIN(Name) RICH_LOG_DECLARE_DOMAIN_DETAIL(Name, Trace, extern)
@@ -127,9 +153,20 @@ struct domain_info
 
 namespace rlog::detail
 {
+/// registers the domain for its lifetime
+/// domains of a shared library are unregistered automatically when it is unloaded (i.e. its statics are destroyed)
+/// unregistering flushes async logging and discards everything rich-log keeps about the domain (e.g. flight records)
+/// NOTE: this is keyed by domain, so LOGs of a shared library that is unloaded again should only use its own domains
 struct domain_registerer
 {
     domain_registerer(domain_info* domain);
+    ~domain_registerer();
+
+    domain_registerer(domain_registerer const&) = delete;
+    domain_registerer& operator=(domain_registerer const&) = delete;
+
+private:
+    domain_info* _domain;
 };
 }
 
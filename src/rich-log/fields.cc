@@ -0,0 +1,33 @@
+#include "fields.hh"
+
+#include <rich-log/detail/format.hh>
+
+void rlog::field::format_value(cc::stream_ref<char> s) const
+{
+    if (format_fn != nullptr)
+    {
+        format_fn(s, data, {});
+        return;
+    }
+
+    // the argument is gone, format the stored value like the original type would be
+    switch (type)
+    {
+    case field_type::signed_int:
+        detail::formatter::do_format(s, i, {});
+        break;
+    case field_type::unsigned_int:
+        detail::formatter::do_format(s, u, {});
+        break;
+    case field_type::floating_point:
+        detail::formatter::do_format(s, f, {});
+        break;
+    case field_type::boolean:
+        detail::formatter::do_format(s, b, {});
+        break;
+    case field_type::string:
+    case field_type::other:
+        s << str;
+        break;
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+#include <clean-core/format.hh>
+#include <clean-core/stream_ref.hh>
+#include <clean-core/string_view.hh>
+
+#include <rich-log/detail/api.hh>
+
+namespace rlog
+{
+enum class field_type : uint8_t
+{
+    signed_int,     // also enums with signed underlying type
+    unsigned_int,   // also enums with unsigned underlying type
+    floating_point, // float and double
+    boolean,
+    string, // strings and char
+    other,  // any other type, only available as text (see field::format_value)
+};
+
+/// a typed key/value pair of a structured message (see LOGS in log.hh)
+/// the value is available typed (for the scalar types and strings) and always as text
+/// CAUTION: references the LOG arguments, only valid as long as the message_ref it belongs to
+struct field
+{
+    cc::string_view key;
+    field_type type = field_type::other;
+
+    union
+    {
+        int64_t i = 0; // signed_int
+        uint64_t u;    // unsigned_int
+        double f;      // floating_point
+        bool b;        // boolean
+    };
+
+    /// string: the value
+    /// other: the formatted value if it was formatted ahead of time (e.g. by the async backend, see format_fn)
+    cc::string_view str;
+
+    /// formats the referenced argument exactly like a LOG would (see formatter::make_arg_info)
+    /// nullptr if the field does not reference an argument anymore (then the value is formatted by type)
+    void (*format_fn)(cc::stream_ref<char> s, void const* data, cc::string_view options) = nullptr;
+    void const* data = nullptr;
+
+    /// writes the value as text, the same way it would appear in a formatted LOG message
+    RLOG_API void format_value(cc::stream_ref<char> s) const;
+};
+
+/// a named argument for the structured LOGS macros, e.g. rlog::kv("latency_us", t)
+/// NOTE: the key must be a string with static lifetime (usually a literal), the value is referenced
+template <class T>
+cc::format_arg<T> kv(char const* key, T const& value)
+{
+    return cc::arg(key, value);
+}
+}
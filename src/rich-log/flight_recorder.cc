@@ -0,0 +1,475 @@
+#include "flight_recorder.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include <clean-core/string.hh>
+#include <clean-core/vector.hh>
+
+#include <rich-log/log.hh>
+#include <rich-log/log_line.hh>
+#include <rich-log/logger.hh>
+#include <rich-log/site_stats.hh>
+#include <rich-log/timestamp.hh>
+
+std::atomic<int> rlog::detail::g_flight_min_verbosity = {rlog::verbosity::_count};
+std::atomic<int> rlog::detail::g_flight_dump_verbosity = {rlog::verbosity::_count};
+
+namespace
+{
+enum record_kind : uint32_t
+{
+    record_padding = 0, // skip to the start of the buffer
+    record_text = 1,
+    record_deferred = 2, // payload is a deferred_payload followed by serialized arguments
+};
+
+// the layout is the same idea as the async buffers (see async.cc), but old records are overwritten instead of waited for
+struct record_header
+{
+    uint32_t size; // total size in bytes, including header, payload, and alignment
+    uint32_t kind;
+    rlog::timestamp timestamp;
+    rlog::location const* location;
+    rlog::domain_info const* domain;
+    int32_t verbosity;
+    uint32_t payload_size;
+};
+
+struct deferred_payload
+{
+    decltype(rlog::detail::deferred_vtable::format_serialized) format_serialized;
+    rlog::detail::format_string fmt_str;
+};
+
+constexpr size_t record_alignment = 8;
+constexpr size_t padding_size = 8; // padding records only have size and kind
+
+constexpr size_t align_record_size(size_t s) { return (s + record_alignment - 1) & ~(record_alignment - 1); }
+
+std::atomic<size_t> g_buffer_size = {64 * 1024};
+std::atomic<size_t> g_max_dumped_records = {64};
+std::atomic<bool> g_dump_all_threads = {false};
+
+// dumped records are logged through the regular pipeline, which must not dump again
+thread_local bool tls_is_dumping = false;
+
+// ring of the recent records of a single thread, written only by that thread
+// the lock is almost never contended: only dumps of other threads (dump_all_threads) and disable take it
+struct thread_ring
+{
+    explicit thread_ring(size_t capacity) : capacity(capacity), mask(capacity - 1) { data.resize(capacity); }
+
+    size_t const capacity;
+    size_t const mask;
+    cc::vector<std::byte> data;
+
+    // guarded by the lock
+    uint64_t head = 0;
+    uint64_t tail = 0;
+    uint16_t thread_id = rlog::no_thread_id;
+    char const* thread_name = ""; // interned (see rlog::get_current_thread_name)
+
+    std::atomic<bool> is_locked = {false};
+    std::atomic<bool> orphaned = {false}; // set when the owning thread exits
+
+    void lock()
+    {
+        while (is_locked.exchange(true, std::memory_order_acquire))
+            std::this_thread::yield();
+    }
+
+    void unlock() { is_locked.store(false, std::memory_order_release); }
+
+    size_t max_payload_size() const { return capacity / 4 - sizeof(record_header); }
+
+    // must hold the lock, returns space for a record of 'size' (aligned) bytes
+    // the oldest records are overwritten if necessary
+    std::byte* allocate(size_t size)
+    {
+        auto const contiguous = capacity - (head & mask);
+        auto const needed = contiguous < size ? contiguous + size : size;
+
+        while (head + needed - tail > capacity)
+        {
+            uint32_t old_size;
+            std::memcpy(&old_size, &data[tail & mask], sizeof(old_size));
+            tail += old_size;
+        }
+
+        if (contiguous < size)
+        {
+            uint32_t const padding[2] = {uint32_t(contiguous), record_padding};
+            std::memcpy(&data[head & mask], padding, padding_size);
+            head += contiguous;
+        }
+
+        auto const dst = &data[head & mask];
+        head += size;
+        return dst;
+    }
+
+    // must hold the lock, turns the records of the domain into padding (they are skipped like it)
+    void discard(rlog::domain_info const& domain)
+    {
+        for (auto pos = tail; pos < head;)
+        {
+            uint32_t prefix[2]; // size and kind
+            std::memcpy(prefix, &data[pos & mask], padding_size);
+            if (prefix[1] != record_padding)
+            {
+                record_header h;
+                std::memcpy(&h, &data[pos & mask], sizeof(h));
+                if (h.domain == &domain)
+                {
+                    prefix[1] = record_padding;
+                    std::memcpy(&data[pos & mask], prefix, padding_size);
+                }
+            }
+            pos += prefix[0];
+        }
+    }
+
+    // must hold the lock, appends all records (without padding) to 'out' and removes them
+    void take_all(cc::vector<std::byte>& out)
+    {
+        while (tail < head)
+        {
+            uint32_t prefix[2]; // size and kind
+            std::memcpy(prefix, &data[tail & mask], padding_size);
+            if (prefix[1] != record_padding)
+            {
+                auto const offset = out.size();
+                out.resize(offset + prefix[0]);
+                std::memcpy(out.data() + offset, &data[tail & mask], prefix[0]);
+            }
+            tail += prefix[0];
+        }
+    }
+};
+
+struct thread_ring_holder
+{
+    thread_ring* ring = nullptr;
+
+    // the ring is deleted by the next registered thread, dump_all_threads, or disable
+    // (until then, its records can still be dumped with dump_all_threads)
+    ~thread_ring_holder()
+    {
+        if (ring)
+            ring->orphaned.store(true, std::memory_order_release);
+        ring = nullptr;
+    }
+};
+
+thread_local thread_ring_holder tls_ring;
+
+// domains are unregistered during static destruction as well, possibly after the registry is gone
+std::atomic<bool> g_is_registry_alive = {false};
+
+struct ring_registry
+{
+    std::mutex mutex; // protects rings (not their content)
+    cc::vector<thread_ring*> rings;
+
+    ring_registry() { g_is_registry_alive.store(true); }
+
+    // the thread-locals of the main thread are destroyed before, so its ring is orphaned by now
+    ~ring_registry()
+    {
+        g_is_registry_alive.store(false);
+
+        auto _ = std::lock_guard<std::mutex>(mutex);
+        remove_orphaned_rings();
+    }
+
+    thread_ring* register_thread()
+    {
+        size_t size = 4096;
+        while (size < g_buffer_size.load(std::memory_order_relaxed))
+            size *= 2;
+
+        auto _ = std::lock_guard<std::mutex>(mutex);
+
+        // short-lived threads would otherwise accumulate rings until the next dump_all_threads or disable
+        remove_orphaned_rings();
+
+        auto const ring = new thread_ring(size);
+        rings.push_back(ring);
+        return ring;
+    }
+
+    // NOTE: mutex must be held, the records of orphaned rings are discarded
+    void remove_orphaned_rings()
+    {
+        for (size_t i = 0; i < rings.size();)
+        {
+            auto const r = rings[i];
+            if (r->orphaned.load(std::memory_order_acquire))
+            {
+                delete r;
+                rings[i] = rings.back();
+                rings.pop_back();
+            }
+            else
+                ++i;
+        }
+    }
+};
+
+// NOTE: rings of threads that are still alive at exit are not freed (their thread_ring_holder might still run)
+ring_registry& registry()
+{
+    static ring_registry r;
+    return r;
+}
+
+thread_ring& current_ring()
+{
+    if (!tls_ring.ring)
+        tls_ring.ring = registry().register_thread();
+    return *tls_ring.ring;
+}
+
+// writes a record with 'payload_size' bytes of payload, filled by 'write_payload'
+template <class WritePayload>
+void write_record(rlog::domain_info const& domain, //
+                  rlog::verbosity::type verbosity,
+                  rlog::location* loc,
+                  record_kind kind,
+                  size_t payload_size,
+                  WritePayload&& write_payload)
+{
+    if (rlog::detail::is_collecting_site_stats())
+        rlog::detail::count_filtered(domain, *loc);
+
+    record_header h;
+    h.size = uint32_t(align_record_size(sizeof(record_header) + payload_size));
+    h.kind = kind;
+    h.timestamp = rlog::get_current_timestamp();
+    h.location = loc;
+    h.domain = &domain;
+    h.verbosity = verbosity;
+    h.payload_size = uint32_t(payload_size);
+
+    auto& ring = current_ring();
+    ring.lock();
+
+    // the name is kept per thread, it usually does not change
+    ring.thread_id = rlog::get_current_thread_id();
+    ring.thread_name = rlog::get_current_thread_name();
+
+    auto const dst = ring.allocate(h.size);
+    std::memcpy(dst, &h, sizeof(h));
+    write_payload(dst + sizeof(h));
+
+    ring.unlock();
+}
+
+// a copied record together with its thread
+struct dump_entry
+{
+    size_t offset;
+    int64_t time;
+    uint16_t thread_id;
+    char const* thread_name;
+};
+
+void dump_records(rlog::domain_info const& domain, rlog::timestamp now, bool all_threads, bool& break_on_log)
+{
+    if (tls_is_dumping)
+        return;
+
+    cc::vector<std::byte> batch;
+    cc::vector<dump_entry> entries;
+
+    // take the records (under the locks), log them afterwards (without any lock)
+    auto const take = [&](thread_ring& ring)
+    {
+        ring.lock();
+        auto const start = batch.size();
+        ring.take_all(batch);
+        auto const thread_id = ring.thread_id;
+        auto const thread_name = ring.thread_name;
+        ring.unlock();
+
+        for (auto offset = start; offset < batch.size();)
+        {
+            record_header h;
+            std::memcpy(&h, batch.data() + offset, sizeof(h));
+            entries.push_back({offset, h.timestamp.monotonic_ns, thread_id, thread_name});
+            offset += h.size;
+        }
+    };
+
+    if (all_threads)
+    {
+        auto& r = registry();
+        auto _ = std::lock_guard<std::mutex>(r.mutex);
+        for (auto ring : r.rings)
+            take(*ring);
+        r.remove_orphaned_rings();
+    }
+    else if (tls_ring.ring)
+        take(*tls_ring.ring);
+
+    // only the most recent records that happened before 'now'
+    std::stable_sort(entries.begin(), entries.end(), [](dump_entry const& a, dump_entry const& b) { return a.time < b.time; });
+    while (!entries.empty() && entries.back().time > now.monotonic_ns)
+        entries.pop_back();
+
+    auto const max_records = g_max_dumped_records.load(std::memory_order_relaxed);
+    auto const first = entries.size() > max_records ? entries.size() - max_records : 0;
+    if (first == entries.size())
+        return;
+
+    tls_is_dumping = true;
+
+    static rlog::location header_location = {"rlog::flight", __FILE__, __LINE__};
+
+    char header[96];
+    auto const header_len = std::snprintf(header, sizeof(header), "flight recorder: %zu recent message(s) below the log level",
+                                          entries.size() - first);
+
+    rlog::message_ref msg;
+    msg.timestamp = rlog::get_current_timestamp();
+    msg.location = &header_location;
+    msg.domain = &domain;
+    msg.verbosity = rlog::verbosity::Info;
+    msg.thread_id = rlog::get_current_thread_id();
+    msg.thread_name = rlog::get_current_thread_name();
+    msg.message = cc::string_view(header, size_t(header_len));
+    rlog::detail::dispatch_message(msg, break_on_log);
+
+    cc::string formatted;
+    for (auto i = first; i < entries.size(); ++i)
+    {
+        auto const& e = entries[i];
+        record_header h;
+        std::memcpy(&h, batch.data() + e.offset, sizeof(h));
+        auto const payload = reinterpret_cast<char const*>(batch.data() + e.offset + sizeof(record_header));
+
+        msg.timestamp = h.timestamp;
+        msg.location = h.location;
+        msg.domain = h.domain;
+        msg.verbosity = rlog::verbosity::type(h.verbosity);
+        msg.thread_id = e.thread_id;
+        msg.thread_name = e.thread_name;
+
+        if (h.kind == record_deferred)
+        {
+            deferred_payload dp;
+            std::memcpy(&dp, payload, sizeof(dp));
+
+            formatted.clear();
+            dp.format_serialized([&](cc::span<char const> chars) { formatted += cc::string_view(chars.data(), chars.size()); }, dp.fmt_str,
+                                 reinterpret_cast<std::byte const*>(payload + sizeof(dp)));
+            msg.message = formatted;
+        }
+        else
+            msg.message = cc::string_view(payload, h.payload_size);
+
+        rlog::detail::dispatch_message(msg, break_on_log);
+    }
+
+    tls_is_dumping = false;
+}
+}
+
+void rlog::flight::enable(config const& cfg)
+{
+    g_buffer_size.store(cfg.buffer_size, std::memory_order_relaxed);
+    g_max_dumped_records.store(cfg.max_dumped_records, std::memory_order_relaxed);
+    g_dump_all_threads.store(cfg.dump_all_threads, std::memory_order_relaxed);
+
+    detail::g_flight_dump_verbosity.store(cfg.dump_verbosity, std::memory_order_relaxed);
+    detail::g_flight_min_verbosity.store(cfg.min_verbosity, std::memory_order_relaxed);
+}
+
+void rlog::flight::disable()
+{
+    detail::g_flight_min_verbosity.store(verbosity::_count, std::memory_order_relaxed);
+    detail::g_flight_dump_verbosity.store(verbosity::_count, std::memory_order_relaxed);
+
+    auto& r = registry();
+    auto _ = std::lock_guard<std::mutex>(r.mutex);
+    for (auto ring : r.rings)
+    {
+        ring->lock();
+        ring->tail = ring->head;
+        ring->unlock();
+    }
+    r.remove_orphaned_rings();
+}
+
+bool rlog::flight::is_enabled() { return detail::g_flight_min_verbosity.load(std::memory_order_relaxed) < verbosity::_count; }
+
+void rlog::flight::dump(bool all_threads)
+{
+    auto break_on_log = false;
+    dump_records(Log::Default::domain, get_current_timestamp(), all_threads, break_on_log);
+}
+
+void rlog::detail::record_flight_text(domain_info const& domain, verbosity::type verbosity, location* loc, cc::string_view message)
+{
+    auto const size = std::min(message.size(), current_ring().max_payload_size());
+    write_record(domain, verbosity, loc, record_text, size, [&](std::byte* dst) { std::memcpy(dst, message.data(), size); });
+}
+
+void rlog::detail::record_flight_deferred(domain_info const& domain, verbosity::type verbosity, location* loc, deferred_message const& message)
+{
+    if (message.is_serializable())
+    {
+        auto const size = sizeof(deferred_payload) + message.vtable->serialized_size(message.args);
+        if (size <= current_ring().max_payload_size())
+        {
+            write_record(domain, verbosity, loc, record_deferred, size,
+                         [&](std::byte* dst)
+                         {
+                             deferred_payload const dp = {message.vtable->format_serialized, message.fmt_str};
+                             std::memcpy(dst, &dp, sizeof(dp));
+                             message.vtable->serialize(dst + sizeof(dp), message.args);
+                         });
+            return;
+        }
+    }
+
+    // the referenced arguments are gone after the LOG, so they are formatted now
+    record_flight_text(domain, verbosity, loc, message.format());
+}
+
+void rlog::detail::record_flight_structured(domain_info const& domain, //
+                                            verbosity::type verbosity,
+                                            location* loc,
+                                            cc::string_view message,
+                                            cc::span<field const> fields)
+{
+    // recorded as text with the fields appended like in text loggers
+    cc::string text = message;
+    append_logfmt_fields(text, fields);
+    record_flight_text(domain, verbosity, loc, text);
+}
+
+void rlog::detail::discard_flight_records(domain_info const& domain)
+{
+    if (!g_is_registry_alive.load())
+        return;
+
+    auto& r = registry();
+    auto _ = std::lock_guard<std::mutex>(r.mutex);
+    for (auto ring : r.rings)
+    {
+        ring->lock();
+        ring->discard(domain);
+        ring->unlock();
+    }
+}
+
+void rlog::detail::dump_flight_records(message_ref const& trigger)
+{
+    auto break_on_log = false; // dumped messages cannot trigger a breakpoint, the trigger itself still can
+    dump_records(*trigger.domain, trigger.timestamp, g_dump_all_threads.load(std::memory_order_relaxed), break_on_log);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#include <clean-core/span.hh>
+#include <clean-core/string_view.hh>
+
+#include <rich-log/detail/api.hh>
+#include <rich-log/detail/deferred.hh>
+#include <rich-log/detail/structured.hh>
+#include <rich-log/domain.hh>
+#include <rich-log/location.hh>
+#include <rich-log/message.hh>
+
+/**
+ * flight recorder: keeps the recent LOGs that are below the runtime verbosity of their domain,
+ * and writes them when an error happens
+ *
+ * normally, a Debug LOG in a domain with min_verbosity Info is dropped before anything is formatted
+ * with the flight recorder, it is stored in a per-thread ring buffer instead (arguments in binary form, formatting is deferred)
+ * when an Error (or Fatal) is logged, the last recorded messages of that thread are logged right before it
+ *
+ * Usage:
+ *
+ *    rlog::flight::config cfg;
+ *    cfg.min_verbosity = rlog::verbosity::Trace; // record everything that is not logged anyway
+ *    cfg.max_dumped_records = 32;
+ *    rlog::flight::enable(cfg);
+ *
+ *    LOGD(Net, Debug, "connecting to %s", host); // recorded, not logged
+ *    LOGD(Net, Error, "connection failed");      // logs "connecting to ..." (with its original time), then the error
+ *
+ * each record is dumped at most once, older records are overwritten when the ring is full
+ * dumped records keep their timestamp, location, domain, verbosity, and thread name
+ *
+ * NOTE: while disabled (the default), the only cost is a relaxed load in LOGs that are below the runtime verbosity
+ *       when enabled, recording a LOG costs a timestamp, serializing its arguments, and an uncontended per-thread lock
+ * NOTE: arguments that cannot be serialized (see detail/deferred.hh) and structured fields are formatted when recorded
+ * NOTE: buffer_size only applies to threads that did not record anything yet
+ * NOTE: the records of an exited thread are kept until the next thread starts recording (or the next dump of all threads)
+ */
+
+namespace rlog::flight
+{
+struct config
+{
+    /// LOGs below the runtime verbosity of their domain are recorded if they are at least this severe
+    verbosity::type min_verbosity = verbosity::Trace;
+
+    /// logging a message of at least this severity dumps the recorded messages first
+    verbosity::type dump_verbosity = verbosity::Error;
+
+    /// size of the ring buffer of each thread in bytes (rounded up to a power of two)
+    size_t buffer_size = 64 * 1024;
+
+    /// at most this many of the most recent records are dumped
+    size_t max_dumped_records = 64;
+
+    /// if true, the records of all threads are dumped (merged by time), otherwise only the ones of the logging thread
+    bool dump_all_threads = false;
+};
+
+/// starts recording (and dumping on errors)
+RLOG_API void enable(config const& cfg = {});
+
+/// stops recording and discards all records
+RLOG_API void disable();
+
+/// returns true if the flight recorder is enabled
+RLOG_API bool is_enabled();
+
+/// logs the recorded messages now (like an error would, but without one)
+RLOG_API void dump(bool all_threads = false);
+}
+
+namespace rlog::detail
+{
+/// NOTE: read in the LOG macros and do_log, use rlog::flight::enable to change them (verbosity::_count if disabled)
+RLOG_API extern std::atomic<int> g_flight_min_verbosity;
+RLOG_API extern std::atomic<int> g_flight_dump_verbosity;
+
+inline bool is_flight_recording(verbosity::type v) { return v >= g_flight_min_verbosity.load(std::memory_order_relaxed); }
+inline bool is_flight_dump_trigger(verbosity::type v) { return v >= g_flight_dump_verbosity.load(std::memory_order_relaxed); }
+
+/// stores a LOG that is below the runtime verbosity in the ring of the calling thread
+RLOG_API void record_flight_text(domain_info const& domain, verbosity::type verbosity, location* loc, cc::string_view message);
+RLOG_API void record_flight_deferred(domain_info const& domain, verbosity::type verbosity, location* loc, deferred_message const& message);
+RLOG_API void record_flight_structured(domain_info const& domain, //
+                                       verbosity::type verbosity,
+                                       location* loc,
+                                       cc::string_view message,
+                                       cc::span<field const> fields);
+
+// same overloads as do_log
+inline void record_flight(domain_info const& domain, verbosity::type verbosity, location* loc, cc::string_view message)
+{
+    record_flight_text(domain, verbosity, loc, message);
+}
+
+template <class... Args>
+void record_flight(domain_info const& domain, verbosity::type verbosity, location* loc, captured_message<Args...> const& message)
+{
+    record_flight_deferred(domain, verbosity, loc, message.as_deferred());
+}
+
+template <size_t N>
+void record_flight(domain_info const& domain, verbosity::type verbosity, location* loc, structured_message<N> const& message)
+{
+    record_flight_structured(domain, verbosity, loc, message.message, cc::span<field const>(message.fields, N));
+}
+
+/// logs the recorded messages that precede 'trigger' (called by do_log for messages at or above dump_verbosity)
+RLOG_API void dump_flight_records(message_ref const& trigger);
+
+/// discards all records of the domain (called when it is unregistered, its records point into the unloaded module)
+RLOG_API void discard_flight_records(domain_info const& domain);
+}
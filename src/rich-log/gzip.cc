@@ -0,0 +1,358 @@
+#include "gzip.hh"
+
+#include <cstdio>
+#include <cstring>
+
+#include <clean-core/macros.hh>
+#include <clean-core/utility.hh>
+#include <clean-core/vector.hh>
+
+namespace
+{
+constexpr int64_t window_size = 32768; // maximum distance in deflate
+constexpr int64_t min_match = 3;
+constexpr int64_t max_match = 258;
+constexpr int hash_bits = 15;
+constexpr int max_chain_length = 32; // candidates checked per position, trades speed for ratio
+
+// input is collected in a buffer that keeps one window of history before the next position to encode
+constexpr int64_t buffer_size = 4 * window_size;
+
+// length symbols 257..285 and distance symbols 0..29 (RFC 1951, 3.2.5)
+constexpr uint16_t length_base[] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr uint8_t length_extra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr uint16_t distance_base[] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+                                      193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+constexpr uint8_t distance_extra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// index of the last entry in 'base' that is <= v
+template <class T, size_t N>
+int find_symbol(T const (&base)[N], int v)
+{
+    auto i = int(N) - 1;
+    while (base[i] > v)
+        --i;
+    return i;
+}
+
+uint32_t reverse_bits(uint32_t code, int count)
+{
+    uint32_t r = 0;
+    for (auto i = 0; i < count; ++i)
+    {
+        r = (r << 1) | (code & 1);
+        code >>= 1;
+    }
+    return r;
+}
+
+// deflate packs bits starting at the least significant bit, Huffman codes start with their most significant bit
+struct bit_writer
+{
+    uint64_t bits = 0;
+    int count = 0;
+
+    void put(cc::string& out, uint32_t value, int n)
+    {
+        bits |= uint64_t(value) << count;
+        count += n;
+        while (count >= 8)
+        {
+            out += char(bits & 0xFF);
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+    void put_code(cc::string& out, uint32_t code, int n) { put(out, reverse_bits(code, n), n); }
+
+    void align(cc::string& out)
+    {
+        if (count > 0)
+            put(out, 0, 8 - count);
+    }
+};
+
+// fixed literal/length code (RFC 1951, 3.2.6)
+void put_symbol(bit_writer& w, cc::string& out, int symbol)
+{
+    if (symbol < 144)
+        w.put_code(out, 0x30 + symbol, 8);
+    else if (symbol < 256)
+        w.put_code(out, 0x190 + (symbol - 144), 9);
+    else if (symbol < 280)
+        w.put_code(out, symbol - 256, 7);
+    else
+        w.put_code(out, 0xC0 + (symbol - 280), 8);
+}
+
+void put_match(bit_writer& w, cc::string& out, int length, int distance)
+{
+    auto const l = find_symbol(length_base, length);
+    put_symbol(w, out, 257 + l);
+    w.put(out, uint32_t(length - length_base[l]), length_extra[l]);
+
+    auto const d = find_symbol(distance_base, distance);
+    w.put_code(out, uint32_t(d), 5);
+    w.put(out, uint32_t(distance - distance_base[d]), distance_extra[d]);
+}
+
+void put_le32(cc::string& out, uint32_t v)
+{
+    for (auto i = 0; i < 4; ++i)
+        out += char((v >> (8 * i)) & 0xFF);
+}
+
+uint32_t const* get_crc_table()
+{
+    static auto const table = []
+    {
+        struct crc_table
+        {
+            uint32_t entries[256];
+        } t;
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            auto c = i;
+            for (auto k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t.entries[i] = c;
+        }
+        return t;
+    }();
+    return table.entries;
+}
+}
+
+struct rlog::gzip_encoder::state
+{
+    // input, buffer[0] is at stream position 'base'
+    cc::vector<uint8_t> buffer;
+    int64_t base = 0;
+    int64_t pos = 0; // next stream position to encode
+    int64_t end = 0; // stream position after the buffered input
+
+    // hash chains of stream positions (-1 terminated)
+    cc::vector<int64_t> head;
+    cc::vector<int64_t> prev; // indexed by position % window_size
+
+    bit_writer bits;
+    uint32_t crc = 0;
+    uint32_t input_size = 0; // modulo 2^32, as in the gzip trailer
+    bool has_header = false;
+    bool is_finished = false;
+
+    uint8_t const* at(int64_t p) const { return buffer.data() + (p - base); }
+
+    uint32_t hash(int64_t p) const
+    {
+        auto const s = at(p);
+        auto const v = uint32_t(s[0]) << 16 | uint32_t(s[1]) << 8 | uint32_t(s[2]);
+        return (v * 2654435761u) >> (32 - hash_bits);
+    }
+
+    void insert(int64_t p)
+    {
+        auto const h = hash(p);
+        prev[p % window_size] = head[h];
+        head[h] = p;
+    }
+
+    void write_header(cc::string& out)
+    {
+        // magic, deflate, no flags, no mtime, no extra flags, unknown OS
+        char const header[] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff'};
+        out += cc::string_view(header, sizeof(header));
+
+        // a single final block with fixed Huffman codes
+        bits.put(out, 1, 1); // BFINAL
+        bits.put(out, 1, 2); // BTYPE
+        has_header = true;
+    }
+
+    // encodes the buffered input up to 'limit' (matches can extend past it)
+    void encode(cc::string& out, int64_t limit)
+    {
+        while (pos < limit)
+        {
+            auto best_length = int64_t(0);
+            auto best_distance = int64_t(0);
+
+            if (end - pos >= min_match)
+            {
+                auto const max_length = cc::min(max_match, end - pos);
+                auto const s = at(pos);
+
+                auto candidate = head[hash(pos)];
+                for (auto chain = 0; chain < max_chain_length && candidate >= 0 && pos - candidate <= window_size; ++chain)
+                {
+                    auto const c = at(candidate);
+                    if (c[best_length] == s[best_length])
+                    {
+                        auto length = int64_t(0);
+                        while (length < max_length && c[length] == s[length])
+                            ++length;
+
+                        if (length > best_length)
+                        {
+                            best_length = length;
+                            best_distance = pos - candidate;
+                            if (length == max_length)
+                                break;
+                        }
+                    }
+
+                    // slots are reused after one window, so a newer position means the chain ended
+                    auto const next = prev[candidate % window_size];
+                    if (next >= candidate)
+                        break;
+                    candidate = next;
+                }
+
+                insert(pos);
+            }
+
+            if (best_length >= min_match)
+            {
+                put_match(bits, out, int(best_length), int(best_distance));
+                for (auto p = pos + 1; p < pos + best_length; ++p)
+                    if (end - p >= min_match)
+                        insert(p);
+                pos += best_length;
+            }
+            else
+            {
+                put_symbol(bits, out, *at(pos));
+                ++pos;
+            }
+        }
+    }
+
+    // drops input that is more than one window behind 'pos'
+    void slide()
+    {
+        auto const keep_from = cc::max(base, pos - window_size);
+        auto const shift = keep_from - base;
+        if (shift == 0)
+            return;
+
+        std::memmove(buffer.data(), buffer.data() + shift, size_t(end - keep_from));
+        base = keep_from;
+    }
+};
+
+rlog::gzip_encoder::gzip_encoder() : _state(cc::make_unique<state>())
+{
+    _state->buffer.resize(size_t(buffer_size));
+    _state->head.resize(size_t(1) << hash_bits, -1);
+    _state->prev.resize(size_t(window_size), -1);
+}
+
+rlog::gzip_encoder::~gzip_encoder() = default;
+
+void rlog::gzip_encoder::append(cc::span<char const> data, cc::string& out)
+{
+    auto& s = *_state;
+    CC_ASSERT(!s.is_finished && "gzip_encoder cannot be used after finish");
+
+    if (!s.has_header)
+        s.write_header(out);
+
+    s.crc = update_crc32(s.crc, data);
+    s.input_size += uint32_t(data.size());
+
+    while (!data.empty())
+    {
+        if (s.end - s.base == buffer_size)
+        {
+            // keep enough lookahead for the longest match
+            s.encode(out, s.end - max_match);
+            s.slide();
+        }
+
+        auto const n = cc::min(data.size(), size_t(buffer_size - (s.end - s.base)));
+        std::memcpy(s.buffer.data() + (s.end - s.base), data.data(), n);
+        s.end += int64_t(n);
+        data = data.subspan(n);
+    }
+}
+
+void rlog::gzip_encoder::finish(cc::string& out)
+{
+    auto& s = *_state;
+    CC_ASSERT(!s.is_finished && "gzip_encoder cannot be used after finish");
+
+    if (!s.has_header)
+        s.write_header(out);
+
+    s.encode(out, s.end);
+    put_symbol(s.bits, out, 256); // end of block
+    s.bits.align(out);
+
+    put_le32(out, s.crc);
+    put_le32(out, s.input_size);
+    s.is_finished = true;
+}
+
+bool rlog::gzip_file(char const* source_path, char const* target_path)
+{
+    auto const source = std::fopen(source_path, "rb");
+    if (source == nullptr)
+        return false;
+
+    auto const target = std::fopen(target_path, "wb");
+    if (target == nullptr)
+    {
+        std::fclose(source);
+        return false;
+    }
+
+    auto ok = true;
+    auto encoder = gzip_encoder();
+    cc::string out;
+    cc::vector<char> chunk;
+    chunk.resize(64 * 1024);
+
+    auto const write_out = [&]
+    {
+        if (!out.empty() && std::fwrite(out.data(), 1, out.size(), target) != out.size())
+            ok = false;
+        out.clear();
+    };
+
+    while (ok)
+    {
+        auto const n = std::fread(chunk.data(), 1, chunk.size(), source);
+        if (n == 0)
+        {
+            ok = std::ferror(source) == 0;
+            break;
+        }
+
+        encoder.append(cc::span<char const>(chunk.data(), n), out);
+        write_out();
+    }
+
+    if (ok)
+    {
+        encoder.finish(out);
+        write_out();
+    }
+
+    std::fclose(source);
+    ok &= std::fclose(target) == 0;
+
+    if (!ok)
+        std::remove(target_path);
+    return ok;
+}
+
+uint32_t rlog::update_crc32(uint32_t crc, cc::span<char const> data)
+{
+    auto const table = get_crc_table();
+    crc = ~crc;
+    for (auto c : data)
+        crc = table[(crc ^ uint8_t(c)) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
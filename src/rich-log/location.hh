@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <ctime>
 
@@ -7,6 +8,48 @@
 
 namespace rlog
 {
+struct domain_info;
+struct location;
+
+/// runtime statistics of a single LOG site, only collected while enabled (see site_stats.hh)
+/// allocated when the site counts something for the first time, on its own cache line
+struct alignas(64) location_stats
+{
+    std::atomic<uint64_t> emitted = {0};    // passed on to the loggers
+    std::atomic<uint64_t> suppressed = {0}; // by the rate limiter
+    std::atomic<uint64_t> filtered = {0};   // by the runtime verbosity, or because no logger or sink wanted the message
+    std::atomic<uint64_t> bytes = {0};      // formatted message text (on the logging thread)
+    std::atomic<uint64_t> ns = {0};         // total time spent in do_log (including formatting and synchronous loggers)
+
+    // the site is removed from the list when its domain is unregistered
+    domain_info const* domain = nullptr;
+
+    // intrusive lock-free list of all sites that ever counted something
+    std::atomic<location*> next = {nullptr};
+};
+
+/// per-site state of the automatic rate limit (see auto_limit.hh)
+/// allocated when the site is logged while the limit is enabled, on its own cache line
+struct alignas(64) location_limit_state
+{
+    std::atomic<int64_t> arrival_ns = {INT64_MIN}; // token bucket as GCRA (see rlog::rate::token_bucket)
+    std::atomic<uint64_t> dropped = {0};           // over budget since the last summary
+    std::atomic<uint64_t> last_hash = {0};         // of the last message that was not dropped, 0 if none
+    std::atomic<uint64_t> repeats = {0};           // identical messages since the last summary
+    std::atomic<int64_t> repeat_report_ns = {0};   // when ongoing repeats are reported next
+
+    // where summaries go when they are flushed without a new message
+    std::atomic<domain_info const*> domain = {nullptr};
+    std::atomic<int> verbosity = {0};
+
+    // intrusive lock-free list of all sites that were ever limited
+    std::atomic<location*> next = {nullptr};
+};
+
+/// the static state of a single LOG site
+/// the constant part and the flags are read by every LOG, but only written rarely
+/// the counters that concurrent LOGs of the same site write are allocated separately on first use, so they do not invalidate the rest
+/// (and sites that never use them stay small)
 struct location
 {
     // constant information about this location
@@ -15,8 +58,12 @@ struct location
     int const line;
 
     // runtime information for per-location features
-    std::time_t last_log = {};
-    bool break_on_log = false;
-    bool break_on_log_once = false;
+    std::atomic<std::time_t> last_log = {0}; // updated at most once per second
+    std::atomic<bool> break_on_log = {false};
+    std::atomic<bool> break_on_log_once = {false};
+
+    // nullptr until first used, never freed (the sites are statics)
+    std::atomic<location_stats*> stats = {nullptr};
+    std::atomic<location_limit_state*> limit = {nullptr};
 };
 }
@@ -1,11 +1,19 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+
 #include <rich-log/detail/api.hh>
+#include <rich-log/detail/deferred.hh>
 #include <rich-log/detail/format.hh>
+#include <rich-log/detail/structured.hh>
 #include <rich-log/domain.hh>
+#include <rich-log/flight_recorder.hh>
 #include <rich-log/fwd.hh>
 #include <rich-log/location.hh>
+#include <rich-log/message.hh>
 #include <rich-log/rate_limit.hh>
+#include <rich-log/site_stats.hh>
 
 /**
  *
@@ -14,7 +22,8 @@
  * Quickstart:
  *
  *    // default logging has info verbosity and goes to Default domain
- *    // logging message is created using rlog::detail::format
+ *    // logging message is created using rlog::detail::format (formatting is deferred until needed, see detail/deferred.hh)
+ *    // format string literals are parsed and checked against the arguments at compile time (see detail/compiled_format.hh)
  *    LOG("created %s vertices and {} faces", v_cnt, f_cnt);
  *
  *    // for quick debugging, use the following shortcut
@@ -36,39 +45,76 @@
  *    // per default, all verbosities are enabled
  *    // a custom minimum compile-time verbosity level for your domain can be specified via
  *    RICH_LOG_DECLARE_DOMAIN_EX(MyDomain, Warning, extern);
+ *
+ *    // structured logging keeps typed key/value fields (see message_ref::fields and structured_sink.hh)
+ *    // the message is not a format string, text loggers append the fields as "key=value"
+ *    LOGS(MyDomain, Info, "request done", rlog::kv("latency_us", t), rlog::kv("path", p));
  */
 
-#define RICH_LOG_IMPL(Domain, Severity, Limiter, Formatter, ...)                                                                            \
-    do                                                                                                                                      \
-    {                                                                                                                                       \
-        if constexpr (rlog::verbosity::Severity >= rlog::verbosity::type(Log::Domain::CompileTimeMinVerbosity))                             \
-        {                                                                                                                                   \
-            if (rlog::verbosity::Severity >= Log::Domain::domain.min_verbosity)                                                             \
-            {                                                                                                                               \
-                static rlog::location _rlog_location = DETAIL_RICH_LOG_MAKE_LOCATION;                                                       \
-                if (rlog::detail::do_log(Log::Domain::domain, rlog::verbosity::Severity, &_rlog_location, Limiter, Formatter(__VA_ARGS__))) \
-                    CC_DEBUG_BREAK();                                                                                                       \
-            }                                                                                                                               \
-        }                                                                                                                                   \
+// NOTE: the rate limiter is checked before the arguments are formatted (or even captured)
+//       so a suppressed LOG costs only the limiter check
+// NOTE: the location is constant-initialized (no guard), LOGs that are filtered or suppressed only count into it if site stats are enabled
+// NOTE: LOGs silenced on the calling thread (see scoped_logger_silence) are dropped before the rate limiter and formatting
+// NOTE: LOGs below the runtime verbosity are only captured (and not formatted) if the flight recorder wants them
+#define RICH_LOG_IMPL(Domain, Severity, Limiter, Formatter, ...)                                                                       \
+    do                                                                                                                                 \
+    {                                                                                                                                  \
+        if constexpr (rlog::verbosity::Severity >= rlog::verbosity::type(Log::Domain::CompileTimeMinVerbosity))                        \
+        {                                                                                                                              \
+            static rlog::location _rlog_location = DETAIL_RICH_LOG_MAKE_LOCATION;                                                      \
+            if (rlog::verbosity::Severity >= Log::Domain::domain.min_verbosity.load(std::memory_order_relaxed))                        \
+            {                                                                                                                          \
+                if (!rlog::detail::passes_thread_gate(rlog::verbosity::Severity))                                                      \
+                {                                                                                                                      \
+                    if (rlog::detail::is_collecting_site_stats())                                                                      \
+                        rlog::detail::count_filtered(Log::Domain::domain, _rlog_location);                                             \
+                }                                                                                                                      \
+                else if (rlog::detail::pass_rate_limit(Limiter))                                                                       \
+                {                                                                                                                      \
+                    if (rlog::detail::do_log(Log::Domain::domain, rlog::verbosity::Severity, &_rlog_location, Formatter(__VA_ARGS__))) \
+                        CC_DEBUG_BREAK();                                                                                              \
+                }                                                                                                                      \
+                else if (rlog::detail::is_collecting_site_stats())                                                                     \
+                    rlog::detail::count_suppressed(Log::Domain::domain, _rlog_location);                                               \
+            }                                                                                                                          \
+            else if (rlog::detail::is_flight_recording(rlog::verbosity::Severity))                                                     \
+                rlog::detail::record_flight(Log::Domain::domain, rlog::verbosity::Severity, &_rlog_location, Formatter(__VA_ARGS__));  \
+            else if (rlog::detail::is_collecting_site_stats())                                                                         \
+                rlog::detail::count_filtered(Log::Domain::domain, _rlog_location);                                                     \
+        }                                                                                                                              \
     } while (0) // force ;
 
 /// writes an info log message to the Default domain using rlog::detail::format (printf AND pythonic syntax)
-#define RICH_LOG(...) RICH_LOG_IMPL(Default, Info, nullptr, rlog::detail::format, __VA_ARGS__)
+#define RICH_LOG(...) RICH_LOG_IMPL(Default, Info, nullptr, DETAIL_RICH_LOG_CAPTURE, __VA_ARGS__)
 /// same as log but with Warning severity
-#define RICH_LOG_WARN(...) RICH_LOG_IMPL(Default, Warning, nullptr, rlog::detail::format, __VA_ARGS__)
+#define RICH_LOG_WARN(...) RICH_LOG_IMPL(Default, Warning, nullptr, DETAIL_RICH_LOG_CAPTURE, __VA_ARGS__)
 /// same as log but with Error severity
-#define RICH_LOG_ERROR(...) RICH_LOG_IMPL(Default, Error, nullptr, rlog::detail::format, __VA_ARGS__)
+#define RICH_LOG_ERROR(...) RICH_LOG_IMPL(Default, Error, nullptr, DETAIL_RICH_LOG_CAPTURE, __VA_ARGS__)
 /// writes a log message with given domain and severity using rlog::detail::format
-#define RICH_LOGD(Domain, Severity, ...) RICH_LOG_IMPL(Domain, Severity, nullptr, rlog::detail::format, __VA_ARGS__)
+#define RICH_LOGD(Domain, Severity, ...) RICH_LOG_IMPL(Domain, Severity, nullptr, DETAIL_RICH_LOG_CAPTURE, __VA_ARGS__)
 /// same as RICH_LOGD but will only log once
-#define RICH_LOGD_ONCE(Limiter, Domain, Severity, ...) RICH_LOG_IMPL(Domain, Severity, &Limiter, rlog::detail::format, __VA_ARGS__)
+#define RICH_LOGD_ONCE(Limiter, Domain, Severity, ...) RICH_LOG_IMPL(Domain, Severity, &Limiter, DETAIL_RICH_LOG_CAPTURE, __VA_ARGS__)
 /// convenience wrapper for LOG("<expr> = %s", <expr>)
 #define RICH_LOG_EXPR(...) RICH_LOG("%s = %s", #__VA_ARGS__, __VA_ARGS__)
+/// writes a structured log message with given domain and severity: RICH_LOGS(Domain, Severity, "message", rlog::kv("key", value), ...)
+#define RICH_LOGS(Domain, Severity, ...) RICH_LOG_IMPL(Domain, Severity, nullptr, rlog::detail::capture_fields, __VA_ARGS__)
+/// same as RICH_LOGS but will only log once
+#define RICH_LOGS_ONCE(Limiter, Domain, Severity, ...) RICH_LOG_IMPL(Domain, Severity, &Limiter, rlog::detail::capture_fields, __VA_ARGS__)
+
+// formatter of the LOG macros, passes the format string through a lambda so that literals can be parsed at compile time
+// (the lambda is only called in constant expressions, runtime format strings never go through it)
+// the parentheses make it return arrays by reference (decltype of an unparenthesized name is the array type itself)
+#define DETAIL_RICH_LOG_CAPTURE(...) \
+    rlog::detail::capture_static([&]() -> decltype(auto) { return (DETAIL_RICH_LOG_FIRST(__VA_ARGS__)); }, __VA_ARGS__)
+#define DETAIL_RICH_LOG_FIRST(...) DETAIL_RICH_LOG_EXPAND(DETAIL_RICH_LOG_FIRST_IMPL(__VA_ARGS__, _))
+#define DETAIL_RICH_LOG_FIRST_IMPL(First, ...) First
+#define DETAIL_RICH_LOG_EXPAND(x) x // MSVC
 
+// release builds keep file and line (each file name is a single shared literal) but not the function signatures
 #ifdef CC_RELEASE
 #define DETAIL_RICH_LOG_MAKE_LOCATION \
     {                                 \
-        "", "", 0                     \
+        "", __FILE__, __LINE__        \
     }
 #else
 #define DETAIL_RICH_LOG_MAKE_LOCATION      \
@@ -81,30 +127,92 @@
 #ifndef RICH_LOG_FORCE_MACRO_PREFIX
 
 /// writes an info log message to the Default domain using rlog::detail::format (printf AND pythonic syntax)
-#define LOG(...) RICH_LOG_IMPL(Default, Info, nullptr, rlog::detail::format, __VA_ARGS__)
+#define LOG(...) RICH_LOG_IMPL(Default, Info, nullptr, DETAIL_RICH_LOG_CAPTURE, __VA_ARGS__)
 /// same as log but only once
-#define LOG_ONCE(Limiter, ...) RICH_LOG_IMPL(Default, Info, &Limiter, rlog::detail::format, __VA_ARGS__)
+#define LOG_ONCE(Limiter, ...) RICH_LOG_IMPL(Default, Info, &Limiter, DETAIL_RICH_LOG_CAPTURE, __VA_ARGS__)
 /// same as log but with Warning severity
-#define LOG_WARN(...) RICH_LOG_IMPL(Default, Warning, nullptr, rlog::detail::format, __VA_ARGS__)
+#define LOG_WARN(...) RICH_LOG_IMPL(Default, Warning, nullptr, DETAIL_RICH_LOG_CAPTURE, __VA_ARGS__)
 /// same as log but with Warning severity and only once
-#define LOG_WARN_ONCE(Limiter, ...) RICH_LOG_IMPL(Default, Warning, &Limiter, rlog::detail::format, __VA_ARGS__)
+#define LOG_WARN_ONCE(Limiter, ...) RICH_LOG_IMPL(Default, Warning, &Limiter, DETAIL_RICH_LOG_CAPTURE, __VA_ARGS__)
 /// same as log but with Error severity
-#define LOG_ERROR(...) RICH_LOG_IMPL(Default, Error, nullptr, rlog::detail::format, __VA_ARGS__)
+#define LOG_ERROR(...) RICH_LOG_IMPL(Default, Error, nullptr, DETAIL_RICH_LOG_CAPTURE, __VA_ARGS__)
 /// same as log but with Error severity and only once
-#define LOG_ERROR_ONCE(Limiter, ...) RICH_LOG_IMPL(Default, Error, &Limiter, rlog::detail::format, __VA_ARGS__)
+#define LOG_ERROR_ONCE(Limiter, ...) RICH_LOG_IMPL(Default, Error, &Limiter, DETAIL_RICH_LOG_CAPTURE, __VA_ARGS__)
 /// writes a log message with given domain and severity using rlog::detail::format
-#define LOGD(Domain, Severity, ...) RICH_LOG_IMPL(Domain, Severity, nullptr, rlog::detail::format, __VA_ARGS__)
+#define LOGD(Domain, Severity, ...) RICH_LOG_IMPL(Domain, Severity, nullptr, DETAIL_RICH_LOG_CAPTURE, __VA_ARGS__)
 /// same as LOGD but will only log once
-#define LOGD_ONCE(Limiter, Domain, Severity, ...) RICH_LOG_IMPL(Domain, Severity, &Limiter, rlog::detail::format, __VA_ARGS__)
+#define LOGD_ONCE(Limiter, Domain, Severity, ...) RICH_LOG_IMPL(Domain, Severity, &Limiter, DETAIL_RICH_LOG_CAPTURE, __VA_ARGS__)
 /// convenience wrapper for LOG("<expr> = %s", <expr>)
 #define LOG_EXPR(...) RICH_LOG("%s = %s", #__VA_ARGS__, __VA_ARGS__)
+/// writes a structured log message with given domain and severity: LOGS(Domain, Severity, "message", rlog::kv("key", value), ...)
+#define LOGS(Domain, Severity, ...) RICH_LOG_IMPL(Domain, Severity, nullptr, rlog::detail::capture_fields, __VA_ARGS__)
+/// same as LOGS but will only log once
+#define LOGS_ONCE(Limiter, Domain, Severity, ...) RICH_LOG_IMPL(Domain, Severity, &Limiter, rlog::detail::capture_fields, __VA_ARGS__)
 
 #endif
 
 namespace rlog::detail
 {
+/// no rate limiter: always log
+constexpr bool pass_rate_limit(std::nullptr_t) { return true; }
+
+/// returns true if the message should be logged
+/// NOTE: called before anything is formatted
+///       templated on the concrete limiter type, so the built-in (final) limiters are called without virtual dispatch
+template <class Limiter>
+bool pass_rate_limit(Limiter* rate_limiter)
+{
+    return rate_limiter->try_log();
+}
+
+/// number of threads that currently silence some LOGs (see scoped_logger_silence)
+/// NOTE: maintained by the local logger stack, read in the LOG macros
+RLOG_API extern std::atomic<int> g_silencing_thread_count;
+
+/// returns true if LOGs of this verbosity are silenced on the calling thread
+/// (reads the routing state that the local logger stack of the thread keeps up to date)
+RLOG_API bool is_silenced_on_current_thread(verbosity::type v);
+
+/// returns false if the LOG is silenced on the calling thread
+/// NOTE: thread_local variables cannot be exported from a DLL, so the thread state is read out of line
+///       but only while any thread silences LOGs, otherwise this is a single relaxed load
+inline bool passes_thread_gate(verbosity::type v)
+{
+    return g_silencing_thread_count.load(std::memory_order_relaxed) == 0 || !is_silenced_on_current_thread(v);
+}
+
 /// NOTE: loc is a pointer to the data segment (static lifetime)
-/// TODO: we might be able to improve performance by providing a threadlocal stream_ref<char> to the formatter
 /// returns true if we want to hit a breakpoint after logging
-RLOG_API bool do_log(rlog::domain_info const& domain, rlog::verbosity::type verbosity, location* loc, rlog::rate::log_rate_limiter* rate_limiter, cc::string_view message);
+RLOG_API bool do_log(rlog::domain_info const& domain, rlog::verbosity::type verbosity, location* loc, cc::string_view message);
+
+/// same as do_log but with captured arguments (see detail/deferred.hh)
+/// the arguments are only formatted if a logger needs the text, directly into a reusable per-thread buffer
+RLOG_API bool do_log_deferred(rlog::domain_info const& domain, rlog::verbosity::type verbosity, location* loc, deferred_message const& message);
+
+template <class... Args>
+bool do_log(rlog::domain_info const& domain, rlog::verbosity::type verbosity, location* loc, captured_message<Args...> const& message)
+{
+    return do_log_deferred(domain, verbosity, loc, message.as_deferred());
+}
+
+/// same as do_log but with typed key/value fields (see LOGS)
+RLOG_API bool do_log_structured(rlog::domain_info const& domain, //
+                                rlog::verbosity::type verbosity,
+                                location* loc,
+                                cc::string_view message,
+                                cc::span<field const> fields);
+
+template <size_t N>
+bool do_log(rlog::domain_info const& domain, rlog::verbosity::type verbosity, location* loc, structured_message<N> const& message)
+{
+    return do_log_structured(domain, verbosity, loc, message.message, cc::span<field const>(message.fields, N));
+}
+
+/// passes a complete message through the local loggers, the async backend, and the global loggers (the last stages of do_log)
+/// used for messages that did not come directly from a LOG (e.g. by the flight recorder)
+RLOG_API void dispatch_message(rlog::message_ref const& msg, bool& break_on_log);
+
+/// passes a message to the global default logger (or the built-in one if none is set)
+/// this is the last stage of do_log and is also called by the async background thread
+RLOG_API void dispatch_to_global_logger(rlog::message_ref const& msg, bool& break_on_log);
 }
@@ -0,0 +1,244 @@
+#include "log_line.hh"
+
+#include <cstdio>
+
+#include <rich-log/timestamp.hh>
+
+#define RLOG_COLOR_TIMESTAMP "\u001b[38;5;37m"
+#define RLOG_COLOR_LOCATION "\u001b[38;5;240m"
+#define RLOG_COLOR_RESET "\u001b[0m"
+
+namespace
+{
+struct line_writer
+{
+    cc::string& out;
+    bool colored;
+    size_t prefix_length = 0; // visible chars before the message
+
+    void color(char const* code)
+    {
+        if (colored)
+            out += code;
+    }
+
+    void text(cc::string_view s)
+    {
+        out += s;
+        prefix_length += s.size();
+    }
+
+    // left-aligned in a column of the given width (plus one space)
+    void column(cc::string_view s, size_t width)
+    {
+        text(s);
+        for (auto i = s.size(); i < width; ++i)
+            text(" ");
+        text(" ");
+    }
+};
+
+bool needs_logfmt_quotes(cc::string_view value)
+{
+    if (value.empty())
+        return true;
+
+    for (auto c : value)
+        if (c == ' ' || c == '=' || c == '"' || c == '\\' || uint8_t(c) < 0x20)
+            return true;
+
+    return false;
+}
+}
+
+char const* rlog::get_verbosity_name(verbosity::type v)
+{
+    switch (v)
+    {
+    case verbosity::Trace:
+        return "TRACE";
+    case verbosity::Debug:
+        return "DEBUG";
+    case verbosity::Info:
+        return "INFO";
+    case verbosity::Warning:
+        return "WARNING";
+    case verbosity::Error:
+        return "ERROR";
+    case verbosity::Fatal:
+        return "FATAL";
+    case verbosity::_count: // silence warning
+        break;
+    }
+    return "";
+}
+
+char const* rlog::get_verbosity_color(verbosity::type v)
+{
+    switch (v)
+    {
+    case verbosity::Trace:
+        return "\u001b[38;5;14m";
+    case verbosity::Debug:
+        return "\u001b[38;5;148m";
+    case verbosity::Info:
+        return "\u001b[38;5;241m";
+    case verbosity::Warning:
+        return "\u001b[38;5;202m";
+    case verbosity::Error:
+    case verbosity::Fatal:
+        return "\u001b[38;5;196m\u001b[1m";
+    case verbosity::_count: // silence warning
+        break;
+    }
+    return "";
+}
+
+void rlog::append_log_line(cc::string& out, message_ref const& msg, console_log_style style)
+{
+    auto const is_verbose = style == console_log_style::verbose || style == console_log_style::verbose_no_color
+                            || style == console_log_style::verbose_with_location;
+
+    line_writer w = {out, style != console_log_style::verbose_no_color && style != console_log_style::message_only};
+
+    char buffer[32];
+    auto const has_domain = msg.domain != nullptr && msg.domain != &Log::Default::domain;
+
+    if (is_verbose)
+    {
+        // 06.05.20 07:14:10 t000      INFO       NET      <the message being printed>
+        w.color(RLOG_COLOR_TIMESTAMP);
+        w.text(cc::string_view(buffer, write_date(buffer, sizeof(buffer), msg.timestamp)));
+        w.text(" ");
+        w.text(cc::string_view(buffer, write_time_of_day(buffer, sizeof(buffer), msg.timestamp)));
+        w.text(" ");
+        w.color(RLOG_COLOR_RESET);
+
+        // unnamed threads are shown by id
+        if (!msg.thread_name.empty())
+            w.column(msg.thread_name, 9);
+        else if (msg.thread_id != rlog::no_thread_id)
+            w.column(cc::string_view(buffer, size_t(std::snprintf(buffer, sizeof(buffer), "t%03d", int(msg.thread_id)))), 9);
+        else
+            w.column("-", 9);
+
+        w.color(get_verbosity_color(msg.verbosity));
+        w.column(get_verbosity_name(msg.verbosity), 10);
+        w.color(RLOG_COLOR_RESET);
+
+        w.color(msg.domain ? msg.domain->ansi_color_code : "");
+        w.column(msg.domain ? msg.domain->name : "", 8);
+        w.color(RLOG_COLOR_RESET);
+
+        if (style == console_log_style::verbose_with_location && msg.location != nullptr && msg.location->file[0] != '\0')
+        {
+            w.color(RLOG_COLOR_LOCATION);
+            w.text(msg.location->file);
+            auto const len = std::snprintf(buffer, sizeof(buffer), ":%d ", msg.location->line);
+            w.text(cc::string_view(buffer, size_t(len)));
+            w.color(RLOG_COLOR_RESET);
+        }
+    }
+    else if (style == console_log_style::brief || style == console_log_style::briefer)
+    {
+        // 07:14:10 INFO NET <the message being printed>
+        // 07:14 I NET <the message being printed>
+        auto const time_length = write_time_of_day(buffer, sizeof(buffer), msg.timestamp);
+
+        w.color(RLOG_COLOR_TIMESTAMP);
+        w.text(cc::string_view(buffer, style == console_log_style::briefer ? 5 : time_length));
+        w.text(" ");
+        w.color(RLOG_COLOR_RESET);
+
+        w.color(get_verbosity_color(msg.verbosity));
+        auto const name = get_verbosity_name(msg.verbosity);
+        w.text(style == console_log_style::briefer ? cc::string_view(name, 1) : cc::string_view(name));
+        w.text(" ");
+        w.color(RLOG_COLOR_RESET);
+
+        if (has_domain)
+        {
+            w.color(msg.domain->ansi_color_code);
+            w.text(msg.domain->name);
+            w.text(" ");
+            w.color(RLOG_COLOR_RESET);
+        }
+    }
+
+    // message line by line
+    auto const message = msg.message;
+    size_t line_start = 0;
+    for (size_t i = 0; i <= message.size(); ++i)
+    {
+        if (i < message.size() && message[i] != '\n')
+            continue;
+
+        if (line_start > 0)
+            for (size_t p = 0; p < w.prefix_length; ++p)
+                out += ' ';
+
+        out += cc::string_view(message.data() + line_start, i - line_start);
+        if (i == message.size())
+            rlog::append_logfmt_fields(out, msg.fields);
+        out += '\n';
+        line_start = i + 1;
+    }
+}
+
+void rlog::append_logfmt_value(cc::string& out, cc::string_view value)
+{
+    if (!needs_logfmt_quotes(value))
+    {
+        out += value;
+        return;
+    }
+
+    out += '"';
+    for (auto c : value)
+    {
+        switch (c)
+        {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+void rlog::append_logfmt_fields(cc::string& out, cc::span<field const> fields)
+{
+    // values are formatted into a per-thread buffer first, because quoting is only known afterwards
+    thread_local cc::string value;
+
+    for (auto const& f : fields)
+    {
+        out += ' ';
+        out += f.key;
+        out += '=';
+
+        if (f.type == field_type::string)
+        {
+            append_logfmt_value(out, f.str);
+            continue;
+        }
+
+        value.clear();
+        f.format_value([&](cc::span<char const> chars) { value += cc::string_view(chars.data(), chars.size()); });
+        append_logfmt_value(out, value);
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <clean-core/string.hh>
+
+#include <rich-log/detail/api.hh>
+#include <rich-log/domain.hh>
+#include <rich-log/logger.hh>
+#include <rich-log/message.hh>
+
+namespace rlog
+{
+/// upper case name of the verbosity, e.g. "WARNING"
+RLOG_API char const* get_verbosity_name(verbosity::type v);
+
+/// ANSI color code used for the verbosity in colored output
+RLOG_API char const* get_verbosity_color(verbosity::type v);
+
+/// appends a full log line for the message in the given style (see console_log_style) to 'out'
+/// lines of multiline messages are indented to line up with the first one
+/// fields of structured messages follow the message (see append_logfmt_fields)
+/// the result always ends with '\n'
+/// NOTE: this is the shared line layout of file sinks and offline tools like rlog-decode
+RLOG_API void append_log_line(cc::string& out, message_ref const& msg, console_log_style style);
+
+/// appends the fields as logfmt pairs, each preceded by a space: ' key=value key2="quoted value"'
+/// values are quoted (and escaped) if they are empty or contain spaces, '=', quotes, or control characters
+RLOG_API void append_logfmt_fields(cc::string& out, cc::span<field const> fields);
+
+/// appends a single logfmt value (quoted and escaped if needed)
+RLOG_API void append_logfmt_value(cc::string& out, cc::string_view value);
+}
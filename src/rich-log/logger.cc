@@ -1,18 +1,28 @@
 #include "logger.hh"
 
+#include <atomic>
 #include <cstdarg>
 #include <cstdio>
 #include <cstring>
-#include <ctime>
 #include <mutex>
 
 #include <clean-core/macros.hh>
+#include <clean-core/string.hh>
 #include <clean-core/utility.hh>
 #include <clean-core/vector.hh>
 
+#include <rich-log/async.hh>
+#include <rich-log/auto_limit.hh>
+#include <rich-log/console.hh>
+#include <rich-log/detail/id_table.hh>
 #include <rich-log/experimental.hh>
+#include <rich-log/flight_recorder.hh>
 #include <rich-log/log.hh>
+#include <rich-log/log_line.hh>
 #include <rich-log/message.hh>
+#include <rich-log/sink.hh>
+#include <rich-log/site_stats.hh>
+#include <rich-log/timestamp.hh>
 
 #ifdef CC_OS_WINDOWS
 #include <clean-core/native/win32_sanitized.hh>
@@ -28,118 +38,307 @@
 #define RLOG_COLOR_TIMESTAMP "\u001b[38;5;37m"
 #define RLOG_COLOR_RESET "\u001b[0m"
 
+std::atomic<int> rlog::detail::g_silencing_thread_count = {0};
+
 namespace
 {
-thread_local char tls_thread_name[32] = "";
-rlog::verbosity::type g_break_on_log_min_verbosity = rlog::verbosity::Fatal;
+// thread identity: a dense id per live thread and an interned name (see get_current_thread_id)
+// interned names are never freed, so message_ref::thread_name stays valid and can be compared by address
+constexpr size_t max_thread_name_size = 31;
+char const* const g_empty_thread_name = "";
 
-rlog::logger_fun g_default_logger;
-thread_local cc::vector<rlog::logger_fun> g_local_logger_stack;
+// current name per thread id, nullptr for unnamed threads and unused ids
+std::atomic<char const*> g_thread_names[rlog::max_thread_ids];
 
-CC_FORCE_INLINE void write_timebuffer(char* timebuffer, size_t size, std::time_t t, char const* format)
+struct thread_registry
 {
-#ifdef CC_OS_WINDOWS
-    std::tm lt_stack;
-    ::localtime_s(&lt_stack, &t);
-    std::tm* const lt = &lt_stack;
-#else
-    std::tm* const lt = std::localtime(&t);
-#endif
-    timebuffer[std::strftime(timebuffer, size, format, lt)] = '\0';
+    std::mutex mutex;
+    cc::vector<char const*> interned_names; // hash set (linear probing, at most half full), nullptr is empty
+    size_t interned_count = 0;
+    cc::vector<uint16_t> free_ids;
+    uint16_t next_id = 1; // 0 is no_thread_id
+
+    // each distinct name is stored once, so memory only grows with the number of different names
+    // (e.g. "worker-<n>" per short-lived thread), not with the number of threads or renames
+    char const* intern(char const* name)
+    {
+        if (name[0] == '\0')
+            return g_empty_thread_name;
+
+        auto const hash = rlog::detail::hash_name(name);
+
+        auto _ = std::lock_guard<std::mutex>(mutex);
+        if (2 * (interned_count + 1) > interned_names.size())
+            grow_interned_names();
+
+        auto const mask = interned_names.size() - 1;
+        for (auto i = size_t(hash) & mask;; i = (i + 1) & mask)
+        {
+            auto const n = interned_names[i];
+            if (n == nullptr)
+            {
+                auto const size = std::strlen(name) + 1;
+                auto const copy = new char[size];
+                std::memcpy(copy, name, size);
+                interned_names[i] = copy;
+                ++interned_count;
+                return copy;
+            }
+
+            if (std::strcmp(n, name) == 0)
+                return n;
+        }
+    }
+
+    // must hold mutex
+    void grow_interned_names()
+    {
+        cc::vector<char const*> names;
+        names.resize(interned_names.empty() ? 64 : 2 * interned_names.size());
+
+        auto const mask = names.size() - 1;
+        for (auto n : interned_names)
+            if (n != nullptr)
+            {
+                auto i = size_t(rlog::detail::hash_name(n)) & mask;
+                while (names[i] != nullptr)
+                    i = (i + 1) & mask;
+                names[i] = n;
+            }
+
+        interned_names = cc::move(names);
+    }
+
+    uint16_t acquire_id()
+    {
+        auto _ = std::lock_guard<std::mutex>(mutex);
+        if (!free_ids.empty())
+        {
+            auto const id = free_ids.back();
+            free_ids.pop_back();
+            return id;
+        }
+
+        if (next_id == rlog::max_thread_ids)
+            return rlog::no_thread_id;
+        return next_id++;
+    }
+
+    void release_id(uint16_t id)
+    {
+        g_thread_names[id].store(nullptr, std::memory_order_release);
+
+        auto _ = std::lock_guard<std::mutex>(mutex);
+        free_ids.push_back(id);
+    }
+};
+
+// never destroyed, threads can still exit during static destruction
+thread_registry& thread_reg()
+{
+    static auto const r = new thread_registry();
+    return *r;
 }
 
+struct thread_identity
+{
+    uint16_t id = rlog::no_thread_id;
+    bool has_id = false; // false until first use (id stays no_thread_id if all ids are taken)
+    char const* name = g_empty_thread_name;
+
+    uint16_t get_id()
+    {
+        if (!has_id)
+        {
+            id = thread_reg().acquire_id();
+            has_id = true;
+            if (id != rlog::no_thread_id && name != g_empty_thread_name)
+                g_thread_names[id].store(name, std::memory_order_release);
+        }
+        return id;
+    }
+
+    // ids of exited threads are reused
+    ~thread_identity()
+    {
+        if (id != rlog::no_thread_id)
+            thread_reg().release_id(id);
+    }
+};
+thread_local thread_identity tls_thread;
+
+std::atomic<rlog::verbosity::type> g_break_on_log_min_verbosity = {rlog::verbosity::Fatal};
+
+rlog::logger_fun g_default_logger;
+
+// entry of the local logger stack, either a logger or a silence (see scoped_logger_silence)
+struct local_logger
+{
+    rlog::logger_fun logger; // invalid for silences
+    int silence_up_to = -1;  // silences consume messages with verbosity <= silence_up_to
+};
+thread_local cc::vector<local_logger> g_local_logger_stack;
+
+// routing decision of the thread, derived from its local logger stack whenever it changes
+// so LOG calls do not need to look at the stack itself
+struct thread_log_state
+{
+    // LOGs below this verbosity are silenced, i.e. dropped before anything is formatted
+    // (only silences above the topmost logger count, loggers above a silence still see everything)
+    int min_verbosity = 0;
+
+    // the stack contains at least one logger (not only silences)
+    bool has_loggers = false;
+};
+thread_local thread_log_state tls_log_state;
+
+void update_thread_log_state()
+{
+    auto const was_silenced = tls_log_state.min_verbosity > 0;
+
+    auto state = thread_log_state{};
+    auto is_top = true;
+    for (auto i = int(g_local_logger_stack.size()) - 1; i >= 0; --i)
+    {
+        auto const& e = g_local_logger_stack[i];
+        if (e.logger.is_valid())
+        {
+            state.has_loggers = true;
+            is_top = false;
+        }
+        else if (is_top && e.silence_up_to + 1 > state.min_verbosity)
+            state.min_verbosity = e.silence_up_to + 1;
+    }
+    tls_log_state = state;
+
+    auto const is_silenced = state.min_verbosity > 0;
+    if (is_silenced != was_silenced)
+        rlog::detail::g_silencing_thread_count.fetch_add(is_silenced ? 1 : -1, std::memory_order_relaxed);
 }
 
-bool rlog::default_logger_fun(message_ref msg, bool& break_on_log)
+// formatted messages are written to a per-thread buffer that keeps its capacity
+// so steady-state logging does not allocate
+// LOGs nested in formatting or in loggers use a temporary string instead (the outer message still views the buffer)
+constexpr size_t max_retained_format_capacity = 64 * 1024;
+
+struct format_buffer
 {
-    (void)break_on_log; // default behavior is fine
+    cc::string text;
+    bool in_use = false;
+};
+thread_local format_buffer tls_format_buffer;
 
-    auto stream = msg.verbosity >= rlog::verbosity::Warning ? stderr : stdout;
+// borrows the thread's format buffer for the duration of a LOG call
+struct format_buffer_lease
+{
+    format_buffer* buffer = nullptr;
+    cc::string fallback;
 
-    // prepare timestamp
-    char timebuffer[9];
-    write_timebuffer(timebuffer, sizeof(timebuffer), msg.timestamp, "%H:%M:%S");
+    cc::string& text() { return buffer ? buffer->text : fallback; }
 
-    // brief log line
-    // [timestamp] [severity] [domain] [message]
-    // 07:14:10 WARNING [NET] <the message being printed>\n
+    format_buffer_lease()
+    {
+        if (!tls_format_buffer.in_use)
+        {
+            buffer = &tls_format_buffer;
+            buffer->in_use = true;
+            buffer->text.clear();
+        }
+    }
 
-    char const* verbosity_color_code = "";
-    char const* verbosity_name = "";
-    switch (msg.verbosity)
+    ~format_buffer_lease()
     {
-    case rlog::verbosity::Trace:
-        verbosity_color_code = "\u001b[38;5;14m";
-        verbosity_name = "TRACE ";
-        break;
-    case rlog::verbosity::Debug:
-        verbosity_color_code = "\u001b[38;5;148m";
-        verbosity_name = "DEBUG ";
-        break;
-    case rlog::verbosity::Info:
-        verbosity_color_code = "\u001b[38;5;241m";
-        // no verbosity name
-        break;
-    case rlog::verbosity::Warning:
-        verbosity_color_code = "\u001b[38;5;202m";
-        verbosity_name = "WARNING ";
-        break;
-    case rlog::verbosity::Error:
-        verbosity_color_code = "\u001b[38;5;196m\u001b[1m";
-        verbosity_name = "ERROR ";
-        break;
-    case rlog::verbosity::Fatal:
-        verbosity_color_code = "\u001b[38;5;196m\u001b[1m";
-        verbosity_name = "FATAL ";
-        break;
-
-    case rlog::verbosity::_count: // silence warning
-        break;
+        if (!buffer)
+            return;
+
+        // do not keep memory of a single huge message around forever
+        if (buffer->text.capacity() > max_retained_format_capacity)
+        {
+            buffer->text.clear();
+            buffer->text.shrink_to_fit();
+        }
+
+        buffer->in_use = false;
     }
 
-    // simple mutex to make sure LOGs are "atomic"
-    // this is not really high performance, but those users should use set_global_default_logger anyways
-    static std::mutex printf_mutex;
-    auto _ = std::lock_guard<std::mutex>(printf_mutex);
+    format_buffer_lease(format_buffer_lease const&) = delete;
+    format_buffer_lease& operator=(format_buffer_lease const&) = delete;
+};
 
-    // flush other stream to improve ordering
-    std::fflush(stream == stdout ? stderr : stdout);
+// brief log line of the built-in default logger
+// [timestamp] [severity] [domain] [message] [fields]
+// 07:14:10 WARNING [NET] <the message being printed> key=value\n
+void append_default_log_line(cc::string& out, rlog::message_ref const& msg)
+{
+    // prepare timestamp (cached per thread, only recomputed when the second changes)
+    char timebuffer[20];
+    auto const time_length = rlog::write_time_of_day(timebuffer, sizeof(timebuffer), msg.timestamp);
+
+    // Info has no verbosity name
+    auto const verbosity_name = msg.verbosity == rlog::verbosity::Info ? "" : rlog::get_verbosity_name(msg.verbosity);
 
     // timestamp and severity (always)
-    int prefix_length = 9 + std::strlen(verbosity_name);
-    std::fprintf(stream,                                                              //
-                 RLOG_COLOR_TIMESTAMP "%s " RLOG_COLOR_RESET "%s%s" RLOG_COLOR_RESET, //
-                 timebuffer, verbosity_color_code, verbosity_name);
+    out += RLOG_COLOR_TIMESTAMP;
+    out += cc::string_view(timebuffer, time_length);
+    out += " " RLOG_COLOR_RESET;
+    out += rlog::get_verbosity_color(msg.verbosity);
+    out += verbosity_name;
+    if (verbosity_name[0] != '\0')
+        out += ' ';
+    out += RLOG_COLOR_RESET;
+    auto prefix_length = time_length + 1 + std::strlen(verbosity_name) + (verbosity_name[0] != '\0' ? 1 : 0);
 
     // domain, optional
     if (msg.domain != &Log::Default::domain)
     {
-        std::fprintf(stream,                   //
-                     "%s%s " RLOG_COLOR_RESET, //
-                     msg.domain->ansi_color_code, msg.domain->name);
+        out += msg.domain->ansi_color_code;
+        out += msg.domain->name;
+        out += " " RLOG_COLOR_RESET;
         prefix_length += std::strlen(msg.domain->name) + 1;
     }
 
-
-    // print actual message line by line
-    auto first_line = true;
-    for (auto line : msg.message.split('\n'))
+    // actual message line by line
+    // (scanned in place, the message is not copied or split into a container)
+    auto rest = msg.message;
+    while (true)
     {
         // TODO: limit output size if it's too large?
 
-        if (first_line)
-            first_line = false;
-        else
-            // pad with spaces
-            std::fprintf(stream, "%*s", prefix_length, "");
+        auto const newline = rest.empty() ? nullptr : static_cast<char const*>(std::memchr(rest.data(), '\n', rest.size()));
+        auto const line_size = newline ? size_t(newline - rest.data()) : rest.size();
+        out += cc::string_view(rest.data(), line_size);
+
+        if (!newline)
+        {
+            // fields of structured messages as " key=value"
+            rlog::append_logfmt_fields(out, msg.fields);
+            out += '\n';
+            break;
+        }
+
+        out += '\n';
+
+        rest = rest.subview(line_size + 1);
 
-        std::fprintf(stream, "%.*s\n", int(line.size()), line.data());
+        // pad with spaces
+        for (size_t i = 0; i < prefix_length; ++i)
+            out += ' ';
     }
-    if (first_line) // empty msg?
-        std::fprintf(stream, "\n");
+}
+}
+
+bool rlog::default_logger_fun(message_ref msg, bool& break_on_log)
+{
+    (void)break_on_log; // default behavior is fine
 
-    // flush curr streams to improve ordering
-    std::fflush(stream == stdout ? stdout : stderr);
+    // the whole (colored, multiline) line is assembled first
+    // so the console lock is only held for a single write
+    thread_local cc::string line;
+    line.clear();
+    append_default_log_line(line, msg);
+
+    auto const stream = msg.verbosity >= rlog::verbosity::Warning ? rlog::detail::console_stream::err : rlog::detail::console_stream::out;
+    rlog::detail::write_to_console(stream, line, msg.verbosity >= rlog::verbosity::Error);
 
     return true;
 }
@@ -149,68 +348,290 @@ void rlog::experimental::set_whitelist_filter(cc::unique_function<bool(cc::strin
     // is ignored in the current model
 }
 
-bool rlog::detail::do_log(const domain_info& domain, verbosity::type verbosity, location* loc, rlog::rate::log_rate_limiter* rate_limiter, cc::string_view message)
+namespace
+{
+// counts a message that reached the loggers into the stats of its site (see site_stats.hh)
+// the time is measured from the message timestamp, so only one additional clock read is needed
+struct emitted_site_stats
 {
-    auto const curr_time = std::time(nullptr);
+    rlog::location* loc;
+    rlog::message_ref const& msg;
+    bool enabled = rlog::detail::is_collecting_site_stats();
 
-    if (rate_limiter && !rate_limiter->try_log())
+    ~emitted_site_stats()
+    {
+        if (!enabled)
+            return;
+
+        auto const ns = rlog::get_current_timestamp().monotonic_ns - msg.timestamp.monotonic_ns;
+        rlog::detail::count_emitted(*msg.domain, *loc, msg.message.size(), uint64_t(ns));
+    }
+};
+
+// returns true if a local logger consumed the message
+bool try_local_loggers(rlog::message_ref const& msg, bool& break_on_log)
+{
+    if (!tls_log_state.has_loggers)
         return false;
 
-    message_ref msg;
-    msg.timestamp = curr_time;
+    for (auto i = int(g_local_logger_stack.size()) - 1; i >= 0; --i)
+    {
+        auto& e = g_local_logger_stack[i];
+        if (e.logger.is_valid() ? e.logger(msg, break_on_log) : msg.verbosity <= e.silence_up_to)
+            return true;
+    }
+    return false;
+}
+
+// identifies messages for collapsing repeats (see auto_limit.hh), never 0
+// FNV-1a over the format string and the serialized arguments, or over the text and fields
+constexpr size_t max_hashed_arguments_size = 256;
+
+struct message_hasher
+{
+    uint64_t value = 14695981039346656037ull;
+
+    void add(void const* data, size_t size)
+    {
+        auto const bytes = static_cast<unsigned char const*>(data);
+        for (size_t i = 0; i < size; ++i)
+            value = (value ^ bytes[i]) * 1099511628211ull;
+    }
+
+    void add(cc::string_view s)
+    {
+        add(s.data(), s.size());
+        add("", 1); // separator
+    }
+
+    uint64_t result() const { return value == 0 ? 1 : value; }
+};
+
+uint64_t hash_text_message(rlog::message_ref const& msg)
+{
+    message_hasher h;
+    h.add(msg.message);
+    for (auto const& f : msg.fields)
+    {
+        h.add(f.key);
+        f.format_value([&](cc::span<char const> chars) { h.add(chars.data(), chars.size()); });
+        h.add("", 1);
+    }
+    return h.result();
+}
+
+// only serializable messages with small arguments, returns 0 otherwise
+uint64_t hash_deferred_message(rlog::detail::deferred_message const& deferred)
+{
+    if (!deferred.is_serializable())
+        return 0;
+
+    auto const size = deferred.vtable->serialized_size(deferred.args);
+    if (size > max_hashed_arguments_size)
+        return 0;
+
+    // the format string is a literal, so its address identifies it
+    std::byte args[max_hashed_arguments_size];
+    deferred.vtable->serialize(args, deferred.args);
+
+    message_hasher h;
+    h.add(&deferred.fmt_str.str, sizeof(deferred.fmt_str.str));
+    h.add(args, size);
+    return h.result();
+}
+
+// shared implementation of do_log and do_log_deferred
+// if 'deferred' is set, 'message' is empty and the arguments are formatted on demand
+bool do_log_impl(rlog::domain_info const& domain,
+                 rlog::verbosity::type verbosity,
+                 rlog::location* loc,
+                 cc::string_view message,
+                 rlog::detail::deferred_message const* deferred,
+                 cc::span<rlog::field const> fields)
+{
+    CC_ASSERT(0 <= verbosity && verbosity < rlog::verbosity::_count);
+    auto break_on_log = false;
+    break_on_log |= verbosity >= g_break_on_log_min_verbosity.load(std::memory_order_relaxed);
+    break_on_log |= loc->break_on_log.load(std::memory_order_relaxed);
+
+    // always disable after, but only write the location if it was set (LOGs of the same site on other threads read it)
+    if (loc->break_on_log_once.load(std::memory_order_relaxed))
+        break_on_log |= loc->break_on_log_once.exchange(false, std::memory_order_relaxed);
+
+    // silenced on this thread (the LOG macros already check this, direct calls do not)
+    if (verbosity < tls_log_state.min_verbosity)
+    {
+        if (rlog::detail::is_collecting_site_stats())
+            rlog::detail::count_filtered(domain, *loc);
+        return break_on_log;
+    }
+
+    // no sink (or global logger) wants this message: skip timestamp, formatting, and dispatch
+    if (!tls_log_state.has_loggers && domain.sink_mask[verbosity].load(std::memory_order_relaxed) == 0)
+    {
+        if (rlog::detail::is_collecting_site_stats())
+            rlog::detail::count_filtered(domain, *loc);
+        return break_on_log;
+    }
+
+    rlog::message_ref msg;
+    msg.timestamp = rlog::get_current_timestamp();
     msg.location = loc;
     msg.domain = &domain;
     msg.verbosity = verbosity;
-    msg.thread_name = tls_thread_name;
+    msg.thread_id = tls_thread.get_id();
+    msg.thread_name = tls_thread.name;
     msg.message = message;
+    msg.fields = fields;
 
-    CC_ASSERT(0 <= verbosity && verbosity < rlog::verbosity::_count);
-    auto break_on_log = false;
-    break_on_log |= verbosity >= g_break_on_log_min_verbosity;
-    break_on_log |= loc->break_on_log;
-    break_on_log |= loc->break_on_log_once;
-
-    loc->break_on_log_once = false; // always disable after
-    loc->last_log = msg.timestamp;
+    // NOTE: the lease must outlive all uses of msg
+    auto lease = format_buffer_lease();
 
-    // try local loggers
-    auto consumed = false;
-    for (auto i = int(g_local_logger_stack.size()) - 1; i >= 0; --i)
+    // automatic rate limit (see auto_limit.hh)
+    if (rlog::detail::is_auto_limiting())
     {
-        if (g_local_logger_stack[i](msg, break_on_log))
+        auto hash = uint64_t(0);
+        if (rlog::detail::is_collapsing_repeats())
         {
-            consumed = true;
-            break;
+            if (deferred)
+                hash = hash_deferred_message(*deferred);
+
+            // everything else is compared by its text, which is then formatted here instead of below
+            if (hash == 0)
+            {
+                if (deferred)
+                {
+                    auto& text = lease.text();
+                    deferred->format_to([&](cc::span<char const> chars) { text += cc::string_view(chars.data(), chars.size()); });
+                    msg.message = text;
+                    deferred = nullptr;
+                }
+                hash = hash_text_message(msg);
+            }
         }
-    }
-    // .. try user-defined default logger
-    if (!consumed && g_default_logger.is_valid())
-    {
-        if (g_default_logger(msg, break_on_log))
+
+        if (!rlog::detail::pass_auto_limit(domain, verbosity, *loc, msg.timestamp.monotonic_ns, hash))
         {
-            consumed = true;
+            if (rlog::detail::is_collecting_site_stats())
+                rlog::detail::count_suppressed(domain, *loc);
+            return break_on_log;
         }
     }
-    // .. if still not consumed, use built-in default logger
-    if (!consumed)
-        default_logger_fun(msg, break_on_log);
+
+    auto const stats = emitted_site_stats{loc, msg};
+
+    // same here: a store per LOG would keep moving the cache line of the location between threads
+    auto const log_time = msg.timestamp.to_time_t();
+    if (loc->last_log.load(std::memory_order_relaxed) != log_time)
+        loc->last_log.store(log_time, std::memory_order_relaxed);
+
+    // recorded context goes first (see flight_recorder.hh)
+    if (rlog::detail::is_flight_dump_trigger(verbosity))
+        rlog::detail::dump_flight_records(msg);
+
+    // Fatal messages are written synchronously, together with everything logged before them
+    // (the process is likely about to end, see crash_handler.hh)
+    auto const is_fatal = verbosity >= rlog::verbosity::Fatal;
+
+    // without local loggers, nobody needs the text on this thread
+    // so the message can go to the async backend in binary form
+    if (!is_fatal && deferred && !tls_log_state.has_loggers && rlog::detail::try_enqueue_async(msg, deferred))
+        return break_on_log;
+
+    if (deferred)
+    {
+        auto& text = lease.text();
+        deferred->format_to([&](cc::span<char const> chars) { text += cc::string_view(chars.data(), chars.size()); });
+        msg.message = text;
+    }
+
+    if (!is_fatal)
+    {
+        rlog::detail::dispatch_message(msg, break_on_log);
+        return break_on_log;
+    }
+
+    if (try_local_loggers(msg, break_on_log))
+        return break_on_log;
+
+    rlog::async::flush();
+    rlog::detail::dispatch_to_global_logger(msg, break_on_log);
+    rlog::console::flush();
+    rlog::flush_sinks();
 
     return break_on_log;
 }
+}
+
+bool rlog::detail::do_log(const domain_info& domain, verbosity::type verbosity, location* loc, cc::string_view message)
+{
+    return do_log_impl(domain, verbosity, loc, message, nullptr, {});
+}
+
+bool rlog::detail::do_log_deferred(const domain_info& domain, verbosity::type verbosity, location* loc, deferred_message const& message)
+{
+    return do_log_impl(domain, verbosity, loc, {}, &message, {});
+}
+
+bool rlog::detail::do_log_structured(const domain_info& domain, //
+                                     verbosity::type verbosity,
+                                     location* loc,
+                                     cc::string_view message,
+                                     cc::span<field const> fields)
+{
+    return do_log_impl(domain, verbosity, loc, message, nullptr, fields);
+}
+
+void rlog::detail::dispatch_message(message_ref const& msg, bool& break_on_log)
+{
+    // try local loggers
+    // .. hand over to the background thread if async logging is enabled
+    // .. otherwise try the global loggers directly
+    if (!try_local_loggers(msg, break_on_log) && !rlog::detail::try_enqueue_async(msg))
+        rlog::detail::dispatch_to_global_logger(msg, break_on_log);
+}
+
+void rlog::detail::dispatch_to_global_logger(message_ref const& msg, bool& break_on_log)
+{
+    // try user-defined default logger
+    if (g_default_logger.is_valid() && g_default_logger(msg, break_on_log))
+        return;
+
+    // .. then all interested sinks
+    // .. and the built-in default logger if there are none
+    if (!rlog::detail::dispatch_to_sinks(msg))
+        default_logger_fun(msg, break_on_log);
+}
 
 void rlog::set_current_thread_name(const char* fmt, ...)
 {
+    char name[max_thread_name_size + 1] = "";
     if (fmt != nullptr)
     {
         std::va_list args;
         va_start(args, fmt);
-        std::vsnprintf(tls_thread_name, sizeof(tls_thread_name), fmt, args);
+        std::vsnprintf(name, sizeof(name), fmt, args);
         va_end(args);
     }
-    else
-    {
-        tls_thread_name[0] = '\0';
-    }
+
+    tls_thread.name = thread_reg().intern(name);
+
+    auto const id = tls_thread.get_id();
+    if (id != no_thread_id)
+        g_thread_names[id].store(tls_thread.name == g_empty_thread_name ? nullptr : tls_thread.name, std::memory_order_release);
+}
+
+char const* rlog::get_current_thread_name() { return tls_thread.name; }
+
+uint16_t rlog::get_current_thread_id() { return tls_thread.get_id(); }
+
+char const* rlog::get_thread_name(uint16_t thread_id)
+{
+    if (thread_id >= max_thread_ids)
+        return g_empty_thread_name;
+
+    auto const name = g_thread_names[thread_id].load(std::memory_order_acquire);
+    return name ? name : g_empty_thread_name;
 }
 
 void rlog::set_console_log_style(rlog::console_log_style)
@@ -239,28 +660,34 @@ bool rlog::enable_win32_colors()
 #endif
 }
 
-void rlog::set_break_on_log_minimum_verbosity(verbosity::type v) { g_break_on_log_min_verbosity = v; }
+void rlog::set_break_on_log_minimum_verbosity(verbosity::type v) { g_break_on_log_min_verbosity.store(v, std::memory_order_relaxed); }
 
-void rlog::set_global_default_logger(logger_fun logger) { g_default_logger = cc::move(logger); }
+void rlog::set_global_default_logger(logger_fun logger)
+{
+    rlog::detail::set_has_global_logger(logger.is_valid());
+    g_default_logger = cc::move(logger);
+}
 
 void rlog::push_local_logger(logger_fun logger)
 {
     CC_ASSERT(logger.is_valid() && "loggger must be a valid function");
-    g_local_logger_stack.push_back(cc::move(logger));
+    g_local_logger_stack.push_back({cc::move(logger)});
+    update_thread_log_state();
 }
 
-void rlog::pop_local_logger()
+void rlog::push_local_silence(verbosity::type allow_above_verbosity)
 {
-    CC_ASSERT(!g_local_logger_stack.empty() && "no local logger on the stack. scope mismatch? or wrong thread?");
-    g_local_logger_stack.pop_back();
+    local_logger e;
+    e.silence_up_to = allow_above_verbosity;
+    g_local_logger_stack.push_back(cc::move(e));
+    update_thread_log_state();
 }
 
-static cc::vector<rlog::domain_info*>& g_domains()
+void rlog::pop_local_logger()
 {
-    static cc::vector<rlog::domain_info*> v;
-    return v;
+    CC_ASSERT(!g_local_logger_stack.empty() && "no local logger on the stack. scope mismatch? or wrong thread?");
+    g_local_logger_stack.pop_back();
+    update_thread_log_state();
 }
 
-rlog::detail::domain_registerer::domain_registerer(domain_info* domain) { g_domains().push_back(domain); }
-
-cc::span<rlog::domain_info*> rlog::get_domains() { return g_domains(); }
+bool rlog::detail::is_silenced_on_current_thread(verbosity::type v) { return v < tls_log_state.min_verbosity; }
@@ -43,6 +43,33 @@ enum class console_log_style
 /// pass nullptr to un-set
 RLOG_API void set_current_thread_name(char const* fmt, ...) CC_PRINTF_FUNC(1);
 
+/// returns the name of the calling thread (empty if none was set)
+/// names are interned, the returned string stays valid (and unchanged) for the rest of the program
+/// NOTE: interned names are never freed, avoid unbounded numbers of distinct names
+RLOG_API char const* get_current_thread_name();
+
+/// thread ids are small dense integers, assigned to a thread on its first LOG (or set_current_thread_name)
+/// ids of exited threads are reused, so they can index per-thread tables of size max_thread_ids
+/// message_ref::thread_id is no_thread_id for messages that did not come from a LOG, or if more than max_thread_ids - 1 threads exist
+constexpr uint16_t no_thread_id = 0;
+constexpr size_t max_thread_ids = 4096;
+
+/// returns the id of the calling thread (see no_thread_id)
+RLOG_API uint16_t get_current_thread_id();
+
+/// returns the current name of the thread with the given id (empty if it has none or the id is unused)
+/// thread-safe, the returned string stays valid (see get_current_thread_name)
+RLOG_API char const* get_thread_name(uint16_t thread_id);
+
+namespace detail
+{
+/// true if message_ref::thread_name is the interned name of its thread, which can then be stored or compared by address
+inline bool has_interned_thread_name(message_ref const& msg)
+{
+    return msg.thread_id != no_thread_id && get_thread_name(msg.thread_id) == msg.thread_name.data();
+}
+}
+
 /// changes the way print_to_console formats its output
 [[deprecated("replace the default logger instead. 2022-06-25")]] //
 RLOG_API void
@@ -55,6 +82,7 @@ RLOG_API bool enable_win32_colors();
 /// e.g. rlog::set_break_on_log_minimum_verbosity(rlog::verbosity::Warning);
 ///      will break on every warning, error, or fatal LOG
 /// default is Fatal
+/// can be changed at any time from any thread
 RLOG_API void set_break_on_log_minimum_verbosity(verbosity::type v);
 
 /// logger functions process message references
@@ -74,16 +102,83 @@ RLOG_API void set_global_default_logger(logger_fun logger);
 /// NOTE: rlog::scoped_logger_override can be used for automatic scoping
 RLOG_API void push_local_logger(logger_fun logger);
 
-/// pops a logger from the threadlocal log overwrite stack
+/// pushes a silence onto the threadlocal log overwrite stack
+/// i.e. all subsequent LOG calls on the current thread with verbosity <= allow_above_verbosity are dropped (unless a logger is pushed on top)
+/// unlike a logger that discards messages, silenced LOGs are dropped before their arguments are even formatted
+/// NOTE: rlog::scoped_logger_silence can be used for automatic scoping
+RLOG_API void push_local_silence(verbosity::type allow_above_verbosity = verbosity::Fatal);
+
+/// pops a logger (or silence) from the threadlocal log overwrite stack
 RLOG_API void pop_local_logger();
 
 /// the default logger
 /// this can be used for custom loggers that still want the default behavior
 RLOG_API bool default_logger_fun(message_ref msg, bool& break_on_log);
 
-/// returns all registered domains
-/// NOTE: the result is invalidated when a new domain is added (e.g. DLL load or before main)
-RLOG_API cc::span<domain_info*> get_domains();
+/// a consistent view of all registered domains at one point in time
+/// taking and reading a snapshot is lock-free and safe while other threads register or unregister domains
+/// the domains in a snapshot stay valid while it is alive, i.e. unregistering one of them waits until it is released
+///
+/// Usage:
+///
+///   for (auto d : rlog::get_domains())
+///       print(d->name);
+///
+/// CAUTION: keep snapshots short-lived, and do not unload a shared library while holding one on the same thread (deadlock)
+class RLOG_API domain_snapshot
+{
+public:
+    domain_snapshot();
+    ~domain_snapshot();
+
+    domain_snapshot(domain_snapshot const&) = delete;
+    domain_snapshot& operator=(domain_snapshot const&) = delete;
+
+    /// increases with every registration and unregistration
+    uint64_t version() const;
+
+    /// in registration order
+    cc::span<domain_info* const> domains() const;
+
+    /// hash lookup by name, nullptr if there is no such domain
+    domain_info* find(cc::string_view name) const;
+
+    size_t size() const { return domains().size(); }
+    bool empty() const { return domains().empty(); }
+    domain_info* operator[](size_t i) const { return domains()[i]; }
+    domain_info* const* begin() const { return domains().data(); }
+    domain_info* const* end() const { return domains().data() + domains().size(); }
+
+private:
+    void const* _list;
+    uint64_t _epoch;
+};
+
+/// returns a snapshot of all registered domains
+RLOG_API domain_snapshot get_domains();
+
+/// returns the registered domain with the given name (lock-free hash lookup), nullptr if there is none
+/// CAUTION: the result becomes invalid if the domain is unregistered (e.g. its shared library is unloaded)
+///          use get_domains().find(name) to keep it alive
+RLOG_API domain_info* find_domain(cc::string_view name);
+
+/// sets the runtime minimum verbosity of a domain
+/// the level is inherited by all descendants (see domain_info::parent), except those that have their own level
+/// NOTE: thread-safe with respect to LOG calls (each domain is updated atomically, all propagation happens here)
+RLOG_API void set_min_verbosity(domain_info& domain, verbosity::type v);
+
+/// removes the own level of a domain, i.e. it inherits the level of its parent again (Info for root domains)
+RLOG_API void reset_min_verbosity(domain_info& domain);
+
+/// sets the runtime minimum verbosity of all registered domains whose name matches the pattern
+/// '*' matches any sequence of characters (including "::"), '?' matches a single character
+/// e.g. rlog::set_min_verbosity("MyEngine::MeshImporter::*", rlog::verbosity::Debug);
+/// same as set_min_verbosity(domain, v) for each matching domain
+/// returns the number of changed domains
+RLOG_API int set_min_verbosity(char const* domain_pattern, verbosity::type v);
+
+/// returns true if the domain name matches the pattern (see set_min_verbosity)
+RLOG_API bool matches_domain_pattern(char const* domain_name, char const* pattern);
 
 /// helper struct for a threadlocal scoped log overwrite
 /// Usage:
@@ -110,14 +205,16 @@ struct RLOG_API scoped_logger_override
 ///
 ///    auto _ = rlog::scoped_logger_silence{}; // no logs in this scope
 ///    auto _ = rlog::scoped_logger_silence{flag}; // no logs in this scope if flag is true
+///    auto _ = rlog::scoped_logger_silence{true, rlog::verbosity::Warning}; // only errors in this scope
 ///
+/// NOTE: a silenced LOG costs about as much as one below the runtime verbosity (see push_local_silence)
 struct RLOG_API scoped_logger_silence
 {
     [[nodiscard]] explicit scoped_logger_silence(bool do_silence = true, verbosity::type allow_above_verbosity = verbosity::Fatal)
       : do_silence(do_silence)
     {
         if (do_silence)
-            push_local_logger([v = allow_above_verbosity](rlog::message_ref m, bool&) { return m.verbosity <= v; });
+            push_local_silence(allow_above_verbosity);
     }
 
     ~scoped_logger_silence()
@@ -1,10 +1,13 @@
 #pragma once
 
-#include <ctime>
+#include <cstdint>
 
 #include <rich-log/domain.hh>
+#include <rich-log/fields.hh>
 #include <rich-log/fwd.hh>
+#include <rich-log/timestamp.hh>
 
+#include <clean-core/span.hh>
 #include <clean-core/string_view.hh>
 
 namespace rlog
@@ -14,11 +17,13 @@ namespace rlog
 ///          the message becomes invalid after the LOG call
 struct message_ref
 {
-    std::time_t timestamp;
+    rlog::timestamp timestamp; // nanosecond resolution, converts to std::time_t
     rlog::location const* location;
     rlog::domain_info const* domain;
     rlog::verbosity::type verbosity;
+    uint16_t thread_id = 0; // dense id of the logging thread, 0 if unknown (see rlog::get_current_thread_id)
     cc::string_view thread_name;
     cc::string_view message;
+    cc::span<rlog::field const> fields; // typed key/value pairs of structured messages (see LOGS), empty otherwise
 };
 }
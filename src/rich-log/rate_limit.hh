@@ -1,11 +1,18 @@
 #pragma once
 
-#include <limits>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include <clean-core/macros.hh>
 
 namespace rlog::rate
 {
 // once, once_per_sec etc
 // usable per invoc, static etc
+//
+// all built-in limiters are thread-safe and lock-free
+// they are 'final', so the LOG macros call try_log without virtual dispatch (see rlog::detail::pass_rate_limit)
 
 struct log_rate_limiter
 {
@@ -14,6 +21,20 @@ struct log_rate_limiter
     virtual ~log_rate_limiter() = default;
 };
 
+namespace detail
+{
+/// monotonic time in nanoseconds
+inline int64_t now_ticks()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// longest interval (about 31 years), longer ones (and infinity) are clamped to it so that tick arithmetic cannot overflow
+constexpr int64_t max_ticks = int64_t(1e18);
+
+inline int64_t seconds_to_ticks(double seconds) { return seconds < 1e9 ? int64_t(seconds * 1e9) : max_ticks; }
+}
+
 /// example usage:
 ///
 ///   // will warn once globally
@@ -31,18 +52,106 @@ struct log_rate_limiter
 ///       }
 ///   }
 ///
-struct once : log_rate_limiter
+struct once final : log_rate_limiter
+{
+    std::atomic<bool> was_logged = {false};
+
+    bool try_log() override
+    {
+        // fast path: a single load once the message was logged
+        if (was_logged.load(std::memory_order_relaxed))
+            return false;
+
+        return !was_logged.exchange(true, std::memory_order_relaxed);
+    }
+};
+
+/// logs at most once per interval
+/// e.g. static rlog::rate::time_limited _limit{5.0}; // every 5 seconds
+struct time_limited final : log_rate_limiter
+{
+    /// NOTE: must not be changed while other threads call try_log
+    double interval_sec;
+    std::atomic<int64_t> next_allowed_tick = {INT64_MIN};
+
+    explicit time_limited(double interval_sec = 1) : interval_sec(interval_sec) {}
+
+    bool try_log() override
+    {
+        auto const now = detail::now_ticks();
+        auto next = next_allowed_tick.load(std::memory_order_relaxed);
+        if (now < next)
+            return false;
+
+        // exactly one thread wins per interval
+        return next_allowed_tick.compare_exchange_strong(next, now + detail::seconds_to_ticks(interval_sec), std::memory_order_relaxed);
+    }
+};
+
+/// allows bursts of up to 'burst' messages, refilled at 'per_second' messages per second
+/// e.g. static rlog::rate::token_bucket _limit{10, 1.0}; // 10 messages at once, then one per second
+///
+/// implemented as GCRA (generic cell rate algorithm), i.e. a single atomic "theoretical arrival time"
+///
+/// NOTE: burst must be at least 1 and per_second positive (asserted, release builds clamp burst to 1 and never refill)
+struct token_bucket final : log_rate_limiter
 {
-    bool was_logged = false;
+    int64_t const emission_interval; // ticks per token
+    int64_t const burst_tolerance;   // how far the arrival time may run ahead of now
+    std::atomic<int64_t> arrival_tick = {INT64_MIN};
+
+    token_bucket(int burst, double per_second)
+      : emission_interval(detail::seconds_to_ticks(per_second > 0 ? 1.0 / per_second : 1e9)),
+        burst_tolerance(detail::seconds_to_ticks(double(burst > 1 ? burst - 1 : 0) * double(emission_interval) / 1e9))
+    {
+        CC_ASSERT(burst >= 1 && "burst must be at least 1");
+        CC_ASSERT(per_second > 0 && "rate must be positive");
+    }
+
+    bool try_log() override
+    {
+        auto const now = detail::now_ticks();
+        auto tat = arrival_tick.load(std::memory_order_relaxed);
+        while (true)
+        {
+            auto const start = tat < now ? now : tat;
+            if (start - now > burst_tolerance)
+                return false;
 
-    bool try_log() override;
+            if (arrival_tick.compare_exchange_weak(tat, start + emission_interval, std::memory_order_relaxed))
+                return true;
+        }
+    }
 };
 
-struct time_limited : log_rate_limiter
+/// logs the 1st, (n+1)th, (2n+1)th, ... message
+/// NOTE: n must be at least 1 (asserted, release builds log every message for 0)
+struct every_nth final : log_rate_limiter
 {
-    double interval_sec = 1;
-    double last_fired = std::numeric_limits<double>::lowest();
+    uint64_t const n;
+    std::atomic<uint64_t> counter = {0};
+
+    explicit every_nth(uint64_t n) : n(n > 0 ? n : 1) { CC_ASSERT(n > 0 && "n must be at least 1"); }
+
+    bool try_log() override { return counter.fetch_add(1, std::memory_order_relaxed) % n == 0; }
+};
+
+/// logs the 1st, 2nd, 4th, 8th, ... message
+/// if max_period is not 0, the gap stops growing at max_period (i.e. then every max_period-th message is logged)
+struct exponential_backoff final : log_rate_limiter
+{
+    uint64_t const max_period;
+    std::atomic<uint64_t> counter = {0};
+
+    explicit exponential_backoff(uint64_t max_period = 0) : max_period(max_period) {}
+
+    bool try_log() override
+    {
+        auto const i = counter.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (max_period != 0 && i > max_period)
+            return i % max_period == 0;
 
-    bool try_log() override;
+        return (i & (i - 1)) == 0; // power of two
+    }
 };
 }
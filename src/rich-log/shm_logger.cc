@@ -0,0 +1,648 @@
+#include "shm_logger.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+#include <clean-core/macros.hh>
+#include <clean-core/utility.hh>
+#include <clean-core/vector.hh>
+
+#include <rich-log/detail/binary_format.hh>
+#include <rich-log/detail/id_table.hh>
+#include <rich-log/detail/shm_format.hh>
+#include <rich-log/domain.hh>
+#include <rich-log/location.hh>
+#include <rich-log/timestamp.hh>
+
+#ifdef CC_OS_WINDOWS
+#include <clean-core/native/win32_sanitized.hh>
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace bf = rlog::detail::binary_format;
+namespace sf = rlog::detail::shm_format;
+using rlog::detail::id_table;
+using rlog::detail::thread_name_table;
+
+namespace
+{
+constexpr size_t min_ring_size = 64 * 1024;
+constexpr size_t header_size = bf::align_record_size(sizeof(sf::segment_header)) + 64; // keeps the definitions cache-line aligned
+
+// a named shared-memory segment mapped into memory
+struct shared_segment
+{
+    std::byte* data = nullptr;
+    size_t size = 0;
+#ifdef CC_OS_WINDOWS
+    ::HANDLE mapping = nullptr;
+#endif
+};
+
+cc::string get_segment_name(char const* name)
+{
+#ifdef CC_OS_WINDOWS
+    cc::string s = "Local\\rlog-";
+#else
+    cc::string s = "/rlog-";
+#endif
+    s += name;
+    return s;
+}
+
+// creates (or replaces) the segment, zero-filled
+bool create_segment(shared_segment& seg, char const* name, size_t size)
+{
+    auto const segment_name = get_segment_name(name);
+#ifdef CC_OS_WINDOWS
+    auto const size_high = ::DWORD(uint64_t(size) >> 32);
+    auto const size_low = ::DWORD(size & 0xFFFFFFFF);
+    seg.mapping = ::CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, size_high, size_low, segment_name.c_str());
+    if (seg.mapping == nullptr)
+        return false;
+
+    seg.data = static_cast<std::byte*>(::MapViewOfFile(seg.mapping, FILE_MAP_ALL_ACCESS, 0, 0, size));
+    if (seg.data == nullptr)
+    {
+        ::CloseHandle(seg.mapping);
+        return false;
+    }
+#else
+    // a reader might still map the old segment, it keeps its memory until it is done
+    ::shm_unlink(segment_name.c_str());
+
+    auto const fd = ::shm_open(segment_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        return false;
+
+    auto const data = ::ftruncate(fd, off_t(size)) == 0 ? ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        ::shm_unlink(segment_name.c_str());
+        return false;
+    }
+
+    seg.data = static_cast<std::byte*>(data);
+#endif
+
+    seg.size = size;
+    return true;
+}
+
+bool open_segment(shared_segment& seg, char const* name)
+{
+    auto const segment_name = get_segment_name(name);
+#ifdef CC_OS_WINDOWS
+    seg.mapping = ::OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, segment_name.c_str());
+    if (seg.mapping == nullptr)
+        return false;
+
+    seg.data = static_cast<std::byte*>(::MapViewOfFile(seg.mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+    ::MEMORY_BASIC_INFORMATION info = {};
+    if (seg.data == nullptr || ::VirtualQuery(seg.data, &info, sizeof(info)) == 0)
+    {
+        if (seg.data != nullptr)
+            ::UnmapViewOfFile(seg.data);
+        ::CloseHandle(seg.mapping);
+        seg.data = nullptr;
+        return false;
+    }
+    seg.size = info.RegionSize;
+#else
+    auto const fd = ::shm_open(segment_name.c_str(), O_RDWR, 0600);
+    if (fd < 0)
+        return false;
+
+    struct stat st = {};
+    auto const data = ::fstat(fd, &st) == 0 && st.st_size > 0 //
+                          ? ::mmap(nullptr, size_t(st.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                          : MAP_FAILED;
+    ::close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    seg.data = static_cast<std::byte*>(data);
+    seg.size = size_t(st.st_size);
+#endif
+    return true;
+}
+
+void close_segment(shared_segment& seg)
+{
+    if (seg.data == nullptr)
+        return;
+
+#ifdef CC_OS_WINDOWS
+    ::UnmapViewOfFile(seg.data);
+    ::CloseHandle(seg.mapping);
+#else
+    ::munmap(seg.data, seg.size);
+#endif
+    seg.data = nullptr;
+}
+
+int64_t get_process_id()
+{
+#ifdef CC_OS_WINDOWS
+    return int64_t(::GetCurrentProcessId());
+#else
+    return int64_t(::getpid());
+#endif
+}
+
+bool is_process_alive(int64_t pid)
+{
+#ifdef CC_OS_WINDOWS
+    auto const process = ::OpenProcess(SYNCHRONIZE, FALSE, ::DWORD(pid));
+    if (process == nullptr)
+        return false;
+    auto const alive = ::WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    ::CloseHandle(process);
+    return alive;
+#else
+    return ::kill(pid_t(pid), 0) == 0 || errno == EPERM;
+#endif
+}
+
+size_t round_up_to_power_of_two(size_t v)
+{
+    size_t p = 1;
+    while (p < v)
+        p <<= 1;
+    return p;
+}
+
+bf::record_prefix load_prefix(std::byte* record)
+{
+    auto const word = sf::prefix_word(record).load(std::memory_order_acquire);
+    bf::record_prefix prefix;
+    std::memcpy(&prefix, &word, sizeof(prefix));
+    return prefix;
+}
+
+void store_prefix(std::byte* record, bf::record_prefix const& prefix, std::memory_order order)
+{
+    uint64_t word;
+    std::memcpy(&word, &prefix, sizeof(word));
+    sf::prefix_word(record).store(word, order);
+}
+
+uint32_t id_of(id_table::entry const* e) { return e ? e->id.load(std::memory_order_relaxed) : bf::unknown_id; }
+
+uint16_t domain_id_of(id_table::entry const* e)
+{
+    auto const id = id_of(e);
+    return id < bf::unknown_domain_id ? uint16_t(id) : bf::unknown_domain_id;
+}
+}
+
+struct rlog::shm_logger::state
+{
+    shm_config config;
+    shared_segment segment;
+    sf::segment_header* header = nullptr;
+    std::byte* definitions = nullptr;
+    std::byte* ring = nullptr;
+    uint64_t ring_mask = 0;
+    size_t max_message_size = 0;
+
+    id_table domains{1 << 10}; // ids must fit into record_prefix::domain_id
+    id_table locations{1 << 14};
+    thread_name_table threads;
+    std::atomic<uint32_t> next_domain_id = {1};
+    std::atomic<uint32_t> next_location_id = {0};
+
+    // definitions are rare (once per id), so they are appended under a lock
+    // readers see them in order up to definitions_pos
+    std::mutex definitions_mutex;
+
+    // appends a definition record, returns the id or unknown_id if the definitions area is full
+    uint32_t define(bf::record_kind kind, uint32_t id, int32_t line, char const* s0, char const* s1 = nullptr)
+    {
+        auto const size = sizeof(bf::definition_record) + std::strlen(s0) + 1 + (s1 ? std::strlen(s1) + 1 : 0);
+
+        auto _ = std::lock_guard<std::mutex>(definitions_mutex);
+        auto const pos = header->definitions_pos.load(std::memory_order_relaxed);
+        if (pos + bf::align_record_size(size) > header->definitions_size)
+            return bf::unknown_id;
+
+        auto const dst = definitions + pos;
+        auto p = dst + sizeof(bf::definition_record);
+        for (auto s : {s0, s1})
+            if (s != nullptr)
+            {
+                auto const len = std::strlen(s) + 1;
+                std::memcpy(p, s, len);
+                p += len;
+            }
+
+        bf::definition_record def = {};
+        def.prefix.size = uint32_t(size);
+        def.prefix.kind = kind;
+        def.id = id;
+        def.line = line;
+        std::memcpy(dst, &def, sizeof(def));
+
+        header->definitions_pos.store(pos + bf::align_record_size(size), std::memory_order_release);
+        return id;
+    }
+};
+
+rlog::shm_logger::shm_logger(shm_config config) : _state(cc::make_unique<state>())
+{
+    auto& s = *_state;
+    s.config = cc::move(config);
+
+    auto const ring_size = round_up_to_power_of_two(cc::max(s.config.ring_size, min_ring_size));
+    auto const definitions_size = bf::align_record_size(s.config.definitions_size);
+    if (!create_segment(s.segment, s.config.name.c_str(), header_size + definitions_size + ring_size))
+    {
+        std::fprintf(stderr, "[rich-log] unable to create shared-memory segment '%s'\n", s.config.name.c_str());
+        return;
+    }
+
+    s.header = new (s.segment.data) sf::segment_header{};
+    s.header->version = sf::version;
+    s.header->header_size = uint32_t(header_size);
+    s.header->definitions_size = definitions_size;
+    s.header->ring_size = ring_size;
+    s.header->producer_pid = get_process_id();
+    s.header->created_wall_ns = rlog::get_current_timestamp().wall_ns;
+
+    // readers only accept the segment once the magic is there
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(s.header->magic, sf::magic, sizeof(sf::magic));
+
+    s.definitions = s.segment.data + header_size;
+    s.ring = s.definitions + definitions_size;
+    s.ring_mask = ring_size - 1;
+    s.max_message_size = ring_size / 4;
+}
+
+rlog::shm_logger::~shm_logger()
+{
+    auto& s = *_state;
+    if (s.header == nullptr)
+        return;
+
+    // the segment itself stays, so a reader can still get everything
+    s.header->is_closed.store(1, std::memory_order_release);
+    close_segment(s.segment);
+}
+
+bool rlog::shm_logger::is_valid() const { return _state->header != nullptr; }
+
+uint64_t rlog::shm_logger::dropped_count() const
+{
+    return _state->header ? _state->header->dropped_messages.load(std::memory_order_relaxed) : 0;
+}
+
+void rlog::shm_logger::write(message_ref const& msg)
+{
+    auto& s = *_state;
+    if (s.header == nullptr)
+        return;
+
+    // thread names are not null-terminated
+    char thread_name[64];
+    auto const thread_name_size = cc::min(msg.thread_name.size(), sizeof(thread_name) - 1);
+    std::memcpy(thread_name, msg.thread_name.data(), thread_name_size);
+    thread_name[thread_name_size] = '\0';
+
+    // resolve ids, first use writes the definition (before any other thread can use the id)
+    // domains are keyed by registration id, the address of an unloaded domain might be reused
+    auto const registration_id = msg.domain ? msg.domain->registration_id : 0u;
+    auto const define_domain = [&]
+    { return s.define(bf::kind_domain, s.next_domain_id.fetch_add(1), 0, msg.domain->name, msg.domain->ansi_color_code); };
+    auto const define_location = [&]
+    {
+        auto const l = msg.location;
+        return s.define(bf::kind_location, s.next_location_id.fetch_add(1), l->line, l->function, l->file);
+    };
+    auto const thread_id = thread_name_table::thread_id_of(msg);
+    auto const define_thread = [&](uint16_t version) { s.define(bf::kind_thread, thread_id, version, thread_name); };
+
+    auto const domain = registration_id != 0 ? s.domains.find_or_insert(registration_id, define_domain) : nullptr;
+    // addresses of sites are reused when a module is unloaded and loaded again, so location ids are stamped with the registration id
+    // (a site always logs to the same domain, which gets a new registration id when its module is loaded again)
+    auto const location = msg.location ? s.locations.find_or_insert(uint64_t(uintptr_t(msg.location)), define_location, registration_id) : nullptr;
+    auto const thread_version = s.threads.get_version(msg, define_thread);
+
+    auto const message_size = cc::min(msg.message.size(), s.max_message_size);
+    auto const record_size = sizeof(bf::message_record) + message_size;
+    auto const size = uint64_t(bf::align_record_size(record_size));
+    auto const ring_size = s.ring_mask + 1;
+    auto& h = *s.header;
+
+    // reserve space (including padding up to the end of the ring if the record does not fit before it)
+    auto pos = h.write_pos.load(std::memory_order_relaxed);
+    auto padding = uint64_t(0);
+    while (true)
+    {
+        auto const offset = pos & s.ring_mask;
+        padding = offset + size > ring_size ? ring_size - offset : 0;
+
+        // the reader zeroes records before it releases their space
+        auto const read_pos = h.read_pos.load(std::memory_order_acquire);
+        if (pos + padding + size - read_pos > ring_size)
+        {
+            h.dropped_messages.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        if (h.write_pos.compare_exchange_weak(pos, pos + padding + size, std::memory_order_relaxed))
+            break;
+    }
+
+    if (padding > 0)
+    {
+        bf::record_prefix prefix = {};
+        prefix.size = uint32_t(padding);
+        prefix.kind = sf::kind_padding;
+        store_prefix(s.ring + (pos & s.ring_mask), prefix, std::memory_order_release);
+    }
+
+    auto const dst = s.ring + ((pos + padding) & s.ring_mask);
+
+    // the size is known right away, so a reader can skip the record if this process dies while writing it
+    bf::record_prefix prefix = {};
+    prefix.size = uint32_t(record_size);
+    prefix.kind = sf::kind_reserved;
+    store_prefix(dst, prefix, std::memory_order_relaxed);
+
+    auto const location_id = id_of(location);
+    std::memcpy(dst + offsetof(bf::message_record, wall_ns), &msg.timestamp.wall_ns, sizeof(int64_t));
+    std::memcpy(dst + offsetof(bf::message_record, location_id), &location_id, sizeof(uint32_t));
+    std::memcpy(dst + offsetof(bf::message_record, thread_id), &thread_id, sizeof(uint16_t));
+    std::memcpy(dst + offsetof(bf::message_record, thread_name_version), &thread_version, sizeof(uint16_t));
+    std::memcpy(dst + sizeof(bf::message_record), msg.message.data(), message_size);
+
+    prefix.kind = bf::kind_message;
+    prefix.verbosity = uint8_t(msg.verbosity);
+    prefix.domain_id = domain_id_of(domain);
+    store_prefix(dst, prefix, std::memory_order_release);
+}
+
+rlog::logger_fun rlog::make_shm_logger(shm_config config)
+{
+    return [logger = cc::make_unique<shm_logger>(cc::move(config))](message_ref msg, bool&)
+    {
+        logger->write(msg);
+        return true;
+    };
+}
+
+struct rlog::shm_reader::state
+{
+    cc::string name;
+    shared_segment segment;
+    sf::segment_header* header = nullptr;
+    std::byte* definitions = nullptr;
+    std::byte* ring = nullptr;
+    uint64_t ring_mask = 0;
+
+    struct location_def
+    {
+        char const* function = "";
+        char const* file = "";
+        int line = 0;
+        bool is_defined = false;
+    };
+
+    struct domain_def
+    {
+        char const* name = "";
+        char const* ansi_color_code = "";
+        bool is_defined = false;
+    };
+
+    // strings point into the definitions area, which is never overwritten
+    cc::vector<domain_def> domains;
+    cc::vector<location_def> locations;
+    cc::vector<cc::vector<char const*>> thread_names; // by thread id and name version, nullptr if not defined
+    uint64_t definitions_read = 0;
+
+    // the strings of a definition, null-terminated within the record
+    static char const* definition_string(std::byte const* record, uint32_t size, size_t index)
+    {
+        auto s = reinterpret_cast<char const*>(record + sizeof(bf::definition_record));
+        auto const end = reinterpret_cast<char const*>(record + size);
+        for (; s < end; --index)
+        {
+            auto const terminator = static_cast<char const*>(std::memchr(s, '\0', size_t(end - s)));
+            if (terminator == nullptr)
+                break;
+            if (index == 0)
+                return s;
+            s = terminator + 1;
+        }
+        return "";
+    }
+
+    // reads the definitions that were added since the last call
+    void read_definitions()
+    {
+        constexpr uint32_t max_id = 1 << 24; // protection against corrupt segments
+
+        auto const end = cc::min(header->definitions_pos.load(std::memory_order_acquire), header->definitions_size);
+        while (definitions_read + sizeof(bf::definition_record) <= end)
+        {
+            auto const record = definitions + definitions_read;
+            bf::definition_record def;
+            std::memcpy(&def, record, sizeof(def));
+            if (def.prefix.size < sizeof(def) || definitions_read + def.prefix.size > end)
+                break; // corrupt
+
+            definitions_read += bf::align_record_size(def.prefix.size);
+            if (def.id >= max_id)
+                continue;
+
+            switch (def.prefix.kind)
+            {
+            case bf::kind_domain:
+                if (domains.size() <= def.id)
+                    domains.resize(def.id + 1);
+                domains[def.id] = {definition_string(record, def.prefix.size, 0), definition_string(record, def.prefix.size, 1), true};
+                break;
+            case bf::kind_location:
+                if (locations.size() <= def.id)
+                    locations.resize(def.id + 1);
+                locations[def.id] = {definition_string(record, def.prefix.size, 0), definition_string(record, def.prefix.size, 1), def.line, true};
+                break;
+            case bf::kind_thread:
+            {
+                if (def.id >= rlog::max_thread_ids || def.line <= 0 || def.line > 0xFFFF)
+                    break;
+
+                if (thread_names.size() <= def.id)
+                    thread_names.resize(def.id + 1);
+                auto& versions = thread_names[def.id];
+                if (versions.size() <= size_t(def.line))
+                    versions.resize(def.line + 1);
+                versions[def.line] = definition_string(record, def.prefix.size, 0);
+                break;
+            }
+            default: // unknown records are skipped
+                break;
+            }
+        }
+    }
+
+    // true if a message uses an id whose definition was not read yet
+    bool has_undefined_ids(bf::record_prefix const& prefix, bf::message_record const& m) const
+    {
+        auto const is_missing_location = m.location_id != bf::unknown_id
+                                         && (m.location_id >= locations.size() || !locations[m.location_id].is_defined);
+        auto const is_missing_domain = prefix.domain_id != 0 && prefix.domain_id != bf::unknown_domain_id
+                                       && (prefix.domain_id >= domains.size() || !domains[prefix.domain_id].is_defined);
+        auto const is_missing_thread = m.thread_name_version != bf::unnamed_thread_version && thread_name_of(m) == nullptr;
+        return is_missing_location || is_missing_domain || is_missing_thread;
+    }
+
+    // nullptr if not defined
+    char const* thread_name_of(bf::message_record const& m) const
+    {
+        if (m.thread_id >= thread_names.size() || m.thread_name_version >= thread_names[m.thread_id].size())
+            return nullptr;
+        return thread_names[m.thread_id][m.thread_name_version];
+    }
+
+    bool try_open()
+    {
+        if (!open_segment(segment, name.c_str()))
+            return false;
+
+        auto const h = reinterpret_cast<sf::segment_header*>(segment.data);
+        auto const is_valid = segment.size >= sizeof(sf::segment_header) && std::memcmp(h->magic, sf::magic, sizeof(sf::magic)) == 0
+                              && h->version == sf::version && h->ring_size > 0 && (h->ring_size & (h->ring_size - 1)) == 0
+                              && uint64_t(h->header_size) + h->definitions_size + h->ring_size <= segment.size;
+        if (!is_valid)
+        {
+            close_segment(segment);
+            return false;
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        header = h;
+        definitions = segment.data + h->header_size;
+        ring = definitions + h->definitions_size;
+        ring_mask = h->ring_size - 1;
+        return true;
+    }
+};
+
+rlog::shm_reader::shm_reader(char const* name) : _state(cc::make_unique<state>())
+{
+    _state->name = name;
+    _state->try_open();
+}
+
+rlog::shm_reader::~shm_reader() { close_segment(_state->segment); }
+
+bool rlog::shm_reader::is_valid() const { return _state->header != nullptr; }
+
+bool rlog::shm_reader::is_producer_done() const
+{
+    auto const h = _state->header;
+    return h == nullptr || h->is_closed.load(std::memory_order_acquire) != 0 || !is_process_alive(h->producer_pid);
+}
+
+uint64_t rlog::shm_reader::dropped_count() const
+{
+    return _state->header ? _state->header->dropped_messages.load(std::memory_order_relaxed) : 0;
+}
+
+void rlog::shm_reader::remove_segment()
+{
+#ifndef CC_OS_WINDOWS
+    ::shm_unlink(get_segment_name(_state->name.c_str()).c_str());
+#endif
+}
+
+size_t rlog::shm_reader::read(cc::function_ref<void(message_ref const&)> on_message)
+{
+    auto& s = *_state;
+    if (s.header == nullptr && !s.try_open())
+        return 0;
+
+    auto& h = *s.header;
+    auto const ring_size = s.ring_mask + 1;
+    auto const write_pos = h.write_pos.load(std::memory_order_acquire);
+    auto read_pos = h.read_pos.load(std::memory_order_relaxed);
+    auto is_producer_done = false;
+    auto checked_producer = false;
+    size_t count = 0;
+
+    while (read_pos < write_pos)
+    {
+        auto const offset = read_pos & s.ring_mask;
+        auto const record = s.ring + offset;
+        auto const prefix = load_prefix(record);
+        auto const size = uint64_t(bf::align_record_size(prefix.size));
+        if (prefix.size == 0 || size > ring_size - offset)
+            break; // not written yet (or corrupt)
+
+        if (prefix.kind == sf::kind_reserved)
+        {
+            // still being written, unless the producer died in the middle of it
+            if (!checked_producer)
+            {
+                is_producer_done = this->is_producer_done();
+                checked_producer = true;
+            }
+            if (!is_producer_done)
+                break;
+        }
+        else if (prefix.kind == bf::kind_message && prefix.size >= sizeof(bf::message_record))
+        {
+            bf::message_record m;
+            std::memcpy(&m, record, sizeof(m));
+
+            // definitions are published before the messages that use them
+            if (s.has_undefined_ids(prefix, m))
+                s.read_definitions();
+
+            auto const loc_def = m.location_id < s.locations.size() ? s.locations[m.location_id] : state::location_def{};
+            rlog::location loc = {loc_def.function, loc_def.file, loc_def.line};
+
+            auto const dom_def = prefix.domain_id < s.domains.size() ? s.domains[prefix.domain_id] : state::domain_def{"?", ""};
+            domain_info domain;
+            domain.name = dom_def.name;
+            domain.ansi_color_code = dom_def.ansi_color_code;
+
+            message_ref msg;
+            msg.timestamp.wall_ns = m.wall_ns;
+            msg.location = &loc;
+            msg.domain = &domain;
+            msg.verbosity = prefix.verbosity < verbosity::_count ? verbosity::type(prefix.verbosity) : verbosity::Fatal;
+            msg.thread_id = m.thread_id;
+            if (auto const thread_name = s.thread_name_of(m))
+                msg.thread_name = thread_name;
+            msg.message = cc::string_view(reinterpret_cast<char const*>(record + sizeof(m)), prefix.size - sizeof(m));
+
+            if (cc::string_view(msg.domain->name) == Log::Default::domain.name)
+                msg.domain = &Log::Default::domain;
+
+            on_message(msg);
+            ++count;
+        }
+        // padding and unknown records are skipped
+
+        // producers expect free space to be zeroed
+        std::memset(record, 0, size_t(size));
+        read_pos += size;
+        h.read_pos.store(read_pos, std::memory_order_release);
+    }
+
+    return count;
+}
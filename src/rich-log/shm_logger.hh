@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <clean-core/function_ref.hh>
+#include <clean-core/string.hh>
+#include <clean-core/unique_ptr.hh>
+
+#include <rich-log/detail/api.hh>
+#include <rich-log/logger.hh>
+#include <rich-log/message.hh>
+#include <rich-log/sink.hh>
+
+/**
+ * log transport through shared memory, for collecting logs in a separate process
+ *
+ * the logging process publishes compact binary records into a lock-free ring buffer in a named shared-memory segment
+ * a collector (e.g. the rlog-tail tool, or any program using shm_reader) formats them, writes them to disk, or forwards them
+ * the strings of domains, locations, and threads are only sent once, messages refer to them by id
+ * (threads by their thread id and a version of their name, which changes when the thread renames itself)
+ * (see detail/shm_format.hh for the layout)
+ *
+ * Usage:
+ *
+ *   // in the latency-critical process
+ *   rlog::add_sink(cc::make_unique<rlog::shm_sink>(rlog::shm_config{"my-server"}));
+ *
+ *   // in a terminal
+ *   rlog-tail my-server
+ *
+ *   // or in a collector process
+ *   rlog::shm_reader reader("my-server");
+ *   while (!reader.is_producer_done())
+ *       if (reader.read([](rlog::message_ref const& msg) { ... }) == 0)
+ *           sleep_a_bit();
+ *
+ * writing a message is a CAS and a copy of the message text, there are no syscalls or line formatting
+ * and no locks (except on the first use of a domain, location, or thread, when its definition is appended)
+ * the segment outlives the process, so a collector still gets everything that was written before a crash
+ *
+ * NOTE: on POSIX, the segment is /dev/shm/rlog-<name> (shm_open), rlog-tail removes it once it read everything of a finished producer
+ *       on Windows, the segment only exists while the producer or a reader has it open
+ * NOTE: messages are dropped if the ring is full, i.e. if the collector is too slow or not running (see dropped_count)
+ * NOTE: there must be only one reader per segment at a time
+ */
+
+namespace rlog
+{
+struct shm_config
+{
+    /// name of the segment, shared by producer and reader
+    /// NOTE: an existing segment with the same name is replaced
+    cc::string name = "rlog";
+
+    /// size of the ring buffer in bytes (rounded up to a power of two)
+    /// should hold the messages of the longest expected stall of the collector
+    size_t ring_size = 4u << 20;
+
+    /// size of the area for domain, location, and thread definitions
+    /// ids that do not fit anymore are sent as unknown
+    size_t definitions_size = 1u << 20;
+};
+
+/// writes messages into a shared-memory segment, thread-safe and lock-free
+class RLOG_API shm_logger
+{
+public:
+    explicit shm_logger(shm_config config);
+    ~shm_logger();
+
+    /// false if the segment could not be created
+    bool is_valid() const;
+
+    /// writes a single message, thread-safe
+    void write(message_ref const& msg);
+
+    /// number of messages dropped because the ring was full
+    uint64_t dropped_count() const;
+
+    shm_logger(shm_logger&&) = delete;
+    shm_logger& operator=(shm_logger&&) = delete;
+    shm_logger(shm_logger const&) = delete;
+    shm_logger& operator=(shm_logger const&) = delete;
+
+private:
+    struct state;
+    cc::unique_ptr<state> _state;
+};
+
+/// shm_logger as a sink (see sink.hh)
+class RLOG_API shm_sink final : public sink
+{
+public:
+    explicit shm_sink(shm_config config) : _logger(cc::move(config)) {}
+
+    void write(message_ref const& msg) override { _logger.write(msg); }
+
+private:
+    shm_logger _logger;
+};
+
+/// creates a logger that writes all messages into a shared-memory segment and consumes them
+RLOG_API logger_fun make_shm_logger(shm_config config);
+
+/// reads the messages of a segment written by shm_logger (the consumer side)
+class RLOG_API shm_reader
+{
+public:
+    /// opens the segment with the given name (see shm_config::name)
+    explicit shm_reader(char const* name);
+    ~shm_reader();
+
+    /// false if there is no such segment (yet)
+    bool is_valid() const;
+
+    /// calls on_message for all messages that were completely written since the last call, in ring order
+    /// the message_refs are reconstructed from the definitions in the segment, the Default domain maps to Log::Default::domain
+    /// returns the number of messages
+    size_t read(cc::function_ref<void(message_ref const&)> on_message);
+
+    /// true if the producer was destroyed or its process no longer exists
+    /// NOTE: call read() afterwards to get the remaining messages
+    bool is_producer_done() const;
+
+    /// number of messages the producer dropped because the ring was full
+    uint64_t dropped_count() const;
+
+    /// removes the name of the segment, the memory is released once the producer and reader are gone
+    void remove_segment();
+
+    shm_reader(shm_reader&&) = delete;
+    shm_reader& operator=(shm_reader&&) = delete;
+    shm_reader(shm_reader const&) = delete;
+    shm_reader& operator=(shm_reader const&) = delete;
+
+private:
+    struct state;
+    cc::unique_ptr<state> _state;
+};
+}
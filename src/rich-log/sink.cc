@@ -0,0 +1,242 @@
+#include "sink.hh"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include <clean-core/string.hh>
+#include <clean-core/utility.hh>
+
+#include <rich-log/console.hh>
+#include <rich-log/log_line.hh>
+
+namespace
+{
+// slot 0 is reserved for the global logger bit
+constexpr int max_sinks = 64;
+
+struct sink_slot
+{
+    // read by dispatching threads
+    std::atomic<rlog::sink*> sink = {nullptr};
+    std::atomic<int> writers = {0};
+
+    // guarded by the registry mutex
+    cc::unique_ptr<rlog::sink> owner;
+    rlog::sink_filter filter;
+    bool is_removing = false; // remove_sink waits for the writers in flight, the slot cannot be reused yet
+};
+
+// true if 'domain' is 'filter' or one of its descendants, e.g. "Net" matches "Net::Http"
+// compares names, so the result does not depend on which intermediate domains are registered
+bool matches_filter_domain(rlog::domain_info const& domain, rlog::domain_info const* filter)
+{
+    if (filter == &domain)
+        return true;
+
+    auto const name = cc::string_view(domain.name);
+    auto const prefix = cc::string_view(filter->name);
+    return name.size() > prefix.size() + 2 && name.subview(0, prefix.size()) == prefix && name[prefix.size()] == ':'
+           && name[prefix.size() + 1] == ':';
+}
+
+struct sink_registry
+{
+    std::mutex mutex;
+    sink_slot slots[max_sinks];
+    std::atomic<int> sink_count = {0};
+    bool has_global_logger = false;
+
+    // must hold mutex
+    uint64_t compute_mask(rlog::domain_info const& domain, rlog::verbosity::type v) const
+    {
+        uint64_t mask = 0;
+
+        // the global logger (user-defined or built-in) gets everything
+        if (has_global_logger || sink_count == 0)
+            mask |= 1;
+
+        for (auto i = 1; i < max_sinks; ++i)
+        {
+            auto const& slot = slots[i];
+            if (slot.owner == nullptr || slot.is_removing || v < slot.filter.min_verbosity)
+                continue;
+
+            auto domain_match = slot.filter.domains.empty();
+            for (auto d : slot.filter.domains)
+                domain_match |= matches_filter_domain(domain, d);
+
+            if (domain_match)
+                mask |= uint64_t(1) << i;
+        }
+
+        return mask;
+    }
+
+    // must hold mutex
+    void update_mask(rlog::domain_info& domain) const
+    {
+        for (auto v = 0; v < rlog::verbosity::_count; ++v)
+            domain.sink_mask[v].store(compute_mask(domain, rlog::verbosity::type(v)), std::memory_order_relaxed);
+    }
+
+    // must hold mutex
+    void update_all_masks() const
+    {
+        for (auto d : rlog::get_domains())
+            update_mask(*d);
+    }
+};
+
+sink_registry& registry()
+{
+    static sink_registry r;
+    return r;
+}
+}
+
+rlog::sink_id rlog::add_sink(cc::unique_ptr<sink> s, sink_filter filter)
+{
+    CC_ASSERT(s != nullptr);
+
+    auto& r = registry();
+    auto _ = std::lock_guard<std::mutex>(r.mutex);
+
+    for (auto i = 1; i < max_sinks; ++i)
+    {
+        auto& slot = r.slots[i];
+        if (slot.owner != nullptr)
+            continue;
+
+        slot.filter = cc::move(filter);
+        slot.owner = cc::move(s);
+        slot.sink.store(slot.owner.get());
+        ++r.sink_count;
+
+        r.update_all_masks();
+        return i;
+    }
+
+    CC_ASSERT(false && "too many sinks");
+    return invalid_sink_id;
+}
+
+void rlog::remove_sink(sink_id id)
+{
+    CC_ASSERT(0 < id && id < max_sinks && "invalid sink id");
+    auto& r = registry();
+    auto& slot = r.slots[id];
+
+    // stop new writes
+    {
+        auto _ = std::lock_guard<std::mutex>(r.mutex);
+        CC_ASSERT(slot.owner != nullptr && !slot.is_removing && "invalid sink id");
+
+        slot.sink.store(nullptr);
+        slot.is_removing = true;
+        --r.sink_count;
+        r.update_all_masks();
+    }
+
+    // wait for the ones in flight without blocking the registry (e.g. for domains registered meanwhile)
+    while (slot.writers.load() != 0)
+        std::this_thread::yield();
+
+    // the sink is destroyed outside the lock, it might flush or log
+    cc::unique_ptr<sink> removed;
+    {
+        auto _ = std::lock_guard<std::mutex>(r.mutex);
+        removed = cc::move(slot.owner);
+        slot.filter = {};
+        slot.is_removing = false;
+    }
+}
+
+void rlog::set_sink_filter(sink_id id, sink_filter filter)
+{
+    auto& r = registry();
+    auto _ = std::lock_guard<std::mutex>(r.mutex);
+
+    CC_ASSERT(0 < id && id < max_sinks && r.slots[id].owner != nullptr && !r.slots[id].is_removing && "invalid sink id");
+    r.slots[id].filter = cc::move(filter);
+
+    r.update_all_masks();
+}
+
+void rlog::flush_sinks()
+{
+    auto& r = registry();
+
+    // registered as writers under the lock, so remove_sink waits for the flushes in flight (like for dispatch_to_sinks)
+    // (remove_sink clears the sink right away, so it is copied here as well)
+    sink_slot* slots[max_sinks];
+    rlog::sink* sinks[max_sinks];
+    auto count = 0;
+    {
+        auto _ = std::lock_guard<std::mutex>(r.mutex);
+        for (auto& slot : r.slots)
+            if (auto const s = slot.sink.load())
+            {
+                slot.writers.fetch_add(1);
+                slots[count] = &slot;
+                sinks[count] = s;
+                ++count;
+            }
+    }
+
+    // flushed outside the lock, a sink might log (e.g. a Fatal message, which flushes the sinks again)
+    for (auto i = 0; i < count; ++i)
+    {
+        sinks[i]->flush();
+        slots[i]->writers.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+bool rlog::detail::dispatch_to_sinks(message_ref const& msg)
+{
+    auto& r = registry();
+
+    // bit 0 is the global logger, which is handled by the caller
+    auto mask = msg.domain->sink_mask[msg.verbosity].load(std::memory_order_relaxed) >> 1;
+    for (auto i = 1; mask != 0; ++i, mask >>= 1)
+    {
+        if ((mask & 1) == 0)
+            continue;
+
+        // registering as writer before loading the sink pairs with remove_sink (which clears the sink, then waits)
+        auto& slot = r.slots[i];
+        slot.writers.fetch_add(1);
+        if (auto const s = slot.sink.load())
+            s->write(msg);
+        slot.writers.fetch_sub(1, std::memory_order_release);
+    }
+
+    return r.sink_count.load(std::memory_order_relaxed) > 0;
+}
+
+void rlog::detail::update_sink_mask(domain_info& domain)
+{
+    auto& r = registry();
+    auto _ = std::lock_guard<std::mutex>(r.mutex);
+    r.update_mask(domain);
+}
+
+void rlog::detail::set_has_global_logger(bool has_logger)
+{
+    auto& r = registry();
+    auto _ = std::lock_guard<std::mutex>(r.mutex);
+    r.has_global_logger = has_logger;
+    r.update_all_masks();
+}
+
+void rlog::console_sink::write(message_ref const& msg)
+{
+    thread_local cc::string line;
+    line.clear();
+    append_log_line(line, msg, _style);
+
+    auto const stream = msg.verbosity >= verbosity::Warning ? detail::console_stream::err : detail::console_stream::out;
+    detail::write_to_console(stream, line, msg.verbosity >= verbosity::Error);
+}
+
+void rlog::console_sink::flush() { console::flush(); }
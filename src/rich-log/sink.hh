@@ -0,0 +1,101 @@
+#pragma once
+
+#include <clean-core/unique_ptr.hh>
+#include <clean-core/vector.hh>
+
+#include <rich-log/detail/api.hh>
+#include <rich-log/domain.hh>
+#include <rich-log/logger.hh>
+#include <rich-log/message.hh>
+
+/**
+ * sinks are log destinations that are registered globally and receive messages in parallel (fan-out)
+ *
+ * Usage:
+ *
+ *   rlog::add_sink(cc::make_unique<rlog::console_sink>(rlog::console_log_style::brief));
+ *
+ *   rlog::sink_filter filter;
+ *   filter.min_verbosity = rlog::verbosity::Warning;
+ *   filter.domains = {&MyEngine::Log::Net::domain};
+ *   rlog::add_sink(cc::make_unique<MyCollectorSink>(...), filter);
+ *
+ * routing of a message:
+ *   - local loggers (see push_local_logger)
+ *   - the user-defined global default logger (see set_global_default_logger)
+ *   - all sinks whose filter matches the message
+ *   - the built-in default logger, but only if no sink is registered
+ *
+ * the registry keeps a per-(domain, verbosity) bitmask of interested sinks (domain_info::sink_mask)
+ * LOGs that no sink (and no logger) wants are dropped before they are formatted
+ */
+
+namespace rlog
+{
+/// base class of all sinks
+/// NOTE: write can be called from multiple threads at the same time (or from the async thread)
+struct sink
+{
+    /// the message is already filtered, formatting is up to the sink
+    virtual void write(message_ref const& msg) = 0;
+
+    /// called by flush_sinks
+    virtual void flush() {}
+
+    virtual ~sink() = default;
+};
+
+/// which messages a sink receives
+struct sink_filter
+{
+    verbosity::type min_verbosity = verbosity::Trace;
+
+    /// if not empty, only messages of these domains (and of their descendants, e.g. "Net::Http" for "Net") are passed to the sink
+    cc::vector<domain_info const*> domains;
+};
+
+/// up to 63 sinks can be registered at the same time
+using sink_id = int;
+constexpr sink_id invalid_sink_id = -1;
+
+/// registers a sink, returns invalid_sink_id if too many sinks are registered
+RLOG_API sink_id add_sink(cc::unique_ptr<sink> s, sink_filter filter = {});
+
+/// unregisters and destroys a sink
+/// waits until no thread is writing to the sink anymore (so it must not be called from within that sink)
+RLOG_API void remove_sink(sink_id id);
+
+/// changes which messages a sink receives
+RLOG_API void set_sink_filter(sink_id id, sink_filter filter);
+
+/// calls flush on all registered sinks
+/// the registry is not locked meanwhile, so a flush may log, and remove_sink waits for it
+RLOG_API void flush_sinks();
+
+/// writes lines in one of the console_log_style layouts to stdout (Warning and above to stderr)
+/// shares the console output (and its ordering and buffering, see console.hh) with the built-in default logger
+class RLOG_API console_sink final : public sink
+{
+public:
+    explicit console_sink(console_log_style style = console_log_style::brief) : _style(style) {}
+
+    void write(message_ref const& msg) override;
+    void flush() override;
+
+private:
+    console_log_style _style;
+};
+}
+
+namespace rlog::detail
+{
+/// passes the message to all interested sinks
+/// returns false if no sink is registered at all
+RLOG_API bool dispatch_to_sinks(message_ref const& msg);
+
+/// (re)computes domain.sink_mask, called when a domain is registered
+RLOG_API void update_sink_mask(domain_info& domain);
+
+/// called by set_global_default_logger, the global logger is interested in all messages
+RLOG_API void set_has_global_logger(bool has_logger);
+}
@@ -0,0 +1,226 @@
+#include "site_stats.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#include <rich-log/console.hh>
+
+std::atomic<bool> rlog::detail::g_site_stats_enabled = {false};
+
+namespace
+{
+// all sites that counted something, newest first
+// sites are added lock-free, but only removed (when their domain is unregistered) and visited under sites_mutex
+std::atomic<rlog::location*> g_first_site = {nullptr};
+
+// never destroyed, domains are also unregistered during static destruction
+std::mutex& sites_mutex()
+{
+    static auto const m = new std::mutex();
+    return *m;
+}
+
+// allocates the counters of a site and registers it the first time it counts something
+rlog::location_stats& get_stats(rlog::domain_info const& domain, rlog::location& loc)
+{
+    auto stats = loc.stats.load(std::memory_order_acquire);
+    if (stats != nullptr)
+        return *stats;
+
+    auto const fresh = new rlog::location_stats();
+    fresh->domain = &domain;
+    if (!loc.stats.compare_exchange_strong(stats, fresh, std::memory_order_acq_rel, std::memory_order_acquire))
+    {
+        delete fresh; // another thread registers it
+        return *stats;
+    }
+
+    auto head = g_first_site.load(std::memory_order_relaxed);
+    do
+    {
+        fresh->next.store(head, std::memory_order_relaxed);
+    } while (!g_first_site.compare_exchange_weak(head, &loc, std::memory_order_release, std::memory_order_relaxed));
+    return *fresh;
+}
+
+// only registered sites are visited, so their counters exist
+// must hold sites_mutex
+template <class F>
+void for_each_site(F&& f)
+{
+    for (auto loc = g_first_site.load(std::memory_order_acquire); loc != nullptr;
+         loc = loc->stats.load(std::memory_order_acquire)->next.load(std::memory_order_relaxed))
+        f(*loc);
+}
+
+// must hold sites_mutex
+void collect_stats(cc::vector<rlog::log_site_stats>& result)
+{
+    for_each_site(
+        [&](rlog::location const& loc)
+        {
+            auto const& s = *loc.stats.load(std::memory_order_acquire);
+            result.push_back({&loc, s.emitted.load(std::memory_order_relaxed), s.suppressed.load(std::memory_order_relaxed),
+                              s.filtered.load(std::memory_order_relaxed), s.bytes.load(std::memory_order_relaxed),
+                              s.ns.load(std::memory_order_relaxed)});
+        });
+
+    // most expensive first, ties (e.g. only filtered LOGs) by number of LOG calls
+    std::sort(result.begin(), result.end(),
+              [](rlog::log_site_stats const& a, rlog::log_site_stats const& b)
+              {
+                  if (a.ns != b.ns)
+                      return a.ns > b.ns;
+                  return a.emitted + a.suppressed + a.filtered > b.emitted + b.suppressed + b.filtered;
+              });
+}
+
+// file name without directories, so the table stays readable
+char const* short_file_name(char const* path)
+{
+    auto name = path;
+    for (auto p = path; *p != '\0'; ++p)
+        if (*p == '/' || *p == '\\')
+            name = p + 1;
+    return name;
+}
+}
+
+void rlog::enable_log_site_stats(bool enabled) { detail::g_site_stats_enabled.store(enabled, std::memory_order_relaxed); }
+
+bool rlog::is_log_site_stats_enabled() { return detail::is_collecting_site_stats(); }
+
+cc::vector<rlog::log_site_stats> rlog::get_log_site_stats()
+{
+    auto _ = std::lock_guard<std::mutex>(sites_mutex());
+
+    cc::vector<log_site_stats> result;
+    collect_stats(result);
+    return result;
+}
+
+void rlog::reset_log_site_stats()
+{
+    auto _ = std::lock_guard<std::mutex>(sites_mutex());
+    for_each_site(
+        [](location& loc)
+        {
+            auto& s = *loc.stats.load(std::memory_order_acquire);
+            s.emitted.store(0, std::memory_order_relaxed);
+            s.suppressed.store(0, std::memory_order_relaxed);
+            s.filtered.store(0, std::memory_order_relaxed);
+            s.bytes.store(0, std::memory_order_relaxed);
+            s.ns.store(0, std::memory_order_relaxed);
+        });
+}
+
+void rlog::append_log_hotspots(cc::string& out, size_t max_sites)
+{
+    // the names of the sites are only valid while they are registered
+    auto _ = std::lock_guard<std::mutex>(sites_mutex());
+
+    cc::vector<log_site_stats> stats;
+    collect_stats(stats);
+
+    char line[512];
+    auto const append = [&](int len) { out += cc::string_view(line, size_t(std::min(len, int(sizeof(line)) - 1))); };
+
+    append(std::snprintf(line, sizeof(line), "log hotspots (%zu site(s), sorted by time spent in LOG):\n", stats.size()));
+    append(std::snprintf(line, sizeof(line), "%12s %10s %10s %10s %12s  %s\n", "time [ms]", "emitted", "suppressed", "filtered", "bytes", "site"));
+
+    for (size_t i = 0; i < stats.size() && i < max_sites; ++i)
+    {
+        auto const& s = stats[i];
+        append(std::snprintf(line, sizeof(line), "%12.3f %10llu %10llu %10llu %12llu  %s:%d (%s)\n", double(s.ns) / 1e6, //
+                             (unsigned long long)s.emitted, (unsigned long long)s.suppressed, (unsigned long long)s.filtered,
+                             (unsigned long long)s.bytes, short_file_name(s.site->file), s.site->line, s.site->function));
+    }
+
+    if (stats.size() > max_sites)
+        append(std::snprintf(line, sizeof(line), "... and %zu more\n", stats.size() - max_sites));
+}
+
+void rlog::dump_log_hotspots(size_t max_sites)
+{
+    cc::string text;
+    append_log_hotspots(text, max_sites);
+    detail::write_to_console(detail::console_stream::out, text, true);
+}
+
+int rlog::set_site_break_on_log(char const* file, int line, bool enabled)
+{
+    auto const suffix = cc::string_view(file);
+    auto count = 0;
+    auto _ = std::lock_guard<std::mutex>(sites_mutex());
+    for_each_site(
+        [&](location& loc)
+        {
+            if (line != 0 && loc.line != line)
+                return;
+
+            // whole path components only, "socket.cc" must not match "websocket.cc"
+            auto const path = cc::string_view(loc.file);
+            if (path.size() < suffix.size() || path.subview(path.size() - suffix.size()) != suffix)
+                return;
+            auto const start = path.size() - suffix.size();
+            if (start > 0 && path[start - 1] != '/' && path[start - 1] != '\\')
+                return;
+
+            loc.break_on_log.store(enabled, std::memory_order_relaxed);
+            ++count;
+        });
+    return count;
+}
+
+void rlog::detail::count_suppressed(domain_info const& domain, location& loc)
+{
+    get_stats(domain, loc).suppressed.fetch_add(1, std::memory_order_relaxed);
+}
+
+void rlog::detail::count_filtered(domain_info const& domain, location& loc)
+{
+    get_stats(domain, loc).filtered.fetch_add(1, std::memory_order_relaxed);
+}
+
+void rlog::detail::count_emitted(domain_info const& domain, location& loc, uint64_t bytes, uint64_t ns)
+{
+    auto& s = get_stats(domain, loc);
+    s.emitted.fetch_add(1, std::memory_order_relaxed);
+    s.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    s.ns.fetch_add(ns, std::memory_order_relaxed);
+}
+
+void rlog::detail::remove_site_stats(domain_info const& domain)
+{
+    auto _ = std::lock_guard<std::mutex>(sites_mutex());
+
+    // only the head can change concurrently (new sites are added without the lock)
+    for (auto link = &g_first_site;;)
+    {
+        auto loc = link->load(std::memory_order_acquire);
+        if (loc == nullptr)
+            break;
+
+        auto const stats = loc->stats.load(std::memory_order_acquire);
+        if (stats->domain != &domain)
+        {
+            link = &stats->next;
+            continue;
+        }
+
+        auto const next = stats->next.load(std::memory_order_relaxed);
+        if (link == &g_first_site)
+        {
+            if (!g_first_site.compare_exchange_strong(loc, next, std::memory_order_acq_rel))
+                continue; // a new site was added in front, it is checked next
+        }
+        else
+            link->store(next, std::memory_order_release);
+
+        // the location is still there (its module's statics are being destroyed right now)
+        loc->stats.store(nullptr, std::memory_order_relaxed);
+        delete stats;
+    }
+}
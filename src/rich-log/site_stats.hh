@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <clean-core/string.hh>
+#include <clean-core/vector.hh>
+
+#include <rich-log/detail/api.hh>
+#include <rich-log/location.hh>
+
+/**
+ * per-site statistics: which LOG calls are responsible for how much logging
+ *
+ * every LOG site has its counters in a block that its static rlog::location points to (allocated when it counts for the first time)
+ * a site is registered in a global lock-free list the first time it counts something
+ *
+ * Usage:
+ *
+ *    rlog::enable_log_site_stats();
+ *
+ *    ... // run the workload
+ *
+ *    rlog::dump_log_hotspots(); // prints the 20 sites with the most time spent in LOG
+ *
+ *    for (auto const& s : rlog::get_log_site_stats())
+ *        if (s.emitted > 1000)
+ *            ...
+ *
+ * NOTE: collection is off by default, then the only cost is a relaxed load in LOGs that are filtered or rate-limited
+ *       when enabled, each emitted LOG also reads the clock twice
+ * NOTE: LOGs that are disabled at compile time are never counted
+ * NOTE: sites are removed (with their counters) when the domain they log to is unregistered, e.g. when a shared library is unloaded
+ */
+
+namespace rlog
+{
+/// a copy of the counters of a single LOG site (see location_stats)
+struct log_site_stats
+{
+    location const* site;
+    uint64_t emitted;
+    uint64_t suppressed;
+    uint64_t filtered;
+    uint64_t bytes;
+    uint64_t ns;
+};
+
+/// starts or stops collecting per-site statistics (counters are kept while disabled)
+RLOG_API void enable_log_site_stats(bool enabled = true);
+
+/// returns true if per-site statistics are being collected
+RLOG_API bool is_log_site_stats_enabled();
+
+/// returns the statistics of all sites that counted something, sorted by time spent (most expensive first)
+/// NOTE: log_site_stats::site is only valid as long as the domain of the site is registered
+RLOG_API cc::vector<log_site_stats> get_log_site_stats();
+
+/// sets all counters to zero
+RLOG_API void reset_log_site_stats();
+
+/// appends a table of the most expensive sites to 'out' (one line per site)
+RLOG_API void append_log_hotspots(cc::string& out, size_t max_sites = 20);
+
+/// writes the table of append_log_hotspots to stdout
+RLOG_API void dump_log_hotspots(size_t max_sites = 20);
+
+/// sets location::break_on_log of all known sites in the given file (a path suffix, e.g. "net/socket.cc") at the given line (any line if 0)
+/// returns the number of matching sites
+/// NOTE: only sites that counted something while collection was enabled are known
+RLOG_API int set_site_break_on_log(char const* file, int line, bool enabled);
+}
+
+namespace rlog::detail
+{
+/// NOTE: read in the LOG macros, use enable_log_site_stats to change it
+RLOG_API extern std::atomic<bool> g_site_stats_enabled;
+
+inline bool is_collecting_site_stats() { return g_site_stats_enabled.load(std::memory_order_relaxed); }
+
+/// counts a LOG that was rejected by its rate limiter
+RLOG_API void count_suppressed(domain_info const& domain, location& loc);
+
+/// counts a LOG that was below the runtime verbosity or that no logger wanted
+RLOG_API void count_filtered(domain_info const& domain, location& loc);
+
+/// counts a LOG that reached the loggers
+RLOG_API void count_emitted(domain_info const& domain, location& loc, uint64_t bytes, uint64_t ns);
+
+/// removes the sites that log to the domain (called when it is unregistered, its sites might go away with it)
+RLOG_API void remove_site_stats(domain_info const& domain);
+}
@@ -0,0 +1,250 @@
+#include "structured_sink.hh"
+
+#include <cmath>
+#include <cstdio>
+
+#include <rich-log/console.hh>
+#include <rich-log/log_line.hh>
+#include <rich-log/timestamp.hh>
+
+namespace
+{
+// RFC 3339 in UTC with nanoseconds, e.g. "2024-05-06T07:14:10.123456789Z"
+// computed from the timestamp alone (no gmtime, no locks)
+void append_utc_time(cc::string& out, rlog::timestamp t)
+{
+    auto const ns = t.subsecond_ns();
+    auto const seconds = (t.wall_ns - ns) / 1'000'000'000;
+    auto days = seconds / 86400;
+    auto const time_of_day = seconds - days * 86400;
+
+    // civil date from days since 1970-01-01 (http://howardhinnant.github.io/date_algorithms.html)
+    days += 719468;
+    auto const era = (days >= 0 ? days : days - 146096) / 146097;
+    auto const doe = days - era * 146097;
+    auto const yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    auto const doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    auto const mp = (5 * doy + 2) / 153;
+    auto const day = doy - (153 * mp + 2) / 5 + 1;
+    auto const month = mp < 10 ? mp + 3 : mp - 9;
+    auto const year = yoe + era * 400 + (month <= 2 ? 1 : 0);
+
+    char buffer[48];
+    auto const len = std::snprintf(buffer, sizeof(buffer), "%04lld-%02lld-%02lldT%02lld:%02lld:%02lld.%09lldZ", //
+                                   (long long)year, (long long)month, (long long)day,                          //
+                                   (long long)(time_of_day / 3600), (long long)(time_of_day / 60 % 60), (long long)(time_of_day % 60),
+                                   (long long)ns);
+    out += cc::string_view(buffer, size_t(len));
+}
+
+char const* get_level_name(rlog::verbosity::type v)
+{
+    switch (v)
+    {
+    case rlog::verbosity::Trace:
+        return "trace";
+    case rlog::verbosity::Debug:
+        return "debug";
+    case rlog::verbosity::Info:
+        return "info";
+    case rlog::verbosity::Warning:
+        return "warning";
+    case rlog::verbosity::Error:
+        return "error";
+    case rlog::verbosity::Fatal:
+        return "fatal";
+    case rlog::verbosity::_count: // silence warning
+        break;
+    }
+    return "";
+}
+
+void append_json_char(cc::string& out, char c)
+{
+    switch (c)
+    {
+    case '"':
+        out += "\\\"";
+        break;
+    case '\\':
+        out += "\\\\";
+        break;
+    case '\n':
+        out += "\\n";
+        break;
+    case '\r':
+        out += "\\r";
+        break;
+    case '\t':
+        out += "\\t";
+        break;
+    default:
+        if (uint8_t(c) < 0x20)
+        {
+            char buffer[8];
+            auto const len = std::snprintf(buffer, sizeof(buffer), "\\u%04x", unsigned(uint8_t(c)));
+            out += cc::string_view(buffer, size_t(len));
+        }
+        else
+            out += c;
+    }
+}
+
+void append_json_string(cc::string& out, cc::string_view s)
+{
+    out += '"';
+    for (auto c : s)
+        append_json_char(out, c);
+    out += '"';
+}
+
+// ,"key":
+void append_json_key(cc::string& out, cc::string_view key)
+{
+    out += ',';
+    append_json_string(out, key);
+    out += ':';
+}
+
+void append_json_value(cc::string& out, rlog::field const& f)
+{
+    char buffer[32];
+    switch (f.type)
+    {
+    case rlog::field_type::signed_int:
+        out += cc::string_view(buffer, size_t(std::snprintf(buffer, sizeof(buffer), "%lld", (long long)f.i)));
+        break;
+    case rlog::field_type::unsigned_int:
+        out += cc::string_view(buffer, size_t(std::snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long)f.u)));
+        break;
+    case rlog::field_type::floating_point:
+        if (std::isfinite(f.f))
+            f.format_value([&](cc::span<char const> chars) { out += cc::string_view(chars.data(), chars.size()); });
+        else
+            out += "null";
+        break;
+    case rlog::field_type::boolean:
+        out += f.b ? "true" : "false";
+        break;
+    case rlog::field_type::string:
+        append_json_string(out, f.str);
+        break;
+    case rlog::field_type::other:
+        // formatted and escaped directly into the line
+        out += '"';
+        f.format_value(
+            [&](cc::span<char const> chars)
+            {
+                for (auto c : chars)
+                    append_json_char(out, c);
+            });
+        out += '"';
+        break;
+    }
+}
+
+void write_line(rlog::line_output_fun& output, rlog::message_ref const& msg, cc::string_view line)
+{
+    if (output.is_valid())
+        output(msg, line);
+    else
+        rlog::detail::write_to_console(rlog::detail::console_stream::out, line, msg.verbosity >= rlog::verbosity::Error);
+}
+}
+
+void rlog::append_json_line(cc::string& out, message_ref const& msg)
+{
+    out += "{\"time\":\"";
+    append_utc_time(out, msg.timestamp);
+    out += "\",\"level\":\"";
+    out += get_level_name(msg.verbosity);
+    out += '"';
+
+    if (msg.domain != nullptr)
+    {
+        append_json_key(out, "domain");
+        append_json_string(out, msg.domain->name);
+    }
+
+    if (!msg.thread_name.empty())
+    {
+        append_json_key(out, "thread");
+        append_json_string(out, msg.thread_name);
+    }
+
+    if (msg.location != nullptr && msg.location->file[0] != '\0')
+    {
+        append_json_key(out, "file");
+        append_json_string(out, msg.location->file);
+
+        char buffer[16];
+        append_json_key(out, "line");
+        out += cc::string_view(buffer, size_t(std::snprintf(buffer, sizeof(buffer), "%d", msg.location->line)));
+    }
+
+    append_json_key(out, "msg");
+    append_json_string(out, msg.message);
+
+    for (auto const& f : msg.fields)
+    {
+        append_json_key(out, f.key);
+        append_json_value(out, f);
+    }
+
+    out += "}\n";
+}
+
+void rlog::append_logfmt_line(cc::string& out, message_ref const& msg)
+{
+    out += "time=";
+    append_utc_time(out, msg.timestamp);
+    out += " level=";
+    out += get_level_name(msg.verbosity);
+
+    if (msg.domain != nullptr)
+    {
+        out += " domain=";
+        append_logfmt_value(out, msg.domain->name);
+    }
+
+    if (!msg.thread_name.empty())
+    {
+        out += " thread=";
+        append_logfmt_value(out, msg.thread_name);
+    }
+
+    out += " msg=";
+    append_logfmt_value(out, msg.message);
+
+    append_logfmt_fields(out, msg.fields);
+    out += '\n';
+}
+
+void rlog::json_lines_sink::write(message_ref const& msg)
+{
+    // the line buffer keeps its capacity, so steady-state logging does not allocate
+    thread_local cc::string line;
+    line.clear();
+    append_json_line(line, msg);
+    write_line(_output, msg, line);
+}
+
+void rlog::json_lines_sink::flush()
+{
+    if (!_output.is_valid())
+        console::flush();
+}
+
+void rlog::logfmt_sink::write(message_ref const& msg)
+{
+    thread_local cc::string line;
+    line.clear();
+    append_logfmt_line(line, msg);
+    write_line(_output, msg, line);
+}
+
+void rlog::logfmt_sink::flush()
+{
+    if (!_output.is_valid())
+        console::flush();
+}
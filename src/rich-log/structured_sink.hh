@@ -0,0 +1,71 @@
+#pragma once
+
+#include <clean-core/string.hh>
+#include <clean-core/string_view.hh>
+#include <clean-core/unique_function.hh>
+
+#include <rich-log/detail/api.hh>
+#include <rich-log/message.hh>
+#include <rich-log/sink.hh>
+
+/**
+ * sinks for machine-readable logs: one JSON object or one logfmt line per message
+ * fields of structured messages (see LOGS in log.hh) are serialized with their types, directly from message_ref::fields
+ *
+ * Usage:
+ *
+ *   rlog::add_sink(cc::make_unique<rlog::json_lines_sink>());
+ *
+ *   LOGS(Net, Info, "request done", rlog::kv("latency_us", 17), rlog::kv("path", "/index.html"));
+ *
+ *   // JSON lines:
+ *   {"time":"2024-05-06T07:14:10.123456789Z","level":"info","domain":"Net","thread":"main","file":"net.cc","line":12,
+ *    "msg":"request done","latency_us":17,"path":"/index.html"} (on a single line)
+ *
+ *   // logfmt:
+ *   time=2024-05-06T07:14:10.123456789Z level=info domain=Net thread=main msg="request done" latency_us=17 path=/index.html
+ *
+ * JSON types of fields: integers and floats are numbers (non-finite floats are null), bools are true/false, everything else is a string
+ * NOTE: fields are written after the built-in keys (time, level, domain, thread, file, line, msg) and may shadow them
+ */
+
+namespace rlog
+{
+/// receives complete lines (always ending with '\n')
+/// NOTE: can be called from multiple threads at the same time
+using line_output_fun = cc::unique_function<void(message_ref const& msg, cc::string_view line)>;
+
+/// appends the message as a single-line JSON object (followed by '\n')
+RLOG_API void append_json_line(cc::string& out, message_ref const& msg);
+
+/// appends the message as a logfmt line (followed by '\n')
+RLOG_API void append_logfmt_line(cc::string& out, message_ref const& msg);
+
+/// writes each message as JSON object on its own line
+/// per default, lines go to stdout (shared with the console output, see console.hh)
+class RLOG_API json_lines_sink final : public sink
+{
+public:
+    explicit json_lines_sink(line_output_fun output = {}) : _output(cc::move(output)) {}
+
+    void write(message_ref const& msg) override;
+    void flush() override;
+
+private:
+    line_output_fun _output;
+};
+
+/// writes each message as logfmt line (key=value pairs)
+/// per default, lines go to stdout (shared with the console output, see console.hh)
+class RLOG_API logfmt_sink final : public sink
+{
+public:
+    explicit logfmt_sink(line_output_fun output = {}) : _output(cc::move(output)) {}
+
+    void write(message_ref const& msg) override;
+    void flush() override;
+
+private:
+    line_output_fun _output;
+};
+}
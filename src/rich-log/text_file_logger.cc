@@ -0,0 +1,382 @@
+#include "text_file_logger.hh"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include <clean-core/utility.hh>
+#include <clean-core/vector.hh>
+
+#include <rich-log/gzip.hh>
+#include <rich-log/log_line.hh>
+#include <rich-log/timestamp.hh>
+
+namespace
+{
+uint64_t get_file_size(char const* path)
+{
+    auto const file = std::fopen(path, "rb");
+    if (file == nullptr)
+        return 0;
+
+    std::fseek(file, 0, SEEK_END);
+    auto const size = std::ftell(file);
+    std::fclose(file);
+    return size > 0 ? uint64_t(size) : 0;
+}
+
+// a closed file that counts towards the retention limits
+struct closed_file
+{
+    cc::string path;
+    uint64_t size = 0;
+};
+
+// lines of a single file, written by the worker
+struct queued_block
+{
+    uint64_t index = 0; // of the file
+    cc::string text;
+};
+
+// writers only wait for the worker if it is this many blocks behind (e.g. while it compresses a large file)
+constexpr size_t max_queued_blocks = 64;
+
+// written blocks that are kept for reuse, so steady-state logging does not allocate
+constexpr size_t max_spare_blocks = 4;
+}
+
+struct rlog::text_file_logger::state
+{
+    text_file_config config;
+
+    // guards everything below (except the worker-only members)
+    // only held to append formatted lines and to hand blocks to the worker, never during file I/O
+    std::mutex mutex;
+    uint64_t index = 0;     // of the file that new lines go to
+    uint64_t file_size = 0; // of that file, including the queued and collected lines
+    int64_t opened_ns = 0;  // monotonic, when that file was started
+    cc::string block;       // collected lines of that file
+
+    cc::vector<queued_block> queue; // oldest first
+    cc::vector<cc::string> spare_blocks;
+    uint64_t queued_count = 0;  // blocks handed to the worker so far
+    uint64_t written_count = 0; // blocks written by the worker so far
+    bool is_stopping = false;
+    std::condition_variable wakeup;  // wakes the worker
+    std::condition_variable written; // wakes flush and writers that wait for the worker
+
+    // false while the current file could not be created, the lines are then dropped
+    std::atomic<bool> has_file = {false};
+
+    // only used by the worker (and the constructor before it starts)
+    std::FILE* file = nullptr;
+    uint64_t file_index = 0;
+    cc::vector<closed_file> closed; // oldest first
+    std::thread worker;
+
+    cc::string file_path(uint64_t i, bool compressed = false) const
+    {
+        char suffix[32];
+        std::snprintf(suffix, sizeof(suffix), compressed ? ".%06llu.log.gz" : ".%06llu.log", (unsigned long long)i);
+
+        auto path = config.path_prefix;
+        path += suffix;
+        return path;
+    }
+
+    // must hold mutex
+    // hands the collected lines to the worker, an empty block only makes it switch to the file 'index'
+    void queue_block()
+    {
+        queue.push_back({index, {}});
+        if (!block.empty())
+        {
+            std::swap(queue.back().text, block);
+            if (!spare_blocks.empty())
+            {
+                std::swap(block, spare_blocks.back());
+                spare_blocks.pop_back();
+            }
+            else
+                block.reserve(config.block_size + 1024);
+        }
+
+        ++queued_count;
+        wakeup.notify_one();
+    }
+
+    // must hold mutex
+    // the worker closes the current file once it reaches the first block of the next one
+    void rotate_file()
+    {
+        queue_block();
+
+        ++index;
+        file_size = 0;
+        opened_ns = rlog::get_current_timestamp().monotonic_ns;
+        queue_block();
+    }
+
+    // must hold mutex
+    bool is_too_old(int64_t now_ns) const
+    {
+        return config.max_file_age_seconds > 0 && file_size > 0 && now_ns - opened_ns >= config.max_file_age_seconds * 1'000'000'000;
+    }
+
+    // called by the worker without holding mutex
+    // retries of the same file do not report the error again
+    void open_file(bool is_retry = false)
+    {
+        file = std::fopen(file_path(file_index).c_str(), "wb");
+        has_file.store(file != nullptr, std::memory_order_relaxed);
+        if (file == nullptr)
+        {
+            if (!is_retry)
+                std::fprintf(stderr, "[rich-log] unable to create log file '%s'\n", file_path(file_index).c_str());
+            return;
+        }
+
+        // the block is the buffer, so written blocks are with the OS right away
+        std::setvbuf(file, nullptr, _IONBF, 0);
+    }
+
+    // called by the worker without holding mutex
+    void close_file()
+    {
+        if (file == nullptr)
+            return;
+
+        std::fclose(file);
+        file = nullptr;
+        process_closed_file(file_index);
+    }
+
+    // called by the worker without holding mutex
+    void write_queued_block(queued_block const& b)
+    {
+        if (b.index != file_index)
+        {
+            close_file();
+            file_index = b.index;
+            open_file();
+        }
+
+        if (file != nullptr && !b.text.empty())
+            std::fwrite(b.text.data(), 1, b.text.size(), file);
+    }
+
+    // compresses a closed file and applies the retention limits
+    // called by the worker without holding mutex
+    void process_closed_file(uint64_t i)
+    {
+        auto path = file_path(i);
+        if (config.compress)
+        {
+            auto const compressed_path = file_path(i, true);
+            if (rlog::gzip_file(path.c_str(), compressed_path.c_str()))
+            {
+                std::remove(path.c_str());
+                path = compressed_path;
+            }
+            else
+                std::fprintf(stderr, "[rich-log] unable to compress log file '%s'\n", path.c_str());
+        }
+
+        closed.push_back({path, get_file_size(path.c_str())});
+
+        auto total_size = uint64_t(0);
+        for (auto const& f : closed)
+            total_size += f.size;
+
+        auto removed = size_t(0);
+        while (removed < closed.size()
+               && ((config.max_files > 0 && closed.size() - removed > size_t(config.max_files))
+                   || (config.max_total_size > 0 && total_size > config.max_total_size)))
+        {
+            std::remove(closed[removed].path.c_str());
+            total_size -= closed[removed].size;
+            ++removed;
+        }
+
+        if (removed > 0)
+        {
+            cc::vector<closed_file> kept;
+            for (auto i = removed; i < closed.size(); ++i)
+                kept.push_back(cc::move(closed[i]));
+            closed = cc::move(kept);
+        }
+    }
+
+    // creates the current file again after it could not be created (e.g. its directory was missing or the disk was full)
+    // must hold mutex, which is released while opening
+    void retry_open_file(std::unique_lock<std::mutex>& lock)
+    {
+        lock.unlock();
+        open_file(true);
+        lock.lock();
+
+        // writers dropped the lines meanwhile, so the new file starts empty
+        if (has_file.load(std::memory_order_relaxed))
+            opened_ns = rlog::get_current_timestamp().monotonic_ns;
+    }
+
+    void run_worker()
+    {
+        auto const interval = std::chrono::milliseconds(config.flush_interval_ms);
+        auto next_flush = std::chrono::steady_clock::now() + interval;
+        cc::vector<queued_block> blocks;
+
+        // a missing file is retried on the flush interval (or every second without one)
+        auto const retry_interval = config.flush_interval_ms > 0 ? interval : std::chrono::milliseconds(1000);
+        auto next_retry = std::chrono::steady_clock::now() + retry_interval;
+
+        auto lock = std::unique_lock<std::mutex>(mutex);
+        while (true)
+        {
+            if (queue.empty() && !is_stopping)
+            {
+                if (config.flush_interval_ms > 0)
+                    wakeup.wait_until(lock, next_flush);
+                else if (!has_file.load(std::memory_order_relaxed))
+                    wakeup.wait_until(lock, next_retry);
+                else
+                    wakeup.wait(lock);
+            }
+
+            // periodic flush point, and time-based rotation of files that are not written to
+            auto const now = std::chrono::steady_clock::now();
+            if (is_too_old(rlog::get_current_timestamp().monotonic_ns))
+                rotate_file();
+            else if (config.flush_interval_ms > 0 && now >= next_flush && !block.empty())
+                queue_block();
+
+            if (now >= next_flush)
+                next_flush = now + interval;
+
+            // queued blocks of a new file try to create it anyway
+            if (queue.empty() && !is_stopping && !has_file.load(std::memory_order_relaxed) && now >= next_retry)
+            {
+                next_retry = now + retry_interval;
+                retry_open_file(lock);
+            }
+
+            if (!queue.empty())
+            {
+                std::swap(blocks, queue);
+
+                lock.unlock();
+                for (auto const& b : blocks)
+                    write_queued_block(b);
+                lock.lock();
+
+                for (auto& b : blocks)
+                    if (!b.text.empty() && spare_blocks.size() < max_spare_blocks)
+                    {
+                        b.text.clear();
+                        spare_blocks.push_back(cc::move(b.text));
+                    }
+
+                written_count += blocks.size();
+                blocks.clear();
+                written.notify_all();
+            }
+            else if (is_stopping)
+            {
+                // waits until the last file is compressed
+                lock.unlock();
+                close_file();
+                return;
+            }
+        }
+    }
+};
+
+rlog::text_file_logger::text_file_logger(text_file_config config) : _state(cc::make_unique<state>())
+{
+    auto& s = *_state;
+    s.config = cc::move(config);
+    s.block.reserve(s.config.block_size + 1024);
+    s.opened_ns = rlog::get_current_timestamp().monotonic_ns;
+
+    // the first file is created right away, so is_valid can report it
+    s.open_file();
+    s.worker = std::thread([&s] { s.run_worker(); });
+}
+
+rlog::text_file_logger::~text_file_logger()
+{
+    auto& s = *_state;
+    {
+        auto _ = std::lock_guard<std::mutex>(s.mutex);
+        s.queue_block();
+        s.is_stopping = true;
+        s.wakeup.notify_one();
+    }
+
+    // waits until everything is written and the last file is compressed
+    s.worker.join();
+}
+
+bool rlog::text_file_logger::is_valid() const { return _state->has_file.load(std::memory_order_relaxed); }
+
+void rlog::text_file_logger::write(message_ref const& msg)
+{
+    auto& s = *_state;
+
+    // formatted before taking the lock, which then only covers appending the line
+    thread_local cc::string line;
+    line.clear();
+    append_log_line(line, msg, s.config.style);
+
+    auto lock = std::unique_lock<std::mutex>(s.mutex);
+
+    // the worker is far behind, e.g. the disk is much slower than logging
+    if (s.queue.size() >= max_queued_blocks)
+        s.written.wait(lock, [&] { return s.queue.size() < max_queued_blocks; });
+
+    if (s.is_too_old(msg.timestamp.monotonic_ns))
+        s.rotate_file();
+
+    if (!s.has_file.load(std::memory_order_relaxed))
+        return; // no file
+
+    s.block += line;
+    s.file_size += line.size();
+
+    if (s.config.max_file_size > 0 && s.file_size >= s.config.max_file_size)
+        s.rotate_file();
+    else if (s.block.size() >= s.config.block_size)
+        s.queue_block();
+}
+
+void rlog::text_file_logger::flush()
+{
+    auto& s = *_state;
+    auto lock = std::unique_lock<std::mutex>(s.mutex);
+
+    if (!s.block.empty())
+        s.queue_block();
+
+    auto const target = s.queued_count;
+    s.written.wait(lock, [&] { return s.written_count >= target; });
+}
+
+void rlog::text_file_logger::rotate()
+{
+    auto _ = std::lock_guard<std::mutex>(_state->mutex);
+    _state->rotate_file();
+}
+
+rlog::logger_fun rlog::make_text_file_logger(text_file_config config)
+{
+    return [logger = cc::make_unique<text_file_logger>(cc::move(config))](message_ref msg, bool&)
+    {
+        logger->write(msg);
+        return true;
+    };
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <clean-core/string.hh>
+#include <clean-core/unique_ptr.hh>
+
+#include <rich-log/detail/api.hh>
+#include <rich-log/logger.hh>
+#include <rich-log/message.hh>
+#include <rich-log/sink.hh>
+
+/**
+ * rotating text log files, closed files are gzip-compressed in the background
+ *
+ * lines use the same layouts as the console (see console_log_style and append_log_line)
+ * they are formatted by the logging thread, collected in memory, and handed to the background thread in blocks,
+ * either when a block is full, on flush(), or every flush_interval_ms
+ * the background thread does all file I/O: writing blocks, closing and creating files, compression, and deletion
+ *
+ * a new file is started when the current one exceeds max_file_size or max_file_age_seconds (or on rotate())
+ * the closed file is then compressed to .log.gz (see gzip.hh) and the oldest closed files are deleted
+ * according to max_files and max_total_size, all on a background thread
+ *
+ * Usage:
+ *
+ *   rlog::text_file_config cfg;
+ *   cfg.path_prefix = "logs/server-2024-05-06";
+ *   cfg.max_file_size = 64u << 20;
+ *   cfg.max_total_size = 1ull << 30;
+ *   rlog::add_sink(cc::make_unique<rlog::text_file_sink>(cfg));
+ *
+ *   // logs/server-2024-05-06.000000.log.gz
+ *   // logs/server-2024-05-06.000001.log.gz
+ *   // logs/server-2024-05-06.000002.log    <- current
+ *
+ * NOTE: a crash of the process loses the lines that were not written yet, i.e. the blocks that the background thread did not write
+ *       and at most one block or flush_interval_ms of collected lines
+ * NOTE: logging only waits for the background thread if it is far behind (e.g. a very slow disk)
+ * NOTE: lines are dropped while the current file cannot be created, the background thread retries it every flush_interval_ms
+ */
+
+namespace rlog
+{
+struct text_file_config
+{
+    /// files are named "<path_prefix>.<index>.log" with a 6 digit index starting at 0
+    /// NOTE: existing files with the same name are overwritten, use a unique prefix per run (e.g. including the date)
+    cc::string path_prefix = "log";
+
+    /// line layout, all styles except verbose_no_color and message_only contain ANSI color codes
+    console_log_style style = console_log_style::verbose_no_color;
+
+    /// a new file is started once the current one reaches this size in bytes (0 for no limit)
+    size_t max_file_size = 16u << 20;
+
+    /// a new file is started once the current one is this old (0 for no limit)
+    int64_t max_file_age_seconds = 0;
+
+    /// if more closed files exist, the oldest ones are deleted (0 keeps all files)
+    int max_files = 16;
+
+    /// if the closed files take more bytes (after compression), the oldest ones are deleted (0 for no limit)
+    uint64_t max_total_size = 0;
+
+    /// if true, closed files are compressed to "<path_prefix>.<index>.log.gz" and the uncompressed file is deleted
+    bool compress = true;
+
+    /// lines are written to the file in blocks of about this size
+    size_t block_size = 64 * 1024;
+
+    /// lines that are collected for longer are written by the background thread (0 only writes full blocks and on flush)
+    int flush_interval_ms = 1000;
+};
+
+/// writes log lines into a set of rotating text files
+/// thread-safe, writing a line is a formatting step and a short critical section, file I/O happens on the background thread
+class RLOG_API text_file_logger
+{
+public:
+    explicit text_file_logger(text_file_config config);
+    ~text_file_logger();
+
+    /// false if the current file could not be created
+    bool is_valid() const;
+
+    /// writes a single message, thread-safe
+    void write(message_ref const& msg);
+
+    /// writes the collected lines to the file (and the file buffers to the OS), waits for the background thread
+    void flush();
+
+    /// closes the current file (which is then compressed) and starts the next one, both on the background thread
+    void rotate();
+
+    text_file_logger(text_file_logger&&) = delete;
+    text_file_logger& operator=(text_file_logger&&) = delete;
+    text_file_logger(text_file_logger const&) = delete;
+    text_file_logger& operator=(text_file_logger const&) = delete;
+
+private:
+    struct state;
+    cc::unique_ptr<state> _state;
+};
+
+/// text_file_logger as a sink (see sink.hh)
+class RLOG_API text_file_sink final : public sink
+{
+public:
+    explicit text_file_sink(text_file_config config) : _logger(cc::move(config)) {}
+
+    void write(message_ref const& msg) override { _logger.write(msg); }
+    void flush() override { _logger.flush(); }
+
+private:
+    text_file_logger _logger;
+};
+
+/// creates a logger that writes all messages into rotating text files and consumes them
+/// (the files are closed when the logger is destroyed, e.g. by set_global_default_logger({}))
+RLOG_API logger_fun make_text_file_logger(text_file_config config);
+}
@@ -0,0 +1,117 @@
+#include "timestamp.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <clean-core/macros.hh>
+
+namespace
+{
+int64_t monotonic_now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t compute_wall_offset()
+{
+    // bracket the system clock read to reduce the error
+    auto const m0 = monotonic_now_ns();
+    auto const wall = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    auto const m1 = monotonic_now_ns();
+    return wall - (m0 + (m1 - m0) / 2);
+}
+
+// constant-initialized so that LOGs during static initialization work
+// 0 means "not calibrated yet"
+std::atomic<int64_t> g_wall_offset_ns = {0};
+
+// the offset is recalibrated about once per second, by the first timestamp after this monotonic time
+// this follows steps of the system clock (NTP, manual changes) and suspends, during which the monotonic clock stops
+constexpr int64_t calibration_interval_ns = 1'000'000'000;
+std::atomic<int64_t> g_next_calibration_ns = {0};
+
+// the last formatted second of this thread
+struct time_of_day_cache
+{
+    int64_t second = INT64_MIN;
+    char time[9] = {}; // HH:MM:SS
+    char date[9] = {}; // dd.mm.yy
+};
+
+thread_local time_of_day_cache tls_time_of_day;
+
+time_of_day_cache const& cached_time_of_day(rlog::timestamp t)
+{
+    auto& cache = tls_time_of_day;
+    auto const second = t.wall_ns >= 0 ? t.wall_ns / 1'000'000'000 : (t.wall_ns + 1) / 1'000'000'000 - 1;
+    if (second != cache.second)
+    {
+        auto const tt = std::time_t(second);
+        std::tm lt;
+#ifdef CC_OS_WINDOWS
+        ::localtime_s(&lt, &tt);
+#else
+        ::localtime_r(&tt, &lt);
+#endif
+        std::strftime(cache.time, sizeof(cache.time), "%H:%M:%S", &lt);
+        std::strftime(cache.date, sizeof(cache.date), "%d.%m.%y", &lt);
+        cache.second = second;
+    }
+    return cache;
+}
+}
+
+rlog::timestamp rlog::get_current_timestamp()
+{
+    timestamp t;
+    t.monotonic_ns = monotonic_now_ns();
+
+    auto offset = g_wall_offset_ns.load(std::memory_order_relaxed);
+    auto next_calibration = g_next_calibration_ns.load(std::memory_order_relaxed);
+    if (t.monotonic_ns >= next_calibration
+        && g_next_calibration_ns.compare_exchange_strong(next_calibration, t.monotonic_ns + calibration_interval_ns, std::memory_order_relaxed))
+    {
+        offset = compute_wall_offset();
+        g_wall_offset_ns.store(offset, std::memory_order_relaxed);
+    }
+    else if (offset == 0)
+        offset = compute_wall_offset(); // another thread is calibrating for the first time
+
+    t.wall_ns = t.monotonic_ns + offset;
+    return t;
+}
+
+void rlog::recalibrate_wall_clock() { g_wall_offset_ns.store(compute_wall_offset(), std::memory_order_relaxed); }
+
+size_t rlog::write_time_of_day(char* buffer, size_t buffer_size, timestamp t, int subsecond_digits)
+{
+    CC_ASSERT(buffer_size >= 19 && "buffer too small");
+    CC_ASSERT(0 <= subsecond_digits && subsecond_digits <= 9);
+
+    std::memcpy(buffer, cached_time_of_day(t).time, 8);
+    size_t len = 8;
+
+    if (subsecond_digits > 0)
+    {
+        auto frac = t.subsecond_ns();
+        for (auto i = subsecond_digits; i < 9; ++i)
+            frac /= 10;
+
+        len += std::snprintf(buffer + 8, buffer_size - 8, ".%0*lld", subsecond_digits, (long long)frac);
+    }
+
+    buffer[len] = '\0';
+    return len;
+}
+
+size_t rlog::write_date(char* buffer, size_t buffer_size, timestamp t)
+{
+    CC_ASSERT(buffer_size >= 9 && "buffer too small");
+    (void)buffer_size; // only asserted
+
+    std::memcpy(buffer, cached_time_of_day(t).date, 8);
+    buffer[8] = '\0';
+    return 8;
+}
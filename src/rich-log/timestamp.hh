@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+
+#include <rich-log/detail/api.hh>
+
+namespace rlog
+{
+/// a point in time with nanosecond resolution
+/// both values come from a single read of the monotonic clock:
+///   - monotonic_ns is steady (use it for durations and ordering)
+///   - wall_ns is nanoseconds since the unix epoch (monotonic_ns + an offset calibrated against the system clock)
+///     the offset is recalibrated about once per second, so wall_ns follows time changes but is not strictly monotonic
+struct timestamp
+{
+    int64_t wall_ns = 0;
+    int64_t monotonic_ns = 0;
+
+    std::time_t to_time_t() const { return std::time_t(wall_ns / 1'000'000'000); }
+
+    /// nanoseconds within the current (wall clock) second
+    int64_t subsecond_ns() const
+    {
+        auto const ns = wall_ns % 1'000'000'000;
+        return ns < 0 ? ns + 1'000'000'000 : ns;
+    }
+
+    /// message_ref::timestamp used to be a std::time_t
+    operator std::time_t() const { return to_time_t(); }
+};
+
+/// returns the current time
+/// this is a single vDSO/QPC call, much cheaper than std::time + std::localtime
+RLOG_API timestamp get_current_timestamp();
+
+/// re-reads the system clock to update the wall clock offset
+/// the offset is recalibrated about once per second anyway, call this to apply a change of the system time right away
+RLOG_API void recalibrate_wall_clock();
+
+/// writes the local time of day as "HH:MM:SS" (plus "." and 1-9 subsecond digits if subsecond_digits > 0)
+/// the HH:MM:SS part is cached per thread and only recomputed when the second changes
+/// buffer should have space for at least 19 chars, output is null-terminated
+/// returns the number of written chars (excluding the terminator)
+RLOG_API size_t write_time_of_day(char* buffer, size_t buffer_size, timestamp t, int subsecond_digits = 0);
+
+/// writes the local date as "dd.mm.yy" (cached like write_time_of_day)
+/// buffer should have space for at least 9 chars, output is null-terminated
+/// returns the number of written chars (excluding the terminator)
+RLOG_API size_t write_date(char* buffer, size_t buffer_size, timestamp t);
+}
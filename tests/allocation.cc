@@ -0,0 +1,116 @@
+#include <nexus/test.hh>
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include <clean-core/string.hh>
+#include <clean-core/string_view.hh>
+
+#include <rich-log/log.hh>
+#include <rich-log/logger.hh>
+
+// counts heap allocations per thread (replaces the global allocation functions of the test binary)
+namespace
+{
+thread_local int tls_allocation_count = 0;
+
+void* counted_alloc(size_t size)
+{
+    ++tls_allocation_count;
+    if (auto const p = std::malloc(size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc();
+}
+}
+
+void* operator new(size_t size) { return counted_alloc(size); }
+void* operator new[](size_t size) { return counted_alloc(size); }
+void* operator new(size_t size, std::nothrow_t const&) noexcept { return std::malloc(size == 0 ? 1 : size); }
+void* operator new[](size_t size, std::nothrow_t const&) noexcept { return std::malloc(size == 0 ? 1 : size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::nothrow_t const&) noexcept { std::free(p); }
+void operator delete[](void* p, std::nothrow_t const&) noexcept { std::free(p); }
+
+namespace
+{
+// copies the message without allocating
+struct last_message
+{
+    char text[256] = {};
+    size_t size = 0;
+
+    cc::string_view view() const { return {text, size}; }
+};
+}
+
+TEST("logging does not allocate in steady state")
+{
+    last_message last;
+    auto _ = rlog::scoped_logger_override(
+        [&](rlog::message_ref m, bool&)
+        {
+            last.size = m.message.size() < sizeof(last.text) ? m.message.size() : sizeof(last.text);
+            std::memcpy(last.text, m.message.data(), last.size);
+            return true;
+        });
+
+    int i = 17;
+    char const* cstr = "cstr";
+    cc::string_view view = "view";
+    char const* runtime_fmt = "runtime {} %s";
+
+    auto const log_all = [&]
+    {
+        LOG("plain message");
+        LOG("int {} and %d", i, i + 1);
+        LOG("strings %s {} {}", cstr, view, "literal");
+        LOG("multi\nline {}", i);
+        LOG(runtime_fmt, i, cstr);
+        LOGS(Default, Info, "structured", rlog::kv("i", i), rlog::kv("view", view));
+        LOG("long message to grow the buffer: {} {} {} {} {} {} {} {} {} {} {} {} {} {} {} {} {} {} {} {} {} {} {} {} {} {}", //
+            i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i, i);
+    };
+
+    // warm-up: grows the per-thread buffer
+    log_all();
+
+    auto const allocations_before = tls_allocation_count;
+    for (auto n = 0; n < 100; ++n)
+        log_all();
+    CHECK(tls_allocation_count == allocations_before);
+
+    LOG("int {} and %d", i, i + 1);
+    CHECK(last.view() == "int 17 and 18");
+
+    LOG(runtime_fmt, i, cstr);
+    CHECK(last.view() == "runtime 17 cstr");
+}
+
+TEST("nested logging keeps the outer message")
+{
+    cc::string outer;
+    cc::string inner;
+    auto _ = rlog::scoped_logger_override(
+        [&](rlog::message_ref m, bool&)
+        {
+            if (m.message.starts_with("outer"))
+            {
+                // the outer message is still in the per-thread buffer, so the nested LOG must not overwrite it
+                LOG("inner {}", 2);
+                outer = m.message;
+            }
+            else
+            {
+                inner = m.message;
+            }
+            return true;
+        });
+
+    LOG("outer {}", 1);
+    CHECK(outer == "outer 1");
+    CHECK(inner == "inner 2");
+}
@@ -0,0 +1,202 @@
+#include <nexus/test.hh>
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+#include <clean-core/string.hh>
+#include <clean-core/vector.hh>
+
+#include <rich-log/async.hh>
+#include <rich-log/log.hh>
+#include <rich-log/logger.hh>
+
+namespace
+{
+// fills a minimal buffer while the background thread is stuck in the global logger
+// returns the indices of the "fill" messages that were printed and the drop count reported in the log
+void fill_buffer(rlog::async::overflow_policy policy, int count, cc::vector<int>& kept, uint64_t& reported_dropped)
+{
+    std::atomic<bool> is_blocked = {false};
+    std::atomic<bool> is_released = {false};
+    rlog::set_global_default_logger(
+        [&](rlog::message_ref m, bool&)
+        {
+            auto i = -1;
+            unsigned long long dropped = 0;
+            if (m.message == "blocker")
+            {
+                is_blocked = true;
+                while (!is_released)
+                    std::this_thread::yield();
+            }
+            else if (std::sscanf(cc::string(m.message).c_str(), "fill %d", &i) == 1)
+                kept.push_back(i);
+            else if (std::sscanf(cc::string(m.message).c_str(), "async log buffer overflow, dropped %llu message(s)", &dropped) == 1)
+                reported_dropped += dropped;
+            return true;
+        });
+
+    rlog::async::config cfg;
+    cfg.buffer_size = 4096;
+    cfg.on_overflow = policy;
+    rlog::async::enable(cfg);
+
+    // a new thread, so that its buffer has the configured size
+    auto t = std::thread(
+        [&]
+        {
+            LOG("blocker");
+            while (!is_blocked)
+                std::this_thread::yield();
+
+            for (auto i = 0; i < count; ++i)
+                LOG("fill %d", i);
+
+            is_released = true;
+        });
+    t.join();
+
+    rlog::async::shutdown();
+    rlog::set_global_default_logger({});
+}
+}
+
+TEST("async logging")
+{
+    std::mutex mutex;
+    cc::vector<cc::string> messages;
+    rlog::set_global_default_logger(
+        [&](rlog::message_ref m, bool&)
+        {
+            auto _ = std::lock_guard<std::mutex>(mutex);
+            messages.push_back(m.message);
+            return true;
+        });
+
+    rlog::async::enable();
+    CHECK(rlog::async::is_enabled());
+
+    LOG("async %d", 1);
+    LOG("async %d", 2);
+
+    // local loggers are still called synchronously
+    {
+        cc::string local_msg;
+        auto _ = rlog::scoped_logger_override(
+            [&](rlog::message_ref m, bool&)
+            {
+                local_msg = m.message;
+                return true;
+            });
+
+        LOG("local");
+        CHECK(local_msg == "local");
+    }
+
+    auto const thread_cnt = 4;
+    auto const msgs_per_thread = 1000;
+    cc::vector<std::thread> threads;
+    for (auto t = 0; t < thread_cnt; ++t)
+        threads.emplace_back(
+            [&]
+            {
+                for (auto i = 0; i < msgs_per_thread; ++i)
+                    LOG("thread msg %d", i);
+            });
+    for (auto& t : threads)
+        t.join();
+
+    rlog::async::flush();
+
+    {
+        auto _ = std::lock_guard<std::mutex>(mutex);
+        CHECK(messages.size() == 2 + thread_cnt * msgs_per_thread);
+        CHECK(messages[0] == "async 1");
+        CHECK(messages[1] == "async 2");
+    }
+
+    rlog::async::shutdown();
+    CHECK(!rlog::async::is_enabled());
+    CHECK(rlog::async::dropped_message_count() == 0);
+
+    LOG("sync again");
+    CHECK(messages.back() == "sync again");
+
+    rlog::set_global_default_logger({});
+}
+
+TEST("async logging unregistered domains")
+{
+    std::mutex mutex;
+    cc::vector<cc::string> messages;
+    rlog::set_global_default_logger(
+        [&](rlog::message_ref m, bool&)
+        {
+            auto _ = std::lock_guard<std::mutex>(mutex);
+            messages.push_back(m.message);
+            return true;
+        });
+
+    rlog::async::enable();
+
+    // like a shared library that logs and is unloaded, its buffered messages must be printed before it is gone
+    rlog::location plugin_location = {"plugin", __FILE__, __LINE__};
+    rlog::domain_info plugin = rlog::domain_info::make_named("AsyncPlugin");
+    {
+        auto const reg = rlog::detail::domain_registerer(&plugin);
+        rlog::detail::do_log(plugin, rlog::verbosity::Info, &plugin_location, cc::string_view("from the plugin"));
+    }
+
+    {
+        auto _ = std::lock_guard<std::mutex>(mutex);
+        CHECK(messages.size() == 1);
+        if (messages.size() == 1)
+            CHECK(messages[0] == "from the plugin");
+    }
+
+    rlog::async::shutdown();
+    rlog::set_global_default_logger({});
+}
+
+TEST("async logging overflow")
+{
+    auto const count = 200;
+
+    // drop_newest keeps the first messages
+    {
+        cc::vector<int> kept;
+        uint64_t reported_dropped = 0;
+        auto const prev_dropped = rlog::async::dropped_message_count();
+        fill_buffer(rlog::async::overflow_policy::drop_newest, count, kept, reported_dropped);
+
+        CHECK(!kept.empty());
+        CHECK(reported_dropped > 0);
+        CHECK(kept.size() + reported_dropped == count);
+        CHECK(rlog::async::dropped_message_count() - prev_dropped == reported_dropped);
+
+        auto is_prefix = true;
+        for (size_t i = 0; i < kept.size(); ++i)
+            is_prefix &= kept[i] == int(i);
+        CHECK(is_prefix);
+    }
+
+    // drop_oldest keeps the last messages
+    {
+        cc::vector<int> kept;
+        uint64_t reported_dropped = 0;
+        auto const prev_dropped = rlog::async::dropped_message_count();
+        fill_buffer(rlog::async::overflow_policy::drop_oldest, count, kept, reported_dropped);
+
+        CHECK(!kept.empty());
+        CHECK(reported_dropped > 0);
+        CHECK(kept.size() + reported_dropped == count);
+        CHECK(rlog::async::dropped_message_count() - prev_dropped == reported_dropped);
+
+        auto is_suffix = true;
+        for (size_t i = 0; i < kept.size(); ++i)
+            is_suffix &= kept[i] == int(count - kept.size() + i);
+        CHECK(is_suffix);
+    }
+}
@@ -0,0 +1,229 @@
+#include <nexus/test.hh>
+
+#include <cstdio>
+#include <new>
+#include <thread>
+
+#include <clean-core/string.hh>
+#include <clean-core/vector.hh>
+
+#include <rich-log/binary_file_logger.hh>
+#include <rich-log/log.hh>
+#include <rich-log/log_line.hh>
+#include <rich-log/logger.hh>
+
+RICH_LOG_DECLARE_DOMAIN(BinaryTest);
+RICH_LOG_DEFINE_DOMAIN(BinaryTest, "binary");
+
+namespace
+{
+cc::string binary_test_file(int index)
+{
+    char path[64];
+    std::snprintf(path, sizeof(path), "rlog-test-binary.%06d.rlog", index);
+    return path;
+}
+}
+
+TEST("binary file logger")
+{
+    {
+        auto _ = rlog::scoped_logger_override(rlog::make_binary_file_logger({"rlog-test-binary"}));
+
+        rlog::set_current_thread_name("t%d", 7);
+        LOG("hello %s", "binary");
+        LOGD(BinaryTest, Warning, "two\nlines");
+        rlog::set_current_thread_name(nullptr);
+    }
+
+    cc::vector<cc::string> lines;
+    auto const ok = rlog::read_binary_log_file(binary_test_file(0).c_str(),
+                                               [&](rlog::message_ref const& msg)
+                                               {
+                                                   cc::string line;
+                                                   rlog::append_log_line(line, msg, rlog::console_log_style::verbose_no_color);
+                                                   lines.push_back(line);
+
+                                                   CHECK(msg.location != nullptr);
+                                               });
+    CHECK(ok);
+    CHECK(lines.size() == 2);
+    if (lines.size() == 2)
+    {
+        // 06.05.20 07:14:10 t7        INFO       default  hello binary
+        CHECK(cc::string_view(lines[0]).subview(18) == "t7        INFO       default  hello binary\n");
+        CHECK(cc::string_view(lines[1]).subview(18) == "t7        WARNING    binary   two\n"
+                                                       "                                                lines\n");
+    }
+
+    std::remove(binary_test_file(0).c_str());
+    CHECK(!rlog::read_binary_log_file(binary_test_file(0).c_str(), [](rlog::message_ref const&) {}));
+}
+
+TEST("binary file logger domain ids")
+{
+    // registration ids are never reused and can exceed the 16 bit of the record, the file uses its own dense ids
+    auto first = rlog::domain_info::make_named("first");
+    auto second = rlog::domain_info::make_named("second");
+    first.registration_id = 0x10001;
+    second.registration_id = 0x20001;
+
+    {
+        rlog::binary_file_logger logger({"rlog-test-binary"});
+
+        rlog::message_ref msg;
+        msg.timestamp = rlog::get_current_timestamp();
+        msg.location = nullptr;
+        msg.verbosity = rlog::verbosity::Info;
+        msg.message = "message";
+        for (auto d : {&first, &second, &first})
+        {
+            msg.domain = d;
+            logger.write(msg);
+        }
+    }
+
+    cc::vector<cc::string> domains;
+    CHECK(rlog::read_binary_log_file(binary_test_file(0).c_str(), [&](rlog::message_ref const& msg) { domains.push_back(msg.domain->name); }));
+    CHECK(domains.size() == 3);
+    if (domains.size() == 3)
+    {
+        CHECK(domains[0] == "first");
+        CHECK(domains[1] == "second");
+        CHECK(domains[2] == "first");
+    }
+
+    std::remove(binary_test_file(0).c_str());
+}
+
+TEST("binary file logger reused location addresses")
+{
+    // a shared library that is unloaded and loaded again might get its sites at the same addresses as before
+    // its domains are registered again though, i.e. they have new registration ids
+    auto before = rlog::domain_info::make_named("plugin");
+    auto after = rlog::domain_info::make_named("plugin");
+    before.registration_id = 0x30001;
+    after.registration_id = 0x30002;
+
+    alignas(rlog::location) std::byte storage[sizeof(rlog::location)];
+    {
+        rlog::binary_file_logger logger({"rlog-test-binary"});
+
+        rlog::message_ref msg;
+        msg.timestamp = rlog::get_current_timestamp();
+        msg.verbosity = rlog::verbosity::Info;
+        msg.message = "message";
+
+        msg.domain = &before;
+        msg.location = new (storage) rlog::location{"before", "before.cc", 1};
+        logger.write(msg);
+
+        msg.domain = &after;
+        msg.location = new (storage) rlog::location{"after", "after.cc", 2};
+        logger.write(msg);
+    }
+
+    cc::vector<cc::string> files;
+    CHECK(rlog::read_binary_log_file(binary_test_file(0).c_str(), [&](rlog::message_ref const& msg) { files.push_back(msg.location->file); }));
+    CHECK(files.size() == 2);
+    if (files.size() == 2)
+    {
+        CHECK(files[0] == "before.cc");
+        CHECK(files[1] == "after.cc");
+    }
+
+    std::remove(binary_test_file(0).c_str());
+}
+
+TEST("binary file logger thread names")
+{
+    {
+        auto _ = rlog::scoped_logger_override(rlog::make_binary_file_logger({"rlog-test-binary"}));
+
+        // every rename is a new definition for the same thread id
+        rlog::set_current_thread_name("before");
+        LOG("one");
+        rlog::set_current_thread_name("after");
+        LOG("two");
+        rlog::set_current_thread_name(nullptr);
+        LOG("three");
+        rlog::set_current_thread_name("before");
+        LOG("four");
+        rlog::set_current_thread_name(nullptr);
+    }
+
+    cc::vector<cc::string> names;
+    auto same_id = true;
+    CHECK(rlog::read_binary_log_file(binary_test_file(0).c_str(),
+                                     [&](rlog::message_ref const& msg)
+                                     {
+                                         names.push_back(msg.thread_name);
+                                         same_id &= msg.thread_id == rlog::get_current_thread_id();
+                                     }));
+    CHECK(same_id);
+    CHECK(names.size() == 4);
+    if (names.size() == 4)
+    {
+        CHECK(names[0] == "before");
+        CHECK(names[1] == "after");
+        CHECK(names[2] == "");
+        CHECK(names[3] == "before");
+    }
+
+    std::remove(binary_test_file(0).c_str());
+}
+
+TEST("binary file logger rotation")
+{
+    rlog::binary_file_config config;
+    config.path_prefix = "rlog-test-binary";
+    config.file_size = 64 * 1024;
+    config.max_files = 3;
+
+    auto const thread_cnt = 4;
+    auto const msgs_per_thread = 2000;
+    {
+        rlog::binary_file_logger logger(config);
+        CHECK(logger.is_valid());
+
+        cc::vector<std::thread> threads;
+        for (auto t = 0; t < thread_cnt; ++t)
+            threads.emplace_back(
+                [&]
+                {
+                    auto _ = rlog::scoped_logger_override(
+                        [&](rlog::message_ref msg, bool&)
+                        {
+                            logger.write(msg);
+                            return true;
+                        });
+
+                    for (auto i = 0; i < msgs_per_thread; ++i)
+                        LOG("message %d with some padding to fill the files faster", i);
+                });
+        for (auto& t : threads)
+            t.join();
+    }
+
+    // only the newest files survive, each one is self-contained
+    auto message_cnt = 0;
+    auto file_cnt = 0;
+    for (auto i = 0; i < 100; ++i)
+    {
+        auto const ok = rlog::read_binary_log_file(binary_test_file(i).c_str(),
+                                                   [&](rlog::message_ref const& msg)
+                                                   {
+                                                       ++message_cnt;
+                                                       CHECK(msg.domain == &Log::Default::domain);
+                                                   });
+        if (ok)
+        {
+            ++file_cnt;
+            std::remove(binary_test_file(i).c_str());
+        }
+    }
+
+    CHECK(file_cnt == 3);
+    CHECK(message_cnt > 0);
+    CHECK(message_cnt < thread_cnt * msgs_per_thread);
+}
@@ -0,0 +1,143 @@
+#include <nexus/test.hh>
+
+#include <clean-core/macros.hh>
+
+#ifndef CC_OS_WINDOWS
+
+#include <cstdio>
+#include <unistd.h>
+
+#include <clean-core/string.hh>
+
+#include <rich-log/console.hh>
+#include <rich-log/log.hh>
+#include <rich-log/logger.hh>
+
+namespace
+{
+// redirects stdout and stderr into the same temporary file, so their relative order can be checked
+struct console_capture
+{
+    std::FILE* file = std::tmpfile();
+    int saved_out = ::dup(1);
+    int saved_err = ::dup(2);
+
+    console_capture()
+    {
+        std::fflush(stdout);
+        std::fflush(stderr);
+        ::dup2(fileno(file), 1);
+        ::dup2(fileno(file), 2);
+    }
+
+    ~console_capture()
+    {
+        ::dup2(saved_out, 1);
+        ::dup2(saved_err, 2);
+        ::close(saved_out);
+        ::close(saved_err);
+        std::fclose(file);
+    }
+
+    cc::string content()
+    {
+        cc::string s;
+        char buffer[512];
+        std::fseek(file, 0, SEEK_SET);
+        while (auto const n = std::fread(buffer, 1, sizeof(buffer), file))
+            s += cc::string_view(buffer, n);
+        return s;
+    }
+};
+
+rlog::location g_console_test_location = {"test", "console.cc", 1};
+
+void log_to_console(rlog::verbosity::type verbosity, cc::string_view text)
+{
+    rlog::message_ref msg;
+    msg.timestamp = rlog::get_current_timestamp();
+    msg.location = &g_console_test_location;
+    msg.domain = &Log::Default::domain;
+    msg.verbosity = verbosity;
+    msg.thread_name = "";
+    msg.message = text;
+
+    auto break_on_log = false;
+    rlog::default_logger_fun(msg, break_on_log);
+}
+
+// position of the first occurrence, or -1
+int find(cc::string_view s, cc::string_view needle)
+{
+    for (size_t i = 0; i + needle.size() <= s.size(); ++i)
+        if (s.subview(i, needle.size()) == needle)
+            return int(i);
+    return -1;
+}
+}
+
+TEST("console output order")
+{
+    console_capture capture;
+
+    log_to_console(rlog::verbosity::Info, "first to stdout");
+    log_to_console(rlog::verbosity::Warning, "second to stderr");
+    log_to_console(rlog::verbosity::Info, "third to stdout\nwith a second line");
+
+    auto const s = capture.content();
+    auto const first = find(s, "first to stdout\n");
+    auto const second = find(s, "second to stderr\n");
+    auto const third = find(s, "third to stdout\n");
+    CHECK(first >= 0);
+    CHECK(first < second);
+    CHECK(second < third);
+
+    // the second line is padded to the timestamp ("07:14:10 ")
+    CHECK(find(s, "third to stdout\n         with a second line\n") >= 0);
+}
+
+TEST("buffered console output")
+{
+    console_capture capture;
+
+    rlog::console::config cfg;
+    cfg.buffered = true;
+    cfg.max_delay_ms = 60 * 1000;
+    rlog::console::configure(cfg);
+
+    log_to_console(rlog::verbosity::Info, "buffered info");
+    log_to_console(rlog::verbosity::Warning, "buffered warning");
+    CHECK(capture.content().empty());
+
+    // errors are written immediately, together with everything before them
+    log_to_console(rlog::verbosity::Error, "urgent error");
+    {
+        auto const s = capture.content();
+        auto const info = find(s, "buffered info\n");
+        auto const warning = find(s, "buffered warning\n");
+        auto const error = find(s, "urgent error\n");
+        CHECK(info >= 0);
+        CHECK(info < warning);
+        CHECK(warning < error);
+    }
+
+    log_to_console(rlog::verbosity::Info, "pending until flush");
+    CHECK(find(capture.content(), "pending until flush") < 0);
+    rlog::console::flush();
+    CHECK(find(capture.content(), "pending until flush") >= 0);
+
+    // size threshold
+    cfg.max_buffered_bytes = 1;
+    rlog::console::configure(cfg);
+    log_to_console(rlog::verbosity::Info, "over the size threshold");
+    CHECK(find(capture.content(), "over the size threshold") >= 0);
+
+    // leaving buffered mode writes everything pending
+    cfg.max_buffered_bytes = 64 * 1024;
+    rlog::console::configure(cfg);
+    log_to_console(rlog::verbosity::Info, "written on configure");
+    rlog::console::configure({});
+    CHECK(find(capture.content(), "written on configure") >= 0);
+}
+
+#endif
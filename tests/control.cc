@@ -0,0 +1,140 @@
+#include <nexus/test.hh>
+
+#include <cstdio>
+#include <cstring>
+
+#include <clean-core/macros.hh>
+#include <clean-core/string.hh>
+
+#include <rich-log/control.hh>
+#include <rich-log/log.hh>
+#include <rich-log/logger.hh>
+#include <rich-log/site_stats.hh>
+
+#ifndef CC_OS_WINDOWS
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+RICH_LOG_DECLARE_DOMAIN(ControlTest);
+RICH_LOG_DEFINE_DOMAIN(ControlTest, "control-test");
+
+namespace
+{
+bool contains(cc::string const& s, char const* needle) { return std::strstr(s.c_str(), needle) != nullptr; }
+
+#ifndef CC_OS_WINDOWS
+// what rlog-ctl does
+cc::string send_command(char const* path, char const* command)
+{
+    cc::string answer;
+
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    std::snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+    auto const fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (::connect(fd, reinterpret_cast<sockaddr const*>(&addr), sizeof(addr)) == 0)
+    {
+        ::send(fd, command, std::strlen(command), 0);
+        ::send(fd, "\n", 1, 0);
+
+        char buffer[256];
+        while (true)
+        {
+            auto const n = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0)
+                break;
+            answer += cc::string_view(buffer, size_t(n));
+        }
+    }
+    ::close(fd);
+    return answer;
+}
+#endif
+}
+
+TEST("control commands")
+{
+    auto& domain = Log::ControlTest::domain;
+
+    CHECK(contains(rlog::control::execute("help"), "break-level"));
+    CHECK(contains(rlog::control::execute("domains"), "control-test"));
+
+    CHECK(rlog::control::execute("level control-test DEBUG") == "1 domain(s) set to DEBUG\n");
+    CHECK(domain.min_verbosity == rlog::verbosity::Debug);
+    CHECK(rlog::control::execute("  level   control-*  warning ") == "1 domain(s) set to WARNING\n");
+    CHECK(domain.min_verbosity == rlog::verbosity::Warning);
+
+    // nothing changes on errors
+    CHECK(contains(rlog::control::execute("level control-test loud"), "error:"));
+    CHECK(contains(rlog::control::execute("level"), "error:"));
+    CHECK(contains(rlog::control::execute("unknown"), "error:"));
+    CHECK(contains(rlog::control::execute(""), "error:"));
+    CHECK(domain.min_verbosity == rlog::verbosity::Warning);
+
+    CHECK(rlog::control::execute("break-level error") == "breaking on LOGs at or above ERROR\n");
+    CHECK(rlog::control::execute("break-level fatal") == "breaking on LOGs at or above FATAL\n");
+
+    // sites are known once site stats counted them
+    rlog::location const* site = nullptr;
+    {
+        auto _ = rlog::scoped_logger_override(
+            [&](rlog::message_ref msg, bool&)
+            {
+                site = msg.location;
+                return true;
+            });
+
+        CHECK(rlog::control::execute("stats on") == "site statistics enabled\n");
+        LOGD(ControlTest, Warning, "a counted message");
+        CHECK(rlog::control::execute("stats off") == "site statistics disabled\n");
+    }
+
+    CHECK(site != nullptr);
+    if (site != nullptr)
+    {
+        char command[64];
+        std::snprintf(command, sizeof(command), "break tests/control.cc:%d", site->line);
+        CHECK(rlog::control::execute(command) == "started breaking on 1 site(s)\n");
+        CHECK(site->break_on_log);
+
+        CHECK(rlog::control::execute("break control.cc off") == "stopped breaking on 1 site(s)\n");
+        CHECK(!site->break_on_log);
+        CHECK(contains(rlog::control::execute("break ontrol.cc"), "0 site(s)"));
+    }
+
+    CHECK(contains(rlog::control::execute("stats"), "control.cc"));
+    CHECK(rlog::control::execute("stats reset") == "site statistics reset\n");
+
+    rlog::reset_min_verbosity(domain);
+}
+
+#ifndef CC_OS_WINDOWS
+TEST("control socket")
+{
+    auto& domain = Log::ControlTest::domain;
+
+    rlog::control::config cfg;
+    cfg.socket_path = "rlog-test-control.sock";
+    CHECK(rlog::control::start(cfg));
+    CHECK(rlog::control::get_socket_path() == "rlog-test-control.sock");
+
+    // only the user running the process can connect
+    struct stat st = {};
+    CHECK(::stat("rlog-test-control.sock", &st) == 0);
+    CHECK((st.st_mode & 0777) == 0600);
+
+    CHECK(send_command("rlog-test-control.sock", "level control-test error") == "1 domain(s) set to ERROR\n");
+    CHECK(domain.min_verbosity == rlog::verbosity::Error);
+    CHECK(contains(send_command("rlog-test-control.sock", "domains"), "control-test"));
+
+    rlog::control::stop();
+    CHECK(rlog::control::get_socket_path().empty());
+    CHECK(::access("rlog-test-control.sock", F_OK) != 0);
+
+    rlog::reset_min_verbosity(domain);
+}
+#endif
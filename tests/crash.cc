@@ -0,0 +1,152 @@
+#include <nexus/test.hh>
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+#include <clean-core/string.hh>
+#include <clean-core/vector.hh>
+
+#include <rich-log/async.hh>
+#include <rich-log/crash_handler.hh>
+#include <rich-log/log.hh>
+#include <rich-log/logger.hh>
+#include <rich-log/sink.hh>
+
+RICH_LOG_DECLARE_DOMAIN(CrashTest);
+RICH_LOG_DEFINE_DOMAIN(CrashTest, "CrashTest");
+
+namespace
+{
+// collects messages, optionally blocking the (async) caller on the first one until released
+struct blocking_sink final : rlog::sink
+{
+    cc::vector<cc::string>* messages;
+    std::atomic<bool>* is_blocked;
+    std::atomic<bool>* release;
+
+    blocking_sink(cc::vector<cc::string>* messages, std::atomic<bool>* is_blocked, std::atomic<bool>* release)
+      : messages(messages), is_blocked(is_blocked), release(release)
+    {
+    }
+
+    void write(rlog::message_ref const& msg) override
+    {
+        static std::mutex m;
+        {
+            auto _ = std::lock_guard<std::mutex>(m);
+            messages->push_back(msg.message);
+        }
+
+        is_blocked->store(true);
+        while (!release->load())
+            std::this_thread::yield();
+    }
+};
+
+cc::string read_file(char const* path)
+{
+    cc::string content;
+    auto const file = std::fopen(path, "rb");
+    if (!file)
+        return content;
+
+    char buffer[256];
+    while (auto const n = std::fread(buffer, 1, sizeof(buffer), file))
+        content += cc::string_view(buffer, n);
+    std::fclose(file);
+    return content;
+}
+}
+
+TEST("crash handler drains async buffers")
+{
+    auto const path = "rlog-test-crash.log";
+    std::remove(path);
+
+    rlog::crash::config cfg;
+    cfg.path = path;
+    CHECK(rlog::crash::install_handler(cfg));
+
+    cc::vector<cc::string> messages;
+    std::atomic<bool> is_blocked = false;
+    std::atomic<bool> release = false;
+    auto const id = rlog::add_sink(cc::make_unique<blocking_sink>(&messages, &is_blocked, &release));
+
+    rlog::async::enable();
+
+    // the background thread is stuck in the sink, so everything after the first message stays buffered
+    LOG("first");
+    while (!is_blocked.load())
+        std::this_thread::yield();
+
+    LOG("second %d", 2);
+    LOGD(CrashTest, Warning, "third {}", "text");
+
+    rlog::crash::drain_buffered_messages();
+
+    release = true;
+    rlog::async::shutdown();
+    rlog::remove_sink(id);
+    rlog::crash::uninstall_handler();
+
+    // drained messages are not dispatched again
+    CHECK(messages.size() == 1);
+    CHECK(messages[0] == "first");
+
+    // "hh:mm:ss.mmmZ SEVERITY Domain message", in logging order
+    cc::vector<cc::string> lines;
+    auto const content = read_file(path);
+    for (auto rest = cc::string_view(content); !rest.empty();)
+    {
+        size_t line_size = 0;
+        while (line_size < rest.size() && rest[line_size] != '\n')
+            ++line_size;
+
+        CHECK(line_size > 13);
+        if (line_size > 13)
+            lines.push_back(rest.subview(13, line_size - 13));
+        rest = rest.subview(line_size < rest.size() ? line_size + 1 : line_size);
+    }
+
+    // the message that is being dispatched is written as well, it might never reach the sink
+    CHECK(lines.size() == 3);
+    if (lines.size() == 3)
+    {
+        CHECK(lines[0] == " INFO first");
+        CHECK(lines[1] == " INFO second 2");
+        CHECK(lines[2] == " WARNING CrashTest third text");
+    }
+
+    std::remove(path);
+}
+
+TEST("fatal messages are written synchronously")
+{
+    cc::vector<cc::string> messages;
+    std::atomic<bool> is_blocked = false;
+    std::atomic<bool> release = true;
+    auto const id = rlog::add_sink(cc::make_unique<blocking_sink>(&messages, &is_blocked, &release));
+
+    // does not consume the message (so it reaches the sinks) and prevents the breakpoint
+    auto _ = rlog::scoped_logger_override(
+        [&](rlog::message_ref, bool& do_break)
+        {
+            do_break = false;
+            return false;
+        });
+
+    rlog::async::enable();
+
+    LOG("before");
+    LOGD(CrashTest, Fatal, "fatal");
+
+    // the earlier message was flushed before the fatal one, without waiting for the background thread
+    CHECK(messages.size() == 2);
+    CHECK(messages[0] == "before");
+    CHECK(messages[1] == "fatal");
+
+    rlog::async::shutdown();
+    rlog::remove_sink(id);
+}
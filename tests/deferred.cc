@@ -0,0 +1,108 @@
+#include <nexus/test.hh>
+
+#include <cstdio>
+
+#include <clean-core/string.hh>
+#include <clean-core/vector.hh>
+
+#include <rich-log/async.hh>
+#include <rich-log/detail/deferred.hh>
+#include <rich-log/log.hh>
+#include <rich-log/logger.hh>
+
+namespace
+{
+enum class color
+{
+    red,
+    green
+};
+
+template <class... Args>
+cc::string format_roundtrip(rlog::detail::captured_message<Args...> const& captured)
+{
+    auto const deferred = captured.as_deferred();
+
+    cc::vector<std::byte> data;
+    data.resize(deferred.vtable->serialized_size(deferred.args));
+    deferred.vtable->serialize(data.data(), deferred.args);
+
+    cc::string s;
+    deferred.vtable->format_serialized([&](cc::span<char const> chars) { s += cc::string_view(chars.data(), chars.size()); }, deferred.fmt_str,
+                                       data.data());
+    return s;
+}
+}
+
+TEST("deferred formatting")
+{
+    static_assert(rlog::detail::captured_message<int, float, char[4], cc::string_view, bool>::is_deferrable);
+    static_assert(!rlog::detail::captured_message<int, cc::vector<int>>::is_deferrable);
+
+    // NOTE: captured messages reference their arguments, so they must outlive it
+    auto i = 17;
+    auto ll = -3ll;
+    auto d = 2.5;
+    auto b = true;
+    cc::string str = "string";
+    char const* cstr = "cstr";
+    auto const captured = rlog::detail::capture("{} {} {} %s %s {} {}", i, ll, d, "lit", cstr, str, b);
+
+    CHECK(captured.format() == "17 -3 2.5 lit cstr string true");
+    CHECK(format_roundtrip(captured) == captured.format());
+    CHECK(format_roundtrip(rlog::detail::capture("no args %%")) == "no args %");
+
+    auto c = 'x';
+    auto e = color::green;
+    auto const with_enum = rlog::detail::capture("{} {}", c, e);
+    CHECK(format_roundtrip(with_enum) == with_enum.format());
+
+    // runtime format strings are formatted eagerly
+    char const* fmt = "runtime {}";
+    cc::string eager = rlog::detail::capture(fmt, 1);
+    CHECK(eager == "runtime 1");
+
+    // so are char buffers (they are not literals, their address must not be kept)
+    char buffer[32] = "buffer {}";
+    cc::string eager_buffer = rlog::detail::capture(buffer, 2);
+    CHECK(eager_buffer == "buffer 2");
+
+    // the LOG macros reference them, but never serialize them
+    CHECK(DETAIL_RICH_LOG_CAPTURE("literal {}", 3).as_deferred().is_serializable());
+    CHECK(!DETAIL_RICH_LOG_CAPTURE(buffer, 3).as_deferred().is_serializable());
+}
+
+TEST("deferred async logging")
+{
+    cc::vector<cc::string> messages;
+    rlog::set_global_default_logger(
+        [&](rlog::message_ref m, bool&)
+        {
+            messages.push_back(m.message);
+            return true;
+        });
+
+    rlog::async::enable();
+
+    {
+        cc::string temporary = "temporary";
+        LOG("int %d, float {}, string {}", 42, 0.5f, temporary);
+        temporary = "overwritten";
+    }
+    LOG("vector {}", cc::vector<int>{1, 2}.size());
+    {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "buffer %s", "{}");
+        LOG(buffer, 3);
+        std::snprintf(buffer, sizeof(buffer), "overwritten");
+    }
+
+    rlog::async::shutdown();
+
+    CHECK(messages.size() == 3);
+    CHECK(messages[0] == "int 42, float 0.5, string temporary");
+    CHECK(messages[1] == "vector 2");
+    CHECK(messages[2] == "buffer 3");
+
+    rlog::set_global_default_logger({});
+}
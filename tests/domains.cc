@@ -1,5 +1,8 @@
 #include <nexus/test.hh>
 
+#include <atomic>
+#include <thread>
+
 #include <rich-log/log.hh>
 #include <rich-log/logger.hh>
 
@@ -64,3 +67,163 @@ TEST("domains in namespaces")
     CHECK(domain_name == "mylib.default");
 }
 }
+
+// registered out of order on purpose: the hierarchy must not depend on static initialization order
+RICH_LOG_DECLARE_DOMAIN(Tree::Mesh::FBX);
+RICH_LOG_DECLARE_DOMAIN(Tree::Mesh);
+RICH_LOG_DECLARE_DOMAIN(Tree::Net::Http);
+RICH_LOG_DECLARE_DOMAIN(Tree);
+RICH_LOG_DEFINE_DOMAIN(Tree::Mesh::FBX, "Tree::Mesh::FBX");
+RICH_LOG_DEFINE_DOMAIN(Tree::Net::Http, "Tree::Net::Http");
+RICH_LOG_DEFINE_DOMAIN(Tree, "Tree");
+RICH_LOG_DEFINE_DOMAIN(Tree::Mesh, "Tree::Mesh");
+
+TEST("domain hierarchy")
+{
+    auto& root = Log::Tree::domain;
+    auto& mesh = Log::Tree::Mesh::domain;
+    auto& fbx = Log::Tree::Mesh::FBX::domain;
+    auto& http = Log::Tree::Net::Http::domain;
+
+    CHECK(root.parent == nullptr);
+    CHECK(mesh.parent == &root);
+    CHECK(fbx.parent == &mesh);
+    CHECK(http.parent == &root); // "Tree::Net" is not a domain
+
+    auto child_count = 0;
+    for (auto c = root.first_child; c != nullptr; c = c->next_sibling)
+    {
+        CHECK((c == &mesh || c == &http));
+        ++child_count;
+    }
+    CHECK(child_count == 2);
+
+    CHECK(rlog::find_domain("Tree::Mesh::FBX") == &fbx);
+    CHECK(rlog::find_domain("Tree::Net") == nullptr);
+    CHECK(rlog::find_domain("default") == &Log::Default::domain);
+
+    // levels are inherited eagerly
+    rlog::set_min_verbosity(root, rlog::verbosity::Debug);
+    CHECK(mesh.min_verbosity == rlog::verbosity::Debug);
+    CHECK(fbx.min_verbosity == rlog::verbosity::Debug);
+    CHECK(http.min_verbosity == rlog::verbosity::Debug);
+
+    // .. except for domains with their own level
+    rlog::set_min_verbosity(mesh, rlog::verbosity::Error);
+    rlog::set_min_verbosity(root, rlog::verbosity::Warning);
+    CHECK(root.min_verbosity == rlog::verbosity::Warning);
+    CHECK(mesh.min_verbosity == rlog::verbosity::Error);
+    CHECK(fbx.min_verbosity == rlog::verbosity::Error);
+    CHECK(http.min_verbosity == rlog::verbosity::Warning);
+
+    cc::string msg;
+    auto _ = rlog::scoped_logger_override(
+        [&](rlog::message_ref m, bool&)
+        {
+            msg = m.message;
+            return true;
+        });
+    LOGD(Tree::Mesh::FBX, Warning, "fbx warning");
+    CHECK(msg == "");
+    LOGD(Tree::Net::Http, Warning, "http warning");
+    CHECK(msg == "http warning");
+
+    // patterns
+    CHECK(rlog::set_min_verbosity("Tree::*", rlog::verbosity::Trace) == 3);
+    CHECK(root.min_verbosity == rlog::verbosity::Warning);
+    CHECK(fbx.min_verbosity == rlog::verbosity::Trace);
+    CHECK(rlog::set_min_verbosity("Tree::Mesh", rlog::verbosity::Info) == 1);
+    CHECK(mesh.min_verbosity == rlog::verbosity::Info);
+    CHECK(fbx.min_verbosity == rlog::verbosity::Trace);
+
+    // back to inheritance
+    for (auto d : {&fbx, &mesh, &http, &root})
+        rlog::reset_min_verbosity(*d);
+    CHECK(root.min_verbosity == rlog::verbosity::Info);
+    CHECK(fbx.min_verbosity == rlog::verbosity::Info);
+}
+
+TEST("domain registration and unregistration")
+{
+    auto const version_before = rlog::get_domains().version();
+    auto const count_before = rlog::get_domains().size();
+
+    // like domains of a shared library that is loaded and unloaded
+    rlog::domain_info plugin = rlog::domain_info::make_named("Tree::Mesh::Plugin");
+    rlog::domain_info plugin_io = rlog::domain_info::make_named("Tree::Mesh::Plugin::IO");
+    {
+        auto const reg = rlog::detail::domain_registerer(&plugin);
+        auto const reg_io = rlog::detail::domain_registerer(&plugin_io);
+
+        CHECK(plugin.registration_id != 0);
+        CHECK(plugin_io.registration_id > plugin.registration_id);
+        CHECK(plugin.parent == &Log::Tree::Mesh::domain);
+        CHECK(plugin_io.parent == &plugin);
+
+        auto const snapshot = rlog::get_domains();
+        CHECK(snapshot.version() == version_before + 2);
+        CHECK(snapshot.size() == count_before + 2);
+        CHECK(snapshot.find("Tree::Mesh::Plugin::IO") == &plugin_io);
+        CHECK(rlog::find_domain("Tree::Mesh::Plugin") == &plugin);
+    }
+
+    CHECK(plugin.registration_id == 0);
+    CHECK(plugin_io.registration_id == 0);
+    CHECK(rlog::find_domain("Tree::Mesh::Plugin") == nullptr);
+    CHECK(rlog::find_domain("Tree::Mesh::Plugin::IO") == nullptr);
+    CHECK(rlog::find_domain("Tree::Mesh") == &Log::Tree::Mesh::domain);
+    CHECK(rlog::get_domains().version() == version_before + 4);
+    CHECK(rlog::get_domains().size() == count_before);
+
+    // no dangling links
+    for (auto c = Log::Tree::Mesh::domain.first_child; c != nullptr; c = c->next_sibling)
+        CHECK(c == &Log::Tree::Mesh::FBX::domain);
+
+    // children of an unregistered domain move up
+    {
+        auto const reg_io = rlog::detail::domain_registerer(&plugin_io);
+        {
+            auto const reg = rlog::detail::domain_registerer(&plugin);
+            CHECK(plugin_io.parent == &plugin);
+
+            rlog::set_min_verbosity(plugin, rlog::verbosity::Error);
+            CHECK(plugin_io.min_verbosity == rlog::verbosity::Error);
+        }
+        CHECK(plugin_io.parent == &Log::Tree::Mesh::domain);
+        CHECK(plugin_io.min_verbosity == Log::Tree::Mesh::domain.min_verbosity.load());
+    }
+}
+
+TEST("domain snapshots while registering")
+{
+    std::atomic<bool> done = false;
+    std::atomic<int> missing = 0;
+
+    // readers never see a partially updated or freed list
+    auto reader = std::thread(
+        [&]
+        {
+            while (!done)
+            {
+                auto const snapshot = rlog::get_domains();
+                auto has_default = false;
+                for (auto d : snapshot)
+                    if (cc::string_view(d->name) == "default")
+                        has_default = true;
+                if (!has_default || snapshot.find("default") != &Log::Default::domain)
+                    ++missing;
+            }
+        });
+
+    for (auto i = 0; i < 200; ++i)
+    {
+        rlog::domain_info d = rlog::domain_info::make_named("Dyn::Domain");
+        auto const reg = rlog::detail::domain_registerer(&d);
+        CHECK(rlog::find_domain("Dyn::Domain") == &d);
+    }
+
+    done = true;
+    reader.join();
+    CHECK(missing == 0);
+    CHECK(rlog::find_domain("Dyn::Domain") == nullptr);
+}
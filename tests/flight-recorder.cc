@@ -0,0 +1,159 @@
+#include <nexus/test.hh>
+
+#include <thread>
+
+#include <clean-core/string.hh>
+#include <clean-core/vector.hh>
+
+#include <rich-log/flight_recorder.hh>
+#include <rich-log/log.hh>
+#include <rich-log/logger.hh>
+
+RICH_LOG_DECLARE_DOMAIN(Flight);
+RICH_LOG_DEFINE_DOMAIN(Flight, "Flight");
+
+namespace
+{
+struct captured
+{
+    cc::string message;
+    cc::string thread_name;
+    rlog::verbosity::type verbosity;
+};
+}
+
+TEST("flight recorder")
+{
+    cc::vector<captured> messages;
+    auto _ = rlog::scoped_logger_override(
+        [&](rlog::message_ref m, bool& do_break)
+        {
+            messages.push_back({m.message, m.thread_name, m.verbosity});
+            do_break = false;
+            return true;
+        });
+
+    rlog::set_min_verbosity(Log::Flight::domain, rlog::verbosity::Info);
+
+    rlog::flight::config cfg;
+    cfg.buffer_size = 4096;
+    cfg.max_dumped_records = 3;
+    rlog::flight::enable(cfg);
+
+    // many more records than fit into the ring
+    for (auto i = 0; i < 500; ++i)
+        LOGD(Flight, Debug, "step %d", i);
+    LOGD(Flight, Trace, "trace {}", "text");
+    LOGS(Flight, Debug, "structured", rlog::kv("n", 1));
+    CHECK(messages.empty());
+
+    LOGD(Flight, Error, "failed");
+    CHECK(messages.size() == 5);
+    if (messages.size() == 5)
+    {
+        CHECK(messages[0].message == "flight recorder: 3 recent message(s) below the log level");
+        CHECK(messages[1].message == "step 499");
+        CHECK(messages[1].verbosity == rlog::verbosity::Debug);
+        CHECK(messages[2].message == "trace text");
+        CHECK(messages[2].verbosity == rlog::verbosity::Trace);
+        CHECK(messages[3].message == "structured n=1");
+        CHECK(messages[4].message == "failed");
+    }
+
+    // every record is dumped only once
+    messages.clear();
+    LOGD(Flight, Error, "failed again");
+    CHECK(messages.size() == 1);
+
+    // records of other threads only with dump_all_threads
+    std::thread(
+        []
+        {
+            rlog::set_current_thread_name("worker");
+            LOGD(Flight, Debug, "from worker");
+        })
+        .join();
+
+    messages.clear();
+    LOGD(Flight, Error, "own thread only");
+    CHECK(messages.size() == 1);
+
+    messages.clear();
+    rlog::flight::dump(true);
+    CHECK(messages.size() == 2);
+    if (messages.size() == 2)
+    {
+        CHECK(messages[1].message == "from worker");
+        CHECK(messages[1].thread_name == "worker");
+    }
+
+    rlog::flight::disable();
+    CHECK(!rlog::flight::is_enabled());
+
+    messages.clear();
+    LOGD(Flight, Debug, "not recorded");
+    LOGD(Flight, Error, "no context");
+    CHECK(messages.size() == 1);
+}
+
+TEST("flight recorder short-lived threads")
+{
+    cc::vector<cc::string> messages;
+    auto _ = rlog::scoped_logger_override(
+        [&](rlog::message_ref m, bool&)
+        {
+            messages.push_back(m.message);
+            return true;
+        });
+
+    rlog::set_min_verbosity(Log::Flight::domain, rlog::verbosity::Info);
+    rlog::flight::enable();
+
+    // each thread frees the rings of the threads that exited before it
+    for (auto i = 0; i < 20; ++i)
+        std::thread([i] { LOGD(Flight, Debug, "short-lived %d", i); }).join();
+
+    rlog::flight::dump(true);
+    CHECK(messages.size() == 2);
+    if (messages.size() == 2)
+        CHECK(messages[1] == "short-lived 19");
+
+    rlog::flight::disable();
+    rlog::reset_min_verbosity(Log::Flight::domain);
+}
+
+TEST("flight recorder unregistered domains")
+{
+    cc::vector<cc::string> messages;
+    auto _ = rlog::scoped_logger_override(
+        [&](rlog::message_ref m, bool& do_break)
+        {
+            messages.push_back(m.message);
+            do_break = false;
+            return true;
+        });
+
+    rlog::set_min_verbosity(Log::Flight::domain, rlog::verbosity::Info);
+    rlog::flight::enable();
+
+    // like a shared library that logs and is unloaded, its records point into its code and data
+    rlog::location plugin_location = {"plugin", __FILE__, __LINE__};
+    rlog::domain_info plugin = rlog::domain_info::make_named("FlightPlugin");
+    {
+        auto const reg = rlog::detail::domain_registerer(&plugin);
+        rlog::detail::record_flight(plugin, rlog::verbosity::Debug, &plugin_location, cc::string_view("from the plugin"));
+        LOGD(Flight, Debug, "before unloading");
+    }
+    LOGD(Flight, Debug, "after unloading");
+
+    LOGD(Flight, Error, "failed");
+    CHECK(messages.size() == 4);
+    if (messages.size() == 4)
+    {
+        CHECK(messages[1] == "before unloading");
+        CHECK(messages[2] == "after unloading");
+    }
+
+    rlog::flight::disable();
+    rlog::reset_min_verbosity(Log::Flight::domain);
+}
@@ -0,0 +1,60 @@
+#include <nexus/test.hh>
+
+#include <cstdio>
+
+#include <clean-core/string.hh>
+
+#include <rich-log/detail/compiled_format.hh>
+#include <rich-log/log.hh>
+#include <rich-log/logger.hh>
+
+TEST("compiled format strings")
+{
+    using rlog::detail::arg_category;
+
+    // segments: "a ", "{}", " b ", "%s", " c"
+    constexpr arg_category args[] = {arg_category::integral, arg_category::other};
+    static_assert(rlog::detail::parse_format_string("a {} b %s c", args, 2, [](auto const&) {}) == 5);
+    static_assert(rlog::detail::parse_format_string("%%{{}}", args, 0, [](auto const&) {}) == 3);
+
+    // a stray '%' leaves the whole string to the runtime formatter
+    static_assert(rlog::detail::parse_format_string("50%", args, 0, [](auto const&) {}) == rlog::detail::parsed_at_runtime);
+    static_assert(rlog::detail::parse_format_string("100% done", args, 0, [](auto const&) {}) == rlog::detail::parsed_at_runtime);
+    static_assert(rlog::detail::parse_format_string("{} is 50%", args, 1, [](auto const&) {}) == rlog::detail::parsed_at_runtime);
+
+    cc::string msg;
+    auto _ = rlog::scoped_logger_override(
+        [&](rlog::message_ref m, bool&)
+        {
+            msg = m.message;
+            return true;
+        });
+
+    LOG("{} + {} = %d%%", 1, 2, 3);
+    CHECK(msg == "1 + 2 = 3%");
+
+    LOG("{1} {0}", "a", "b");
+    CHECK(msg == "b a");
+
+    LOG("{{literal}} %s", "x");
+    CHECK(msg == "{literal} x");
+
+    LOG("no placeholders");
+    CHECK(msg == "no placeholders");
+
+    // runtime format strings are parsed at runtime
+    char const* runtime_fmt = "runtime {}";
+    LOG(runtime_fmt, 5);
+    CHECK(msg == "runtime 5");
+
+    // so are char buffers
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "buffer %s", "{}");
+    LOG(buffer, 6);
+    CHECK(msg == "buffer 6");
+
+    LOG("50%");
+    CHECK(msg == rlog::detail::format("50%"));
+    LOG("100% done");
+    CHECK(msg == rlog::detail::format("100% done"));
+}
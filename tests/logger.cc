@@ -1,6 +1,13 @@
 #include <nexus/test.hh>
 
+#include <cstring>
+#include <thread>
+
+#include <clean-core/string.hh>
+#include <clean-core/vector.hh>
+
 #include <rich-log/log.hh>
+#include <rich-log/log_line.hh>
 #include <rich-log/logger.hh>
 
 RICH_LOG_DECLARE_DOMAIN(Test);
@@ -75,3 +82,133 @@ TEST("default logger")
 
     rlog::set_global_default_logger({});
 }
+
+TEST("logger silence")
+{
+    cc::vector<cc::string> messages;
+    auto _ = rlog::scoped_logger_override(
+        [&](rlog::message_ref m, bool& do_break)
+        {
+            messages.push_back(m.message);
+            do_break = false;
+            return true;
+        });
+
+    auto evaluated = 0;
+    {
+        auto _ = rlog::scoped_logger_silence{true, rlog::verbosity::Warning};
+
+        // silenced LOGs do not even evaluate their arguments
+        LOG("silenced %d", ++evaluated);
+        LOGD(Test, Warning, "silenced {}", ++evaluated);
+        LOGD(Test, Error, "error %d", ++evaluated);
+        CHECK(evaluated == 1);
+
+        {
+            // loggers pushed on top of a silence still see everything
+            cc::string inner;
+            auto _ = rlog::scoped_logger_override(
+                [&](rlog::message_ref m, bool&)
+                {
+                    inner = m.message;
+                    return m.verbosity == rlog::verbosity::Warning;
+                });
+
+            LOGD(Test, Warning, "warning");
+            CHECK(inner == "warning");
+
+            // not consumed, so the silence below drops it
+            LOG("info");
+            CHECK(inner == "info");
+
+            auto const s = rlog::scoped_logger_silence{};
+            LOG("silenced again");
+            CHECK(inner == "info");
+        }
+
+        LOG("silenced %d", ++evaluated);
+        CHECK(evaluated == 1);
+    }
+
+    {
+        auto _ = rlog::scoped_logger_silence{false};
+        LOG("not silenced");
+    }
+
+    LOG("after");
+
+    CHECK(messages.size() == 3);
+    if (messages.size() == 3)
+    {
+        CHECK(messages[0] == "error 1");
+        CHECK(messages[1] == "not silenced");
+        CHECK(messages[2] == "after");
+    }
+}
+
+TEST("thread ids")
+{
+    auto id = uint16_t(0);
+    auto name = cc::string_view();
+    auto const capture = [&](rlog::message_ref m, bool&)
+    {
+        id = m.thread_id;
+        name = m.thread_name;
+        return true;
+    };
+
+    auto _ = rlog::scoped_logger_override(capture);
+
+    LOG("main");
+    auto const main_id = id;
+    CHECK(main_id != rlog::no_thread_id);
+    CHECK(main_id == rlog::get_current_thread_id());
+
+    rlog::set_current_thread_name("main-%d", 1);
+    LOG("named");
+    CHECK(id == main_id);
+    CHECK(name == "main-1");
+    CHECK(cc::string_view(rlog::get_thread_name(main_id)) == "main-1");
+
+    // names are interned, the same name has the same address
+    auto const interned = name.data();
+    rlog::set_current_thread_name("other");
+    rlog::set_current_thread_name("main-1");
+    CHECK(rlog::get_current_thread_name() == interned);
+
+    // other threads get other ids, which are reused once they exit
+    auto other_id = uint16_t(0);
+    cc::string other_name;
+    auto t = std::thread(
+        [&]
+        {
+            auto _ = rlog::scoped_logger_override(capture);
+            rlog::set_current_thread_name("worker");
+            LOG("from worker");
+            other_id = id;
+            other_name = rlog::get_thread_name(other_id);
+        });
+    t.join();
+
+    CHECK(other_id != rlog::no_thread_id);
+    CHECK(other_name == "worker");
+    CHECK(name == "worker");
+    CHECK(other_id != main_id);
+    CHECK(cc::string_view(rlog::get_thread_name(other_id)) == "");
+
+    rlog::set_current_thread_name(nullptr);
+    LOG("unnamed");
+    CHECK(name.empty());
+    CHECK(cc::string_view(rlog::get_thread_name(main_id)) == "");
+
+    // the verbose line shows unnamed threads by id
+    cc::string line;
+    rlog::message_ref msg;
+    msg.timestamp = rlog::get_current_timestamp();
+    msg.domain = &Log::Default::domain;
+    msg.verbosity = rlog::verbosity::Info;
+    msg.thread_id = 7;
+    msg.message = "text";
+    rlog::append_log_line(line, msg, rlog::console_log_style::verbose_no_color);
+    CHECK(std::strstr(line.c_str(), " t007 ") != nullptr);
+}
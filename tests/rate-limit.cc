@@ -1,5 +1,14 @@
 #include <nexus/test.hh>
 
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include <clean-core/string.hh>
+#include <clean-core/vector.hh>
+
+#include <rich-log/auto_limit.hh>
 #include <rich-log/log.hh>
 #include <rich-log/logger.hh>
 
@@ -27,3 +36,193 @@ TEST("logger cooldown verbosity")
         LOGD_ONCE(_once, Default, Info, "many logs, captured once");
     CHECK(msg_cnt == 12);
 }
+
+TEST("rate limiters")
+{
+    int msg_cnt = 0;
+    auto _ = rlog::scoped_logger_override(
+        [&](rlog::message_ref, bool&)
+        {
+            msg_cnt++;
+            return true;
+        });
+
+    rlog::rate::every_nth nth(3);
+    for (auto i = 0; i < 9; ++i)
+        LOG_ONCE(nth, "every third");
+    CHECK(msg_cnt == 3);
+
+    msg_cnt = 0;
+    rlog::rate::exponential_backoff backoff;
+    for (auto i = 0; i < 16; ++i)
+        LOG_ONCE(backoff, "backoff"); // 1, 2, 4, 8, 16
+    CHECK(msg_cnt == 5);
+
+    msg_cnt = 0;
+    rlog::rate::token_bucket bucket(3, 0.001);
+    for (auto i = 0; i < 10; ++i)
+        LOG_ONCE(bucket, "bucket");
+    CHECK(msg_cnt == 3);
+
+    msg_cnt = 0;
+    rlog::rate::time_limited limited(1000.0);
+    for (auto i = 0; i < 10; ++i)
+        LOG_ONCE(limited, "time limited");
+    CHECK(msg_cnt == 1);
+
+    // the interval can also be set after construction
+    msg_cnt = 0;
+    rlog::rate::time_limited limited_later;
+    limited_later.interval_sec = 1000.0;
+    for (auto i = 0; i < 10; ++i)
+        LOG_ONCE(limited_later, "time limited");
+    CHECK(msg_cnt == 1);
+}
+
+TEST("rate limiters are thread-safe")
+{
+    rlog::rate::once once;
+    rlog::rate::every_nth nth(10);
+
+    std::atomic<int> once_cnt = 0;
+    std::atomic<int> nth_cnt = 0;
+
+    cc::vector<std::thread> threads;
+    for (auto t = 0; t < 8; ++t)
+        threads.emplace_back(
+            [&]
+            {
+                for (auto i = 0; i < 1000; ++i)
+                {
+                    if (once.try_log())
+                        once_cnt++;
+                    if (nth.try_log())
+                        nth_cnt++;
+                }
+            });
+    for (auto& t : threads)
+        t.join();
+
+    CHECK(once_cnt == 1);
+    CHECK(nth_cnt == 800);
+}
+
+TEST("automatic rate limit")
+{
+    cc::vector<cc::string> messages;
+    auto _ = rlog::scoped_logger_override(
+        [&](rlog::message_ref m, bool&)
+        {
+            messages.push_back(m.message);
+            return true;
+        });
+
+    rlog::rate::auto_limit_policy policy;
+    policy.burst = 3;
+    policy.per_second = 0.001;
+    rlog::rate::set_auto_limit(policy);
+
+    auto const log_value = [](int v) { LOG("value %d", v); };
+
+    for (auto i = 0; i < 10; ++i)
+        log_value(1); // collapsed, does not take from the budget
+    log_value(2);
+    log_value(3);
+    log_value(4); // dropped
+    log_value(5); // dropped
+    rlog::rate::flush_auto_limit();
+
+    CHECK(messages.size() == 5);
+    CHECK(messages[0] == "value 1");
+    CHECK(messages[1] == "last message repeated 9 times");
+    CHECK(messages[2] == "value 2");
+    CHECK(messages[3] == "value 3");
+    CHECK(messages[4] == "2 messages dropped by the rate limit");
+
+    // messages without serializable arguments are compared by text and fields
+    messages.clear();
+    for (auto i = 0; i < 3; ++i)
+        LOGS(Default, Info, "structured", rlog::kv("n", 1));
+    rlog::rate::disable_auto_limit();
+
+    CHECK(messages.size() == 2);
+    CHECK(messages[0] == "structured");
+    CHECK(messages[1] == "last message repeated 2 times");
+
+    LOG("not limited anymore");
+    CHECK(messages.size() == 3);
+}
+
+TEST("automatic rate limit summaries are flushed in the background")
+{
+    std::mutex mutex;
+    cc::vector<cc::string> messages;
+    rlog::set_global_default_logger(
+        [&](rlog::message_ref m, bool&)
+        {
+            auto _ = std::lock_guard<std::mutex>(mutex);
+            messages.push_back(m.message);
+            return true;
+        });
+
+    rlog::rate::auto_limit_policy policy;
+    policy.repeat_report_interval = 0.01;
+    rlog::rate::set_auto_limit(policy);
+
+    // the site goes quiet after the repeats, the summary must not wait for its next message
+    for (auto i = 0; i < 5; ++i)
+        LOG("repeated");
+
+    auto has_summary = false;
+    for (auto i = 0; i < 500 && !has_summary; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        auto _ = std::lock_guard<std::mutex>(mutex);
+        has_summary = messages.size() == 2;
+    }
+
+    rlog::rate::disable_auto_limit();
+    rlog::set_global_default_logger({});
+
+    CHECK(has_summary);
+    CHECK(messages.size() == 2);
+    if (messages.size() == 2)
+    {
+        CHECK(messages[0] == "repeated");
+        CHECK(messages[1] == "last message repeated 4 times");
+    }
+}
+
+TEST("automatic rate limit of unregistered domains")
+{
+    cc::vector<cc::string> messages;
+    auto _ = rlog::scoped_logger_override(
+        [&](rlog::message_ref m, bool&)
+        {
+            messages.push_back(m.message);
+            return true;
+        });
+
+    rlog::rate::set_auto_limit({});
+
+    // like a shared library that logs and is unloaded, its sites must not be visited anymore (e.g. by the background thread)
+    rlog::location plugin_location = {"plugin", __FILE__, __LINE__};
+    rlog::domain_info plugin = rlog::domain_info::make_named("LimitPlugin");
+    {
+        auto const reg = rlog::detail::domain_registerer(&plugin);
+        for (auto i = 0; i < 3; ++i)
+            rlog::detail::do_log(plugin, rlog::verbosity::Info, &plugin_location, cc::string_view("repeated"));
+        CHECK(messages.size() == 1);
+    }
+
+    // the pending summary is logged when the domain goes away
+    CHECK(messages.size() == 2);
+    if (messages.size() == 2)
+        CHECK(messages[1] == "last message repeated 2 times");
+    CHECK(plugin_location.limit.load() == nullptr);
+
+    rlog::rate::flush_auto_limit();
+    CHECK(messages.size() == 2);
+
+    rlog::rate::disable_auto_limit();
+}
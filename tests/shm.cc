@@ -0,0 +1,265 @@
+#include <nexus/test.hh>
+
+#include <cstdio>
+#include <new>
+#include <thread>
+
+#include <clean-core/string.hh>
+#include <clean-core/vector.hh>
+
+#include <rich-log/log.hh>
+#include <rich-log/log_line.hh>
+#include <rich-log/logger.hh>
+#include <rich-log/shm_logger.hh>
+
+RICH_LOG_DECLARE_DOMAIN(ShmTest);
+RICH_LOG_DEFINE_DOMAIN(ShmTest, "shm");
+
+namespace
+{
+struct received
+{
+    cc::string message;
+    cc::string domain;
+    cc::string thread_name;
+    rlog::verbosity::type verbosity;
+    int line;
+};
+}
+
+TEST("shared-memory logger")
+{
+    char name[64];
+    std::snprintf(name, sizeof(name), "test-%d", int(rlog::get_current_timestamp().wall_ns % 1000000));
+
+    cc::vector<received> messages;
+    auto const on_message = [&](rlog::message_ref const& msg)
+    { messages.push_back({msg.message, msg.domain->name, msg.thread_name, msg.verbosity, msg.location ? msg.location->line : 0}); };
+
+    rlog::shm_config cfg;
+    cfg.name = name;
+    cfg.ring_size = 64 * 1024;
+
+    {
+        rlog::shm_logger logger(cfg);
+        CHECK(logger.is_valid());
+
+        // local loggers are per thread, so the writer thread below pushes the same one
+        auto const to_shm = [&](rlog::message_ref msg, bool&)
+        {
+            logger.write(msg);
+            return true;
+        };
+        auto _ = rlog::scoped_logger_override(to_shm);
+
+        // the reader can start before or after the first message
+        rlog::shm_reader reader(name);
+        CHECK(reader.is_valid());
+        CHECK(!reader.is_producer_done());
+
+        rlog::set_current_thread_name("main");
+        LOG("hello %s", "shm");
+        auto const line = __LINE__ - 1;
+        LOGD(ShmTest, Warning, "two\nlines");
+        rlog::set_current_thread_name(nullptr);
+        LOG("unnamed");
+
+        CHECK(reader.read(on_message) == 3);
+        CHECK(messages.size() == 3);
+        if (messages.size() == 3)
+        {
+            CHECK(messages[0].message == "hello shm");
+            CHECK(messages[0].domain == Log::Default::domain.name);
+            CHECK(messages[0].thread_name == "main");
+            CHECK(messages[0].verbosity == rlog::verbosity::Info);
+            CHECK(messages[0].line == line);
+            CHECK(messages[1].message == "two\nlines");
+            CHECK(messages[1].domain == "shm");
+            CHECK(messages[1].verbosity == rlog::verbosity::Warning);
+            CHECK(messages[2].thread_name == "");
+        }
+
+        // wraps around the ring many times, while reading concurrently
+        messages.clear();
+        auto t = std::thread(
+            [&]
+            {
+                auto _ = rlog::scoped_logger_override(to_shm);
+                rlog::set_current_thread_name("writer");
+                for (auto i = 0; i < 5000; ++i)
+                    LOGD(ShmTest, Info, "message %d with some padding to fill the ring faster", i);
+            });
+
+        auto read_count = size_t(0);
+        while (read_count + reader.dropped_count() < 5000)
+            read_count += reader.read(on_message);
+        t.join();
+
+        CHECK(read_count == messages.size());
+        CHECK(read_count > 0);
+        auto in_order = true;
+        auto last = -1;
+        for (auto const& m : messages)
+        {
+            auto i = -1;
+            std::sscanf(m.message.c_str(), "message %d", &i);
+            in_order &= i > last && m.thread_name == "writer" && m.domain == "shm";
+            last = i;
+        }
+        CHECK(in_order);
+
+        // nobody reads: the ring fills up and further messages are dropped
+        for (auto i = 0; i < 2000; ++i)
+            LOG("dropped %d", i);
+        CHECK(reader.dropped_count() > 0);
+        CHECK(reader.dropped_count() == logger.dropped_count());
+    }
+
+    // the segment outlives the producer
+    rlog::shm_reader reader(name);
+    CHECK(reader.is_valid());
+    CHECK(reader.is_producer_done());
+
+    messages.clear();
+    CHECK(reader.read(on_message) > 0);
+    CHECK(messages.size() > 0);
+    if (messages.size() > 0)
+        CHECK(messages[0].message == "dropped 0");
+
+    reader.remove_segment();
+    CHECK(!rlog::shm_reader(name).is_valid());
+}
+
+TEST("shared-memory logger domain ids")
+{
+    char name[64];
+    std::snprintf(name, sizeof(name), "test-domains-%d", int(rlog::get_current_timestamp().wall_ns % 1000000));
+
+    // registration ids are never reused and can exceed the 16 bit of the record, the segment uses its own dense ids
+    auto first = rlog::domain_info::make_named("first");
+    auto second = rlog::domain_info::make_named("second");
+    first.registration_id = 0x10001;
+    second.registration_id = 0x20001;
+
+    rlog::shm_config cfg;
+    cfg.name = name;
+
+    cc::vector<cc::string> domains;
+    {
+        rlog::shm_logger logger(cfg);
+
+        rlog::message_ref msg;
+        msg.timestamp = rlog::get_current_timestamp();
+        msg.location = nullptr;
+        msg.verbosity = rlog::verbosity::Info;
+        msg.message = "message";
+        for (auto d : {&first, &second, &first})
+        {
+            msg.domain = d;
+            logger.write(msg);
+        }
+
+        rlog::shm_reader reader(name);
+        CHECK(reader.read([&](rlog::message_ref const& m) { domains.push_back(m.domain->name); }) == 3);
+        reader.remove_segment();
+    }
+
+    CHECK(domains.size() == 3);
+    if (domains.size() == 3)
+    {
+        CHECK(domains[0] == "first");
+        CHECK(domains[1] == "second");
+        CHECK(domains[2] == "first");
+    }
+}
+
+TEST("shared-memory logger reused location addresses")
+{
+    char name[64];
+    std::snprintf(name, sizeof(name), "test-locations-%d", int(rlog::get_current_timestamp().wall_ns % 1000000));
+
+    // a shared library that is unloaded and loaded again might get its sites at the same addresses as before
+    // its domains are registered again though, i.e. they have new registration ids
+    auto before = rlog::domain_info::make_named("plugin");
+    auto after = rlog::domain_info::make_named("plugin");
+    before.registration_id = 0x30001;
+    after.registration_id = 0x30002;
+
+    rlog::shm_config cfg;
+    cfg.name = name;
+
+    alignas(rlog::location) std::byte storage[sizeof(rlog::location)];
+    cc::vector<cc::string> files;
+    {
+        rlog::shm_logger logger(cfg);
+        rlog::shm_reader reader(name);
+
+        rlog::message_ref msg;
+        msg.timestamp = rlog::get_current_timestamp();
+        msg.verbosity = rlog::verbosity::Info;
+        msg.message = "message";
+
+        msg.domain = &before;
+        msg.location = new (storage) rlog::location{"before", "before.cc", 1};
+        logger.write(msg);
+
+        msg.domain = &after;
+        msg.location = new (storage) rlog::location{"after", "after.cc", 2};
+        logger.write(msg);
+
+        CHECK(reader.read([&](rlog::message_ref const& m) { files.push_back(m.location->file); }) == 2);
+        reader.remove_segment();
+    }
+
+    CHECK(files.size() == 2);
+    if (files.size() == 2)
+    {
+        CHECK(files[0] == "before.cc");
+        CHECK(files[1] == "after.cc");
+    }
+}
+
+TEST("shared-memory logger thread names")
+{
+    char name[64];
+    std::snprintf(name, sizeof(name), "test-threads-%d", int(rlog::get_current_timestamp().wall_ns % 1000000));
+
+    rlog::shm_config cfg;
+    cfg.name = name;
+
+    cc::vector<cc::string> names;
+    auto same_id = true;
+    {
+        auto _ = rlog::scoped_logger_override(rlog::make_shm_logger(cfg));
+
+        // the reader is already past the first definition when the thread is renamed
+        rlog::shm_reader reader(name);
+        auto const on_message = [&](rlog::message_ref const& m)
+        {
+            names.push_back(m.thread_name);
+            same_id &= m.thread_id == rlog::get_current_thread_id();
+        };
+
+        rlog::set_current_thread_name("before");
+        LOG("one");
+        CHECK(reader.read(on_message) == 1);
+
+        LOG("two");
+        rlog::set_current_thread_name("after");
+        LOG("three");
+        rlog::set_current_thread_name(nullptr);
+        LOG("four");
+        CHECK(reader.read(on_message) == 3);
+        reader.remove_segment();
+    }
+
+    CHECK(same_id);
+    CHECK(names.size() == 4);
+    if (names.size() == 4)
+    {
+        CHECK(names[0] == "before");
+        CHECK(names[1] == "before");
+        CHECK(names[2] == "after");
+        CHECK(names[3] == "");
+    }
+}
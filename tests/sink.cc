@@ -0,0 +1,152 @@
+#include <nexus/test.hh>
+
+#include <mutex>
+
+#include <clean-core/string.hh>
+#include <clean-core/vector.hh>
+
+#include <rich-log/log.hh>
+#include <rich-log/logger.hh>
+#include <rich-log/sink.hh>
+
+RICH_LOG_DECLARE_DOMAIN(Test);
+RICH_LOG_DECLARE_DOMAIN(SinkNet);
+RICH_LOG_DECLARE_DOMAIN(SinkNet::Http);
+RICH_LOG_DEFINE_DOMAIN(SinkNet, "SinkNet");
+RICH_LOG_DEFINE_DOMAIN(SinkNet::Http, "SinkNet::Http");
+
+namespace
+{
+struct collecting_sink final : rlog::sink
+{
+    cc::vector<cc::string>* messages;
+    int* flush_cnt;
+
+    collecting_sink(cc::vector<cc::string>* messages, int* flush_cnt) : messages(messages), flush_cnt(flush_cnt) {}
+
+    void write(rlog::message_ref const& msg) override
+    {
+        static std::mutex m;
+        auto _ = std::lock_guard<std::mutex>(m);
+        messages->push_back(msg.message);
+    }
+
+    void flush() override { ++*flush_cnt; }
+};
+
+// logs and flushes again while being flushed, like a Fatal message from within flush would
+struct reentrant_sink final : rlog::sink
+{
+    cc::vector<cc::string> messages;
+    int flush_cnt = 0;
+
+    void write(rlog::message_ref const& msg) override { messages.push_back(msg.message); }
+
+    void flush() override
+    {
+        if (++flush_cnt > 1)
+            return;
+
+        LOGD(Test, Info, "flushing");
+        rlog::flush_sinks();
+    }
+};
+}
+
+TEST("sinks")
+{
+    cc::vector<cc::string> all;
+    cc::vector<cc::string> test_warnings;
+    int flush_cnt = 0;
+
+    auto const all_id = rlog::add_sink(cc::make_unique<collecting_sink>(&all, &flush_cnt));
+
+    rlog::sink_filter filter;
+    filter.min_verbosity = rlog::verbosity::Warning;
+    filter.domains = {&Log::Test::domain};
+    auto const warn_id = rlog::add_sink(cc::make_unique<collecting_sink>(&test_warnings, &flush_cnt), filter);
+    CHECK(all_id != rlog::invalid_sink_id);
+    CHECK(warn_id != rlog::invalid_sink_id);
+
+    // masks are precomputed per domain and verbosity
+    CHECK(Log::Test::domain.sink_mask[rlog::verbosity::Info] == uint64_t(1) << all_id);
+    CHECK(Log::Test::domain.sink_mask[rlog::verbosity::Error] == ((uint64_t(1) << all_id) | (uint64_t(1) << warn_id)));
+    CHECK(Log::Default::domain.sink_mask[rlog::verbosity::Error] == uint64_t(1) << all_id);
+
+    LOG("info %d", 1);
+    LOGD(Test, Info, "test info");
+    LOGD(Test, Warning, "test warning");
+    LOG_WARN("default warning");
+
+    CHECK(all.size() == 4);
+    CHECK(test_warnings.size() == 1);
+    CHECK(test_warnings.back() == "test warning");
+
+    rlog::flush_sinks();
+    CHECK(flush_cnt == 2);
+
+    // nobody wants Test::Info anymore
+    rlog::set_sink_filter(all_id, filter);
+    CHECK(Log::Test::domain.sink_mask[rlog::verbosity::Info] == 0);
+
+    LOGD(Test, Info, "skipped");
+    LOGD(Test, Error, "test error");
+    CHECK(all.size() == 5);
+    CHECK(test_warnings.size() == 2);
+
+    // user-defined global logger gets everything
+    cc::string global_msg;
+    rlog::set_global_default_logger(
+        [&](rlog::message_ref m, bool&)
+        {
+            global_msg = m.message;
+            return false; // continue to sinks
+        });
+    CHECK(Log::Test::domain.sink_mask[rlog::verbosity::Info] == 1);
+
+    LOGD(Test, Error, "global");
+    CHECK(global_msg == "global");
+    CHECK(all.back() == "global");
+
+    rlog::set_global_default_logger({});
+    rlog::remove_sink(all_id);
+    rlog::remove_sink(warn_id);
+
+    // back to the built-in default logger
+    CHECK(Log::Test::domain.sink_mask[rlog::verbosity::Info] == 1);
+}
+
+TEST("sink domain filter")
+{
+    cc::vector<cc::string> net;
+    int flush_cnt = 0;
+
+    // a filter also matches the descendants of its domains
+    rlog::sink_filter filter;
+    filter.domains = {&Log::SinkNet::domain};
+    auto const id = rlog::add_sink(cc::make_unique<collecting_sink>(&net, &flush_cnt), filter);
+    CHECK(Log::SinkNet::Http::domain.sink_mask[rlog::verbosity::Info] == uint64_t(1) << id);
+    CHECK(Log::Test::domain.sink_mask[rlog::verbosity::Info] == 0);
+
+    LOGD(SinkNet, Info, "net");
+    LOGD(SinkNet::Http, Info, "http");
+    LOGD(Test, Info, "test");
+    CHECK(net.size() == 2);
+
+    rlog::remove_sink(id);
+    CHECK(Log::SinkNet::Http::domain.sink_mask[rlog::verbosity::Info] == 1);
+}
+
+TEST("sink flush reentrancy")
+{
+    auto sink = cc::make_unique<reentrant_sink>();
+    auto const& flushed = *sink;
+    auto const id = rlog::add_sink(cc::move(sink));
+
+    // sinks are flushed without holding the registry lock
+    rlog::flush_sinks();
+    CHECK(flushed.flush_cnt == 2);
+    CHECK(flushed.messages.size() == 1);
+
+    rlog::remove_sink(id);
+}
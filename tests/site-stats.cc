@@ -0,0 +1,107 @@
+#include <nexus/test.hh>
+
+#include <clean-core/string.hh>
+
+#include <rich-log/log.hh>
+#include <rich-log/logger.hh>
+#include <rich-log/site_stats.hh>
+
+namespace
+{
+// position of the first occurrence, or -1
+int find(cc::string_view s, cc::string_view needle)
+{
+    for (size_t i = 0; i + needle.size() <= s.size(); ++i)
+        if (s.subview(i, needle.size()) == needle)
+            return int(i);
+    return -1;
+}
+
+rlog::log_site_stats const* find_site(cc::vector<rlog::log_site_stats> const& stats, int line)
+{
+    for (auto const& s : stats)
+        if (s.site->line == line && find(s.site->file, "site-stats.cc") >= 0)
+            return &s;
+    return nullptr;
+}
+}
+
+TEST("log site stats")
+{
+    auto _ = rlog::scoped_logger_override([](rlog::message_ref, bool&) { return true; });
+
+    // nothing is counted while disabled
+    LOG("not counted");
+    auto const not_counted_line = __LINE__ - 1;
+    CHECK(find_site(rlog::get_log_site_stats(), not_counted_line) == nullptr);
+
+    rlog::enable_log_site_stats();
+    CHECK(rlog::is_log_site_stats_enabled());
+
+    static rlog::rate::every_nth limiter{4};
+    for (auto i = 0; i < 8; ++i)
+    {
+        LOG("emitted %d", i);
+        LOGD(Default, Debug, "filtered %d", i);
+        LOGD_ONCE(limiter, Default, Info, "limited %d", i);
+    }
+    auto const emitted_line = __LINE__ - 4;
+    auto const filtered_line = __LINE__ - 4;
+    auto const limited_line = __LINE__ - 4;
+
+    rlog::enable_log_site_stats(false);
+    LOG("emitted %d", 100); // not counted anymore
+
+    auto const stats = rlog::get_log_site_stats();
+    auto const emitted = find_site(stats, emitted_line);
+    auto const filtered = find_site(stats, filtered_line);
+    auto const limited = find_site(stats, limited_line);
+
+    CHECK(emitted != nullptr);
+    CHECK(emitted->emitted == 8);
+    CHECK(emitted->filtered == 0);
+    CHECK(emitted->bytes == 8 * cc::string_view("emitted 0").size());
+    CHECK(emitted->ns > 0);
+
+    CHECK(filtered != nullptr);
+    CHECK(filtered->emitted == 0);
+    CHECK(filtered->filtered == 8);
+    CHECK(filtered->ns == 0);
+
+    CHECK(limited != nullptr);
+    CHECK(limited->emitted == 2);
+    CHECK(limited->suppressed == 6);
+
+    // sorted by time spent
+    for (size_t i = 1; i < stats.size(); ++i)
+        CHECK(stats[i - 1].ns >= stats[i].ns);
+
+    cc::string report;
+    rlog::append_log_hotspots(report, 100);
+    CHECK(find(report, "log hotspots") == 0);
+    CHECK(find(report, "site-stats.cc:") > 0);
+
+    rlog::reset_log_site_stats();
+    CHECK(find_site(rlog::get_log_site_stats(), emitted_line)->emitted == 0);
+}
+
+TEST("log site stats of unregistered domains")
+{
+    rlog::enable_log_site_stats();
+
+    // like a shared library that logs and is unloaded, its sites must not be visited anymore
+    rlog::location plugin_location = {"plugin", __FILE__, __LINE__};
+    auto const plugin_line = __LINE__ - 1;
+    rlog::domain_info plugin = rlog::domain_info::make_named("StatsPlugin");
+    {
+        auto const reg = rlog::detail::domain_registerer(&plugin);
+        rlog::detail::count_filtered(plugin, plugin_location);
+        CHECK(find_site(rlog::get_log_site_stats(), plugin_line) != nullptr);
+    }
+
+    CHECK(find_site(rlog::get_log_site_stats(), plugin_line) == nullptr);
+    CHECK(plugin_location.stats.load() == nullptr);
+    CHECK(rlog::set_site_break_on_log("site-stats.cc", plugin_line, true) == 0);
+
+    rlog::enable_log_site_stats(false);
+}
@@ -0,0 +1,178 @@
+#include <nexus/test.hh>
+
+#include <mutex>
+
+#include <clean-core/string.hh>
+#include <clean-core/vector.hh>
+
+#include <rich-log/async.hh>
+#include <rich-log/log.hh>
+#include <rich-log/log_line.hh>
+#include <rich-log/logger.hh>
+#include <rich-log/sink.hh>
+#include <rich-log/structured_sink.hh>
+
+RICH_LOG_DECLARE_DOMAIN(Structured);
+RICH_LOG_DEFINE_DOMAIN(Structured, "Structured");
+
+namespace
+{
+struct vec2
+{
+    int x, y;
+};
+
+cc::string to_string(vec2 const& v) { return cc::to_string(v.x) + "," + cc::to_string(v.y); }
+
+// a captured message_ref with copied fields
+struct structured_capture
+{
+    cc::string message;
+    cc::vector<rlog::field> fields;
+    cc::vector<cc::string> values;
+
+    void set(rlog::message_ref const& m)
+    {
+        message = m.message;
+        fields.clear();
+        values.clear();
+        for (auto const& f : m.fields)
+        {
+            fields.push_back(f);
+
+            cc::string v;
+            f.format_value([&](cc::span<char const> chars) { v += cc::string_view(chars.data(), chars.size()); });
+            values.push_back(v);
+        }
+    }
+};
+
+rlog::message_ref make_message(cc::string_view text, cc::span<rlog::field const> fields)
+{
+    static rlog::location location = {"handle_request", "server.cc", 42};
+
+    rlog::message_ref msg;
+    msg.timestamp.wall_ns = 951782400'000000123; // 2000-02-29
+    msg.location = &location;
+    msg.domain = &Log::Structured::domain;
+    msg.verbosity = rlog::verbosity::Warning;
+    msg.thread_name = "main";
+    msg.message = text;
+    msg.fields = fields;
+    return msg;
+}
+}
+
+TEST("structured logging")
+{
+    structured_capture c;
+    auto _ = rlog::scoped_logger_override(
+        [&](rlog::message_ref m, bool&)
+        {
+            c.set(m);
+            return true;
+        });
+
+    cc::string path = "/index.html";
+    LOGS(Structured, Info, "request done", rlog::kv("latency_us", 17), rlog::kv("path", path), rlog::kv("ok", true), //
+         rlog::kv("load", 0.5), rlog::kv("bytes", uint64_t(1) << 40), rlog::kv("size", vec2{3, 4}));
+
+    CHECK(c.message == "request done");
+    CHECK(c.fields.size() == 6);
+
+    CHECK(c.fields[0].key == "latency_us");
+    CHECK(c.fields[0].type == rlog::field_type::signed_int);
+    CHECK(c.fields[0].i == 17);
+
+    CHECK(c.fields[1].type == rlog::field_type::string);
+    CHECK(c.fields[1].str == "/index.html");
+
+    CHECK(c.fields[2].type == rlog::field_type::boolean);
+    CHECK(c.fields[2].b);
+
+    CHECK(c.fields[3].type == rlog::field_type::floating_point);
+    CHECK(c.fields[3].f == 0.5);
+
+    CHECK(c.fields[4].type == rlog::field_type::unsigned_int);
+    CHECK(c.fields[4].u == uint64_t(1) << 40);
+
+    CHECK(c.fields[5].type == rlog::field_type::other);
+    CHECK(c.values[5] == "3,4");
+
+    LOGS(Structured, Info, "no fields");
+    CHECK(c.message == "no fields");
+    CHECK(c.fields.empty());
+
+    // regular LOGs have no fields
+    LOG("plain");
+    CHECK(c.fields.empty());
+}
+
+TEST("structured log lines")
+{
+    auto const value = vec2{1, 2};
+    rlog::field fields[3];
+    fields[0].key = "latency_us";
+    fields[0].type = rlog::field_type::signed_int;
+    fields[0].i = -17;
+    fields[1].key = "path";
+    fields[1].type = rlog::field_type::string;
+    fields[1].str = "/a b\"c";
+    fields[2] = rlog::detail::make_field(rlog::kv("v", value));
+
+    auto const msg = make_message("request done", fields);
+
+    cc::string json;
+    rlog::append_json_line(json, msg);
+    CHECK(json
+          == "{\"time\":\"2000-02-29T00:00:00.000000123Z\",\"level\":\"warning\",\"domain\":\"Structured\",\"thread\":\"main\","
+             "\"file\":\"server.cc\",\"line\":42,\"msg\":\"request done\",\"latency_us\":-17,\"path\":\"/a b\\\"c\",\"v\":\"1,2\"}\n");
+
+    cc::string logfmt;
+    rlog::append_logfmt_line(logfmt, msg);
+    CHECK(logfmt
+          == "time=2000-02-29T00:00:00.000000123Z level=warning domain=Structured thread=main msg=\"request done\" "
+             "latency_us=-17 path=\"/a b\\\"c\" v=1,2\n");
+
+    // text lines append the fields
+    cc::string line;
+    rlog::append_log_line(line, msg, rlog::console_log_style::message_only);
+    CHECK(line == "request done latency_us=-17 path=\"/a b\\\"c\" v=1,2\n");
+}
+
+TEST("structured sinks")
+{
+    std::mutex mutex;
+    cc::vector<cc::string> lines;
+    auto const collect = [&](rlog::message_ref const&, cc::string_view line)
+    {
+        auto _ = std::lock_guard<std::mutex>(mutex);
+        lines.push_back(line);
+    };
+
+    auto const json_id = rlog::add_sink(cc::make_unique<rlog::json_lines_sink>(collect));
+    auto const logfmt_id = rlog::add_sink(cc::make_unique<rlog::logfmt_sink>(collect));
+
+    auto const ends_with = [](cc::string_view s, cc::string_view suffix)
+    { return s.size() >= suffix.size() && s.subview(s.size() - suffix.size()) == suffix; };
+
+    // values of type 'other' are formatted before they go to the background thread
+    rlog::async::enable();
+    {
+        auto const v = vec2{5, 6};
+        LOGS(Structured, Info, "async", rlog::kv("v", v), rlog::kv("n", 3), rlog::kv("s", "text"));
+    }
+    rlog::async::flush();
+    rlog::async::shutdown();
+
+    LOGS(Structured, Info, "sync", rlog::kv("n", 4));
+
+    rlog::remove_sink(json_id);
+    rlog::remove_sink(logfmt_id);
+
+    CHECK(lines.size() == 4);
+    CHECK(ends_with(lines[0], "\"msg\":\"async\",\"v\":\"5,6\",\"n\":3,\"s\":\"text\"}\n"));
+    CHECK(ends_with(lines[1], "msg=async v=5,6 n=3 s=text\n"));
+    CHECK(ends_with(lines[2], "\"msg\":\"sync\",\"n\":4}\n"));
+    CHECK(ends_with(lines[3], "msg=sync n=4\n"));
+}
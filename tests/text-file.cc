@@ -0,0 +1,337 @@
+#include <nexus/test.hh>
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include <clean-core/macros.hh>
+#include <clean-core/string.hh>
+#include <clean-core/vector.hh>
+
+#include <rich-log/gzip.hh>
+#include <rich-log/log.hh>
+#include <rich-log/logger.hh>
+#include <rich-log/text_file_logger.hh>
+
+#ifndef CC_OS_WINDOWS
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+cc::string text_test_file(int index, char const* extension = "log")
+{
+    char path[64];
+    std::snprintf(path, sizeof(path), "rlog-test-text.%06d.%s", index, extension);
+    return path;
+}
+
+// returns false if the file does not exist
+bool read_file(char const* path, cc::string& content)
+{
+    content.clear();
+    auto const file = std::fopen(path, "rb");
+    if (!file)
+        return false;
+
+    char buffer[256];
+    while (auto const n = std::fread(buffer, 1, sizeof(buffer), file))
+        content += cc::string_view(buffer, n);
+    std::fclose(file);
+    return true;
+}
+
+uint32_t read_le32(char const* p)
+{
+    uint32_t v = 0;
+    for (auto i = 0; i < 4; ++i)
+        v |= uint32_t(uint8_t(p[i])) << (8 * i);
+    return v;
+}
+
+// minimal gzip decoder for round trips, only stored and fixed Huffman blocks (the encoder writes the latter)
+// returns false if the input is malformed or does not match its trailer
+bool gunzip(cc::string_view gz, cc::string& out)
+{
+    out.clear();
+    if (gz.size() < 18 || uint8_t(gz[0]) != 0x1f || uint8_t(gz[1]) != 0x8b || gz[2] != 8 || gz[3] != 0)
+        return false;
+
+    auto const end = gz.size() - 8; // trailer
+    size_t pos = 10;
+    uint32_t bit_buffer = 0;
+    auto bit_count = 0;
+    auto is_truncated = false;
+
+    // deflate values are packed starting at the least significant bit
+    auto const bits = [&](int n)
+    {
+        while (bit_count < n)
+        {
+            if (pos >= end)
+            {
+                is_truncated = true;
+                return uint32_t(0);
+            }
+            bit_buffer |= uint32_t(uint8_t(gz[pos++])) << bit_count;
+            bit_count += 8;
+        }
+        auto const v = bit_buffer & ((1u << n) - 1);
+        bit_buffer >>= n;
+        bit_count -= n;
+        return v;
+    };
+
+    // Huffman codes are packed starting at their most significant bit
+    auto const code_bits = [&](uint32_t code, int n)
+    {
+        for (auto i = 0; i < n; ++i)
+            code = code << 1 | bits(1);
+        return code;
+    };
+
+    static int const length_base[] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                      31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static int const length_extra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static int const distance_base[] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+                                        193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    static int const distance_extra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    auto is_final = false;
+    while (!is_final && !is_truncated)
+    {
+        is_final = bits(1) == 1;
+        auto const type = bits(2);
+
+        if (type == 0)
+        {
+            // byte-aligned LEN and NLEN, then the raw bytes
+            bit_buffer = 0;
+            bit_count = 0;
+            if (pos + 4 > end)
+                return false;
+            auto const len = size_t(uint8_t(gz[pos])) | size_t(uint8_t(gz[pos + 1])) << 8;
+            pos += 4;
+            if (pos + len > end)
+                return false;
+            out += gz.subview(pos, len);
+            pos += len;
+            continue;
+        }
+
+        if (type != 1)
+            return false;
+
+        while (!is_truncated)
+        {
+            // 7 bit codes for 256-279, 8 bit codes for 0-143 and 280-287, 9 bit codes for 144-255
+            int symbol;
+            auto code = code_bits(0, 7);
+            if (code <= 0x17)
+                symbol = int(code) + 256;
+            else
+            {
+                code = code_bits(code, 1);
+                if (code >= 0x30 && code <= 0xBF)
+                    symbol = int(code) - 0x30;
+                else if (code >= 0xC0 && code <= 0xC7)
+                    symbol = int(code) - 0xC0 + 280;
+                else
+                    symbol = int(code_bits(code, 1)) - 0x190 + 144;
+            }
+
+            if (symbol < 256)
+                out += char(symbol);
+            else if (symbol == 256)
+                break;
+            else if (symbol > 285)
+                return false;
+            else
+            {
+                auto const length = length_base[symbol - 257] + int(bits(length_extra[symbol - 257]));
+                auto const distance_code = code_bits(0, 5);
+                if (distance_code >= 30)
+                    return false;
+
+                auto const distance = size_t(distance_base[distance_code]) + bits(distance_extra[distance_code]);
+                if (distance > out.size())
+                    return false;
+
+                // copied byte by byte, the source can overlap the output
+                for (auto i = 0; i < length; ++i)
+                    out += out[out.size() - distance];
+            }
+        }
+    }
+
+    return !is_truncated && read_le32(gz.data() + end) == rlog::update_crc32(0, cc::span<char const>(out.data(), out.size()))
+           && read_le32(gz.data() + end + 4) == uint32_t(out.size());
+}
+
+void remove_test_files()
+{
+    for (auto i = 0; i < 8; ++i)
+    {
+        std::remove(text_test_file(i).c_str());
+        std::remove(text_test_file(i, "log.gz").c_str());
+    }
+}
+}
+
+TEST("gzip encoder")
+{
+    // standard check value
+    CHECK(rlog::update_crc32(0, cc::span<char const>("123456789", 9)) == 0xCBF43926u);
+    CHECK(rlog::update_crc32(rlog::update_crc32(0, cc::span<char const>("1234", 4)), cc::span<char const>("56789", 5)) == 0xCBF43926u);
+
+    cc::string text;
+    for (auto i = 0; i < 20000; ++i)
+    {
+        char line[64];
+        auto const n = std::snprintf(line, sizeof(line), "12:00:%02d INFO Net request %d done\n", i % 60, i);
+        text += cc::string_view(line, size_t(n));
+    }
+
+    cc::string out;
+    rlog::gzip_encoder enc;
+    enc.append(cc::span<char const>(text.data(), text.size() / 2), out);
+    enc.append(cc::span<char const>(text.data() + text.size() / 2, text.size() - text.size() / 2), out);
+    enc.finish(out);
+
+    CHECK(out.size() > 18);
+    CHECK(out.size() < text.size() / 3);
+    if (out.size() > 18)
+    {
+        CHECK(uint8_t(out[0]) == 0x1f);
+        CHECK(uint8_t(out[1]) == 0x8b);
+        CHECK(out[2] == 8); // deflate
+        CHECK(read_le32(out.data() + out.size() - 8) == rlog::update_crc32(0, cc::span<char const>(text.data(), text.size())));
+        CHECK(read_le32(out.data() + out.size() - 4) == uint32_t(text.size()));
+    }
+
+    cc::string decoded;
+    CHECK(gunzip(out, decoded));
+    CHECK(decoded == text);
+
+    // empty input is still a valid file (header, empty block, trailer)
+    cc::string empty_out;
+    rlog::gzip_encoder empty_enc;
+    empty_enc.finish(empty_out);
+    CHECK(empty_out.size() == 20);
+    CHECK(gunzip(empty_out, decoded));
+    CHECK(decoded.empty());
+}
+
+TEST("text file logger")
+{
+    remove_test_files();
+
+    rlog::text_file_config cfg;
+    cfg.path_prefix = "rlog-test-text";
+    cfg.style = rlog::console_log_style::message_only;
+    cfg.max_file_size = 20;
+    cfg.max_files = 2;
+    cfg.compress = false;
+    cfg.flush_interval_ms = 0;
+
+    cc::string content;
+    {
+        auto logger = rlog::text_file_logger(cfg);
+        CHECK(logger.is_valid());
+
+        auto const log = [&](char const* text)
+        {
+            rlog::message_ref msg;
+            msg.verbosity = rlog::verbosity::Info;
+            msg.message = text;
+            logger.write(msg);
+        };
+
+        // each file ends with the line that reaches max_file_size
+        log("first message");  // 14 bytes
+        log("second message"); // 29 bytes, rotates
+        log("third");
+        log("fourth");
+        log("fifth message"); // rotates
+        log("sixth");
+        log("current");
+
+        // lines are collected until flushed (the file itself is created by the background thread)
+        CHECK(!read_file(text_test_file(2).c_str(), content) || content.empty());
+        logger.flush();
+        CHECK(read_file(text_test_file(2).c_str(), content));
+        CHECK(content == "sixth\ncurrent\n");
+    }
+
+    // only the 2 newest closed files are kept
+    CHECK(!read_file(text_test_file(0).c_str(), content));
+    CHECK(read_file(text_test_file(1).c_str(), content));
+    CHECK(content == "third\nfourth\nfifth message\n");
+    CHECK(read_file(text_test_file(2).c_str(), content));
+    CHECK(content == "sixth\ncurrent\n");
+
+    remove_test_files();
+
+    // closed files are compressed
+    cfg.compress = true;
+    cfg.max_files = 0;
+    {
+        auto _ = rlog::scoped_logger_override(rlog::make_text_file_logger(cfg));
+        LOG("a message that is long enough to rotate");
+        LOG("another one");
+    }
+
+    CHECK(!read_file(text_test_file(0).c_str(), content));
+    CHECK(read_file(text_test_file(0, "log.gz").c_str(), content));
+    cc::string decoded;
+    CHECK(gunzip(content, decoded));
+    CHECK(decoded == "a message that is long enough to rotate\n");
+    CHECK(read_file(text_test_file(1, "log.gz").c_str(), content));
+    CHECK(gunzip(content, decoded));
+    CHECK(decoded == "another one\n");
+
+    remove_test_files();
+}
+
+#ifndef CC_OS_WINDOWS
+TEST("text file logger missing directory")
+{
+    auto const dir = "rlog-test-text-dir";
+    std::remove("rlog-test-text-dir/log.000000.log");
+    ::rmdir(dir);
+
+    rlog::text_file_config cfg;
+    cfg.path_prefix = "rlog-test-text-dir/log";
+    cfg.style = rlog::console_log_style::message_only;
+    cfg.compress = false;
+    cfg.flush_interval_ms = 10;
+
+    cc::string content;
+    {
+        auto logger = rlog::text_file_logger(cfg);
+        CHECK(!logger.is_valid());
+
+        rlog::message_ref msg;
+        msg.verbosity = rlog::verbosity::Info;
+        msg.message = "dropped";
+        logger.write(msg);
+
+        // the background thread creates the file once its directory exists
+        ::mkdir(dir, 0700);
+        for (auto i = 0; i < 500 && !logger.is_valid(); ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        CHECK(logger.is_valid());
+
+        msg.message = "written";
+        logger.write(msg);
+        logger.flush();
+    }
+
+    CHECK(read_file("rlog-test-text-dir/log.000000.log", content));
+    CHECK(content == "written\n");
+
+    std::remove("rlog-test-text-dir/log.000000.log");
+    ::rmdir(dir);
+}
+#endif
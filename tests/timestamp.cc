@@ -0,0 +1,55 @@
+#include <nexus/test.hh>
+
+#include <cstring>
+#include <ctime>
+
+#include <rich-log/log.hh>
+#include <rich-log/logger.hh>
+#include <rich-log/timestamp.hh>
+
+TEST("timestamps")
+{
+    auto const t0 = rlog::get_current_timestamp();
+    auto const t1 = rlog::get_current_timestamp();
+
+    CHECK(t1.monotonic_ns >= t0.monotonic_ns);
+    // equal unless the wall clock offset was recalibrated in between
+    auto const drift = (t1.wall_ns - t0.wall_ns) - (t1.monotonic_ns - t0.monotonic_ns);
+    CHECK(-1'000'000 < drift && drift < 1'000'000);
+
+    // wall clock agrees with std::time
+    auto const diff = t0.to_time_t() - std::time(nullptr);
+    CHECK(-2 <= diff && diff <= 2);
+
+    char buffer[20];
+    CHECK(rlog::write_time_of_day(buffer, sizeof(buffer), t0) == 8);
+    CHECK(std::strlen(buffer) == 8);
+    CHECK(buffer[2] == ':');
+    CHECK(buffer[5] == ':');
+
+    CHECK(rlog::write_time_of_day(buffer, sizeof(buffer), t0, 6) == 15);
+    CHECK(buffer[8] == '.');
+
+    rlog::timestamp ts;
+    ts.wall_ns = 1'500'000'123;
+    CHECK(ts.to_time_t() == 1);
+    CHECK(ts.subsecond_ns() == 500'000'123);
+}
+
+TEST("message timestamps")
+{
+    rlog::timestamp ts;
+    auto _ = rlog::scoped_logger_override(
+        [&](rlog::message_ref m, bool&)
+        {
+            ts = m.timestamp;
+            return true;
+        });
+
+    auto const before = rlog::get_current_timestamp();
+    LOG("hello");
+    auto const after = rlog::get_current_timestamp();
+
+    CHECK(before.monotonic_ns <= ts.monotonic_ns);
+    CHECK(ts.monotonic_ns <= after.monotonic_ns);
+}
@@ -1,5 +1,8 @@
 #include <nexus/test.hh>
 
+#include <atomic>
+#include <thread>
+
 #include <rich-log/log.hh>
 #include <rich-log/logger.hh>
 
@@ -34,3 +37,75 @@ TEST("domain min verbosity")
     LOGD(Test, Trace, "nope, this removed compile-time");
     CHECK(msg == "now you see me");
 }
+
+RICH_LOG_DECLARE_DOMAIN(VerbosityGlob::Mesh::FBX);
+RICH_LOG_DECLARE_DOMAIN(VerbosityGlob::Mesh::OBJ);
+RICH_LOG_DECLARE_DOMAIN(VerbosityGlob::Net);
+RICH_LOG_DEFINE_DOMAIN(VerbosityGlob::Mesh::FBX, "VerbosityGlob::Mesh::FBX");
+RICH_LOG_DEFINE_DOMAIN(VerbosityGlob::Mesh::OBJ, "VerbosityGlob::Mesh::OBJ");
+RICH_LOG_DEFINE_DOMAIN(VerbosityGlob::Net, "VerbosityGlob::Net");
+
+TEST("domain pattern matching")
+{
+    CHECK(rlog::matches_domain_pattern("Engine::Mesh::FBX", "Engine::Mesh::FBX"));
+    CHECK(rlog::matches_domain_pattern("Engine::Mesh::FBX", "Engine::Mesh::*"));
+    CHECK(rlog::matches_domain_pattern("Engine::Mesh::FBX", "Engine::*"));
+    CHECK(rlog::matches_domain_pattern("Engine::Mesh::FBX", "*::FBX"));
+    CHECK(rlog::matches_domain_pattern("Engine::Mesh::FBX", "*"));
+    CHECK(rlog::matches_domain_pattern("Engine::Mesh::FBX", "Engine::Mesh::?BX"));
+    CHECK(rlog::matches_domain_pattern("Engine::Mesh::FBX", "E*M*X"));
+
+    CHECK(!rlog::matches_domain_pattern("Engine::Mesh::FBX", "Engine::Mesh"));
+    CHECK(!rlog::matches_domain_pattern("Engine::Mesh::FBX", "Engine::Net::*"));
+    CHECK(!rlog::matches_domain_pattern("Engine::Mesh::FBX", "*::OBJ"));
+    CHECK(!rlog::matches_domain_pattern("Engine", "Engine::*"));
+}
+
+TEST("set min verbosity by pattern")
+{
+    cc::string msg;
+    auto _ = rlog::scoped_logger_override(
+        [&](rlog::message_ref m, bool&)
+        {
+            msg = m.message;
+            return true;
+        });
+
+    CHECK(rlog::set_min_verbosity("VerbosityGlob::Mesh::*", rlog::verbosity::Debug) == 2);
+    CHECK(Log::VerbosityGlob::Mesh::FBX::domain.min_verbosity == rlog::verbosity::Debug);
+    CHECK(Log::VerbosityGlob::Mesh::OBJ::domain.min_verbosity == rlog::verbosity::Debug);
+    CHECK(Log::VerbosityGlob::Net::domain.min_verbosity == rlog::verbosity::Info);
+
+    LOGD(VerbosityGlob::Mesh::FBX, Debug, "fbx debug");
+    CHECK(msg == "fbx debug");
+
+    LOGD(VerbosityGlob::Net, Debug, "net debug");
+    CHECK(msg == "fbx debug");
+
+    CHECK(rlog::set_min_verbosity("VerbosityGlob::*", rlog::verbosity::Error) == 3);
+    LOGD(VerbosityGlob::Mesh::OBJ, Warning, "obj warning");
+    CHECK(msg == "fbx debug");
+
+    CHECK(rlog::set_min_verbosity("NoSuchDomain::*", rlog::verbosity::Trace) == 0);
+
+    // changing levels while other threads log is safe
+    auto logged = std::atomic<int>(0);
+    std::thread logger_thread(
+        [&]
+        {
+            auto _ = rlog::scoped_logger_override(
+                [&](rlog::message_ref, bool&)
+                {
+                    ++logged;
+                    return true;
+                });
+            for (auto i = 0; i < 10000; ++i)
+                LOGD(VerbosityGlob::Net, Debug, "value %d", i);
+        });
+    for (auto i = 0; i < 1000; ++i)
+        rlog::set_min_verbosity("VerbosityGlob::Net", i % 2 == 0 ? rlog::verbosity::Debug : rlog::verbosity::Info);
+    logger_thread.join();
+    CHECK(logged.load() <= 10000);
+
+    rlog::set_min_verbosity("VerbosityGlob::*", rlog::verbosity::Info);
+}
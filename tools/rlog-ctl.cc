@@ -0,0 +1,113 @@
+#include <cstdio>
+#include <cstring>
+
+#include <clean-core/macros.hh>
+#include <clean-core/string.hh>
+
+#ifndef CC_OS_WINDOWS
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// sends a command to a process that serves rlog::control (see control.hh) and prints the answer
+//
+// Usage:
+//
+//   rlog-ctl <pid or socket path> <command...>
+//
+//   rlog-ctl 12345 help
+//   rlog-ctl 12345 level "MyEngine::Net::*" debug
+//   rlog-ctl /run/my-server/rlog.sock stats
+
+namespace
+{
+void print_usage() { std::fprintf(stderr, "usage: rlog-ctl <pid or socket path> <command...> (see 'rlog-ctl <pid> help')\n"); }
+
+bool is_number(char const* s)
+{
+    for (auto p = s; *p != '\0'; ++p)
+        if (*p < '0' || *p > '9')
+            return false;
+    return *s != '\0';
+}
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        print_usage();
+        return 1;
+    }
+
+#ifdef CC_OS_WINDOWS
+    (void)argv;
+    std::fprintf(stderr, "[rlog-ctl] the control socket is not supported on this platform\n");
+    return 1;
+#else
+    // a pid means the default path of rlog::control::start
+    char path[128];
+    if (is_number(argv[1]))
+        std::snprintf(path, sizeof(path), "/tmp/rlog-%s.sock", argv[1]);
+    else
+        std::snprintf(path, sizeof(path), "%s", argv[1]);
+
+    cc::string command;
+    for (auto i = 2; i < argc; ++i)
+    {
+        if (i > 2)
+            command += ' ';
+        command += argv[i];
+    }
+    command += '\n';
+
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (std::strlen(path) >= sizeof(addr.sun_path))
+    {
+        std::fprintf(stderr, "[rlog-ctl] socket path too long: %s\n", path);
+        return 1;
+    }
+    std::memcpy(addr.sun_path, path, std::strlen(path));
+
+    auto const fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr const*>(&addr), sizeof(addr)) != 0)
+    {
+        std::fprintf(stderr, "[rlog-ctl] unable to connect to %s (is rlog::control::start called?)\n", path);
+        return 1;
+    }
+
+    for (size_t sent = 0; sent < command.size();)
+    {
+        auto const n = ::send(fd, command.data() + sent, command.size() - sent, 0);
+        if (n <= 0)
+        {
+            std::fprintf(stderr, "[rlog-ctl] unable to send the command\n");
+            ::close(fd);
+            return 1;
+        }
+        sent += size_t(n);
+    }
+
+    // the answer ends when the process closes the connection
+    auto is_error = false;
+    auto is_first = true;
+    char buffer[4096];
+    while (true)
+    {
+        auto const n = ::recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0)
+            break;
+
+        if (is_first)
+            is_error = n >= 6 && std::memcmp(buffer, "error:", 6) == 0;
+        is_first = false;
+
+        std::fwrite(buffer, 1, size_t(n), stdout);
+    }
+
+    ::close(fd);
+    return is_error ? 1 : 0;
+#endif
+}
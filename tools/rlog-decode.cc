@@ -0,0 +1,97 @@
+#include <cstdio>
+#include <cstring>
+
+#include <clean-core/string.hh>
+
+#include <rich-log/binary_file_logger.hh>
+#include <rich-log/log_line.hh>
+#include <rich-log/logger.hh>
+
+// turns files written by rlog::binary_file_logger back into text
+//
+// Usage:
+//
+//   rlog-decode [--style <style>] <files...>
+//
+//   styles: verbose (default), brief, briefer, message_only, verbose_no_color, verbose_with_location
+
+namespace
+{
+struct style_name
+{
+    char const* name;
+    rlog::console_log_style style;
+};
+
+constexpr style_name style_names[] = {
+    {"verbose", rlog::console_log_style::verbose},
+    {"brief", rlog::console_log_style::brief},
+    {"briefer", rlog::console_log_style::briefer},
+    {"message_only", rlog::console_log_style::message_only},
+    {"verbose_no_color", rlog::console_log_style::verbose_no_color},
+    {"verbose_with_location", rlog::console_log_style::verbose_with_location},
+};
+
+void print_usage()
+{
+    std::fprintf(stderr, "usage: rlog-decode [--style <style>] <files...>\n");
+    std::fprintf(stderr, "styles:");
+    for (auto const& s : style_names)
+        std::fprintf(stderr, " %s", s.name);
+    std::fprintf(stderr, "\n");
+}
+}
+
+int main(int argc, char** argv)
+{
+    auto style = rlog::console_log_style::verbose;
+    auto file_count = 0;
+    auto success = true;
+
+    cc::string line;
+    for (auto i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--style") == 0)
+        {
+            auto found = false;
+            for (auto const& s : style_names)
+                if (i + 1 < argc && std::strcmp(argv[i + 1], s.name) == 0)
+                {
+                    style = s.style;
+                    found = true;
+                }
+
+            if (!found)
+            {
+                print_usage();
+                return 1;
+            }
+
+            ++i;
+            continue;
+        }
+
+        ++file_count;
+        auto const ok = rlog::read_binary_log_file(argv[i],
+                                                   [&](rlog::message_ref const& msg)
+                                                   {
+                                                       line.clear();
+                                                       rlog::append_log_line(line, msg, style);
+                                                       std::fwrite(line.data(), 1, line.size(), stdout);
+                                                   });
+
+        if (!ok)
+        {
+            std::fprintf(stderr, "[rlog-decode] unable to read '%s'\n", argv[i]);
+            success = false;
+        }
+    }
+
+    if (file_count == 0)
+    {
+        print_usage();
+        return 1;
+    }
+
+    return success ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include <clean-core/string.hh>
+
+#include <rich-log/log_line.hh>
+#include <rich-log/logger.hh>
+#include <rich-log/shm_logger.hh>
+
+// prints the messages that a process writes with rlog::shm_logger (or shm_sink)
+// waits for the segment to appear, and ends once the producer is gone and everything is read
+//
+// Usage:
+//
+//   rlog-tail [--style <style>] [--keep] <name>
+//
+//   styles: verbose (default), brief, briefer, message_only, verbose_no_color, verbose_with_location
+//   --keep: do not remove the segment at the end (so it can be read again)
+
+namespace
+{
+struct style_name
+{
+    char const* name;
+    rlog::console_log_style style;
+};
+
+constexpr style_name style_names[] = {
+    {"verbose", rlog::console_log_style::verbose},
+    {"brief", rlog::console_log_style::brief},
+    {"briefer", rlog::console_log_style::briefer},
+    {"message_only", rlog::console_log_style::message_only},
+    {"verbose_no_color", rlog::console_log_style::verbose_no_color},
+    {"verbose_with_location", rlog::console_log_style::verbose_with_location},
+};
+
+void print_usage()
+{
+    std::fprintf(stderr, "usage: rlog-tail [--style <style>] [--keep] <name>\n");
+    std::fprintf(stderr, "styles:");
+    for (auto const& s : style_names)
+        std::fprintf(stderr, " %s", s.name);
+    std::fprintf(stderr, "\n");
+}
+}
+
+int main(int argc, char** argv)
+{
+    auto style = rlog::console_log_style::verbose;
+    auto keep = false;
+    char const* name = nullptr;
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--style") == 0)
+        {
+            auto found = false;
+            for (auto const& s : style_names)
+                if (i + 1 < argc && std::strcmp(argv[i + 1], s.name) == 0)
+                {
+                    style = s.style;
+                    found = true;
+                }
+
+            if (!found)
+            {
+                print_usage();
+                return 1;
+            }
+
+            ++i;
+            continue;
+        }
+
+        if (std::strcmp(argv[i], "--keep") == 0)
+        {
+            keep = true;
+            continue;
+        }
+
+        if (name != nullptr)
+        {
+            print_usage();
+            return 1;
+        }
+        name = argv[i];
+    }
+
+    if (name == nullptr)
+    {
+        print_usage();
+        return 1;
+    }
+
+    rlog::shm_reader reader(name);
+    if (!reader.is_valid())
+        std::fprintf(stderr, "[rlog-tail] waiting for '%s'\n", name);
+
+    cc::string line;
+    auto const print = [&](rlog::message_ref const& msg)
+    {
+        line.clear();
+        rlog::append_log_line(line, msg, style);
+        std::fwrite(line.data(), 1, line.size(), stdout);
+    };
+
+    // idle readers back off up to 10ms
+    auto idle_us = 0;
+    auto reported_drops = uint64_t(0);
+    while (true)
+    {
+        // checked before reading, so the last messages of a finished producer are not missed
+        auto const is_done = reader.is_valid() && reader.is_producer_done();
+
+        if (reader.read(print) > 0)
+        {
+            std::fflush(stdout);
+            idle_us = 0;
+        }
+        else if (is_done)
+            break;
+        else
+        {
+            idle_us = idle_us == 0 ? 50 : (idle_us * 2 < 10000 ? idle_us * 2 : 10000);
+            std::this_thread::sleep_for(std::chrono::microseconds(idle_us));
+        }
+
+        auto const drops = reader.dropped_count();
+        if (drops != reported_drops)
+        {
+            std::fprintf(stderr, "[rlog-tail] %llu message(s) dropped (ring buffer full)\n", (unsigned long long)(drops - reported_drops));
+            reported_drops = drops;
+        }
+    }
+
+    if (!keep)
+        reader.remove_segment();
+
+    return 0;
+}